@@ -0,0 +1,186 @@
+#include "bench.hpp"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <numeric>
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+// bounds the growth of the iteration count between calibration runs
+constexpr double MAX_GROWTH = 10;
+
+std::chrono::nanoseconds time_body(const erd::bench::suite_t::body_t &body,
+                                   std::uint64_t iterations) {
+  auto start = clock_type::now();
+  body(iterations);
+  return clock_type::now() - start;
+}
+
+std::uint64_t calibrate(const erd::bench::suite_t::body_t &body,
+                        std::chrono::nanoseconds min_time) {
+  std::uint64_t iterations = 1;
+  for (;;) {
+    auto elapsed = time_body(body, iterations);
+    if (elapsed >= min_time) {
+      return iterations;
+    }
+    double growth = MAX_GROWTH;
+    if (elapsed.count() > 0) {
+      // overshoot slightly so that the next run is likely to be the last
+      growth = std::min(1.2 * static_cast<double>(min_time.count()) /
+                            static_cast<double>(elapsed.count()),
+                        MAX_GROWTH);
+    }
+    iterations = std::max(
+        iterations + 1,
+        static_cast<std::uint64_t>(static_cast<double>(iterations) * growth));
+  }
+}
+
+erd::bench::result_t summarise(std::string name, std::uint64_t iterations,
+                               std::vector<double> samples) {
+  erd::bench::result_t result;
+  result.name = std::move(name);
+  result.iterations = iterations;
+  result.repetitions = static_cast<unsigned>(samples.size());
+  std::sort(samples.begin(), samples.end());
+  size_t n = samples.size();
+  result.min = samples.front();
+  result.max = samples.back();
+  result.median = n % 2 ? samples[n / 2]
+                        : (samples[n / 2 - 1] + samples[n / 2]) / 2;
+  result.mean = std::accumulate(samples.begin(), samples.end(), 0.0) /
+                static_cast<double>(n);
+  double sq = 0;
+  for (double s : samples) {
+    sq += (s - result.mean) * (s - result.mean);
+  }
+  result.stddev = n > 1 ? std::sqrt(sq / static_cast<double>(n - 1)) : 0;
+  return result;
+}
+
+std::string escape_json(const std::string &str) {
+  std::string retval;
+  retval.reserve(str.size());
+  for (char c : str) {
+    if (c == '"' || c == '\\') {
+      retval += '\\';
+      retval += c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      retval += fmt::format("\\u{:04x}", c);
+    } else {
+      retval += c;
+    }
+  }
+  return retval;
+}
+
+std::string escape_csv(const std::string &str) {
+  if (str.find_first_of(",\"\n") == std::string::npos) {
+    return str;
+  }
+  std::string retval = "\"";
+  for (char c : str) {
+    if (c == '"') {
+      retval += '"';
+    }
+    retval += c;
+  }
+  retval += '"';
+  return retval;
+}
+
+} // namespace
+
+namespace erd::bench {
+
+void suite_t::add(std::string name, body_t body) {
+  benchmarks_.emplace_back(std::move(name), std::move(body));
+}
+
+std::vector<result_t> suite_t::run(const options_t &options) const {
+  std::vector<result_t> results;
+  for (const auto &[name, body] : benchmarks_) {
+    if (name.find(options.filter) == std::string::npos) {
+      continue;
+    }
+    std::cerr << "Running " << name << "\n";
+    std::uint64_t iterations = calibrate(body, options.min_time);
+    std::vector<double> samples;
+    samples.reserve(options.repetitions);
+    for (unsigned i = 0; i < std::max(options.repetitions, 1u); i++) {
+      auto elapsed = time_body(body, iterations);
+      samples.push_back(static_cast<double>(elapsed.count()) /
+                        static_cast<double>(iterations));
+    }
+    results.push_back(summarise(name, iterations, std::move(samples)));
+  }
+  return results;
+}
+
+void report_text(std::ostream &os, const context_t &context,
+                 const std::vector<result_t> &results) {
+  for (const auto &[key, value] : context) {
+    os << fmt::format("{}: {}\n", key, value);
+  }
+  size_t width = 9;
+  for (const result_t &r : results) {
+    width = std::max(width, r.name.size());
+  }
+  os << fmt::format("{:<{}} {:>12} {:>12} {:>12} {:>10} {:>12}\n",
+                    "Benchmark", width, "Median (ns)", "Min (ns)",
+                    "Max (ns)", "Stddev", "Iterations");
+  for (const result_t &r : results) {
+    os << fmt::format("{:<{}} {:>12.1f} {:>12.1f} {:>12.1f} {:>10.1f} {:>12}\n",
+                      r.name, width, r.median, r.min, r.max, r.stddev,
+                      r.iterations);
+  }
+}
+
+void report_json(std::ostream &os, const context_t &context,
+                 const std::vector<result_t> &results) {
+  os << "{\n  \"context\": {";
+  for (size_t i = 0; i < context.size(); i++) {
+    os << fmt::format("{}\n    \"{}\": \"{}\"", i ? "," : "",
+                      escape_json(context[i].first),
+                      escape_json(context[i].second));
+  }
+  os << "\n  },\n  \"benchmarks\": [";
+  for (size_t i = 0; i < results.size(); i++) {
+    const result_t &r = results[i];
+    os << fmt::format("{}\n    {{\"name\": \"{}\", \"iterations\": {}, "
+                      "\"repetitions\": {}, \"unit\": \"ns\", "
+                      "\"min\": {:.3f}, \"median\": {:.3f}, \"mean\": {:.3f}, "
+                      "\"max\": {:.3f}, \"stddev\": {:.3f}}}",
+                      i ? "," : "", escape_json(r.name), r.iterations,
+                      r.repetitions, r.min, r.median, r.mean, r.max,
+                      r.stddev);
+  }
+  os << "\n  ]\n}\n";
+}
+
+void report_csv(std::ostream &os, const context_t &context,
+                const std::vector<result_t> &results) {
+  // the context is repeated on every row so that files can be concatenated
+  os << "name,iterations,repetitions,min_ns,median_ns,mean_ns,max_ns,stddev_ns";
+  for (const auto &[key, value] : context) {
+    os << "," << escape_csv(key);
+  }
+  os << "\n";
+  for (const result_t &r : results) {
+    os << fmt::format("{},{},{},{:.3f},{:.3f},{:.3f},{:.3f},{:.3f}",
+                      escape_csv(r.name), r.iterations, r.repetitions, r.min,
+                      r.median, r.mean, r.max, r.stddev);
+    for (const auto &[key, value] : context) {
+      os << "," << escape_csv(value);
+    }
+    os << "\n";
+  }
+}
+
+} // namespace erd::bench
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace erd::bench {
+
+// keeps the compiler from discarding the computation of value
+template <typename T> inline void do_not_optimize(const T &value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+struct options_t {
+  std::chrono::nanoseconds min_time = std::chrono::milliseconds(100);
+  unsigned repetitions = 10;
+  std::string filter;
+};
+
+// nanoseconds per iteration across the repetitions of a benchmark
+struct result_t {
+  std::string name;
+  std::uint64_t iterations; // per repetition
+  unsigned repetitions;
+  double min;
+  double median;
+  double mean;
+  double max;
+  double stddev;
+};
+
+using context_t = std::vector<std::pair<std::string, std::string>>;
+
+// a benchmark body runs the measured operation the given number of times, so
+// the loop is compiled together with the operation
+class suite_t {
+public:
+  using body_t = std::function<void(std::uint64_t)>;
+
+  void add(std::string name, body_t body);
+
+  // runs the benchmarks whose name contains the filter; the iterations of a
+  // repetition are calibrated to last at least min_time
+  [[nodiscard]] std::vector<result_t> run(const options_t &options) const;
+
+private:
+  std::vector<std::pair<std::string, body_t>> benchmarks_;
+};
+
+void report_text(std::ostream &os, const context_t &context,
+                 const std::vector<result_t> &results);
+void report_json(std::ostream &os, const context_t &context,
+                 const std::vector<result_t> &results);
+void report_csv(std::ostream &os, const context_t &context,
+                const std::vector<result_t> &results);
+
+} // namespace erd::bench
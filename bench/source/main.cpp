@@ -0,0 +1,582 @@
+#include "bench.hpp"
+#include "client.hpp"
+#include "read_cache.hpp"
+#include "server.hpp"
+
+#include <erd/codec.hpp>
+#include <erd/erd.h>
+#include <erd/erd.hpp>
+#include <erd/ipc/message.hpp>
+#include <erd/region.hpp>
+#include <erd/units.hpp>
+
+#include <asio/io_context.hpp>
+#include <cxxopts.hpp>
+#include <fmt/format.h>
+
+#include <unistd.h>
+
+#include <array>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using erd::bench::do_not_optimize;
+
+bool string_to_domain(std::string_view domain_str, erd::domain_t &domain) {
+  if (domain_str == "package") {
+    domain = erd::domain_t::package;
+  } else if (domain_str == "cores") {
+    domain = erd::domain_t::cores;
+  } else if (domain_str == "uncore") {
+    domain = erd::domain_t::uncore;
+  } else if (domain_str == "dram") {
+    domain = erd::domain_t::dram;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+erd_rapl_domain_t to_c_domain(erd::domain_t domain) {
+  switch (domain) {
+  case erd::domain_t::cores:
+    return ERD_CORES;
+  case erd::domain_t::uncore:
+    return ERD_UNCORE;
+  case erd::domain_t::dram:
+    return ERD_DRAM;
+  default:
+    return ERD_PACKAGE;
+  }
+}
+
+std::string current_date() {
+  std::time_t now = std::time(nullptr);
+  std::array<char, 32> buffer;
+  std::strftime(buffer.data(), buffer.size(), "%FT%TZ", std::gmtime(&now));
+  return buffer.data();
+}
+
+std::string host_name() {
+  std::array<char, 256> buffer{};
+  if (gethostname(buffer.data(), buffer.size() - 1) == -1) {
+    return "unknown";
+  }
+  return buffer.data();
+}
+
+// inputs the compiler cannot see through, so that conversions are not folded
+template <typename T> std::array<T, 64> make_inputs(T first, T step) {
+  std::array<T, 64> values;
+  for (T &v : values) {
+    v = first;
+    first += step;
+  }
+  do_not_optimize(values);
+  return values;
+}
+
+void add_reader_benchmarks(erd::bench::suite_t &suite,
+                           const erd::reader_t &reader) {
+  suite.add("reader/obtain_readings", [&reader](std::uint64_t n) {
+    erd::readings_t readings;
+    std::error_code ec;
+    for (std::uint64_t i = 0; i < n; i++) {
+      reader.obtain_readings(readings, ec);
+      do_not_optimize(readings);
+    }
+  });
+
+  erd::readings_t lhs;
+  erd::readings_t rhs;
+  std::error_code ec;
+  reader.obtain_readings(rhs, ec);
+  reader.obtain_readings(lhs, ec);
+  suite.add("reader/subtract", [&reader, lhs, rhs](std::uint64_t n) {
+    for (std::uint64_t i = 0; i < n; i++) {
+      do_not_optimize(reader.subtract(lhs, rhs));
+    }
+  });
+}
+
+// a read within the maximum age, as the daemon serves most requests when many
+// clients poll the same domain
+void add_read_cache_benchmarks(erd::bench::suite_t &suite,
+                               const erd::reader_t &reader) {
+  auto cache = std::make_shared<erd::ipc::read_cache_t>(
+      reader, std::chrono::milliseconds(1));
+  suite.add("read_cache/obtain_readings", [cache](std::uint64_t n) {
+    erd::readings_t readings;
+    erd::clock_t::duration age;
+    std::error_code ec;
+    for (std::uint64_t i = 0; i < n; i++) {
+      cache->obtain_readings(readings, age, ec);
+      do_not_optimize(readings);
+    }
+  });
+}
+
+void add_region_benchmarks(erd::bench::suite_t &suite,
+                           const erd::reader_t &reader) {
+  auto profiler = std::make_shared<erd::profiler_t>(reader);
+  suite.add("region/scope", [profiler](std::uint64_t n) {
+    for (std::uint64_t i = 0; i < n; i++) {
+      erd::region_t region{*profiler, "bench"};
+    }
+  });
+}
+
+void add_unit_benchmarks(erd::bench::suite_t &suite) {
+  suite.add("units/microjoules_to_joules", [](std::uint64_t n) {
+    auto inputs = make_inputs<std::uint64_t>(262143328850, 123457);
+    for (std::uint64_t i = 0; i < n; i++) {
+      erd::microjoules<std::uint64_t> uj{inputs[i % inputs.size()]};
+      do_not_optimize(erd::joules<double>(uj));
+    }
+  });
+  suite.add("units/joules_to_microjoules", [](std::uint64_t n) {
+    auto inputs = make_inputs<double>(262143.32885, 0.123457);
+    for (std::uint64_t i = 0; i < n; i++) {
+      erd::joules<double> j{inputs[i % inputs.size()]};
+      do_not_optimize(
+          erd::unit_cast<erd::microjoules<std::uint64_t>>(j).count());
+    }
+  });
+  suite.add("units/mixed_energy_sum", [](std::uint64_t n) {
+    auto inputs = make_inputs<std::uint64_t>(262143328850, 123457);
+    erd::joules<double> sum{0};
+    for (std::uint64_t i = 0; i < n; i++) {
+      sum += erd::microjoules<std::uint64_t>{inputs[i % inputs.size()]};
+      do_not_optimize(sum);
+    }
+  });
+  suite.add("units/watts_to_milliwatts", [](std::uint64_t n) {
+    auto inputs = make_inputs<double>(51.25, 0.5);
+    for (std::uint64_t i = 0; i < n; i++) {
+      erd::watts<double> w{inputs[i % inputs.size()]};
+      do_not_optimize(erd::milliwatts<double>(w));
+    }
+  });
+}
+
+// a trace sampled every millisecond, whose counter wraps once
+std::vector<erd::readings_t> make_trace(erd::energy_t max_energy) {
+  std::vector<erd::readings_t> trace(1024);
+  erd::time_point_t time{};
+  erd::energy_t energy = max_energy - erd::energy_t{25000 * 512};
+  for (erd::readings_t &r : trace) {
+    r = erd::readings_t{time, energy};
+    time += std::chrono::milliseconds(1);
+    energy = erd::energy_t{(energy.count() + 25000) % max_energy.count()};
+  }
+  do_not_optimize(trace);
+  return trace;
+}
+
+// each iteration goes through a trace of 1024 samples
+void add_series_benchmarks(erd::bench::suite_t &suite,
+                           const erd::reader_t &reader) {
+  auto trace = make_trace(reader.max_energy());
+  suite.add("series/subtract_loop", [&reader, trace](std::uint64_t n) {
+    std::vector<erd::difference_t> out(trace.size() - 1);
+    for (std::uint64_t i = 0; i < n; i++) {
+      for (size_t j = 0; j < out.size(); j++) {
+        out[j] = reader.subtract(trace[j + 1], trace[j]);
+      }
+      do_not_optimize(out.data());
+    }
+  });
+  suite.add("series/subtract_n", [&reader, trace](std::uint64_t n) {
+    std::vector<erd::difference_t> out(trace.size() - 1);
+    for (std::uint64_t i = 0; i < n; i++) {
+      reader.subtract_n(trace.data(), trace.size(), out.data());
+      do_not_optimize(out.data());
+    }
+  });
+  suite.add("series/power_loop", [&reader, trace](std::uint64_t n) {
+    std::vector<erd::watts<double>> out(trace.size() - 1);
+    for (std::uint64_t i = 0; i < n; i++) {
+      for (size_t j = 0; j < out.size(); j++) {
+        erd::difference_t diff = reader.subtract(trace[j + 1], trace[j]);
+        out[j] = diff.energy_consumed / diff.duration;
+      }
+      do_not_optimize(out.data());
+    }
+  });
+  suite.add("series/power_series", [&reader, trace](std::uint64_t n) {
+    std::vector<erd::watts<double>> out(trace.size() - 1);
+    for (std::uint64_t i = 0; i < n; i++) {
+      reader.power_series(trace.data(), trace.size(), out.data());
+      do_not_optimize(out.data());
+    }
+  });
+}
+
+// each iteration compresses or expands the same trace, as a single block
+void add_codec_benchmarks(erd::bench::suite_t &suite,
+                          const erd::reader_t &reader) {
+  auto trace = make_trace(reader.max_energy());
+  suite.add("codec/encode", [trace](std::uint64_t n) {
+    std::vector<std::uint8_t> out;
+    out.reserve(erd::codec::max_block_size(trace.size()));
+    for (std::uint64_t i = 0; i < n; i++) {
+      out.clear();
+      erd::codec::encode(trace.data(), trace.size(), out);
+      do_not_optimize(out.data());
+    }
+  });
+  std::vector<std::uint8_t> block;
+  erd::codec::encode(trace.data(), trace.size(), block);
+  suite.add("codec/decode", [block, count = trace.size()](std::uint64_t n) {
+    std::vector<erd::readings_t> out(count);
+    std::error_code ec;
+    for (std::uint64_t i = 0; i < n; i++) {
+      const std::uint8_t *data = block.data();
+      erd::codec::decode(data, data + block.size(), out.data(), out.size(),
+                         ec);
+      do_not_optimize(out.data());
+    }
+  });
+}
+
+void add_message_benchmarks(erd::bench::suite_t &suite,
+                            const erd::reader_t &reader) {
+  erd::readings_t lhs;
+  erd::readings_t rhs;
+  std::error_code ec;
+  reader.obtain_readings(rhs, ec);
+  reader.obtain_readings(lhs, ec);
+  erd::difference_t diff = reader.subtract(lhs, rhs);
+
+  suite.add("message/request_serialize", [lhs, rhs](std::uint64_t n) {
+    erd::ipc::message_request request;
+    for (std::uint64_t i = 0; i < n; i++) {
+      request.serialize(lhs, rhs);
+      do_not_optimize(request);
+    }
+  });
+  suite.add("message/request_deserialize", [lhs, rhs](std::uint64_t n) {
+    erd::ipc::message_request request;
+    request.serialize(lhs, rhs);
+    erd::readings_t l;
+    erd::readings_t r;
+    std::error_code ec;
+    for (std::uint64_t i = 0; i < n; i++) {
+      do_not_optimize(request);
+      request.readings(l, r, ec);
+      do_not_optimize(l);
+      do_not_optimize(r);
+    }
+  });
+  suite.add("message/response_serialize", [lhs](std::uint64_t n) {
+    erd::ipc::message_response response;
+    for (std::uint64_t i = 0; i < n; i++) {
+      response.serialize(erd::ipc::status_code_t::success, lhs);
+      do_not_optimize(response);
+    }
+  });
+  suite.add("message/response_deserialize", [diff](std::uint64_t n) {
+    erd::ipc::message_response response;
+    response.serialize(erd::ipc::status_code_t::success, diff);
+    erd::difference_t d;
+    std::error_code ec;
+    for (std::uint64_t i = 0; i < n; i++) {
+      do_not_optimize(response);
+      response.difference(d, ec);
+      do_not_optimize(d);
+    }
+  });
+  suite.add("message/frame_round_trip", [lhs, rhs](std::uint64_t n) {
+    erd::ipc::request_frame frame;
+    erd::ipc::request_operation_t op;
+    erd::readings_t l;
+    erd::readings_t r;
+    std::error_code ec;
+    for (std::uint64_t i = 0; i < n; i++) {
+      frame.begin(static_cast<uint32_t>(i));
+      frame.add_obtain_readings();
+      frame.add_subtract(lhs, rhs);
+      frame.finish();
+      while (frame.next(op, ec)) {
+        op.readings(l, r, ec);
+      }
+      do_not_optimize(l);
+    }
+  });
+}
+
+// the handle is owned by the caller, so that it outlives the suite
+bool add_c_api_benchmarks(erd::bench::suite_t &suite, erd_handle_t &handle,
+                          const erd::attributes_t &attr) {
+  std::array<char, 256> buffer{};
+  erd_error_descriptor_t ed{buffer.data(), buffer.size()};
+  erd_attr_t c_attr = nullptr;
+  if (erd_attr_create(&c_attr, &ed) != ERD_SUCCESS ||
+      erd_attr_set_domain(c_attr, to_c_domain(attr.domain)) != ERD_SUCCESS ||
+      erd_attr_set_socket(c_attr, attr.socket) != ERD_SUCCESS ||
+      erd_handle_create(&handle, c_attr, &ed) != ERD_SUCCESS) {
+    std::cerr << "Skipping C API benchmarks: " << buffer.data() << "\n";
+    erd_attr_destroy(c_attr);
+    return false;
+  }
+  erd_attr_destroy(c_attr);
+
+  suite.add("c_api/erd_obtain_readings", [handle](std::uint64_t n) {
+    erd_readings_t readings;
+    for (std::uint64_t i = 0; i < n; i++) {
+      erd_obtain_readings(handle, &readings, nullptr);
+      do_not_optimize(readings);
+    }
+  });
+  suite.add("c_api/erd_subtract_readings", [handle](std::uint64_t n) {
+    erd_readings_t lhs;
+    erd_readings_t rhs;
+    erd_readings_t result;
+    erd_obtain_readings(handle, &rhs, nullptr);
+    erd_obtain_readings(handle, &lhs, nullptr);
+    for (std::uint64_t i = 0; i < n; i++) {
+      do_not_optimize(lhs);
+      erd_subtract_readings(handle, &lhs, &rhs, &result);
+      do_not_optimize(result);
+    }
+  });
+
+  // a group of four domains, each read by the same handle
+  constexpr std::size_t group_size = 4;
+  erd_group_t group = nullptr;
+  if (erd_group_create(&group, &ed) != ERD_SUCCESS) {
+    std::cerr << "Skipping C API group benchmarks: " << buffer.data() << "\n";
+    return true;
+  }
+  for (std::size_t i = 0; i < group_size; i++) {
+    erd_group_add(group, handle, nullptr);
+  }
+  std::shared_ptr<erd_group_st> shared_group{group, erd_group_destroy};
+  suite.add("c_api/erd_group_obtain_readings",
+            [shared_group](std::uint64_t n) {
+              std::array<erd_readings_t, group_size> readings;
+              for (std::uint64_t i = 0; i < n; i++) {
+                erd_group_obtain_readings(shared_group.get(), readings.data(),
+                                          readings.size(), nullptr);
+                do_not_optimize(readings);
+              }
+            });
+  suite.add("c_api/erd_group_subtract_n", [shared_group](std::uint64_t n) {
+    std::array<erd_readings_t, group_size> lhs;
+    std::array<erd_readings_t, group_size> rhs;
+    std::array<erd_readings_t, group_size> result;
+    erd_group_obtain_readings(shared_group.get(), rhs.data(), rhs.size(),
+                              nullptr);
+    erd_group_obtain_readings(shared_group.get(), lhs.data(), lhs.size(),
+                              nullptr);
+    for (std::uint64_t i = 0; i < n; i++) {
+      do_not_optimize(lhs);
+      erd_group_subtract_n(shared_group.get(), lhs.data(), rhs.data(),
+                           result.data(), result.size());
+      do_not_optimize(result);
+    }
+  });
+  return true;
+}
+
+// serves the reader from an in-process server unless a socket path is given,
+// so the round trip can be measured without a daemon running
+class ipc_fixture {
+public:
+  ipc_fixture(const erd::reader_t &reader, std::string socket_path) {
+    if (socket_path.empty()) {
+      socket_path = fmt::format("/tmp/erd-bench-{}.sock", getpid());
+      readers_.push_back(reader);
+      server_.emplace(context_, socket_path, readers_);
+    }
+    // the connection is queued by the listening socket until accepted
+    client_.emplace(socket_path);
+    if (server_) {
+      thread_ = std::thread{[this] { context_.run(); }};
+    }
+  }
+
+  ~ipc_fixture() noexcept {
+    client_.reset();
+    context_.stop();
+    if (thread_.joinable()) {
+      thread_.join();
+    }
+  }
+
+  ipc_fixture(const ipc_fixture &) = delete;
+  ipc_fixture &operator=(const ipc_fixture &) = delete;
+
+  erd::ipc::reader_client &client() noexcept { return *client_; }
+
+private:
+  asio::io_context context_;
+  std::vector<erd::reader_t> readers_;
+  std::optional<erd::ipc::server> server_;
+  std::thread thread_;
+  std::optional<erd::ipc::reader_client> client_;
+};
+
+void add_ipc_benchmarks(erd::bench::suite_t &suite, ipc_fixture &ipc) {
+  suite.add("ipc/obtain_readings", [&ipc](std::uint64_t n) {
+    erd::readings_t readings;
+    std::error_code ec;
+    for (std::uint64_t i = 0; i < n; i++) {
+      ipc.client().obtain_readings(readings, ec);
+      do_not_optimize(readings);
+    }
+  });
+  suite.add("ipc/subtract", [&ipc](std::uint64_t n) {
+    erd::readings_t lhs;
+    erd::readings_t rhs;
+    erd::difference_t diff;
+    std::error_code ec;
+    ipc.client().obtain_readings(rhs, ec);
+    ipc.client().obtain_readings(lhs, ec);
+    for (std::uint64_t i = 0; i < n; i++) {
+      ipc.client().subtract(diff, lhs, rhs, ec);
+      do_not_optimize(diff);
+    }
+  });
+  suite.add("ipc/frame_obtain_readings", [&ipc](std::uint64_t n) {
+    erd::ipc::request_frame request;
+    erd::ipc::response_frame response;
+    erd::ipc::response_operation_t op;
+    erd::readings_t readings;
+    std::error_code ec;
+    for (std::uint64_t i = 0; i < n; i++) {
+      request.begin(static_cast<uint32_t>(i));
+      request.add_obtain_readings();
+      request.finish();
+      ipc.client().send(request, ec);
+      ipc.client().receive(response, ec);
+      while (response.next(op, ec)) {
+        op.readings(readings, ec);
+      }
+      do_not_optimize(readings);
+    }
+  });
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  cxxopts::Options options(
+      "erd_bench", "Microbenchmarks of the erd read path, IPC and C API");
+  options.add_options() //
+      ("d,domain", "RAPL domain to read from - package, cores, uncore, dram",
+       cxxopts::value<std::string>()->default_value("package")) //
+      ("s,socket", "CPU socket to consider",
+       cxxopts::value<uint32_t>()->default_value("0")) //
+      ("r,root", "Powercap tree to read, such as one made by the simulator",
+       cxxopts::value<std::string>()) //
+      ("b,backend", "Comma-separated backends to try, as ERD_BACKEND",
+       cxxopts::value<std::string>()) //
+      ("f,filter", "Run only the benchmarks whose name contains this",
+       cxxopts::value<std::string>()->default_value("")) //
+      ("t,min-time", "Minimum duration of a repetition, in milliseconds",
+       cxxopts::value<uint32_t>()->default_value("100")) //
+      ("n,repetitions", "Number of repetitions of each benchmark",
+       cxxopts::value<uint32_t>()->default_value("10")) //
+      ("i,ipc-socket", "Daemon socket for the IPC benchmarks, instead of an "
+                       "in-process server",
+       cxxopts::value<std::string>()->default_value("")) //
+      ("F,format", "Output format - text, json, csv",
+       cxxopts::value<std::string>()->default_value("text")) //
+      ("o,output", "Output file, instead of the standard output",
+       cxxopts::value<std::string>()) //
+      ("h,help", "Print usage");
+  auto result = options.parse(argc, argv);
+
+  if (result.count("help") > 0) {
+    std::cout << options.help() << std::endl;
+    return 0;
+  }
+
+  // both are read when the first reader is constructed
+  if (result.count("root") > 0) {
+    setenv("ERD_POWERCAP_ROOT", result["root"].as<std::string>().c_str(), 1);
+  }
+  if (result.count("backend") > 0) {
+    setenv("ERD_BACKEND", result["backend"].as<std::string>().c_str(), 1);
+  }
+
+  std::string domain_str = result["domain"].as<std::string>();
+  erd::domain_t domain;
+  if (!string_to_domain(domain_str, domain)) {
+    std::cerr << "Invalid domain value: " << domain_str << "\n";
+    return 1;
+  }
+  erd::attributes_t attr{domain, result["socket"].as<uint32_t>()};
+
+  std::string format = result["format"].as<std::string>();
+  auto report = erd::bench::report_text;
+  if (format == "json") {
+    report = erd::bench::report_json;
+  } else if (format == "csv") {
+    report = erd::bench::report_csv;
+  } else if (format != "text") {
+    std::cerr << "Invalid format value: " << format << "\n";
+    return 1;
+  }
+
+  erd::reader_t reader{attr};
+  const char *root = std::getenv("ERD_POWERCAP_ROOT");
+  erd::bench::context_t context{
+      {"date", current_date()},
+      {"host", host_name()},
+      {"backend", reader.backend().name()},
+      {"powercap_root", root ? root : "/sys/class/powercap"},
+      {"domain", domain_str},
+      {"socket", std::to_string(attr.socket)},
+      {"series_vectorised", erd::series_vectorised() ? "yes" : "no"},
+  };
+
+  erd::bench::suite_t suite;
+  add_reader_benchmarks(suite, reader);
+  add_read_cache_benchmarks(suite, reader);
+  add_region_benchmarks(suite, reader);
+  add_unit_benchmarks(suite);
+  add_series_benchmarks(suite, reader);
+  add_codec_benchmarks(suite, reader);
+  add_message_benchmarks(suite, reader);
+
+  erd_handle_t handle = nullptr;
+  add_c_api_benchmarks(suite, handle, attr);
+
+  std::unique_ptr<ipc_fixture> ipc;
+  try {
+    ipc = std::make_unique<ipc_fixture>(
+        reader, result["ipc-socket"].as<std::string>());
+    add_ipc_benchmarks(suite, *ipc);
+  } catch (const std::exception &e) {
+    std::cerr << "Skipping IPC benchmarks: " << e.what() << "\n";
+  }
+
+  erd::bench::options_t bench_options;
+  bench_options.min_time =
+      std::chrono::milliseconds(result["min-time"].as<uint32_t>());
+  bench_options.repetitions = result["repetitions"].as<uint32_t>();
+  bench_options.filter = result["filter"].as<std::string>();
+  std::vector<erd::bench::result_t> results = suite.run(bench_options);
+
+  ipc.reset();
+  if (handle) {
+    erd_handle_destroy(handle);
+  }
+
+  if (result.count("output") > 0) {
+    std::ofstream file{result["output"].as<std::string>()};
+    report(file, context, results);
+  } else {
+    report(std::cout, context, results);
+  }
+}
@@ -1,5 +1,8 @@
 #include "client.hpp"
 
+#include <asio/read.hpp>
+#include <asio/write.hpp>
+
 #include <cassert>
 
 namespace erd::ipc {
@@ -38,6 +41,29 @@ bool reader_client::subtract(difference_t &into, const readings_t &lhs,
   return response_.difference(into, ec);
 }
 
+bool reader_client::send(const request_frame &frame,
+                         std::error_code &ec) noexcept {
+  asio::write(socket_, asio::buffer(frame.data(), frame.size()), ec);
+  return !ec;
+}
+
+bool reader_client::receive(response_frame &frame,
+                            std::error_code &ec) noexcept {
+  try {
+    asio::read(socket_,
+               asio::buffer(frame.header_buffer(), frame_header_t::size), ec);
+    if (ec || !frame.prepare_payload(ec)) {
+      return false;
+    }
+  } catch (const std::bad_alloc &) {
+    ec = std::make_error_code(std::errc::not_enough_memory);
+    return false;
+  }
+  asio::read(socket_,
+             asio::buffer(frame.payload_buffer(), frame.payload_size()), ec);
+  return !ec;
+}
+
 bool reader_client::comm_common(std::error_code &ec) noexcept {
   size_t bytes;
   bytes = socket_.write_some(
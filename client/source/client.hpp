@@ -15,6 +15,12 @@ public:
   bool subtract(difference_t &into, const readings_t &lhs,
                 const readings_t &rhs, std::error_code &ec) noexcept;
 
+  // protocol v2; responses arrive in the order the frames were sent, so any
+  // number of frames may be sent before receiving the first response
+  bool send(const request_frame &frame, std::error_code &ec) noexcept;
+
+  bool receive(response_frame &frame, std::error_code &ec) noexcept;
+
 private:
   bool comm_common(std::error_code &ec) noexcept;
 
@@ -1,9 +1,12 @@
 #include "client.hpp"
 
+#include <erd/ipc/shared_readings.hpp>
+
 #include <fmt/format.h>
 
 #include <cstdlib>
 #include <iostream>
+#include <memory>
 #include <thread>
 
 static std::string get_socket_path() {
@@ -29,12 +32,25 @@ int main() {
   erd::readings_t before;
   erd::readings_t after;
 
-  if (std::error_code ec; !reader.obtain_readings(before, ec)) {
+  // when set, readings come from the daemon's shared memory segment
+  std::unique_ptr<erd::ipc::shared_readings_reader> shared;
+  if (char *env = std::getenv("ERD_SHM"); env) {
+    std::cout << "Shared memory: " << env << "\n";
+    shared = std::make_unique<erd::ipc::shared_readings_reader>(env);
+  }
+  auto obtain_readings = [&](erd::readings_t &into, std::error_code &ec) {
+    if (shared) {
+      return shared->obtain_readings(into, ec);
+    }
+    return reader.obtain_readings(into, ec);
+  };
+
+  if (std::error_code ec; !obtain_readings(before, ec)) {
     std::cerr << "Error obtaining readings: " << ec.message() << "\n";
     return 1;
   }
   std::this_thread::sleep_for(std::chrono::seconds{1});
-  if (std::error_code ec; !reader.obtain_readings(after, ec)) {
+  if (std::error_code ec; !obtain_readings(after, ec)) {
     std::cerr << "Error obtaining readings: " << ec.message() << "\n";
     return 1;
   }
@@ -1,16 +1,26 @@
+#include "server.hpp"
+
+#include <erd/attribution.hpp>
 #include <erd/erd.hpp>
-#include <erd/ipc/message.hpp>
+#include <erd/ipc/shared_readings.hpp>
+#include <erd/trace.hpp>
 
-#include <asio/error_code.hpp>
 #include <asio/io_context.hpp>
-#include <asio/local/stream_protocol.hpp>
+#include <asio/signal_set.hpp>
 #include <cxxopts.hpp>
 #include <fmt/format.h>
 
 #include <unistd.h>
 
+#include <algorithm>
+#include <atomic>
+#include <csignal>
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
 
 static std::string get_socket_path(bool unique) {
   auto get_socket_prefix = []() -> std::string {
@@ -31,6 +41,90 @@ static std::string get_socket_path(bool unique) {
   return fmt::format("{}/{}.sock", prefix, "erd");
 }
 
+static std::string get_shm_name(bool unique) {
+  if (char *env = std::getenv("ERD_SHM"); env) {
+    return env;
+  }
+  if (unique) {
+    return fmt::format("/{}-{}", "erd", getpid());
+  }
+  return fmt::format("/{}", "erd");
+}
+
+// periodically publishes the readings of every reader to shared memory, all
+// at once through the set if there is one
+static void publish_readings(const std::vector<erd::reader_t> &readers,
+                             const erd::reader_set_t *set,
+                             erd::ipc::shared_readings_writer &writer,
+                             std::chrono::microseconds period,
+                             const std::atomic<bool> &stop) {
+  bool failing = false;
+  erd::readings_set_t batch;
+  auto next = std::chrono::steady_clock::now();
+  while (!stop.load(std::memory_order_relaxed)) {
+    std::error_code ec;
+    bool published = true;
+    if (set && (published = set->obtain_readings(batch, ec))) {
+      for (size_t i = 0; i < set->size(); i++) {
+        writer.publish(i, batch.readings(i));
+      }
+    } else if (!set) {
+      for (size_t i = 0; i < readers.size(); i++) {
+        erd::readings_t readings;
+        if (std::error_code rec; readers[i].obtain_readings(readings, rec)) {
+          writer.publish(i, readings);
+        } else {
+          ec = rec;
+          published = false;
+        }
+      }
+    }
+    if (published) {
+      failing = false;
+    } else if (!failing) {
+      std::cerr << "Error publishing readings: " << ec.message() << "\n";
+      failing = true;
+    }
+    // skip the periods missed instead of publishing in bursts to catch up
+    next += period;
+    if (auto now = std::chrono::steady_clock::now(); next < now) {
+      next = now;
+    }
+    std::this_thread::sleep_until(next);
+  }
+}
+
+// periodically attributes the energy consumed since the previous update to
+// the processes and cgroups that ran
+static void attribute_energy(erd::attribution_t &attribution,
+                             std::chrono::milliseconds period,
+                             const std::atomic<bool> &stop) {
+  bool failing = false;
+  auto next = std::chrono::steady_clock::now();
+  while (!stop.load(std::memory_order_relaxed)) {
+    if (std::error_code ec; attribution.update(ec)) {
+      failing = false;
+    } else if (!failing) {
+      std::cerr << "Error attributing energy: " << ec.message() << "\n";
+      failing = true;
+    }
+    next += period;
+    std::this_thread::sleep_until(next);
+  }
+}
+
+// the package and, where it exists, the cores domain of a socket
+static std::vector<erd::reader_t> attribution_readers(uint32_t socket) {
+  std::vector<erd::reader_t> readers;
+  readers.emplace_back(erd::attributes_t{erd::domain_t::package, socket});
+  try {
+    readers.emplace_back(erd::attributes_t{erd::domain_t::cores, socket});
+  } catch (const std::exception &e) {
+    std::cerr << "Not attributing cores energy: " << e.what() << "\n";
+  }
+  return readers;
+}
+
 static bool string_to_domain(std::string_view domain_str, erd::domain_t &domain,
                              std::error_code &ec) {
   bool retval = true;
@@ -50,35 +144,89 @@ static bool string_to_domain(std::string_view domain_str, erd::domain_t &domain,
   return retval;
 }
 
-static bool process_message(const erd::reader_t &reader,
-                            const erd::ipc::message_request &request,
-                            erd::ipc::message_response &response,
-                            std::error_code &ec) noexcept {
-  using erd::ipc::operation_type_t;
-  switch (request.operation_type()) {
-  case operation_type_t::obtain_readings: {
-    erd::ipc::status_code_t status = erd::ipc::status_code_t::success;
-    erd::readings_t readings;
-    if (!reader.obtain_readings(readings, ec)) {
-      status = erd::ipc::status_code_t::error;
+static const char *domain_to_string(erd::domain_t domain) noexcept {
+  switch (domain) {
+  case erd::domain_t::package:
+    return "package";
+  case erd::domain_t::cores:
+    return "cores";
+  case erd::domain_t::uncore:
+    return "uncore";
+  case erd::domain_t::dram:
+    return "dram";
+  }
+  return "unknown";
+}
+
+#if defined(ERD_POWERCAP)
+static bool is_powercap(const erd::reader_t &reader) noexcept {
+  return std::strcmp(reader.backend().name(),
+                     erd::powercap_reader_t::backend_name) == 0;
+}
+#endif
+
+// every domain of every socket besides the default one: the zones of the
+// powercap topology, of the first sockets only if max_sockets is set; other
+// backends cannot tell which sockets exist, so the domains they can read of
+// the first max_sockets sockets, or of the first one
+static void add_all_readers(std::vector<erd::reader_t> &readers,
+                            uint32_t max_sockets) {
+  const erd::attributes_t served = readers.front().attributes();
+  auto is_served = [&served](const erd::attributes_t &attr) {
+    return attr.domain == served.domain && attr.socket == served.socket;
+  };
+#if defined(ERD_POWERCAP)
+  if (is_powercap(readers.front())) {
+    for (const erd::zone_t &zone : erd::topology_t::instance().zones()) {
+      if ((!max_sockets || zone.attr.socket < max_sockets) &&
+          !is_served(zone.attr)) {
+        readers.emplace_back(std::in_place,
+                             erd::powercap_reader_t::backend_name, zone.attr);
+      }
+    }
+    return;
+  }
+#endif
+  constexpr erd::domain_t domains[] = {erd::domain_t::package,
+                                       erd::domain_t::cores,
+                                       erd::domain_t::uncore,
+                                       erd::domain_t::dram};
+  for (uint32_t socket = 0; socket < std::max(max_sockets, 1u); socket++) {
+    for (erd::domain_t domain : domains) {
+      if (is_served(erd::attributes_t{domain, socket})) {
+        continue;
+      }
+      try {
+        readers.emplace_back(erd::attributes_t{domain, socket});
+      } catch (const std::exception &) {
+        // not every socket has every domain
+      }
     }
-    response.serialize(status, readings);
-    return status == erd::ipc::status_code_t::success;
-  }
-  case operation_type_t::subtract: {
-    erd::readings_t lhs;
-    erd::readings_t rhs;
-    if (request.readings(lhs, rhs, ec)) {
-      response.serialize(erd::ipc::status_code_t::success,
-                         reader.subtract(lhs, rhs));
-      return true;
+  }
+}
+
+// reads every domain through a set of their backend, with a single timestamp,
+// where all readers share one; a batch where the backend has them
+static std::unique_ptr<erd::reader_set_t>
+make_reader_set(const std::vector<erd::reader_t> &readers) {
+  const char *backend = readers.front().backend().name();
+  std::vector<erd::attributes_t> attrs;
+  for (const erd::reader_t &reader : readers) {
+    if (std::strcmp(reader.backend().name(), backend) != 0) {
+      return nullptr;
     }
-    response.serialize(erd::ipc::status_code_t::error, erd::difference_t{});
-    return false;
+    attrs.push_back(reader.attributes());
   }
+  try {
+    auto set = std::make_unique<erd::reader_set_t>(backend, attrs);
+    // reading one by one is what the server does without a set
+    if (std::strcmp(set->name(), backend) == 0) {
+      return set;
+    }
+  } catch (const std::exception &e) {
+    std::cerr << "Reading domains one by one: " << e.what() << "\n";
   }
-  ec = std::make_error_code(std::errc::bad_message);
-  return false;
+  return nullptr;
 }
 
 int main(int argc, char *argv[]) {
@@ -91,6 +239,38 @@ int main(int argc, char *argv[]) {
        cxxopts::value<std::string>()->default_value("package")) //
       ("s,socket", "CPU socket to consider",
        cxxopts::value<uint32_t>()->default_value("0")) //
+      ("a,all",
+       "Also serve every other domain of every socket, to clients naming it; "
+       "the domain and socket above remain the default",
+       cxxopts::value<bool>()->default_value("false")) //
+      ("sockets",
+       "Most CPU sockets served with --all, every one found by default; "
+       "without a powercap tree, the sockets served, the first by default",
+       cxxopts::value<uint32_t>()->default_value("0")) //
+      ("m,shm", "Publish readings to shared memory",
+       cxxopts::value<bool>()->default_value("false")) //
+      ("p,period",
+       "Shared memory publishing and recording period, in microseconds",
+       cxxopts::value<uint32_t>()->default_value("1000")) //
+      ("r,record", "Record readings to a trace file",
+       cxxopts::value<std::string>()) //
+      ("compress", "Compress the recorded trace",
+       cxxopts::value<bool>()->default_value("false")) //
+      ("t,threads", "Number of threads serving clients",
+       cxxopts::value<uint32_t>()->default_value("1")) //
+      ("max-age",
+       "Serve readings up to this many microseconds old, so that the reads "
+       "of concurrent requests are coalesced; 0 reads for every request",
+       cxxopts::value<uint32_t>()->default_value("0")) //
+      ("attribute",
+       "Attribute the energy of the socket to processes, updating every "
+       "this many milliseconds",
+       cxxopts::value<uint32_t>()) //
+      ("cgroup",
+       "Also attribute energy to this cgroup, relative to the cgroup root",
+       cxxopts::value<std::vector<std::string>>()) //
+      ("stats", "Collect latency metrics, served by the stats operation",
+       cxxopts::value<bool>()->default_value("false")) //
       ("h,help", "Print usage");
   auto result = options.parse(argc, argv);
 
@@ -113,42 +293,110 @@ int main(int argc, char *argv[]) {
   std::cout << "Socket path: " << socket_path << "\n";
   std::cout << "RAPL Domain: " << domain_str << "\n";
   std::cout << "CPU socket: " << socket << "\n";
-  erd::reader_t reader{erd::attributes_t{domain, socket}};
+  if (result["stats"].as<bool>()) {
+    erd::metrics_t::enable(true);
+  }
+  // the first reader is the default, and the only one traces and v1 clients
+  // use
+  std::vector<erd::reader_t> readers;
+  readers.emplace_back(erd::attributes_t{domain, socket});
+  if (result["all"].as<bool>()) {
+    add_all_readers(readers, result["sockets"].as<uint32_t>());
+    std::cout << "Serving:";
+    for (const erd::reader_t &r : readers) {
+      std::cout << " " << domain_to_string(r.attributes().domain) << ":"
+                << r.attributes().socket;
+    }
+    std::cout << "\n";
+  }
+  const erd::reader_t &reader = readers.front();
+  std::unique_ptr<erd::reader_set_t> reader_set = make_reader_set(readers);
 
-  asio::io_context context;
-  asio::local::stream_protocol::endpoint endpoint(socket_path);
+  std::atomic<bool> stop_publishing = false;
+  std::unique_ptr<erd::ipc::shared_readings_writer> writer;
+  std::thread publisher;
+  if (result["shm"].as<bool>()) {
+    std::string shm_name = get_shm_name(result["unique"].as<bool>());
+    std::chrono::microseconds period{result["period"].as<uint32_t>()};
+    std::cout << "Shared memory: " << shm_name << "\n";
+    std::vector<erd::attributes_t> attrs;
+    for (const erd::reader_t &r : readers) {
+      attrs.push_back(r.attributes());
+    }
+    writer = std::make_unique<erd::ipc::shared_readings_writer>(
+        shm_name, std::move(attrs));
+    publisher = std::thread{publish_readings,   std::cref(readers),
+                            reader_set.get(),   std::ref(*writer),
+                            period,             std::cref(stop_publishing)};
+  }
 
-  while (true) {
-    ::unlink(socket_path.c_str());
-    asio::local::stream_protocol::socket socket(context);
-    asio::local::stream_protocol::acceptor acceptor(context, endpoint);
+  // the sampler has its own copy of the reader
+  std::unique_ptr<erd::sampler_t> sampler;
+  std::unique_ptr<erd::trace_recorder_t> recorder;
+  if (result.count("record") > 0) {
+    std::string trace_path = result["record"].as<std::string>();
+    std::chrono::microseconds period{result["period"].as<uint32_t>()};
+    std::cout << "Trace: " << trace_path << "\n";
+    auto encoding = result["compress"].as<bool>()
+                        ? erd::trace_encoding_t::compressed
+                        : erd::trace_encoding_t::raw;
+    sampler = std::make_unique<erd::sampler_t>(reader, period);
+    recorder = std::make_unique<erd::trace_recorder_t>(
+        *sampler, trace_path, erd::trace_writer_t::default_chunk_size,
+        encoding);
+  }
 
-    acceptor.accept(socket, ec);
-    if (ec) {
-      std::cerr << "Error binding to socket: " << ec.message() << "\n";
-      return 1;
+  std::atomic<bool> stop_attributing = false;
+  std::unique_ptr<erd::attribution_t> attribution;
+  std::thread attributor;
+  if (result.count("attribute") > 0) {
+    std::chrono::milliseconds period{
+        std::max(result["attribute"].as<uint32_t>(), 1u)};
+    std::vector<std::string> cgroups;
+    if (result.count("cgroup") > 0) {
+      cgroups = result["cgroup"].as<std::vector<std::string>>();
     }
+    std::cout << "Attribution period: " << period.count() << " ms\n";
+    attribution = std::make_unique<erd::attribution_t>(
+        attribution_readers(socket), std::move(cgroups));
+    attributor =
+        std::thread{attribute_energy, std::ref(*attribution), period,
+                    std::cref(stop_attributing)};
+  }
 
-    std::error_code ec;
-    erd::ipc::message_request request;
-    erd::ipc::message_response response;
-    while (true) {
-      size_t bytes_read = socket.read_some(
-          asio::buffer(request.buffer(), erd::ipc::message_request::size), ec);
-      if (ec) {
-        break;
-      }
-      assert(bytes_read == request.size);
-      if (!process_message(reader, request, response, ec)) {
-        std::cerr << "Error processing message: " << ec.message() << "\n";
-      }
-      size_t bytes_written = socket.write_some(
-          asio::buffer(response.buffer(), erd::ipc::message_response::size),
-          ec);
-      if (ec) {
-        break;
-      }
-      assert(bytes_written == response.size);
-    }
+  asio::io_context context;
+  std::chrono::microseconds max_age{result["max-age"].as<uint32_t>()};
+  if (max_age.count() > 0) {
+    std::cout << "Maximum age: " << max_age.count() << " us\n";
+  }
+  erd::ipc::server server{context, socket_path,     readers,
+                          attribution.get(), max_age, reader_set.get()};
+
+  asio::signal_set signals{context, SIGINT, SIGTERM};
+  signals.async_wait([&context](std::error_code, int) { context.stop(); });
+
+  const uint32_t threads = std::max(result["threads"].as<uint32_t>(), 1u);
+  std::cout << "Threads: " << threads << "\n";
+  std::vector<std::thread> pool;
+  pool.reserve(threads - 1);
+  for (uint32_t i = 1; i < threads; i++) {
+    pool.emplace_back([&context] { context.run(); });
+  }
+  context.run();
+  for (std::thread &t : pool) {
+    t.join();
+  }
+
+  if (publisher.joinable()) {
+    stop_publishing = true;
+    publisher.join();
+  }
+  if (sampler) {
+    sampler->stop();
+    recorder->stop();
+  }
+  if (attributor.joinable()) {
+    stop_attributing = true;
+    attributor.join();
   }
 }
@@ -0,0 +1,45 @@
+#include "read_cache.hpp"
+
+#include <erd/clock.hpp>
+
+namespace erd::ipc {
+
+read_cache_t::read_cache_t(const reader_t &reader,
+                           clock_t::duration max_age) noexcept
+    : reader_(reader), max_age_(max_age) {}
+
+bool read_cache_t::obtain_readings(readings_t &into, clock_t::duration &age,
+                                   std::error_code &ec) const noexcept {
+  if (fresh(into, age)) {
+    ec.clear();
+    return true;
+  }
+  std::lock_guard lock{mutex_};
+  // another request may have read while this one waited
+  if (fresh(into, age)) {
+    ec.clear();
+    return true;
+  }
+  if (!reader_.obtain_readings(into, ec)) {
+    return false;
+  }
+  cached_.store(into);
+  age = now() - into.timestamp;
+  return true;
+}
+
+bool read_cache_t::fresh(readings_t &into,
+                         clock_t::duration &age) const noexcept {
+  readings_t cached = cached_.load();
+  if (cached.timestamp == time_point_t{}) {
+    return false;
+  }
+  age = now() - cached.timestamp;
+  if (age > max_age_) {
+    return false;
+  }
+  into = cached;
+  return true;
+}
+
+} // namespace erd::ipc
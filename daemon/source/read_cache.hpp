@@ -0,0 +1,36 @@
+#pragma once
+#include <erd/erd.hpp>
+#include <erd/seqlock.hpp>
+
+#include <mutex>
+
+namespace erd::ipc {
+
+// coalesces the reads of a reader for many clients: readings at most max_age
+// old are served from the cache without reading, and of the requests finding
+// them older at the same time, one reads while the others wait for its
+// readings; safe to use from any number of threads
+class read_cache_t {
+public:
+  read_cache_t(const reader_t &reader, clock_t::duration max_age) noexcept;
+
+  read_cache_t(const read_cache_t &) = delete;
+  read_cache_t &operator=(const read_cache_t &) = delete;
+
+  // age is the time elapsed since the readings were taken
+  bool obtain_readings(readings_t &into, clock_t::duration &age,
+                       std::error_code &ec) const noexcept;
+
+  [[nodiscard]] const reader_t &reader() const noexcept { return reader_; }
+
+private:
+  bool fresh(readings_t &into, clock_t::duration &age) const noexcept;
+
+  const reader_t &reader_;
+  clock_t::duration max_age_;
+  // the time point is the epoch until the first read succeeds
+  mutable seqlock_t<readings_t> cached_;
+  mutable std::mutex mutex_;
+};
+
+} // namespace erd::ipc
@@ -0,0 +1,570 @@
+#include "server.hpp"
+
+#include <asio/bind_executor.hpp>
+#include <asio/dispatch.hpp>
+#include <asio/read.hpp>
+#include <asio/write.hpp>
+
+#include <unistd.h>
+
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+// bounds the samples kept for a client that reads slower than they are taken
+constexpr size_t MAX_PENDING_SAMPLES = 4 * erd::ipc::max_subscription_batch;
+
+bool process_message(const erd::reader_t &reader,
+                     const erd::ipc::read_cache_t *cache,
+                     const erd::ipc::message_request &request,
+                     erd::ipc::message_response &response,
+                     std::error_code &ec) noexcept {
+  using erd::ipc::operation_type_t;
+  switch (request.operation_type()) {
+  case operation_type_t::obtain_readings: {
+    erd::ipc::status_code_t status = erd::ipc::status_code_t::success;
+    erd::readings_t readings;
+    erd::clock_t::duration age;
+    if (cache ? !cache->obtain_readings(readings, age, ec)
+              : !reader.obtain_readings(readings, ec)) {
+      status = erd::ipc::status_code_t::error;
+    }
+    response.serialize(status, readings);
+    return status == erd::ipc::status_code_t::success;
+  }
+  case operation_type_t::subtract: {
+    erd::readings_t lhs;
+    erd::readings_t rhs;
+    if (request.readings(lhs, rhs, ec)) {
+      response.serialize(erd::ipc::status_code_t::success,
+                         reader.subtract(lhs, rhs));
+      return true;
+    }
+    response.serialize(erd::ipc::status_code_t::error, erd::difference_t{});
+    return false;
+  }
+  // subscriptions, stats, attribution and snapshots require v2 frames
+  case operation_type_t::subscribe:
+  case operation_type_t::unsubscribe:
+  case operation_type_t::stats:
+  case operation_type_t::samples:
+  case operation_type_t::attribution:
+  case operation_type_t::snapshot:
+    break;
+  }
+  ec = std::make_error_code(std::errc::bad_message);
+  return false;
+}
+
+erd::energy_t round_energy(erd::joules<double> energy) noexcept {
+  return erd::energy_t{static_cast<erd::energy_t::rep>(
+      erd::microjoules<double>{energy}.count() + 0.5)};
+}
+
+// removes a stale socket file left by a previous instance
+asio::local::stream_protocol::endpoint
+make_endpoint(const std::string &socket_path) {
+  ::unlink(socket_path.c_str());
+  return asio::local::stream_protocol::endpoint(socket_path);
+}
+
+} // namespace
+
+namespace erd::ipc {
+
+session::session(asio::local::stream_protocol::socket socket,
+                 const std::vector<reader_t> &readers,
+                 const std::vector<std::unique_ptr<read_cache_t>> &caches,
+                 const reader_set_t *reader_set,
+                 const attribution_t *attribution)
+    : socket_(std::move(socket)), strand_(socket_.get_executor()),
+      timer_(strand_), readers_(readers), caches_(caches),
+      reader_set_(reader_set), attribution_(attribution) {}
+
+void session::start() {
+  asio::dispatch(strand_,
+                 [self = shared_from_this()] { self->read_request(); });
+}
+
+// the first four bytes are either the operation type of a v1 message or the
+// magic value of a v2 frame
+void session::read_request() {
+  asio::async_read(
+      socket_, asio::buffer(&prefix_, sizeof(prefix_)),
+      asio::bind_executor(
+          strand_, [self = shared_from_this()](std::error_code ec, size_t) {
+            // the client disconnecting ends the session
+            if (ec) {
+              self->close();
+              return;
+            }
+            if (self->prefix_ == frame_magic) {
+              self->read_frame();
+            } else {
+              self->read_message();
+            }
+          }));
+}
+
+void session::read_message() {
+  static_assert(sizeof(prefix_) == detail::message_common::size);
+  std::memcpy(request_.buffer(), &prefix_, sizeof(prefix_));
+  asio::async_read(
+      socket_,
+      asio::buffer(request_.buffer() + sizeof(prefix_),
+                   message_request::size - sizeof(prefix_)),
+      asio::bind_executor(
+          strand_, [self = shared_from_this()](std::error_code ec, size_t) {
+            if (ec) {
+              self->close();
+              return;
+            }
+            auto start = clock_t::now();
+            bool processed = process_message(
+                self->readers_.front(),
+                self->caches_.empty() ? nullptr : self->caches_.front().get(),
+                self->request_, self->response_, ec);
+            self->record_request(start, processed);
+            if (!processed) {
+              std::cerr << "Error processing message: " << ec.message()
+                        << "\n";
+            }
+            self->write_response(asio::buffer(self->response_.buffer(),
+                                              message_response::size));
+          }));
+}
+
+void session::read_frame() {
+  char *header = request_frame_.header_buffer();
+  std::memcpy(header, &prefix_, sizeof(prefix_));
+  asio::async_read(
+      socket_,
+      asio::buffer(header + sizeof(prefix_),
+                   frame_header_t::size - sizeof(prefix_)),
+      asio::bind_executor(
+          strand_, [self = shared_from_this()](std::error_code ec, size_t) {
+            if (ec) {
+              self->close();
+              return;
+            }
+            // the stream cannot be resynchronised after an invalid header
+            if (!self->request_frame_.prepare_payload(ec)) {
+              std::cerr << "Error reading frame header: " << ec.message()
+                        << "\n";
+              self->close();
+              return;
+            }
+            self->read_frame_payload();
+          }));
+}
+
+void session::read_frame_payload() {
+  asio::async_read(
+      socket_,
+      asio::buffer(request_frame_.payload_buffer(),
+                   request_frame_.payload_size()),
+      asio::bind_executor(
+          strand_, [self = shared_from_this()](std::error_code ec, size_t) {
+            if (ec) {
+              self->close();
+              return;
+            }
+            self->process_frame();
+            self->write_response(asio::buffer(self->response_frame_.data(),
+                                              self->response_frame_.size()));
+          }));
+}
+
+void session::process_frame() {
+  auto start = clock_t::now();
+  bool failed = false;
+  uint32_t request_id = request_frame_.header().request_id;
+  response_frame_.begin(request_id);
+  request_operation_t op{};
+  std::error_code ec;
+  // a malformed frame is answered with a single error operation, and none of
+  // its operations is processed
+  if (!request_frame_.validate(op, ec)) {
+    std::cerr << "Error processing frame: " << ec.message() << "\n";
+    response_frame_.add(op.type, status_code_t::error);
+    response_frame_.finish();
+    record_request(start, false);
+    return;
+  }
+  while (request_frame_.next(op, ec)) {
+    switch (op.type) {
+    case operation_type_t::obtain_readings: {
+      status_code_t status = status_code_t::success;
+      readings_t readings;
+      clock_t::duration age{};
+      const reader_t *reader = find_reader(op);
+      if (!reader) {
+        status = status_code_t::error;
+        failed = true;
+      } else if (std::error_code oec;
+                 !obtain_readings(*reader, readings, age, oec)) {
+        std::cerr << "Error obtaining readings: " << oec.message() << "\n";
+        status = status_code_t::error;
+        failed = true;
+      } else if (!caches_.empty() && metrics_t::enabled()) {
+        metrics_t::instance().record(metric_t::staleness, age);
+      }
+      response_frame_.add(status, readings, age);
+      break;
+    }
+    case operation_type_t::subtract: {
+      readings_t lhs;
+      readings_t rhs;
+      const reader_t *reader = find_reader(op);
+      if (std::error_code oec; reader && op.readings(lhs, rhs, oec)) {
+        response_frame_.add(status_code_t::success, reader->subtract(lhs, rhs));
+      } else {
+        response_frame_.add(status_code_t::error, difference_t{});
+        failed = true;
+      }
+      break;
+    }
+    case operation_type_t::subscribe: {
+      std::chrono::nanoseconds interval;
+      subscription_mode_t mode;
+      uint32_t batch;
+      const reader_t *reader = find_reader(op);
+      if (std::error_code oec;
+          reader && op.subscription(interval, mode, batch, oec)) {
+        subscription_.reader = reader;
+        subscribe(interval, mode, batch, request_id);
+        response_frame_.add(op.type, status_code_t::success);
+      } else {
+        response_frame_.add(op.type, status_code_t::error);
+        failed = true;
+      }
+      break;
+    }
+    case operation_type_t::unsubscribe:
+      unsubscribe();
+      response_frame_.add(op.type, status_code_t::success);
+      break;
+    case operation_type_t::stats:
+      response_frame_.add(status_code_t::success,
+                          metrics_t::instance().snapshot());
+      break;
+    case operation_type_t::attribution:
+      add_attribution(op, failed);
+      break;
+    case operation_type_t::snapshot:
+      add_snapshot(failed);
+      break;
+    default:
+      response_frame_.add(op.type, status_code_t::error);
+      failed = true;
+      break;
+    }
+  }
+  if (ec) {
+    std::cerr << "Error processing frame: " << ec.message() << "\n";
+    failed = true;
+  }
+  response_frame_.finish();
+  record_request(start, !failed);
+}
+
+// fails if the process or cgroup is not tracked
+void session::add_attribution(const request_operation_t &op, bool &failed) {
+  attribution_target_t target;
+  int32_t pid = 0;
+  std::string_view cgroup;
+  std::vector<attributed_energy_t> energy;
+  bool found = false;
+  if (std::error_code oec;
+      attribution_ && op.attribution(target, pid, cgroup, oec)) {
+    found = true;
+    for (size_t i = 0; found && i < attribution_->size(); i++) {
+      joules<double> value;
+      found = target == attribution_target_t::process
+                  ? attribution_->process_energy(pid, i, value)
+                  : attribution_->cgroup_energy(cgroup, i, value);
+      energy.push_back(attributed_energy_t{
+          attribution_->reader(i).attributes(), round_energy(value)});
+    }
+  }
+  if (!found) {
+    energy.clear();
+    failed = true;
+  }
+  response_frame_.add(found ? status_code_t::success : status_code_t::error,
+                      energy);
+}
+
+// every domain of the reader set is read at once, with one timestamp;
+// without one, the readers are read back to back, bypassing the caches, so
+// the readings are as close in time as they allow but not atomic; fails if
+// any of them cannot be read
+void session::add_snapshot(bool &failed) {
+  snapshot_.clear();
+  status_code_t status = status_code_t::success;
+  if (reader_set_) {
+    std::error_code ec;
+    if (!reader_set_->obtain_readings(snapshot_set_, ec)) {
+      std::cerr << "Error obtaining readings: " << ec.message() << "\n";
+      status = status_code_t::error;
+    }
+    // each readings is paired with the domain the set read it for
+    const std::vector<attributes_t> &attrs = reader_set_->attributes();
+    for (size_t i = 0; i < attrs.size(); i++) {
+      snapshot_.push_back(
+          {attrs[i], status,
+           status == status_code_t::success ? snapshot_set_.readings(i)
+                                            : readings_t{}});
+    }
+  } else {
+    for (const reader_t &reader : readers_) {
+      snapshot_entry_t entry{reader.attributes(), status_code_t::success, {}};
+      if (std::error_code ec; !reader.obtain_readings(entry.readings, ec)) {
+        std::cerr << "Error obtaining readings: " << ec.message() << "\n";
+        entry.status = status_code_t::error;
+        status = status_code_t::error;
+      }
+      snapshot_.push_back(entry);
+    }
+  }
+  failed |= status == status_code_t::error;
+  response_frame_.add(status, snapshot_);
+}
+
+const reader_t *
+session::find_reader(const request_operation_t &op) const noexcept {
+  attributes_t attr;
+  if (!op.attributes(attr)) {
+    return &readers_.front();
+  }
+  for (const reader_t &reader : readers_) {
+    const attributes_t &served = reader.attributes();
+    if (served.domain == attr.domain && served.socket == attr.socket) {
+      return &reader;
+    }
+  }
+  return nullptr;
+}
+
+bool session::obtain_readings(const reader_t &reader, readings_t &into,
+                              clock_t::duration &age,
+                              std::error_code &ec) const noexcept {
+  if (!caches_.empty()) {
+    return caches_[&reader - readers_.data()]->obtain_readings(into, age, ec);
+  }
+  if (!reader.obtain_readings(into, ec)) {
+    return false;
+  }
+  age = now() - into.timestamp;
+  return true;
+}
+
+void session::record_request(time_point_t start, bool succeeded) {
+  if (!metrics_t::enabled()) {
+    return;
+  }
+  metrics_t &metrics = metrics_t::instance();
+  metrics.record(metric_t::ipc, clock_t::now() - start);
+  if (!succeeded) {
+    metrics.record_error(metric_t::ipc);
+  }
+}
+
+void session::write_response(asio::const_buffer buffer) {
+  response_buffer_ = buffer;
+  response_pending_ = true;
+  write_next();
+}
+
+void session::write_next() {
+  if (writing_) {
+    return;
+  }
+  if (response_pending_) {
+    response_pending_ = false;
+    writing_ = true;
+    asio::async_write(
+        socket_, response_buffer_,
+        asio::bind_executor(
+            strand_, [self = shared_from_this()](std::error_code ec, size_t) {
+              self->writing_ = false;
+              if (ec) {
+                self->close();
+                return;
+              }
+              self->read_request();
+              self->write_next();
+            }));
+    return;
+  }
+  if (subscription_.push_pending) {
+    subscription_t &sub = subscription_;
+    sub.push_pending = false;
+    push_frame_.begin(sub.request_id);
+    if (sub.status == status_code_t::success && metrics_t::enabled()) {
+      metrics_t::instance().record(metric_t::staleness,
+                                   clock_t::now() - sub.latest.timestamp);
+    }
+    if (sub.mode == subscription_mode_t::readings) {
+      push_frame_.add(sub.status, sub.latest);
+    } else if (sub.mode == subscription_mode_t::samples) {
+      // samples taken before an error are sent with the next batch
+      if (sub.status == status_code_t::success) {
+        push_frame_.add(sub.status, sub.pending.data() + sub.pending_first,
+                        sub.pending.size() - sub.pending_first);
+        sub.pending.clear();
+        sub.pending_first = 0;
+      } else {
+        push_frame_.add(sub.status, nullptr, 0);
+      }
+    } else if (sub.status == status_code_t::success) {
+      // covers every sample coalesced since the previous push
+      push_frame_.add(sub.status,
+                      sub.reader->subtract(sub.latest, sub.last_sent));
+      sub.last_sent = sub.latest;
+    } else {
+      push_frame_.add(sub.status, difference_t{});
+    }
+    push_frame_.finish();
+    writing_ = true;
+    asio::async_write(
+        socket_, asio::buffer(push_frame_.data(), push_frame_.size()),
+        asio::bind_executor(
+            strand_, [self = shared_from_this()](std::error_code ec, size_t) {
+              self->writing_ = false;
+              if (ec) {
+                self->close();
+                return;
+              }
+              self->write_next();
+            }));
+  }
+}
+
+void session::close() {
+  unsubscribe();
+  asio::error_code ignored;
+  socket_.close(ignored);
+}
+
+void session::subscribe(std::chrono::nanoseconds interval,
+                        subscription_mode_t mode, uint32_t batch,
+                        uint32_t request_id) {
+  subscription_t &sub = subscription_;
+  sub.request_id = request_id;
+  sub.mode = mode;
+  sub.interval = interval;
+  sub.push_pending = false;
+  sub.batch = batch;
+  sub.pending.clear();
+  sub.pending_first = 0;
+  if (mode == subscription_mode_t::difference) {
+    clock_t::duration age;
+    if (std::error_code ec;
+        !obtain_readings(*sub.reader, sub.last_sent, age, ec)) {
+      std::cerr << "Error obtaining readings: " << ec.message() << "\n";
+    }
+  }
+  sub.next = std::chrono::steady_clock::now() + interval;
+  if (!sub.active) {
+    sub.active = true;
+    wait_tick();
+  }
+}
+
+void session::unsubscribe() {
+  subscription_.active = false;
+  subscription_.push_pending = false;
+  timer_.cancel();
+}
+
+void session::wait_tick() {
+  timer_.expires_at(subscription_.next);
+  timer_.async_wait(asio::bind_executor(
+      strand_, [self = shared_from_this()](std::error_code ec) {
+        if (ec || !self->subscription_.active) {
+          return;
+        }
+        self->tick();
+      }));
+}
+
+void session::tick() {
+  subscription_t &sub = subscription_;
+  if (metrics_t::enabled()) {
+    metrics_t::instance().record(metric_t::wakeup,
+                                 std::chrono::steady_clock::now() - sub.next);
+  }
+  sub.status = status_code_t::success;
+  clock_t::duration age;
+  if (std::error_code ec; !obtain_readings(*sub.reader, sub.latest, age, ec)) {
+    sub.status = status_code_t::error;
+  }
+  if (sub.mode != subscription_mode_t::samples) {
+    // a push still pending is replaced rather than queued
+    sub.push_pending = true;
+    write_next();
+  } else if (sub.status == status_code_t::error) {
+    sub.push_pending = true;
+    write_next();
+  } else {
+    // the oldest sample is dropped by moving past it, and those dropped are
+    // only erased once there are as many of them as kept samples
+    if (sub.pending.size() - sub.pending_first == MAX_PENDING_SAMPLES &&
+        ++sub.pending_first == MAX_PENDING_SAMPLES) {
+      sub.pending.erase(sub.pending.begin(),
+                        sub.pending.begin() + sub.pending_first);
+      sub.pending_first = 0;
+    }
+    sub.pending.push_back(sub.latest);
+    // the samples taken while a push is written join the next one
+    if (sub.pending.size() - sub.pending_first >= sub.batch) {
+      sub.push_pending = true;
+      write_next();
+    }
+  }
+
+  // skip the intervals missed instead of pushing in bursts to catch up
+  sub.next += sub.interval;
+  if (auto now = std::chrono::steady_clock::now(); sub.next < now) {
+    sub.next = now + sub.interval;
+  }
+  wait_tick();
+}
+
+server::server(asio::io_context &context, std::string socket_path,
+               const std::vector<reader_t> &readers,
+               const attribution_t *attribution, clock_t::duration max_age,
+               const reader_set_t *reader_set)
+    : socket_path_(std::move(socket_path)),
+      acceptor_(context, make_endpoint(socket_path_)), readers_(readers),
+      reader_set_(reader_set), attribution_(attribution) {
+  if (max_age > clock_t::duration::zero()) {
+    for (const reader_t &reader : readers_) {
+      caches_.push_back(std::make_unique<read_cache_t>(reader, max_age));
+    }
+  }
+  accept();
+}
+
+server::~server() noexcept { ::unlink(socket_path_.c_str()); }
+
+void server::accept() {
+  acceptor_.async_accept(
+      [this](std::error_code ec, asio::local::stream_protocol::socket socket) {
+        if (ec == asio::error::operation_aborted) {
+          return;
+        }
+        if (ec) {
+          std::cerr << "Error accepting connection: " << ec.message() << "\n";
+        } else {
+          std::make_shared<session>(std::move(socket), readers_, caches_,
+                                    reader_set_, attribution_)
+              ->start();
+        }
+        accept();
+      });
+}
+
+} // namespace erd::ipc
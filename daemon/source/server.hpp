@@ -0,0 +1,129 @@
+#pragma once
+#include "read_cache.hpp"
+
+#include <erd/attribution.hpp>
+#include <erd/erd.hpp>
+#include <erd/ipc/message.hpp>
+
+#include <asio/io_context.hpp>
+#include <asio/local/stream_protocol.hpp>
+#include <asio/steady_timer.hpp>
+#include <asio/strand.hpp>
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace erd::ipc {
+
+// one connected client; requests are read, processed and answered in order,
+// so a client may pipeline requests without waiting for the responses; all
+// handlers of a session run on its strand
+class session : public std::enable_shared_from_this<session> {
+public:
+  session(asio::local::stream_protocol::socket socket,
+          const std::vector<reader_t> &readers,
+          const std::vector<std::unique_ptr<read_cache_t>> &caches,
+          const reader_set_t *reader_set, const attribution_t *attribution);
+
+  void start();
+
+private:
+  void read_request();
+  void read_message();
+  void read_frame();
+  void read_frame_payload();
+  void process_frame();
+  void record_request(time_point_t start, bool succeeded);
+
+  // the next request is read only once the response is written; a pending
+  // response takes priority over a pending push
+  void write_response(asio::const_buffer buffer);
+  void write_next();
+  void close();
+
+  void subscribe(std::chrono::nanoseconds interval, subscription_mode_t mode,
+                 uint32_t batch, uint32_t request_id);
+  void unsubscribe();
+  void wait_tick();
+  void tick();
+  void add_attribution(const request_operation_t &op, bool &failed);
+  void add_snapshot(bool &failed);
+  // the reader of the domain an operation is for; null if it is not served
+  const reader_t *find_reader(const request_operation_t &op) const noexcept;
+  // through the cache of the reader, if the server has caches
+  bool obtain_readings(const reader_t &reader, readings_t &into,
+                       clock_t::duration &age,
+                       std::error_code &ec) const noexcept;
+
+  asio::local::stream_protocol::socket socket_;
+  asio::strand<asio::local::stream_protocol::socket::executor_type> strand_;
+  asio::steady_timer timer_;
+  const std::vector<reader_t> &readers_;
+  const std::vector<std::unique_ptr<read_cache_t>> &caches_;
+  const reader_set_t *reader_set_;
+  const attribution_t *attribution_;
+  uint32_t prefix_;
+  message_request request_;
+  message_response response_;
+  request_frame request_frame_;
+  response_frame response_frame_;
+
+  bool writing_ = false;
+  bool response_pending_ = false;
+  asio::const_buffer response_buffer_;
+
+  struct subscription_t {
+    bool active = false;
+    bool push_pending = false;
+    uint32_t request_id;
+    subscription_mode_t mode;
+    std::chrono::nanoseconds interval;
+    std::chrono::steady_clock::time_point next;
+    status_code_t status;
+    readings_t latest;
+    readings_t last_sent;
+    // in samples mode, those taken since the previous push, from
+    // pending_first on
+    uint32_t batch;
+    std::vector<readings_t> pending;
+    size_t pending_first = 0;
+    const reader_t *reader;
+  } subscription_;
+  response_frame push_frame_;
+  std::vector<snapshot_entry_t> snapshot_;
+  readings_set_t snapshot_set_;
+};
+
+// accepts connections asynchronously and serves every client concurrently
+// from the threads running the io_context; operations naming no domain are
+// for the first reader and those naming a domain not served fail, as do
+// attribution operations unless an attribution is given; with a max_age, the
+// reads of every client are coalesced by a read_cache_t per reader; a reader
+// set over the domains of the readers makes snapshots atomic, its entries
+// following the order of the set
+class server {
+public:
+  server(asio::io_context &context, std::string socket_path,
+         const std::vector<reader_t> &readers,
+         const attribution_t *attribution = nullptr,
+         clock_t::duration max_age = {},
+         const reader_set_t *reader_set = nullptr);
+  ~server() noexcept;
+
+  server(const server &) = delete;
+  server &operator=(const server &) = delete;
+
+private:
+  void accept();
+
+  std::string socket_path_;
+  asio::local::stream_protocol::acceptor acceptor_;
+  const std::vector<reader_t> &readers_;
+  std::vector<std::unique_ptr<read_cache_t>> caches_;
+  const reader_set_t *reader_set_;
+  const attribution_t *attribution_;
+};
+
+} // namespace erd::ipc
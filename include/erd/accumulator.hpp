@@ -0,0 +1,63 @@
+#pragma once
+
+#include <erd/erd.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+namespace erd {
+
+// folds the wrapping counter of a reader into an energy value that only grows,
+// saturating at the maximum of energy_t; a background thread reads the counter
+// often enough that it never wraps twice between reads, so readings taken any
+// time apart can be subtracted exactly
+class accumulator_t {
+public:
+  // the background period is derived from the counter range and the observed
+  // power, and never exceeds max_period
+  explicit accumulator_t(reader_t reader,
+                         clock_t::duration max_period = std::chrono::seconds(1));
+  ~accumulator_t() noexcept;
+
+  accumulator_t(const accumulator_t &) = delete;
+  accumulator_t &operator=(const accumulator_t &) = delete;
+
+  // stops the background reads; accumulating remains correct as long as
+  // readings are obtained more often than the counter wraps
+  void stop() noexcept;
+
+  // reads the counter; the energy is that consumed since construction
+  bool obtain_readings(readings_t &into, std::error_code &ec) noexcept;
+
+  [[nodiscard]] static difference_t subtract(const readings_t &lhs,
+                                             const readings_t &rhs) noexcept;
+
+  [[nodiscard]] const reader_t &reader() const noexcept;
+
+  // current period of the background reads
+  [[nodiscard]] clock_t::duration period() const noexcept;
+
+  // number of failed background reads since construction
+  [[nodiscard]] std::uint64_t errors() const noexcept;
+
+private:
+  reader_t reader_;
+  clock_t::duration max_period_;
+  std::atomic<clock_t::rep> period_;
+  std::atomic<std::uint64_t> errors_{0};
+  std::mutex state_mtx_;
+  readings_t last_;
+  energy_t total_{};
+  std::mutex mtx_;
+  std::condition_variable cv_;
+  bool stop_ = false;
+  std::thread thread_;
+
+  bool update(readings_t &into, std::error_code &ec) noexcept;
+  void run() noexcept;
+};
+
+} // namespace erd
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <erd/erd.hpp>
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include <dirent.h>
+
+namespace erd {
+
+// apportions the energy of some readers, such as the package and cores domains
+// of a socket, among processes and cgroups in proportion to the CPU time each
+// used between updates; energy consumed while only the kernel or processes
+// that have since exited ran is left unattributed; CPU time is that of the
+// whole machine, so on a machine with several sockets the energy of one
+// socket is shared among processes in proportion to their CPU time on every
+// socket, not only on the one it was consumed by
+class attribution_t {
+public:
+  // /proc and /sys/fs/cgroup, unless ERD_PROC_ROOT or ERD_CGROUP_ROOT name
+  // other directories, such as fake trees for testing
+  static std::string default_proc_root();
+  static std::string default_cgroup_root();
+
+  // cgroups are paths relative to the cgroup root; throws if the proc root
+  // cannot be opened
+  attribution_t(std::vector<reader_t> readers,
+                std::vector<std::string> cgroups = {},
+                const std::string &proc_root = default_proc_root(),
+                const std::string &cgroup_root = default_cgroup_root());
+  ~attribution_t() noexcept;
+
+  attribution_t(const attribution_t &) = delete;
+  attribution_t &operator=(const attribution_t &) = delete;
+
+  // reads the readers and CPU time, then scans every process and attributes
+  // the energy consumed since the previous update; once the tables have grown
+  // to the number of processes, it allocates nothing; must not be called
+  // concurrently with itself, but may be with the queries
+  bool update(std::error_code &ec) noexcept;
+
+  // the energy of reader idx attributed to a process since it was first seen,
+  // or to a cgroup since construction; false if it is not tracked
+  bool process_energy(std::int32_t pid, std::size_t idx,
+                      joules<double> &into) const noexcept;
+  bool cgroup_energy(std::string_view cgroup, std::size_t idx,
+                     joules<double> &into) const noexcept;
+
+  // the energy of reader idx left unattributed since construction; false if
+  // there is no such reader
+  bool unattributed(std::size_t idx, joules<double> &into) const noexcept;
+
+  [[nodiscard]] const reader_t &reader(std::size_t idx = 0) const noexcept;
+
+  // number of readers
+  [[nodiscard]] std::size_t size() const noexcept;
+
+  // number of processes seen by the last update
+  [[nodiscard]] std::size_t process_count() const noexcept;
+
+private:
+  struct process_t {
+    std::int32_t pid;
+    std::uint64_t start_time; // tells a process from one reusing its PID
+    std::uint64_t cpu_ticks;
+  };
+
+  struct cgroup_t {
+    std::string name;
+    std::string stat_path; // cpu.stat, relative to the cgroup root
+    bool seen;
+    std::uint64_t usage_us;
+    // read by the update in progress
+    bool sampled;
+    std::uint64_t sample_us;
+  };
+
+  std::vector<reader_t> readers_;
+  std::vector<readings_t> readings_;
+  std::vector<readings_t> next_readings_;
+  DIR *proc_dir_;
+  int cgroup_fd_;
+  double ticks_per_second_;
+  bool first_ = true;
+  std::uint64_t busy_ticks_ = 0;
+
+  // sorted by PID; the energy of entry i of reader r is at i * readers + r
+  std::vector<process_t> processes_;
+  std::vector<double> process_energy_;
+  // where an update builds the tables before swapping them in
+  std::vector<process_t> scan_;
+  std::vector<double> scan_energy_;
+  std::vector<std::uint64_t> scan_deltas_;
+  std::vector<cgroup_t> cgroups_;
+  std::vector<double> cgroup_energy_;
+  std::vector<double> unattributed_;
+  mutable std::mutex mtx_;
+
+  bool read_busy_ticks(std::uint64_t &into, std::error_code &ec) noexcept;
+  bool scan_processes(std::error_code &ec) noexcept;
+  bool read_usage(const cgroup_t &cgroup, std::uint64_t &into) noexcept;
+};
+
+} // namespace erd
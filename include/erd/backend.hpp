@@ -0,0 +1,351 @@
+#pragma once
+
+#include <erd/clock.hpp>
+#include <erd/erd_common.hpp>
+#include <erd/metrics.hpp>
+#include <erd/series.hpp>
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace erd {
+
+// interface every backend is used through when chosen at runtime
+class backend_t {
+public:
+  virtual ~backend_t() = default;
+
+  [[nodiscard]] virtual std::unique_ptr<backend_t> clone() const = 0;
+
+  virtual bool obtain_readings(readings_t &into,
+                               std::error_code &ec) const noexcept = 0;
+
+  [[nodiscard]] virtual difference_t
+  subtract(const readings_t &lhs, const readings_t &rhs) const noexcept = 0;
+
+  [[nodiscard]] virtual const attributes_t &attributes() const noexcept = 0;
+
+  [[nodiscard]] virtual energy_t max_energy() const noexcept = 0;
+
+  [[nodiscard]] virtual const char *name() const noexcept = 0;
+};
+
+// interface every backend reading several domains at once is used through
+// when chosen at runtime
+class backend_set_t {
+public:
+  virtual ~backend_set_t() = default;
+
+  virtual bool obtain_readings(readings_set_t &into,
+                               std::error_code &ec) const noexcept = 0;
+
+  [[nodiscard]] virtual difference_t
+  subtract(std::size_t idx, const readings_set_t &lhs,
+           const readings_set_t &rhs) const noexcept = 0;
+
+  [[nodiscard]] virtual std::size_t size() const noexcept = 0;
+
+  [[nodiscard]] virtual const std::vector<attributes_t> &
+  attributes() const noexcept = 0;
+
+  [[nodiscard]] virtual const char *name() const noexcept = 0;
+};
+
+namespace detail {
+
+template <typename Reader> class backend_adapter final : public backend_t {
+public:
+  explicit backend_adapter(Reader reader) : reader_(std::move(reader)) {}
+
+  std::unique_ptr<backend_t> clone() const override {
+    return std::make_unique<backend_adapter>(reader_);
+  }
+
+  bool obtain_readings(readings_t &into,
+                       std::error_code &ec) const noexcept override {
+    return reader_.obtain_readings(into, ec);
+  }
+
+  difference_t subtract(const readings_t &lhs,
+                        const readings_t &rhs) const noexcept override {
+    return reader_.subtract(lhs, rhs);
+  }
+
+  const attributes_t &attributes() const noexcept override {
+    return reader_.attributes();
+  }
+
+  energy_t max_energy() const noexcept override {
+    return reader_.max_energy();
+  }
+
+  const char *name() const noexcept override { return Reader::backend_name; }
+
+private:
+  Reader reader_;
+};
+
+template <typename ReaderSet>
+class backend_set_adapter final : public backend_set_t {
+public:
+  backend_set_adapter(const char *name, ReaderSet set)
+      : name_(name), set_(std::move(set)) {}
+
+  bool obtain_readings(readings_set_t &into,
+                       std::error_code &ec) const noexcept override {
+    return set_.obtain_readings(into, ec);
+  }
+
+  difference_t subtract(std::size_t idx, const readings_set_t &lhs,
+                        const readings_set_t &rhs) const noexcept override {
+    return set_.subtract(idx, lhs, rhs);
+  }
+
+  std::size_t size() const noexcept override { return set_.size(); }
+
+  const std::vector<attributes_t> &attributes() const noexcept override {
+    return set_.attributes();
+  }
+
+  const char *name() const noexcept override { return name_; }
+
+private:
+  const char *name_;
+  ReaderSet set_;
+};
+
+} // namespace detail
+
+// the backends available to this process, tried in order of registration
+// unless ERD_BACKEND lists the names to try, e.g. ERD_BACKEND=msr,powercap;
+// backends added as not probed, which accept any attributes, are only tried
+// when listed
+class backend_registry_t {
+public:
+  using factory_t = std::unique_ptr<backend_t> (*)(const attributes_t &);
+  using set_factory_t = std::unique_ptr<backend_set_t> (*)(
+      const std::vector<attributes_t> &);
+
+  // holds every backend built into the library
+  static backend_registry_t &instance();
+
+  // the set factory is null for backends that do not batch reads
+  void add(std::string name, factory_t factory, bool probed = true,
+           set_factory_t set_factory = nullptr);
+
+  // Reader must be constructible from attributes_t and have a backend_name;
+  // ReaderSet, if any, from a vector of them
+  template <typename Reader, typename ReaderSet = void>
+  void add(bool probed = true) {
+    set_factory_t set_factory = nullptr;
+    if constexpr (!std::is_void_v<ReaderSet>) {
+      set_factory = [](const std::vector<attributes_t> &attrs)
+          -> std::unique_ptr<backend_set_t> {
+        return std::make_unique<detail::backend_set_adapter<ReaderSet>>(
+            Reader::backend_name, ReaderSet{attrs});
+      };
+    }
+    add(
+        Reader::backend_name,
+        [](const attributes_t &attr) -> std::unique_ptr<backend_t> {
+          return std::make_unique<detail::backend_adapter<Reader>>(
+              Reader{attr});
+        },
+        probed, set_factory);
+  }
+
+  // the first backend that can be constructed for attr; throws the error of
+  // the last one tried, with the reason each one failed, if none can
+  [[nodiscard]] std::unique_ptr<backend_t> make(const attributes_t &attr) const;
+  [[nodiscard]] std::unique_ptr<backend_t> make(std::string_view name,
+                                                const attributes_t &attr) const;
+
+  // the backends make selects for each domain; read through the set of their
+  // backend if they are all the same one and it batches reads, and back to
+  // back otherwise
+  [[nodiscard]] std::unique_ptr<backend_set_t>
+  make_set(const std::vector<attributes_t> &attrs) const;
+  // the set of the named backend, or its readers read back to back if it
+  // does not batch reads
+  [[nodiscard]] std::unique_ptr<backend_set_t>
+  make_set(std::string_view name, const std::vector<attributes_t> &attrs) const;
+
+  [[nodiscard]] std::vector<std::string> names() const;
+
+private:
+  struct entry_t {
+    std::string name;
+    factory_t factory;
+    bool probed;
+    set_factory_t set_factory;
+  };
+
+  backend_registry_t();
+
+  [[nodiscard]] std::vector<std::string> probe_order() const;
+  [[nodiscard]] entry_t find(std::string_view name) const;
+  [[nodiscard]] set_factory_t find_set_factory(std::string_view name) const;
+
+  mutable std::mutex mtx_;
+  std::vector<entry_t> entries_;
+};
+
+// selects its backend at runtime through the registry
+class any_backend_t {
+public:
+  static constexpr const char *backend_name = "any";
+
+  explicit any_backend_t(const attributes_t &attr);
+  any_backend_t(std::string_view backend, const attributes_t &attr);
+  explicit any_backend_t(std::unique_ptr<backend_t> backend) noexcept;
+
+  any_backend_t(const any_backend_t &other);
+  any_backend_t &operator=(const any_backend_t &other);
+  any_backend_t(any_backend_t &&other) noexcept = default;
+  any_backend_t &operator=(any_backend_t &&other) noexcept = default;
+
+  bool obtain_readings(readings_t &into, std::error_code &ec) const noexcept {
+    return impl_->obtain_readings(into, ec);
+  }
+
+  [[nodiscard]] difference_t subtract(const readings_t &lhs,
+                                      const readings_t &rhs) const noexcept {
+    return impl_->subtract(lhs, rhs);
+  }
+
+  [[nodiscard]] const attributes_t &attributes() const noexcept {
+    return impl_->attributes();
+  }
+
+  [[nodiscard]] energy_t max_energy() const noexcept {
+    return impl_->max_energy();
+  }
+
+  // name of the backend selected
+  [[nodiscard]] const char *name() const noexcept { return impl_->name(); }
+
+private:
+  std::unique_ptr<backend_t> impl_;
+};
+
+// reads several domains, at once if the backend selected at runtime through
+// the registry batches reads; readings of domain i are in energy[i]
+class any_reader_set_t {
+public:
+  explicit any_reader_set_t(const std::vector<attributes_t> &attrs);
+  any_reader_set_t(std::string_view backend,
+                   const std::vector<attributes_t> &attrs);
+  any_reader_set_t(const std::vector<std::uint32_t> &sockets,
+                   const std::vector<domain_t> &domains);
+  explicit any_reader_set_t(std::unique_ptr<backend_set_t> set) noexcept;
+
+  bool obtain_readings(readings_set_t &into,
+                       std::error_code &ec) const noexcept {
+    return impl_->obtain_readings(into, ec);
+  }
+
+  [[nodiscard]] difference_t
+  subtract(std::size_t idx, const readings_set_t &lhs,
+           const readings_set_t &rhs) const noexcept {
+    return impl_->subtract(idx, lhs, rhs);
+  }
+
+  [[nodiscard]] std::size_t size() const noexcept { return impl_->size(); }
+
+  [[nodiscard]] const std::vector<attributes_t> &attributes() const noexcept {
+    return impl_->attributes();
+  }
+
+  // name of the backend selected, or any_backend_t::backend_name if its
+  // domains are read one by one through backends selected for each
+  [[nodiscard]] const char *name() const noexcept { return impl_->name(); }
+
+private:
+  std::unique_ptr<backend_set_t> impl_;
+};
+
+// a reader over a backend known at compile time, so that no call is virtual
+// and hot loops can inline the read path; reader_t is the runtime-selected
+// basic_reader<any_backend_t>
+template <typename Backend> class basic_reader {
+public:
+  using backend_type = Backend;
+
+  explicit basic_reader(attributes_t attr) : backend_(std::move(attr)) {}
+
+  template <typename... Args>
+  explicit basic_reader(std::in_place_t, Args &&...args)
+      : backend_(std::forward<Args>(args)...) {}
+
+  // timed into metric_t::read when metrics are enabled
+  bool obtain_readings(readings_t &into, std::error_code &ec) const noexcept {
+    if (!metrics_t::enabled()) {
+      return backend_.obtain_readings(into, ec);
+    }
+    auto start = now();
+    bool retval = backend_.obtain_readings(into, ec);
+    metrics_t &metrics = metrics_t::instance();
+    metrics.record(metric_t::read, now() - start);
+    if (!retval) {
+      metrics.record_error(metric_t::read);
+    }
+    return retval;
+  }
+
+  // also brackets the read with timestamps from the selected clock; the
+  // timestamp backends take once the counter is read ends the bracket
+  bool obtain_readings(readings_t &into, read_timestamps_t &ts,
+                       std::error_code &ec) const noexcept {
+    ts.before = now();
+    bool retval = backend_.obtain_readings(into, ec);
+    ts.after = retval ? into.timestamp : now();
+    ts.realtime = to_realtime(ts.before);
+    if (metrics_t::enabled()) {
+      metrics_t &metrics = metrics_t::instance();
+      metrics.record(metric_t::read, ts.after - ts.before);
+      if (!retval) {
+        metrics.record_error(metric_t::read);
+      }
+    }
+    return retval;
+  }
+
+  [[nodiscard]] difference_t subtract(const readings_t &lhs,
+                                      const readings_t &rhs) const noexcept {
+    return backend_.subtract(lhs, rhs);
+  }
+
+  // the differences between consecutive samples, count - 1 of them
+  void subtract_n(const readings_t *samples, std::size_t count,
+                  difference_t *out) const noexcept {
+    erd::subtract_n(samples, count, backend_.max_energy(), out);
+  }
+
+  // the power between consecutive samples, count - 1 values
+  void power_series(const readings_t *samples, std::size_t count,
+                    watts<double> *out) const noexcept {
+    erd::power_series(samples, count, backend_.max_energy(), out);
+  }
+
+  [[nodiscard]] const attributes_t &attributes() const noexcept {
+    return backend_.attributes();
+  }
+
+  // value at which the energy counter wraps around
+  [[nodiscard]] energy_t max_energy() const noexcept {
+    return backend_.max_energy();
+  }
+
+  [[nodiscard]] const Backend &backend() const noexcept { return backend_; }
+
+private:
+  Backend backend_;
+};
+
+} // namespace erd
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <erd/erd_common.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <system_error>
+
+namespace erd {
+
+enum class clock_source_t {
+  standard, // clock_t::now(), a clock_gettime call
+  tsc,      // the invariant timestamp counter, calibrated against clock_t
+};
+
+// clock reading the invariant timestamp counter of x86 processors, on the
+// timeline of clock_t; it is re-anchored to clock_t every second, slewing
+// rather than stepping to correct the drift, so the two agree to within
+// microseconds and time never goes backwards; only a step of clock_t forward,
+// such as after a suspend, is followed at once
+//
+// the first call of now or frequency, or set_clock_source selecting it,
+// calibrates the counter against clock_t, which sleeps for 10 ms
+class tsc_clock_t {
+public:
+  using duration = clock_t::duration;
+  using rep = duration::rep;
+  using period = duration::period;
+  using time_point = time_point_t;
+  static constexpr bool is_steady = clock_t::is_steady;
+
+  // whether the processor has an invariant counter which the kernel also
+  // trusts as its clock source
+  static bool available() noexcept;
+
+  static time_point now() noexcept;
+
+  // counter ticks per second, as calibrated
+  static double frequency() noexcept;
+};
+
+namespace detail {
+
+inline std::atomic<bool> tsc_selected{false};
+
+} // namespace detail
+
+// selects the clock of the timestamps taken by readers; defaults to
+// standard, or to tsc when ERD_CLOCK is set to tsc; fails with
+// errc::not_supported when the counter is unavailable
+bool set_clock_source(clock_source_t source, std::error_code &ec) noexcept;
+
+[[nodiscard]] clock_source_t clock_source() noexcept;
+
+// the current time on the timeline of clock_t, from the selected source
+inline time_point_t now() noexcept {
+  if (detail::tsc_selected.load(std::memory_order_relaxed)) {
+    return tsc_clock_t::now();
+  }
+  return clock_t::now();
+}
+
+// the wall-clock time of a time point, through an offset between the clocks
+// which is measured again when more than a second old
+std::chrono::system_clock::time_point to_realtime(time_point_t tp) noexcept;
+
+// a read bracketed by timestamps taken immediately before it and once the
+// counter is read, and the wall-clock time of the first, to align traces with
+// other logs
+struct read_timestamps_t {
+  time_point_t before;
+  time_point_t after;
+  std::chrono::system_clock::time_point realtime;
+
+  // error bar of a timestamp taken during the read
+  [[nodiscard]] clock_t::duration uncertainty() const noexcept {
+    return (after - before) / 2;
+  }
+};
+
+} // namespace erd
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <erd/erd_common.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <system_error>
+#include <vector>
+
+namespace erd {
+
+// compact encoding of samples in time order, in self-delimiting blocks: the
+// number of samples and the first sample, then for every other sample the
+// change in the step between timestamps, as in Gorilla, and the change in
+// energy, all as zigzag varints; a steady sampling period makes timestamps
+// about a byte each, and a counter wrap is encoded as a negative change
+namespace codec {
+
+// the largest size of a block of count samples
+[[nodiscard]] std::size_t max_block_size(std::size_t count) noexcept;
+
+// appends a block to out; timestamps are in ticks of clock_t
+void encode(const readings_t *samples, std::size_t count,
+            std::vector<std::uint8_t> &out);
+void encode(const std::int64_t *time, const std::uint64_t *energy,
+            std::size_t count, std::vector<std::uint8_t> &out);
+
+// the number of samples of the block at data
+bool block_count(const std::uint8_t *data, std::size_t size, std::size_t &count,
+                 std::error_code &ec) noexcept;
+
+// decodes the block at data into at most capacity samples and advances data
+// past it; fails with errc::bad_message if the block is malformed or
+// truncated and errc::no_buffer_space if it holds more than capacity samples
+bool decode(const std::uint8_t *&data, const std::uint8_t *end,
+            readings_t *out, std::size_t capacity,
+            std::error_code &ec) noexcept;
+bool decode(const std::uint8_t *&data, const std::uint8_t *end,
+            std::int64_t *time, std::uint64_t *energy, std::size_t capacity,
+            std::error_code &ec) noexcept;
+
+// decodes the block at data, appending its samples to out
+bool decode(const std::uint8_t *&data, const std::uint8_t *end,
+            std::vector<readings_t> &out, std::error_code &ec);
+
+} // namespace codec
+
+} // namespace erd
@@ -35,6 +35,18 @@ typedef enum erd_rapl_domain_e {
   ERD_DRAM,
 } erd_rapl_domain_t;
 
+typedef enum erd_metric_e {
+  ERD_METRIC_READ,
+  ERD_METRIC_IPC,
+  ERD_METRIC_WAKEUP,
+  ERD_METRIC_STALENESS,
+} erd_metric_t;
+
+typedef enum erd_clock_e {
+  ERD_CLOCK_STANDARD,
+  ERD_CLOCK_TSC,
+} erd_clock_t;
+
 typedef struct erd_readings_st {
   int64_t time;
   uint64_t energy;
@@ -42,6 +54,18 @@ typedef struct erd_readings_st {
   erd_energy_unit_t eunit;
 } erd_readings_t;
 
+typedef struct erd_stats_st {
+  uint64_t count;
+  uint64_t errors;
+  uint64_t min;
+  uint64_t max;
+  double mean;
+  uint64_t p50;
+  uint64_t p90;
+  uint64_t p99;
+  uint64_t p999;
+} erd_stats_t;
+
 typedef struct erd_error_descriptor_st {
   char *what;
   uint64_t size;
@@ -49,6 +73,8 @@ typedef struct erd_error_descriptor_st {
 
 typedef struct erd_attr_st *erd_attr_t;
 typedef struct erd_handle_st *erd_handle_t;
+typedef struct erd_sampler_st *erd_sampler_t;
+typedef struct erd_group_st *erd_group_t;
 
 erd_status_t erd_attr_create(erd_attr_t *attr, erd_error_descriptor_t *ed);
 
@@ -71,6 +97,87 @@ erd_status_t erd_subtract_readings(erd_handle_t handle,
                                    const erd_readings_t *rhs,
                                    erd_readings_t *result);
 
+// batch forms over columns of samples, time in nanoseconds and energy in
+// microjoules, so that bindings make one call per batch rather than per sample
+
+// takes count samples period_ns nanoseconds apart, or back to back when 0;
+// on error, *taken holds the number of samples taken before it
+erd_status_t erd_sample_n(erd_handle_t handle, int64_t period_ns, size_t count,
+                          int64_t *time, uint64_t *energy, size_t *taken,
+                          erd_error_descriptor_t *ed);
+
+// reads count handles, such as several domains, one after another
+erd_status_t erd_obtain_readings_n(const erd_handle_t *handles, size_t count,
+                                   int64_t *time, uint64_t *energy,
+                                   erd_error_descriptor_t *ed);
+
+// the count - 1 differences between consecutive samples
+erd_status_t erd_subtract_n(erd_handle_t handle, const int64_t *time,
+                            const uint64_t *energy, size_t count,
+                            int64_t *duration, uint64_t *consumed);
+
+// the count - 1 average powers, in watts, between consecutive samples
+erd_status_t erd_power_n(erd_handle_t handle, const int64_t *time,
+                         const uint64_t *energy, size_t count, double *watts);
+
+// reads handle every period_ns nanoseconds on a thread of its own, into a ring
+// buffer of capacity samples rounded up to a power of two; the oldest samples
+// are overwritten when they are not drained in time
+erd_status_t erd_sampler_create(erd_sampler_t *sampler, erd_handle_t handle,
+                                int64_t period_ns, size_t capacity,
+                                erd_error_descriptor_t *ed);
+
+erd_status_t erd_sampler_destroy(erd_sampler_t sampler);
+
+// stops sampling; the samples taken remain to be drained
+erd_status_t erd_sampler_stop(erd_sampler_t sampler);
+
+// each consumer keeps its own cursor, starting at 0; copies up to size of the
+// samples from position *cursor onwards, oldest first, and advances *cursor
+// past them; samples overwritten before being drained are skipped
+erd_status_t erd_sampler_drain(erd_sampler_t sampler, uint64_t *cursor,
+                               int64_t *time, uint64_t *energy, size_t size,
+                               size_t *count);
+
+// the number of samples from position cursor onwards still held
+erd_status_t erd_sampler_available(erd_sampler_t sampler, uint64_t cursor,
+                                   size_t *count);
+
+// the number of failed reads since creation
+erd_status_t erd_sampler_errors(erd_sampler_t sampler, uint64_t *errors);
+
+// a group reads and subtracts many handles, such as every domain of every
+// socket, in one call with a single error path
+erd_status_t erd_group_create(erd_group_t *group, erd_error_descriptor_t *ed);
+
+erd_status_t erd_group_destroy(erd_group_t group);
+
+// appends a copy of handle, which may be destroyed afterwards
+erd_status_t erd_group_add(erd_group_t group, erd_handle_t handle,
+                           erd_error_descriptor_t *ed);
+
+erd_status_t erd_group_size(erd_group_t group, size_t *size);
+
+// reads the handles into out, in the order they were added; n must be the size
+// of the group, and on error the readings before the failed one are written;
+// ed, which may be null, says why a read failed, as for erd_obtain_readings
+erd_status_t erd_group_obtain_readings(erd_group_t group, erd_readings_t *out,
+                                       size_t n, erd_error_descriptor_t *ed);
+
+// out[i] is lhs[i] minus rhs[i], subtracted by handle i of the group
+erd_status_t erd_group_subtract_n(erd_group_t group, const erd_readings_t *lhs,
+                                  const erd_readings_t *rhs,
+                                  erd_readings_t *out, size_t n);
+
+erd_status_t erd_stats_enable(int enable);
+
+erd_status_t erd_stats_get(erd_metric_t metric, erd_stats_t *into,
+                           erd_error_descriptor_t *ed);
+
+erd_status_t erd_stats_reset(void);
+
+erd_status_t erd_set_clock(erd_clock_t clock, erd_error_descriptor_t *ed);
+
 #if defined(__cplusplus)
 }
 #endif // defined(__cplusplus)
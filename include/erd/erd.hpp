@@ -1,7 +1,20 @@
 #pragma once
 
+#include <erd/backend.hpp>
+#include <erd/erd_nop.hpp>
+#include <erd/erd_sim.hpp>
+
 #if defined(ERD_POWERCAP)
 #include <erd/erd_powercap.hpp>
-#else
-#include <erd/erd_nop.hpp>
 #endif
+
+#if defined(ERD_MSR)
+#include <erd/erd_msr.hpp>
+#endif
+
+namespace erd {
+
+using reader_t = basic_reader<any_backend_t>;
+using reader_set_t = any_reader_set_t;
+
+} // namespace erd
@@ -5,6 +5,7 @@
 #include <chrono>
 #include <cstdint>
 #include <system_error>
+#include <vector>
 
 namespace erd {
 
@@ -48,4 +49,20 @@ struct difference_t {
   energy_t energy_consumed;
 };
 
+// readings of several domains sharing one timestamp bracket; the energy of
+// domain i of a reader_set_t is stored in energy[i]
+struct readings_set_t {
+  time_point_t begin;
+  time_point_t end;
+  std::vector<energy_t> energy;
+
+  [[nodiscard]] readings_t readings(std::size_t idx) const noexcept {
+    return readings_t{end, energy[idx]};
+  }
+};
+
+// every combination of the sockets and domains given, socket-major
+std::vector<attributes_t> make_attributes(const std::vector<uint32_t> &sockets,
+                                          const std::vector<domain_t> &domains);
+
 } // namespace erd
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <erd/erd_common.hpp>
+#include <erd/file_descriptor.hpp>
+#include <erd/units.hpp>
+
+#include <cstdint>
+#include <string>
+#include <system_error>
+
+namespace erd {
+
+namespace detail {
+
+// the model of the CPU running the caller if it is an Intel family 6 one, the
+// family whose models RAPL quirks depend on, and 0 otherwise
+[[nodiscard]] std::uint32_t intel_cpu_model() noexcept;
+
+} // namespace detail
+
+// reads the RAPL energy status registers through the msr driver, bypassing
+// powercap; the energy unit is decoded once and counts are converted to
+// microjoules with integer arithmetic; as in intel_rapl, DRAM counts in 2^-16 J
+// on the server models that fix it rather than in the unit of the package
+class msr_reader_t {
+public:
+  static constexpr const char *backend_name = "msr";
+
+  // uses /dev/cpu/N/msr, N being the first CPU of the socket
+  explicit msr_reader_t(attributes_t attr);
+  // uses the given device, or a regular file laid out like one: register R is
+  // the 8 bytes at offset R; the CPU model selects the unit of DRAM
+  msr_reader_t(attributes_t attr, const std::string &device,
+               std::uint32_t cpu_model = detail::intel_cpu_model());
+
+  bool obtain_readings(readings_t &into, std::error_code &ec) const noexcept;
+
+  [[nodiscard]] difference_t subtract(const readings_t &lhs,
+                                      const readings_t &rhs) const noexcept;
+
+  [[nodiscard]] const attributes_t &attributes() const noexcept;
+
+  // value at which the energy counter wraps around
+  [[nodiscard]] energy_t max_energy() const noexcept;
+
+private:
+  attributes_t attr_;
+  detail::file_descriptor device_;
+  std::uint32_t status_register_;
+  std::uint32_t energy_unit_;
+  energy_t maxvalue_;
+};
+
+} // namespace erd
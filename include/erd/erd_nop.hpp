@@ -5,12 +5,16 @@
 
 #include <string>
 #include <system_error>
+#include <vector>
 
 namespace erd {
 
-class reader_t {
+// reads no energy; the fallback where no other backend is available
+class nop_reader_t {
 public:
-  explicit reader_t(attributes_t attr);
+  static constexpr const char *backend_name = "nop";
+
+  explicit nop_reader_t(attributes_t attr);
 
   bool obtain_readings(readings_t &into, std::error_code &ec) const noexcept;
 
@@ -19,8 +23,32 @@ public:
 
   [[nodiscard]] const attributes_t &attributes() const noexcept;
 
+  // value at which the energy counter wraps around
+  [[nodiscard]] energy_t max_energy() const noexcept;
+
 private:
   attributes_t attr_;
 };
 
+class nop_reader_set_t {
+public:
+  explicit nop_reader_set_t(std::vector<attributes_t> attrs);
+  nop_reader_set_t(const std::vector<std::uint32_t> &sockets,
+                   const std::vector<domain_t> &domains);
+
+  bool obtain_readings(readings_set_t &into,
+                       std::error_code &ec) const noexcept;
+
+  [[nodiscard]] difference_t subtract(std::size_t idx,
+                                      const readings_set_t &lhs,
+                                      const readings_set_t &rhs) const noexcept;
+
+  [[nodiscard]] std::size_t size() const noexcept;
+
+  [[nodiscard]] const std::vector<attributes_t> &attributes() const noexcept;
+
+private:
+  std::vector<attributes_t> attrs_;
+};
+
 } // namespace erd
@@ -1,38 +1,55 @@
 #pragma once
 
 #include <erd/erd_common.hpp>
+#include <erd/file_descriptor.hpp>
+#include <erd/topology.hpp>
 #include <erd/units.hpp>
 
 #include <chrono>
 #include <cstdint>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <system_error>
+#include <vector>
 
 namespace erd {
 
 namespace detail {
 
-class file_descriptor {
-  int value_;
-
+// reads the unsigned integer contents of several files at once, with a single
+// io_uring submission when available and one pread per file otherwise
+class batch_reader {
 public:
-  explicit file_descriptor(const std::string &path);
-  explicit file_descriptor(const char *path);
-  ~file_descriptor() noexcept;
+  explicit batch_reader(std::vector<file_descriptor> fds);
+  ~batch_reader() noexcept;
+
+  batch_reader(batch_reader &&other) noexcept;
+  batch_reader &operator=(batch_reader &&other) noexcept;
+
+  bool read(energy_t *into, std::error_code &ec) const noexcept;
 
-  file_descriptor(const file_descriptor &fd);
-  file_descriptor(file_descriptor &&fd) noexcept;
-  file_descriptor &operator=(const file_descriptor &other);
-  file_descriptor &operator=(file_descriptor &&other) noexcept;
+  [[nodiscard]] std::size_t size() const noexcept;
 
-  explicit operator int() const noexcept;
+  [[nodiscard]] bool uses_io_uring() const noexcept;
+
+private:
+  struct ring;
+
+  std::vector<file_descriptor> fds_;
+  std::unique_ptr<ring> ring_;
+  std::unique_ptr<std::mutex> ring_mtx_;
+
+  bool read_sync(energy_t *into, std::error_code &ec) const noexcept;
 };
 
 } // namespace detail
 
-class reader_t {
+class powercap_reader_t {
 public:
-  explicit reader_t(attributes_t attr);
+  static constexpr const char *backend_name = "powercap";
+
+  explicit powercap_reader_t(attributes_t attr);
 
   bool obtain_readings(readings_t &into, std::error_code &ec) const noexcept;
 
@@ -41,12 +58,44 @@ public:
 
   [[nodiscard]] const attributes_t &attributes() const noexcept;
 
+  // value at which the energy counter wraps around
+  [[nodiscard]] energy_t max_energy() const noexcept;
+
 private:
   attributes_t attr_;
   detail::file_descriptor sensor_;
+  std::vector<detail::file_descriptor> dies_;
   energy_t maxvalue_;
 
-  reader_t(attributes_t &&attr, const std::string &prefix);
+  powercap_reader_t(attributes_t &&attr, const zone_t &zone);
+};
+
+class powercap_reader_set_t {
+public:
+  explicit powercap_reader_set_t(std::vector<attributes_t> attrs);
+  powercap_reader_set_t(const std::vector<std::uint32_t> &sockets,
+                        const std::vector<domain_t> &domains);
+
+  bool obtain_readings(readings_set_t &into,
+                       std::error_code &ec) const noexcept;
+
+  [[nodiscard]] difference_t subtract(std::size_t idx,
+                                      const readings_set_t &lhs,
+                                      const readings_set_t &rhs) const noexcept;
+
+  [[nodiscard]] std::size_t size() const noexcept;
+
+  [[nodiscard]] const std::vector<attributes_t> &attributes() const noexcept;
+
+private:
+  std::vector<attributes_t> attrs_;
+  std::vector<energy_t> maxvalues_;
+  // number of files read for each domain, one per die
+  std::vector<std::size_t> counts_;
+  detail::batch_reader sensors_;
+
+  powercap_reader_set_t(std::vector<attributes_t> &&attrs,
+                        const std::vector<const zone_t *> &zones);
 };
 
 } // namespace erd
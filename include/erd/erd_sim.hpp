@@ -0,0 +1,83 @@
+#pragma once
+
+#include <erd/erd_common.hpp>
+#include <erd/units.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <system_error>
+
+namespace erd {
+
+// synthetic power draw of a simulated zone: a constant, plus a sine wave, plus
+// gaussian noise drawn at every counter update
+struct sim_model_t {
+  double power = 50;    // watts
+  double amplitude = 0; // watts
+  clock_t::duration period = std::chrono::seconds(1);
+  double noise = 0; // standard deviation, watts
+  clock_t::duration granularity = std::chrono::milliseconds(1);
+  energy_t max_energy{262143328850};
+  std::uint64_t seed = 0;
+
+  // the defaults, overridden by ERD_SIM_POWER, ERD_SIM_AMPLITUDE,
+  // ERD_SIM_PERIOD_MS, ERD_SIM_NOISE, ERD_SIM_GRANULARITY_US,
+  // ERD_SIM_MAX_ENERGY and ERD_SIM_SEED
+  static sim_model_t from_env();
+};
+
+namespace detail {
+
+// energy counter following a model, advanced lazily in whole updates and
+// wrapping around at the model's max_energy
+class sim_counter {
+public:
+  sim_counter(const sim_model_t &model, std::uint64_t seed);
+
+  energy_t read(time_point_t now) noexcept;
+
+private:
+  sim_model_t model_;
+  std::mutex mtx_;
+  time_point_t start_;
+  std::uint64_t updates_ = 0;
+  std::uint64_t energy_ = 0; // microjoules, before wrapping
+  double remainder_ = 0;     // fraction of a microjoule
+  std::mt19937_64 rng_;
+  std::normal_distribution<double> noise_;
+
+  void advance(std::uint64_t updates) noexcept;
+};
+
+} // namespace detail
+
+// reads a simulated counter instead of hardware, to exercise everything built
+// on readers where RAPL is absent; copies share the counter
+class sim_reader_t {
+public:
+  static constexpr const char *backend_name = "sim";
+
+  // uses sim_model_t::from_env()
+  explicit sim_reader_t(attributes_t attr);
+  sim_reader_t(attributes_t attr, const sim_model_t &model);
+
+  bool obtain_readings(readings_t &into, std::error_code &ec) const noexcept;
+
+  [[nodiscard]] difference_t subtract(const readings_t &lhs,
+                                      const readings_t &rhs) const noexcept;
+
+  [[nodiscard]] const attributes_t &attributes() const noexcept;
+
+  // value at which the energy counter wraps around
+  [[nodiscard]] energy_t max_energy() const noexcept;
+
+private:
+  attributes_t attr_;
+  energy_t maxvalue_;
+  std::shared_ptr<detail::sim_counter> counter_;
+};
+
+} // namespace erd
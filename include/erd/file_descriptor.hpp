@@ -0,0 +1,23 @@
+#pragma once
+
+#include <string>
+
+namespace erd::detail {
+
+class file_descriptor {
+  int value_;
+
+public:
+  explicit file_descriptor(const std::string &path);
+  explicit file_descriptor(const char *path);
+  ~file_descriptor() noexcept;
+
+  file_descriptor(const file_descriptor &fd);
+  file_descriptor(file_descriptor &&fd) noexcept;
+  file_descriptor &operator=(const file_descriptor &other);
+  file_descriptor &operator=(file_descriptor &&other) noexcept;
+
+  explicit operator int() const noexcept;
+};
+
+} // namespace erd::detail
@@ -3,12 +3,20 @@
 #include <erd/erd.hpp>
 
 #include <cstdint>
+#include <string_view>
+#include <vector>
 
 namespace erd::ipc {
 
 enum class operation_type_t : uint32_t {
   obtain_readings,
   subtract,
+  subscribe,
+  unsubscribe,
+  stats,
+  samples,
+  attribution,
+  snapshot,
 };
 
 enum class status_code_t : uint32_t {
@@ -26,6 +34,36 @@ enum class unit_time_t : uint16_t {
   nanosecond,
 };
 
+// what the daemon pushes to a subscribed client on every interval, or in
+// samples mode once a batch of samples taken every interval is complete
+enum class subscription_mode_t : uint32_t {
+  readings,
+  difference,
+  samples,
+};
+
+// the most samples a client may ask to receive in one push
+constexpr uint32_t max_subscription_batch = 4096;
+
+// what the energy of an attribution operation is queried for
+enum class attribution_target_t : uint32_t {
+  process,
+  cgroup,
+};
+
+// the energy attributed to a process or cgroup from one domain
+struct attributed_energy_t {
+  attributes_t attributes;
+  energy_t energy;
+};
+
+// the readings of one of the domains served by the daemon for a snapshot
+struct snapshot_entry_t {
+  attributes_t attributes;
+  status_code_t status;
+  readings_t readings;
+};
+
 namespace detail {
 
 struct message_common {
@@ -78,4 +116,147 @@ private:
   char buffer_[size - detail::message_common::size];
 };
 
+// protocol v2: a frame is a header followed by a payload of one or more
+// operations; the first field of a v1 message is the operation type, which
+// never equals the magic value, so both versions can share a connection
+constexpr uint32_t frame_magic = 0x32445245; // ERD2
+constexpr uint16_t frame_version = 2;
+
+struct frame_header_t {
+  static constexpr size_t size = 16;
+  static constexpr uint32_t max_length = 1 << 20;
+
+  uint32_t magic = frame_magic;
+  uint16_t version = frame_version;
+  uint16_t count = 0;
+  uint32_t length = 0;
+  uint32_t request_id = 0;
+};
+
+struct request_operation_t {
+  operation_type_t type;
+  const char *payload;
+  uint32_t length;
+
+  bool readings(readings_t &lhs, readings_t &rhs,
+                std::error_code &ec) const noexcept;
+  bool subscription(std::chrono::nanoseconds &interval,
+                    subscription_mode_t &mode, uint32_t &batch,
+                    std::error_code &ec) const noexcept;
+  // the PID is set for a process and the cgroup, pointing into the payload,
+  // for a cgroup
+  bool attribution(attribution_target_t &target, int32_t &pid,
+                   std::string_view &cgroup,
+                   std::error_code &ec) const noexcept;
+  // the domain an obtain_readings, subtract or subscribe operation is for;
+  // false if it names none, meaning the default domain of the daemon
+  bool attributes(attributes_t &into) const noexcept;
+};
+
+struct response_operation_t {
+  operation_type_t type;
+  status_code_t status;
+  const char *payload;
+  uint32_t length;
+
+  bool readings(readings_t &into, std::error_code &ec) const noexcept;
+  // the time elapsed since the readings of an obtain_readings operation were
+  // taken, when the daemon answered; false if it did not send it
+  bool age(std::chrono::nanoseconds &into) const noexcept;
+  bool difference(difference_t &into, std::error_code &ec) const noexcept;
+  bool stats(stats_t &into, std::error_code &ec) const noexcept;
+  // replaces the contents of into with the samples of a batch
+  bool samples(std::vector<readings_t> &into, std::error_code &ec) const;
+  bool attribution(std::vector<attributed_energy_t> &into,
+                   std::error_code &ec) const;
+  bool snapshot(std::vector<snapshot_entry_t> &into,
+                std::error_code &ec) const;
+};
+
+namespace detail {
+
+class frame_common {
+public:
+  // building: begin, add operations, then finish to write the header
+  void begin(uint32_t request_id);
+  void finish() noexcept;
+
+  // receiving: read frame_header_t::size bytes into header_buffer, call
+  // prepare_payload and read payload_size bytes into payload_buffer
+  char *header_buffer();
+  bool prepare_payload(std::error_code &ec);
+  char *payload_buffer() noexcept;
+  [[nodiscard]] size_t payload_size() const noexcept;
+
+  [[nodiscard]] const frame_header_t &header() const noexcept;
+
+  [[nodiscard]] const char *data() const noexcept;
+  [[nodiscard]] size_t size() const noexcept;
+
+protected:
+  std::vector<char> buffer_;
+  frame_header_t header_;
+  size_t offset_ = frame_header_t::size;
+  uint32_t consumed_ = 0;
+
+  char *append(size_t bytes);
+  const char *consume(size_t bytes, std::error_code &ec) noexcept;
+};
+
+} // namespace detail
+
+class request_frame : public detail::frame_common {
+public:
+  // without attributes, operations are for the default domain of the daemon
+  void add_obtain_readings();
+  void add_obtain_readings(const attributes_t &attr);
+  void add_subtract(const readings_t &lhs, const readings_t &rhs);
+  void add_subtract(const readings_t &lhs, const readings_t &rhs,
+                    const attributes_t &attr);
+  // the daemon answers with a subscribe operation and then pushes response
+  // frames with the same request ID, carrying readings or differences since
+  // the previous push; a client that reads slowly receives only the latest;
+  // in samples mode, every sample is pushed, in batches of at least batch
+  // samples compressed with the codec
+  void add_subscribe(std::chrono::nanoseconds interval,
+                     subscription_mode_t mode, uint32_t batch = 1);
+  void add_subscribe(std::chrono::nanoseconds interval,
+                     subscription_mode_t mode, uint32_t batch,
+                     const attributes_t &attr);
+  void add_unsubscribe();
+  // the metrics of the daemon process, empty unless it collects them
+  void add_stats();
+  // the energy attributed to a process or cgroup by a daemon attributing
+  // energy, per domain; the cgroup is relative to the cgroup root
+  void add_attribution(int32_t pid);
+  void add_attribution(std::string_view cgroup);
+  // the readings of every domain the daemon serves, read at once where the
+  // backend allows and back to back otherwise
+  void add_snapshot();
+
+  // iterates over the operations of a received frame; returns false with a
+  // cleared error code after the last one; a frame holding more operations
+  // than its header counts is malformed
+  bool next(request_operation_t &op, std::error_code &ec) noexcept;
+  // whether every operation of a received frame can be iterated over, without
+  // moving the iteration; op is the operation found malformed, if any
+  bool validate(request_operation_t &op, std::error_code &ec) noexcept;
+};
+
+class response_frame : public detail::frame_common {
+public:
+  void add(status_code_t status, const readings_t &data);
+  void add(status_code_t status, const readings_t &data,
+           std::chrono::nanoseconds age);
+  void add(status_code_t status, const difference_t &data);
+  void add(status_code_t status, const stats_t &data);
+  void add(status_code_t status, const readings_t *samples, size_t count);
+  void add(status_code_t status,
+           const std::vector<attributed_energy_t> &energy);
+  void add(status_code_t status, const std::vector<snapshot_entry_t> &entries);
+  void add(operation_type_t optype, status_code_t status);
+
+  bool next(response_operation_t &op, std::error_code &ec) noexcept;
+};
+
 } // namespace erd::ipc
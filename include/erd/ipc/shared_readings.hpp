@@ -0,0 +1,110 @@
+#pragma once
+
+#include <erd/erd.hpp>
+#include <erd/seqlock.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace erd::ipc {
+
+namespace detail {
+
+struct shared_sample_t {
+  int64_t time;    // nanoseconds since the clock epoch
+  uint64_t energy; // microjoules
+};
+
+struct shared_entry_t {
+  uint32_t domain;
+  uint32_t socket;
+  seqlock_t<shared_sample_t> sample;
+};
+
+struct shared_header_t {
+  static constexpr uint64_t magic_value = 0x3153444552445245; // ERDREDS1
+  static constexpr uint32_t version_value = 1;
+
+  // stored last, so that a reader seeing it sees the rest initialised
+  std::atomic<uint64_t> magic;
+  uint32_t version;
+  uint32_t count;
+};
+
+class shared_mapping {
+public:
+  shared_mapping(void *address, std::size_t size) noexcept;
+  ~shared_mapping() noexcept;
+
+  shared_mapping(const shared_mapping &) = delete;
+  shared_mapping &operator=(const shared_mapping &) = delete;
+  shared_mapping(shared_mapping &&other) noexcept;
+  shared_mapping &operator=(shared_mapping &&other) noexcept;
+
+  [[nodiscard]] void *get() const noexcept;
+
+  [[nodiscard]] std::size_t size() const noexcept;
+
+private:
+  void *address_;
+  std::size_t size_;
+};
+
+} // namespace detail
+
+// publishes the latest readings of a set of domains to a POSIX shared memory
+// segment; every entry is guarded by its own seqlock and must have at most one
+// writer thread
+class shared_readings_writer {
+public:
+  shared_readings_writer(std::string name, std::vector<attributes_t> attrs);
+  ~shared_readings_writer() noexcept;
+
+  shared_readings_writer(const shared_readings_writer &) = delete;
+  shared_readings_writer &operator=(const shared_readings_writer &) = delete;
+
+  void publish(std::size_t idx, const readings_t &readings) noexcept;
+
+  [[nodiscard]] std::size_t size() const noexcept;
+
+  [[nodiscard]] const std::string &name() const noexcept;
+
+private:
+  std::string name_;
+  // the object created, which the name may no longer refer to
+  uint64_t device_;
+  uint64_t inode_;
+  detail::shared_mapping mapping_;
+  detail::shared_entry_t *entries_;
+  std::size_t count_;
+};
+
+// maps a segment created by shared_readings_writer read-only; obtaining
+// readings is a handful of loads and makes no syscalls
+class shared_readings_reader {
+public:
+  explicit shared_readings_reader(const std::string &name);
+
+  bool obtain_readings(readings_t &into, std::error_code &ec,
+                       std::size_t idx = 0) const noexcept;
+
+  // index of the entry with the given attributes, or size() if absent
+  [[nodiscard]] std::size_t find(const attributes_t &attr) const noexcept;
+
+  [[nodiscard]] attributes_t attributes(std::size_t idx) const noexcept;
+
+  // number of times the entry was published
+  [[nodiscard]] uint64_t version(std::size_t idx) const noexcept;
+
+  [[nodiscard]] std::size_t size() const noexcept;
+
+private:
+  detail::shared_mapping mapping_;
+  const detail::shared_entry_t *entries_;
+  std::size_t count_;
+};
+
+} // namespace erd::ipc
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <erd/erd_common.hpp>
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace erd {
+
+// log-bucketed histogram in the style of HdrHistogram: values below 16 have a
+// bucket each and larger values 16 buckets per power of two, so every value
+// is recorded within 1/16 of its magnitude
+class histogram_t {
+public:
+  static constexpr unsigned sub_bucket_bits = 4;
+  static constexpr std::size_t sub_bucket_count = 1u << sub_bucket_bits;
+  static constexpr std::size_t bucket_count =
+      (64 - sub_bucket_bits + 1) * sub_bucket_count;
+
+  static std::size_t bucket_index(std::uint64_t value) noexcept;
+  static std::uint64_t bucket_lower(std::size_t index) noexcept;
+  static std::uint64_t bucket_upper(std::size_t index) noexcept;
+
+  void record(std::uint64_t value, std::uint64_t count = 1) noexcept;
+  void merge(const histogram_t &other) noexcept;
+  void reset() noexcept;
+
+  [[nodiscard]] std::uint64_t count() const noexcept;
+  [[nodiscard]] std::uint64_t sum() const noexcept;
+  [[nodiscard]] std::uint64_t min() const noexcept;
+  [[nodiscard]] std::uint64_t max() const noexcept;
+  [[nodiscard]] double mean() const noexcept;
+
+  // the value below which the fraction q of the values recorded lie, as the
+  // upper bound of its bucket; 0 if empty
+  [[nodiscard]] std::uint64_t percentile(double q) const noexcept;
+
+  [[nodiscard]] std::uint64_t bucket(std::size_t index) const noexcept;
+
+  // rebuild a histogram from its buckets and summary, such as one received
+  // over IPC; add_bucket leaves the sum, min and max untouched
+  void add_bucket(std::size_t index, std::uint64_t count) noexcept;
+  void set_summary(std::uint64_t sum, std::uint64_t min,
+                   std::uint64_t max) noexcept;
+
+private:
+  std::array<std::uint64_t, bucket_count> buckets_{};
+  std::uint64_t count_ = 0;
+  std::uint64_t sum_ = 0;
+  std::uint64_t min_ = std::numeric_limits<std::uint64_t>::max();
+  std::uint64_t max_ = 0;
+};
+
+// what is measured; latencies and ages are recorded in nanoseconds
+enum class metric_t : std::uint32_t {
+  read,      // reader_t::obtain_readings
+  ipc,       // processing of a daemon request, from decoding to response
+  wakeup,    // lateness of periodic wakeups of samplers and subscriptions
+  staleness, // age of a sample when handed to a consumer
+};
+
+constexpr std::size_t metric_count = 4;
+
+struct stats_t {
+  std::array<histogram_t, metric_count> histograms;
+  std::array<std::uint64_t, metric_count> errors{};
+
+  [[nodiscard]] const histogram_t &histogram(metric_t metric) const noexcept;
+  [[nodiscard]] std::uint64_t error_count(metric_t metric) const noexcept;
+};
+
+namespace detail {
+
+inline std::atomic<bool> metrics_enabled{false};
+
+// written only by the thread owning it, read by whoever merges
+struct thread_metrics {
+  struct histogram {
+    std::array<std::atomic<std::uint64_t>, histogram_t::bucket_count> buckets;
+    std::atomic<std::uint64_t> sum;
+    std::atomic<std::uint64_t> min;
+    std::atomic<std::uint64_t> max;
+  };
+
+  std::array<histogram, metric_count> histograms;
+  std::array<std::atomic<std::uint64_t>, metric_count> errors;
+  // the counters are stale when this differs from that of metrics_t
+  std::atomic<std::uint64_t> generation;
+
+  void clear() noexcept;
+  void add_to(stats_t &stats) const noexcept;
+};
+
+struct thread_metrics_slot;
+
+} // namespace detail
+
+// process-wide instrumentation of readers, samplers and the daemon; disabled
+// by default, or enabled from the start when ERD_STATS is set to 1; values
+// are recorded without locks into counters of the recording thread, which are
+// merged when a snapshot is taken
+class metrics_t {
+public:
+  static metrics_t &instance();
+
+  [[nodiscard]] static bool enabled() noexcept {
+    return detail::metrics_enabled.load(std::memory_order_relaxed);
+  }
+  static void enable(bool value) noexcept;
+
+  void record(metric_t metric, clock_t::duration value) noexcept;
+  void record_error(metric_t metric) noexcept;
+
+  [[nodiscard]] stats_t snapshot() const;
+
+  // discards what was recorded so far, by every thread
+  void reset() noexcept;
+
+private:
+  friend struct detail::thread_metrics_slot;
+
+  metrics_t() = default;
+
+  detail::thread_metrics *local() noexcept;
+  void retire(detail::thread_metrics *tm) noexcept;
+
+  mutable std::mutex mtx_;
+  std::vector<detail::thread_metrics *> threads_;
+  stats_t retired_;
+  std::atomic<std::uint64_t> generation_{0};
+};
+
+} // namespace erd
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <erd/erd.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace erd {
+
+class sampler_t;
+
+// what the regions of one label consumed, summed over every thread
+struct region_stats_t {
+  std::string label;
+  std::uint64_t count;
+  // regions whose readings could not be obtained, not part of the sums
+  std::uint64_t errors;
+  clock_t::duration duration;
+  energy_t energy;
+};
+
+namespace detail {
+struct region_table;
+} // namespace detail
+
+// aggregates the regions that refer to it; every thread records into a table
+// of its own without locks, and the tables are merged only when a report is
+// requested; a table outlives its thread and is handed to the next thread
+// that records, so thread churn does not grow the memory used
+class profiler_t {
+public:
+  // each region reads the reader when it starts and when it stops; a thread
+  // records at most max_labels distinct labels, and those beyond are dropped
+  explicit profiler_t(reader_t reader, std::size_t max_labels = 256);
+
+  // each region takes the latest sample of reader idx instead, so it makes no
+  // syscall, but regions shorter than the sampler period see no energy
+  explicit profiler_t(const sampler_t &sampler, std::size_t idx = 0,
+                      std::size_t max_labels = 256);
+
+  ~profiler_t() noexcept;
+
+  profiler_t(const profiler_t &) = delete;
+  profiler_t &operator=(const profiler_t &) = delete;
+
+  // sorted by label
+  [[nodiscard]] std::vector<region_stats_t> report() const;
+
+  // number of regions not recorded because their thread had run out of labels
+  [[nodiscard]] std::uint64_t dropped() const noexcept;
+
+  [[nodiscard]] const reader_t &reader() const noexcept;
+
+private:
+  friend class region_t;
+
+  std::optional<reader_t> reader_;
+  const sampler_t *sampler_ = nullptr;
+  std::size_t idx_ = 0;
+  std::size_t max_labels_;
+  std::uint64_t id_;
+  mutable std::mutex mtx_;
+  std::vector<std::shared_ptr<detail::region_table>> tables_;
+
+  bool read(readings_t &into) const noexcept;
+  detail::region_table *local() noexcept;
+  void record(const char *label, const difference_t *diff) noexcept;
+};
+
+// measures the energy and time from its construction to its destruction, or
+// to an earlier stop, under a label; the label is compared by address when
+// recording, so it must outlive the profiler, as a string literal does
+class region_t {
+public:
+  region_t(profiler_t &profiler, const char *label) noexcept;
+  ~region_t() noexcept { stop(); }
+
+  region_t(const region_t &) = delete;
+  region_t &operator=(const region_t &) = delete;
+
+  // records the region unless already stopped
+  void stop() noexcept;
+
+private:
+  profiler_t *profiler_;
+  const char *label_;
+  readings_t start_;
+  bool started_;
+};
+
+} // namespace erd
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <erd/seqlock.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace erd {
+
+// single-producer, multi-consumer ring buffer; the producer never waits and
+// overwrites the oldest entries, consumers never modify the buffer and detect
+// entries overwritten while they were reading them
+template <typename T> class ring_buffer_t {
+  struct entry_t {
+    std::uint64_t position;
+    T value;
+  };
+
+public:
+  explicit ring_buffer_t(std::size_t capacity)
+      : capacity_(round_capacity(capacity)),
+        slots_(std::make_unique<seqlock_t<entry_t>[]>(capacity_)) {}
+
+  // only one thread may push
+  void push(const T &value) noexcept {
+    std::uint64_t head = head_.load(std::memory_order_relaxed);
+    slots_[head & (capacity_ - 1)].store(entry_t{head, value});
+    head_.store(head + 1, std::memory_order_release);
+  }
+
+  // the most recently pushed value; false if nothing was pushed yet
+  bool latest(T &into) const noexcept {
+    for (;;) {
+      std::uint64_t head = head_.load(std::memory_order_acquire);
+      if (!head) {
+        return false;
+      }
+      entry_t entry;
+      if (slots_[(head - 1) & (capacity_ - 1)].try_load(entry) &&
+          entry.position == head - 1) {
+        into = entry.value;
+        return true;
+      }
+    }
+  }
+
+  // copies every value from position cursor onwards that is still held, or
+  // the oldest max_count of them, and advances cursor past them; returns the
+  // number of values copied; a cursor past head, such as one kept for another
+  // buffer, is moved back to head
+  template <typename OutputIt>
+  std::size_t drain(std::uint64_t &cursor, OutputIt out,
+                    std::size_t max_count = SIZE_MAX) const {
+    std::uint64_t head = head_.load(std::memory_order_acquire);
+    if (cursor > head) {
+      cursor = head;
+    } else if (head - cursor > capacity_) {
+      cursor = head - capacity_;
+    }
+    std::size_t count = 0;
+    for (; cursor < head && count < max_count; cursor++) {
+      entry_t entry;
+      if (slots_[cursor & (capacity_ - 1)].try_load(entry) &&
+          entry.position == cursor) {
+        *out++ = entry.value;
+        count++;
+      }
+    }
+    return count;
+  }
+
+  // total number of values pushed, i.e. the position of the next push
+  [[nodiscard]] std::uint64_t head() const noexcept {
+    return head_.load(std::memory_order_acquire);
+  }
+
+  [[nodiscard]] std::size_t capacity() const noexcept { return capacity_; }
+
+private:
+  static std::size_t round_capacity(std::size_t capacity) noexcept {
+    std::size_t retval = 1;
+    while (retval < capacity) {
+      retval <<= 1;
+    }
+    return retval;
+  }
+
+  std::size_t capacity_;
+  std::unique_ptr<seqlock_t<entry_t>[]> slots_;
+  alignas(64) std::atomic<std::uint64_t> head_{0};
+};
+
+} // namespace erd
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <erd/erd.hpp>
+#include <erd/ring_buffer.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace erd {
+
+// samples one or more readers periodically on a dedicated thread; readings are
+// published to a ring buffer per reader, so consumers never make syscalls
+class sampler_t {
+public:
+  using buffer_t = ring_buffer_t<readings_t>;
+
+  sampler_t(reader_t reader, clock_t::duration period,
+            std::size_t capacity = 4096);
+  sampler_t(std::vector<reader_t> readers, clock_t::duration period,
+            std::size_t capacity = 4096);
+  ~sampler_t() noexcept;
+
+  sampler_t(const sampler_t &) = delete;
+  sampler_t &operator=(const sampler_t &) = delete;
+
+  // stops sampling; the buffers remain readable
+  void stop() noexcept;
+
+  bool latest(readings_t &into, std::size_t idx = 0) const noexcept;
+
+  // see ring_buffer_t::drain; each consumer keeps its own cursor
+  template <typename OutputIt>
+  std::size_t drain(std::uint64_t &cursor, OutputIt out,
+                    std::size_t idx = 0) const {
+    return buffers_[idx].drain(cursor, out);
+  }
+
+  template <typename OutputIt>
+  std::size_t drain(std::uint64_t &cursor, OutputIt out, std::size_t idx,
+                    std::size_t max_count) const {
+    return buffers_[idx].drain(cursor, out, max_count);
+  }
+
+  [[nodiscard]] const buffer_t &buffer(std::size_t idx = 0) const noexcept;
+
+  [[nodiscard]] const reader_t &reader(std::size_t idx = 0) const noexcept;
+
+  [[nodiscard]] std::size_t size() const noexcept;
+
+  [[nodiscard]] clock_t::duration period() const noexcept;
+
+  // number of failed reads since construction
+  [[nodiscard]] std::uint64_t errors() const noexcept;
+
+private:
+  std::vector<reader_t> readers_;
+  std::deque<buffer_t> buffers_;
+  clock_t::duration period_;
+  std::atomic<std::uint64_t> errors_{0};
+  std::mutex mtx_;
+  std::condition_variable cv_;
+  bool stop_ = false;
+  std::thread thread_;
+
+  void run() noexcept;
+};
+
+} // namespace erd
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace erd {
+
+// single-writer, multi-reader sequence lock; the value is stored as relaxed
+// atomic words so that readers racing with the writer never cause a data
+// race, and the type is address-free so that it can live in shared memory
+template <typename T> class seqlock_t {
+  static_assert(std::is_trivially_copyable_v<T>,
+                "seqlock_t requires a trivially copyable type");
+
+  static constexpr std::size_t words =
+      (sizeof(T) + sizeof(std::uint64_t) - 1) / sizeof(std::uint64_t);
+
+public:
+  void store(const T &value) noexcept {
+    std::uint64_t buffer[words]{};
+    std::memcpy(buffer, &value, sizeof(T));
+    std::uint64_t seq = seq_.load(std::memory_order_relaxed);
+    seq_.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (std::size_t i = 0; i < words; i++) {
+      data_[i].store(buffer[i], std::memory_order_relaxed);
+    }
+    seq_.store(seq + 2, std::memory_order_release);
+  }
+
+  // fails if a store was in progress or completed while reading
+  bool try_load(T &into) const noexcept {
+    std::uint64_t buffer[words];
+    std::uint64_t seq = seq_.load(std::memory_order_acquire);
+    if (seq & 1) {
+      return false;
+    }
+    for (std::size_t i = 0; i < words; i++) {
+      buffer[i] = data_[i].load(std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (seq_.load(std::memory_order_relaxed) != seq) {
+      return false;
+    }
+    std::memcpy(&into, buffer, sizeof(T));
+    return true;
+  }
+
+  [[nodiscard]] T load() const noexcept {
+    T value{};
+    while (!try_load(value))
+      ;
+    return value;
+  }
+
+  // number of completed stores
+  [[nodiscard]] std::uint64_t version() const noexcept {
+    return seq_.load(std::memory_order_acquire) / 2;
+  }
+
+private:
+  std::atomic<std::uint64_t> seq_{0};
+  std::atomic<std::uint64_t> data_[words]{};
+};
+
+} // namespace erd
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <erd/erd_common.hpp>
+
+#include <cstddef>
+
+namespace erd {
+
+// batch forms of subtract and of dividing energy by time, over samples
+// ordered in time such as a trace; each consecutive pair gives one result, so
+// count samples give count - 1 results, and an energy that decreases is taken
+// as the counter wrapping around at max_energy, as every backend does
+
+void subtract_n(const readings_t *samples, std::size_t count,
+                energy_t max_energy, difference_t *out) noexcept;
+
+// the average power between consecutive samples; a zero duration gives an
+// infinite or NaN power, as dividing a single difference does
+void power_series(const readings_t *samples, std::size_t count,
+                  energy_t max_energy, watts<double> *out) noexcept;
+
+// the power of each of count differences
+void power_series(const difference_t *diffs, std::size_t count,
+                  watts<double> *out) noexcept;
+
+// whether the vectorised kernels are used on this processor
+[[nodiscard]] bool series_vectorised() noexcept;
+
+} // namespace erd
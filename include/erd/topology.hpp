@@ -0,0 +1,64 @@
+#pragma once
+
+#include <erd/erd_common.hpp>
+
+#include <cstdint>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace erd {
+
+// a RAPL zone of the powercap tree
+struct zone_t {
+  attributes_t attr;
+  std::string path;    // directory holding energy_uj
+  std::string name;    // contents of the name file, e.g. package-0 or dram
+  energy_t max_energy; // contents of max_energy_range_uj
+  // directories of the same zone on the other dies of the package, whose
+  // counters are added to that of path
+  std::vector<std::string> dies;
+};
+
+// every RAPL zone of the machine, found with a single walk of the powercap
+// directory instead of probing for each reader; on packages with several dies,
+// named package-N-die-M, a zone of the package covers every die, its counter
+// being the sum of theirs modulo the range they share; a die whose range
+// differs from that of the first die is left out
+class topology_t {
+public:
+  topology_t() = default;
+  explicit topology_t(std::vector<zone_t> zones);
+
+  // /sys/class/powercap, unless ERD_POWERCAP_ROOT names another directory,
+  // such as a tree generated by the simulator
+  static std::string default_root();
+
+  // walks a powercap directory; throws if it cannot be read
+  static topology_t discover(const std::string &root);
+
+  // the index shared by every reader of the process, built on first use from
+  // default_root(); when ERD_TOPOLOGY_CACHE names a file, it is loaded from
+  // there if the file was written since the last boot, and written there
+  // otherwise
+  static const topology_t &instance();
+
+  // a cache is only loaded if it was saved during the current boot and for the
+  // same root, since zone numbering may change across reboots
+  static bool load(const std::string &file, topology_t &into,
+                   std::error_code &ec);
+  bool save(const std::string &file, std::error_code &ec) const;
+
+  // the zone with the given attributes, or nullptr if absent
+  [[nodiscard]] const zone_t *find(const attributes_t &attr) const noexcept;
+
+  [[nodiscard]] const std::vector<zone_t> &zones() const noexcept;
+
+  // number of packages that have a zone
+  [[nodiscard]] std::uint32_t sockets() const noexcept;
+
+private:
+  std::vector<zone_t> zones_;
+};
+
+} // namespace erd
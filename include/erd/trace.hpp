@@ -0,0 +1,223 @@
+#pragma once
+
+#include <erd/erd.hpp>
+#include <erd/ipc/shared_readings.hpp>
+#include <erd/sampler.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace erd {
+
+// how chunks store their columns: raw columns are read in place, compressed
+// ones are blocks of the codec, decoded when first read
+enum class trace_encoding_t : std::uint32_t { raw, compressed };
+
+// a sequence of samples of one domain in a trace, such as those of a reader
+struct trace_series_t {
+  attributes_t attributes;
+  energy_t max_energy;
+};
+
+// consecutive samples of one series, as columns pointing into a mapped trace
+struct trace_span_t {
+  const std::int64_t *time;    // nanoseconds since the clock epoch
+  const std::uint64_t *energy; // microjoules
+  std::size_t count;
+
+  [[nodiscard]] readings_t readings(std::size_t idx) const noexcept;
+};
+
+namespace detail {
+
+// a trace is a header, a table of series and a run of chunks, each holding the
+// columns of up to chunk_size samples of one series; closing the trace appends
+// an index of the chunks and a footer pointing at it; every field is in the
+// byte order of the host and every offset a multiple of 8
+struct trace_header_t {
+  static constexpr uint64_t magic_value = 0x3143415254445245; // ERDTRAC1
+  static constexpr uint32_t version_value = 1;
+
+  uint64_t magic;
+  uint32_t version;
+  uint32_t series_count;
+  uint32_t chunk_size;
+  uint32_t encoding; // trace_encoding_t
+  // system_clock minus clock_t when the trace was created, in nanoseconds
+  int64_t realtime_offset;
+};
+
+struct trace_series_entry_t {
+  uint32_t domain;
+  uint32_t socket;
+  uint64_t max_energy;
+};
+
+// followed by count timestamps and then count energy values or, if
+// compressed, by the size of a codec block, the block and padding to 8 bytes
+struct trace_chunk_header_t {
+  uint32_t series;
+  uint32_t count;
+  int64_t first;
+  int64_t last;
+};
+
+struct trace_index_entry_t {
+  trace_chunk_header_t chunk;
+  uint64_t offset;
+};
+
+struct trace_footer_t {
+  static constexpr uint64_t magic_value = 0x3158444954445245; // ERDTIDX1
+
+  uint64_t index_offset;
+  uint64_t chunk_count;
+  uint64_t magic;
+};
+
+struct trace_buffer_t {
+  std::vector<std::int64_t> time;
+  std::vector<std::uint64_t> energy;
+};
+
+} // namespace detail
+
+// appends samples to a trace file; memory is bounded by one chunk per series,
+// written out as it fills; samples of a series must be appended in time order;
+// a failed write is latched, after which appends and flushes fail with its
+// error, and closing leaves the chunks written so far without an index
+class trace_writer_t {
+public:
+  static constexpr std::size_t default_chunk_size = 4096;
+
+  trace_writer_t(const std::string &path, std::vector<trace_series_t> series,
+                 std::size_t chunk_size = default_chunk_size,
+                 trace_encoding_t encoding = trace_encoding_t::raw);
+  ~trace_writer_t() noexcept;
+
+  trace_writer_t(const trace_writer_t &) = delete;
+  trace_writer_t &operator=(const trace_writer_t &) = delete;
+  trace_writer_t(trace_writer_t &&other) noexcept;
+  trace_writer_t &operator=(trace_writer_t &&other) noexcept;
+
+  bool append(std::size_t idx, const readings_t &readings,
+              std::error_code &ec) noexcept;
+
+  // writes the samples buffered as chunks, so that they can be read even if
+  // the writer is never closed
+  bool flush(std::error_code &ec) noexcept;
+
+  // flushes and writes the index; nothing can be appended afterwards
+  bool close(std::error_code &ec) noexcept;
+
+  [[nodiscard]] const trace_series_t &series(std::size_t idx) const noexcept;
+
+  [[nodiscard]] std::size_t size() const noexcept;
+
+private:
+  int fd_;
+  std::vector<trace_series_t> series_;
+  std::size_t chunk_size_;
+  trace_encoding_t encoding_;
+  std::vector<detail::trace_buffer_t> buffers_;
+  std::vector<detail::trace_index_entry_t> index_;
+  std::vector<std::uint8_t> encoded_;
+  std::uint64_t offset_;
+  std::error_code error_;
+
+  bool write_chunk(std::size_t idx, std::error_code &ec) noexcept;
+};
+
+// maps a trace read-only; samples are accessed in place, by time range, or
+// for compressed traces in chunks decoded on first access and kept
+class trace_reader_t {
+public:
+  explicit trace_reader_t(const std::string &path);
+
+  [[nodiscard]] const trace_series_t &series(std::size_t idx) const noexcept;
+
+  // number of series
+  [[nodiscard]] std::size_t size() const noexcept;
+
+  [[nodiscard]] std::size_t sample_count(std::size_t idx) const noexcept;
+
+  // the samples of series idx timestamped within [from, to], in order; throws
+  // if a compressed chunk is corrupt
+  [[nodiscard]] std::vector<trace_span_t>
+  spans(std::size_t idx, time_point_t from = time_point_t::min(),
+        time_point_t to = time_point_t::max()) const;
+
+  // the same samples, copied
+  [[nodiscard]] std::vector<readings_t>
+  readings(std::size_t idx, time_point_t from = time_point_t::min(),
+           time_point_t to = time_point_t::max()) const;
+
+  // wall-clock time of a timestamp, through the offset recorded in the trace
+  [[nodiscard]] std::chrono::system_clock::time_point
+  realtime(time_point_t tp) const noexcept;
+
+  // false if the writer was not closed, in which case the chunks were found
+  // by scanning the file and a chunk cut short is ignored
+  [[nodiscard]] bool complete() const noexcept;
+
+  [[nodiscard]] trace_encoding_t encoding() const noexcept;
+
+private:
+  using decoded_chunks_t =
+      std::vector<std::vector<std::unique_ptr<detail::trace_buffer_t>>>;
+
+  ipc::detail::shared_mapping mapping_;
+  std::int64_t realtime_offset_;
+  trace_encoding_t encoding_;
+  std::vector<trace_series_t> series_;
+  std::vector<std::vector<detail::trace_index_entry_t>> chunks_;
+  bool complete_;
+  // parallel to chunks_, filled as compressed chunks are read
+  mutable std::mutex decoded_mtx_;
+  mutable decoded_chunks_t decoded_;
+
+  trace_span_t span(std::size_t idx, std::size_t chunk) const;
+};
+
+// records every sample of a sampler to a trace, one series per reader, by
+// draining its buffers on its own thread often enough that none is lost
+class trace_recorder_t {
+public:
+  trace_recorder_t(const sampler_t &sampler, const std::string &path,
+                   std::size_t chunk_size = trace_writer_t::default_chunk_size,
+                   trace_encoding_t encoding = trace_encoding_t::raw);
+  ~trace_recorder_t() noexcept;
+
+  trace_recorder_t(const trace_recorder_t &) = delete;
+  trace_recorder_t &operator=(const trace_recorder_t &) = delete;
+
+  // records what remains in the buffers and closes the trace
+  void stop() noexcept;
+
+  // number of samples overwritten in the buffers before being recorded
+  [[nodiscard]] std::uint64_t lost() const noexcept;
+
+private:
+  const sampler_t &sampler_;
+  trace_writer_t writer_;
+  std::vector<std::uint64_t> cursors_;
+  clock_t::duration period_;
+  std::atomic<std::uint64_t> lost_{0};
+  std::mutex mtx_;
+  std::condition_variable cv_;
+  bool stop_ = false;
+  std::thread thread_;
+
+  bool record(std::vector<readings_t> &scratch, std::error_code &ec) noexcept;
+  void run() noexcept;
+};
+
+} // namespace erd
@@ -0,0 +1,371 @@
+// batch entry points of the C interface for Python; arrays are taken through
+// the buffer protocol, so NumPy arrays, array.array and memoryviews are filled
+// and read in place, and the GIL is released while the library runs; the C
+// functions are those of the library already loaded by erd.py, bound once
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <erd/erd.h>
+
+#include <cstring>
+#include <new>
+#include <vector>
+
+namespace {
+
+struct functions_t {
+  decltype(&erd_sample_n) sample_n;
+  decltype(&erd_obtain_readings_n) obtain_readings_n;
+  decltype(&erd_subtract_n) subtract_n;
+  decltype(&erd_power_n) power_n;
+  decltype(&erd_sampler_drain) sampler_drain;
+} functions;
+
+PyObject *native_error;
+
+enum class element_t { int64, uint64, float64 };
+
+// a contiguous buffer of 8-byte elements of the given type
+class buffer_t {
+public:
+  buffer_t() noexcept = default;
+  ~buffer_t() noexcept {
+    if (view_.obj) {
+      PyBuffer_Release(&view_);
+    }
+  }
+
+  buffer_t(const buffer_t &) = delete;
+  buffer_t &operator=(const buffer_t &) = delete;
+
+  bool get(PyObject *obj, element_t type, bool writable, const char *name) {
+    int flags = PyBUF_C_CONTIGUOUS | PyBUF_FORMAT;
+    if (writable) {
+      flags |= PyBUF_WRITABLE;
+    }
+    if (PyObject_GetBuffer(obj, &view_, flags) < 0) {
+      return false;
+    }
+    if (view_.itemsize != 8 || !matches(view_.format, type)) {
+      PyErr_Format(PyExc_TypeError, "%s must hold %s", name,
+                   type == element_t::int64    ? "int64"
+                   : type == element_t::uint64 ? "uint64"
+                                               : "float64");
+      return false;
+    }
+    return true;
+  }
+
+  template <typename T> T *data() const noexcept {
+    return static_cast<T *>(view_.buf);
+  }
+
+  size_t size() const noexcept {
+    return static_cast<size_t>(view_.len / view_.itemsize);
+  }
+
+private:
+  Py_buffer view_{};
+
+  static bool matches(const char *format, element_t type) noexcept {
+    if (!format) {
+      return false;
+    }
+    // native or little-endian byte order, as the library writes
+    if (*format == '@' || *format == '=' || *format == '<') {
+      format++;
+    }
+    if (std::strlen(format) != 1) {
+      return false;
+    }
+    switch (type) {
+    case element_t::int64:
+      return *format == 'q' || *format == 'l';
+    case element_t::uint64:
+      return *format == 'Q' || *format == 'L';
+    case element_t::float64:
+      return *format == 'd';
+    }
+    return false;
+  }
+};
+
+bool check_bound() {
+  if (!functions.sample_n) {
+    PyErr_SetString(PyExc_RuntimeError, "erd._native is not bound");
+    return false;
+  }
+  return true;
+}
+
+bool check_samples(const buffer_t &time, const buffer_t &energy) {
+  if (time.size() != energy.size()) {
+    PyErr_SetString(PyExc_ValueError,
+                    "time and energy must have the same length");
+    return false;
+  }
+  return true;
+}
+
+bool check_results(const buffer_t &out, size_t samples, const char *name) {
+  if (samples && out.size() < samples - 1) {
+    PyErr_Format(PyExc_ValueError, "%s must hold at least %zu elements", name,
+                 samples - 1);
+    return false;
+  }
+  return true;
+}
+
+PyObject *raise(erd_status_t status, const char *what) {
+  PyObject *args = Py_BuildValue("(is)", static_cast<int>(status), what);
+  if (args) {
+    PyErr_SetObject(native_error, args);
+    Py_DECREF(args);
+  }
+  return nullptr;
+}
+
+erd_handle_t to_handle(unsigned long long address) noexcept {
+  return reinterpret_cast<erd_handle_t>(static_cast<uintptr_t>(address));
+}
+
+PyObject *bind(PyObject *, PyObject *args) {
+  unsigned long long sample_n;
+  unsigned long long obtain_readings_n;
+  unsigned long long subtract_n;
+  unsigned long long power_n;
+  unsigned long long sampler_drain;
+  if (!PyArg_ParseTuple(args, "KKKKK", &sample_n, &obtain_readings_n,
+                        &subtract_n, &power_n, &sampler_drain)) {
+    return nullptr;
+  }
+  functions.sample_n = reinterpret_cast<decltype(&erd_sample_n)>(sample_n);
+  functions.obtain_readings_n =
+      reinterpret_cast<decltype(&erd_obtain_readings_n)>(obtain_readings_n);
+  functions.subtract_n =
+      reinterpret_cast<decltype(&erd_subtract_n)>(subtract_n);
+  functions.power_n = reinterpret_cast<decltype(&erd_power_n)>(power_n);
+  functions.sampler_drain =
+      reinterpret_cast<decltype(&erd_sampler_drain)>(sampler_drain);
+  Py_RETURN_NONE;
+}
+
+PyObject *sample(PyObject *, PyObject *args) {
+  unsigned long long handle;
+  PyObject *time_obj;
+  PyObject *energy_obj;
+  long long period_ns = 0;
+  if (!PyArg_ParseTuple(args, "KOO|L", &handle, &time_obj, &energy_obj,
+                        &period_ns) ||
+      !check_bound()) {
+    return nullptr;
+  }
+  buffer_t time;
+  buffer_t energy;
+  if (!time.get(time_obj, element_t::int64, true, "time") ||
+      !energy.get(energy_obj, element_t::uint64, true, "energy") ||
+      !check_samples(time, energy)) {
+    return nullptr;
+  }
+  char what[256] = "";
+  erd_error_descriptor_t ed{what, sizeof(what)};
+  size_t taken;
+  erd_status_t status;
+  Py_BEGIN_ALLOW_THREADS;
+  status = functions.sample_n(to_handle(handle), period_ns, time.size(),
+                              time.data<int64_t>(), energy.data<uint64_t>(),
+                              &taken, &ed);
+  Py_END_ALLOW_THREADS;
+  if (status != ERD_SUCCESS) {
+    return raise(status, what);
+  }
+  return PyLong_FromSize_t(taken);
+}
+
+PyObject *obtain_readings(PyObject *, PyObject *args) {
+  PyObject *handles_obj;
+  PyObject *time_obj;
+  PyObject *energy_obj;
+  if (!PyArg_ParseTuple(args, "OOO", &handles_obj, &time_obj, &energy_obj) ||
+      !check_bound()) {
+    return nullptr;
+  }
+  buffer_t time;
+  buffer_t energy;
+  if (!time.get(time_obj, element_t::int64, true, "time") ||
+      !energy.get(energy_obj, element_t::uint64, true, "energy") ||
+      !check_samples(time, energy)) {
+    return nullptr;
+  }
+  PyObject *seq = PySequence_Fast(handles_obj, "handles must be a sequence");
+  if (!seq) {
+    return nullptr;
+  }
+  auto count = static_cast<size_t>(PySequence_Fast_GET_SIZE(seq));
+  if (count > time.size()) {
+    Py_DECREF(seq);
+    PyErr_SetString(PyExc_ValueError, "time and energy are too short");
+    return nullptr;
+  }
+  std::vector<erd_handle_t> handles;
+  try {
+    handles.resize(count);
+  } catch (const std::bad_alloc &) {
+    Py_DECREF(seq);
+    return PyErr_NoMemory();
+  }
+  for (size_t i = 0; i < count; i++) {
+    PyObject *item = PySequence_Fast_GET_ITEM(seq, static_cast<Py_ssize_t>(i));
+    unsigned long long address = PyLong_AsUnsignedLongLong(item);
+    if (PyErr_Occurred()) {
+      Py_DECREF(seq);
+      return nullptr;
+    }
+    handles[i] = to_handle(address);
+  }
+  Py_DECREF(seq);
+  char what[256] = "";
+  erd_error_descriptor_t ed{what, sizeof(what)};
+  erd_status_t status;
+  Py_BEGIN_ALLOW_THREADS;
+  status = functions.obtain_readings_n(handles.data(), count,
+                                       time.data<int64_t>(),
+                                       energy.data<uint64_t>(), &ed);
+  Py_END_ALLOW_THREADS;
+  if (status != ERD_SUCCESS) {
+    return raise(status, what);
+  }
+  Py_RETURN_NONE;
+}
+
+PyObject *subtract(PyObject *, PyObject *args) {
+  unsigned long long handle;
+  PyObject *time_obj;
+  PyObject *energy_obj;
+  PyObject *duration_obj;
+  PyObject *consumed_obj;
+  if (!PyArg_ParseTuple(args, "KOOOO", &handle, &time_obj, &energy_obj,
+                        &duration_obj, &consumed_obj) ||
+      !check_bound()) {
+    return nullptr;
+  }
+  buffer_t time;
+  buffer_t energy;
+  buffer_t duration;
+  buffer_t consumed;
+  if (!time.get(time_obj, element_t::int64, false, "time") ||
+      !energy.get(energy_obj, element_t::uint64, false, "energy") ||
+      !duration.get(duration_obj, element_t::int64, true, "duration") ||
+      !consumed.get(consumed_obj, element_t::uint64, true, "consumed") ||
+      !check_samples(time, energy) ||
+      !check_results(duration, time.size(), "duration") ||
+      !check_results(consumed, time.size(), "consumed")) {
+    return nullptr;
+  }
+  Py_BEGIN_ALLOW_THREADS;
+  functions.subtract_n(to_handle(handle), time.data<int64_t>(),
+                       energy.data<uint64_t>(), time.size(),
+                       duration.data<int64_t>(), consumed.data<uint64_t>());
+  Py_END_ALLOW_THREADS;
+  Py_RETURN_NONE;
+}
+
+PyObject *power(PyObject *, PyObject *args) {
+  unsigned long long handle;
+  PyObject *time_obj;
+  PyObject *energy_obj;
+  PyObject *watts_obj;
+  if (!PyArg_ParseTuple(args, "KOOO", &handle, &time_obj, &energy_obj,
+                        &watts_obj) ||
+      !check_bound()) {
+    return nullptr;
+  }
+  buffer_t time;
+  buffer_t energy;
+  buffer_t watts;
+  if (!time.get(time_obj, element_t::int64, false, "time") ||
+      !energy.get(energy_obj, element_t::uint64, false, "energy") ||
+      !watts.get(watts_obj, element_t::float64, true, "watts") ||
+      !check_samples(time, energy) ||
+      !check_results(watts, time.size(), "watts")) {
+    return nullptr;
+  }
+  Py_BEGIN_ALLOW_THREADS;
+  functions.power_n(to_handle(handle), time.data<int64_t>(),
+                    energy.data<uint64_t>(), time.size(),
+                    watts.data<double>());
+  Py_END_ALLOW_THREADS;
+  Py_RETURN_NONE;
+}
+
+PyObject *sampler_drain(PyObject *, PyObject *args) {
+  unsigned long long sampler;
+  unsigned long long cursor;
+  PyObject *time_obj;
+  PyObject *energy_obj;
+  if (!PyArg_ParseTuple(args, "KKOO", &sampler, &cursor, &time_obj,
+                        &energy_obj) ||
+      !check_bound()) {
+    return nullptr;
+  }
+  buffer_t time;
+  buffer_t energy;
+  if (!time.get(time_obj, element_t::int64, true, "time") ||
+      !energy.get(energy_obj, element_t::uint64, true, "energy") ||
+      !check_samples(time, energy)) {
+    return nullptr;
+  }
+  uint64_t position = cursor;
+  size_t count;
+  Py_BEGIN_ALLOW_THREADS;
+  functions.sampler_drain(
+      reinterpret_cast<erd_sampler_t>(static_cast<uintptr_t>(sampler)),
+      &position, time.data<int64_t>(), energy.data<uint64_t>(), time.size(),
+      &count);
+  Py_END_ALLOW_THREADS;
+  return Py_BuildValue("(nK)", static_cast<Py_ssize_t>(count),
+                       static_cast<unsigned long long>(position));
+}
+
+PyMethodDef methods[] = {
+    {"bind", bind, METH_VARARGS,
+     "bind(sample_n, obtain_readings_n, subtract_n, power_n, sampler_drain): "
+     "addresses of the C functions to call"},
+    {"sample", sample, METH_VARARGS,
+     "sample(handle, time, energy, period_ns=0) -> int: fills time and "
+     "energy with samples period_ns apart"},
+    {"obtain_readings", obtain_readings, METH_VARARGS,
+     "obtain_readings(handles, time, energy): reads each handle into the "
+     "element of the same index"},
+    {"subtract", subtract, METH_VARARGS,
+     "subtract(handle, time, energy, duration, consumed): differences "
+     "between consecutive samples"},
+    {"power", power, METH_VARARGS,
+     "power(handle, time, energy, watts): power between consecutive samples"},
+    {"sampler_drain", sampler_drain, METH_VARARGS,
+     "sampler_drain(sampler, cursor, time, energy) -> (count, cursor): "
+     "copies the samples from cursor onwards"},
+    {nullptr, nullptr, 0, nullptr},
+};
+
+PyModuleDef module = {
+    PyModuleDef_HEAD_INIT, "erd._native", nullptr, -1, methods,
+    nullptr,               nullptr,       nullptr, nullptr,
+};
+
+} // namespace
+
+PyMODINIT_FUNC PyInit__native() {
+  PyObject *m = PyModule_Create(&module);
+  if (!m) {
+    return nullptr;
+  }
+  native_error = PyErr_NewException("erd._native.error", nullptr, nullptr);
+  if (!native_error || PyModule_AddObject(m, "error", native_error) < 0) {
+    Py_XDECREF(native_error);
+    Py_DECREF(m);
+    return nullptr;
+  }
+  Py_INCREF(native_error);
+  return m;
+}
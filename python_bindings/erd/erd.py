@@ -1,9 +1,10 @@
+import array
 import ctypes
 import os
 import sys
 import enum
 import weakref
-from typing import Optional, Tuple
+from typing import Any, Optional, Sequence, Tuple
 
 shared_lib_path = os.environ.get("ERD_SHARED_LIB", None)
 if not shared_lib_path:
@@ -98,6 +99,134 @@ _erdlib.erd_subtract_readings.argtypes = (
 )
 _erdlib.erd_subtract_readings.restype = _erd_status_t
 
+_erdlib.erd_sample_n.argtypes = (
+    _erd_handle_t,
+    ctypes.c_int64,
+    ctypes.c_size_t,
+    ctypes.c_void_p,
+    ctypes.c_void_p,
+    ctypes.POINTER(ctypes.c_size_t),
+    ctypes.POINTER(_erd_error_descriptor_st),
+)
+_erdlib.erd_sample_n.restype = _erd_status_t
+
+_erdlib.erd_obtain_readings_n.argtypes = (
+    ctypes.POINTER(_erd_handle_t),
+    ctypes.c_size_t,
+    ctypes.c_void_p,
+    ctypes.c_void_p,
+    ctypes.POINTER(_erd_error_descriptor_st),
+)
+_erdlib.erd_obtain_readings_n.restype = _erd_status_t
+
+_erdlib.erd_subtract_n.argtypes = (
+    _erd_handle_t,
+    ctypes.c_void_p,
+    ctypes.c_void_p,
+    ctypes.c_size_t,
+    ctypes.c_void_p,
+    ctypes.c_void_p,
+)
+_erdlib.erd_subtract_n.restype = _erd_status_t
+
+_erdlib.erd_power_n.argtypes = (
+    _erd_handle_t,
+    ctypes.c_void_p,
+    ctypes.c_void_p,
+    ctypes.c_size_t,
+    ctypes.c_void_p,
+)
+_erdlib.erd_power_n.restype = _erd_status_t
+_erd_sampler_t = ctypes.c_void_p
+
+_erdlib.erd_sampler_create.argtypes = (
+    ctypes.POINTER(_erd_sampler_t),
+    _erd_handle_t,
+    ctypes.c_int64,
+    ctypes.c_size_t,
+    ctypes.POINTER(_erd_error_descriptor_st),
+)
+_erdlib.erd_sampler_create.restype = _erd_status_t
+
+_erdlib.erd_sampler_destroy.argtypes = (_erd_sampler_t,)
+_erdlib.erd_sampler_destroy.restype = _erd_status_t
+
+_erdlib.erd_sampler_stop.argtypes = (_erd_sampler_t,)
+_erdlib.erd_sampler_stop.restype = _erd_status_t
+
+_erdlib.erd_sampler_drain.argtypes = (
+    _erd_sampler_t,
+    ctypes.POINTER(ctypes.c_uint64),
+    ctypes.c_void_p,
+    ctypes.c_void_p,
+    ctypes.c_size_t,
+    ctypes.POINTER(ctypes.c_size_t),
+)
+_erdlib.erd_sampler_drain.restype = _erd_status_t
+
+_erdlib.erd_sampler_available.argtypes = (
+    _erd_sampler_t,
+    ctypes.c_uint64,
+    ctypes.POINTER(ctypes.c_size_t),
+)
+_erdlib.erd_sampler_available.restype = _erd_status_t
+
+_erdlib.erd_sampler_errors.argtypes = (
+    _erd_sampler_t,
+    ctypes.POINTER(ctypes.c_uint64),
+)
+_erdlib.erd_sampler_errors.restype = _erd_status_t
+
+
+# the compiled batch functions, when built; they take the arrays through the
+# buffer protocol and call the library loaded above without going through
+# ctypes, otherwise the batch methods fall back to ctypes
+try:
+    from . import _native
+
+    _native.bind(
+        *(
+            ctypes.cast(f, ctypes.c_void_p).value
+            for f in (
+                _erdlib.erd_sample_n,
+                _erdlib.erd_obtain_readings_n,
+                _erdlib.erd_subtract_n,
+                _erdlib.erd_power_n,
+                _erdlib.erd_sampler_drain,
+            )
+        )
+    )
+except ImportError:
+    _native = None
+
+
+def _empty(size: int, typecode: str) -> Any:
+    """A NumPy array of size elements if NumPy is available, or an array.array"""
+    try:
+        import numpy
+
+        dtypes = {"q": numpy.int64, "Q": numpy.uint64, "d": numpy.float64}
+        return numpy.empty(size, dtype=dtypes[typecode])
+    except ImportError:
+        return array.array(typecode, bytes(8 * size))
+
+
+def _head(buffer: Any, count: int) -> Any:
+    """The first count elements of buffer, without copying"""
+    if hasattr(buffer, "__array_interface__"):
+        return buffer[:count]
+    return memoryview(buffer)[:count]
+
+
+def _address(buffer: Any) -> Tuple[int, int]:
+    """The address and length of a contiguous buffer of 8-byte elements"""
+    view = memoryview(buffer).cast("B")
+    if view.readonly:
+        raise TypeError("Read-only buffer")
+    if not len(view):
+        return 0, 0
+    return ctypes.addressof(ctypes.c_char.from_buffer(view)), len(view) // 8
+
 
 class StatusCode(enum.Enum):
     success = 0
@@ -241,6 +370,7 @@ class Handle:
         if status.value != StatusCode.success.value:
             raise Error("Error creating handle", StatusCode(status.value), ed)
         self._pointer = pointer
+        self._address = ctypes.cast(pointer, ctypes.c_void_p).value
 
     @staticmethod
     def _destroy(pointer: _erd_handle_t) -> None:
@@ -260,6 +390,75 @@ class Handle:
             raise Error("Error obtaining readings", StatusCode(status.value))
         return Readings(readings_native)
 
+    def sample(self, time: Any, energy: Any, period_ns: int = 0) -> int:
+        """Fills time, in nanoseconds, and energy, in microjoules, with samples
+        period_ns apart, or back to back when 0; both are writable arrays of
+        int64 and uint64, such as NumPy arrays, filled in place"""
+        if _native is not None:
+            try:
+                return _native.sample(self._address, time, energy, period_ns)
+            except _native.error as e:
+                raise Error(
+                    "Error obtaining readings: {}".format(e.args[1]),
+                    StatusCode(e.args[0]),
+                )
+        taddr, count = _address(time)
+        eaddr, ecount = _address(energy)
+        if count != ecount:
+            raise ValueError("time and energy must have the same length")
+        taken = ctypes.c_size_t()
+        ed = _ErrorDescriptor()
+        status: _erd_status_t = _erdlib.erd_sample_n(
+            self._pointer, period_ns, count, taddr, eaddr, taken, ed._ed
+        )
+        if status.value != StatusCode.success.value:
+            raise Error("Error obtaining readings", StatusCode(status.value), ed)
+        return taken.value
+
+    def subtract_n(
+        self,
+        time: Any,
+        energy: Any,
+        duration: Optional[Any] = None,
+        consumed: Optional[Any] = None,
+    ) -> Tuple[Any, Any]:
+        """The durations, in nanoseconds, and energies, in microjoules, between
+        consecutive samples; the outputs are allocated unless given"""
+        count = len(time)
+        if duration is None:
+            duration = _empty(max(count - 1, 0), "q")
+        if consumed is None:
+            consumed = _empty(max(count - 1, 0), "Q")
+        if _native is not None:
+            _native.subtract(self._address, time, energy, duration, consumed)
+        else:
+            _erdlib.erd_subtract_n(
+                self._pointer,
+                _address(time)[0],
+                _address(energy)[0],
+                count,
+                _address(duration)[0],
+                _address(consumed)[0],
+            )
+        return duration, consumed
+
+    def power_n(self, time: Any, energy: Any, watts: Optional[Any] = None) -> Any:
+        """The average power, in watts, between consecutive samples"""
+        count = len(time)
+        if watts is None:
+            watts = _empty(max(count - 1, 0), "d")
+        if _native is not None:
+            _native.power(self._address, time, energy, watts)
+        else:
+            _erdlib.erd_power_n(
+                self._pointer,
+                _address(time)[0],
+                _address(energy)[0],
+                count,
+                _address(watts)[0],
+            )
+        return watts
+
     def subtract(self, lhs: Readings, rhs: Readings) -> Difference:
         readings_native = _erd_readings_st()
         status: _erd_status_t = _erdlib.erd_subtract_readings(
@@ -279,6 +478,114 @@ class Handle:
         self._finalizer()
 
 
+class Sampler:
+    """Reads a handle periodically on a native thread of its own, which never
+    takes the GIL, so the samples are evenly spaced however busy the
+    interpreter is; they are kept in a ring buffer of capacity samples, so
+    drain must be called before older ones are overwritten"""
+
+    def __init__(self, handle: Handle, period_ns: int, capacity: int = 65536) -> None:
+        self.handle = handle
+        self._cursor = 0
+        # samples overwritten before they were drained
+        self.lost = 0
+        self._pointer = _erd_sampler_t()
+        ed = _ErrorDescriptor()
+        status: _erd_status_t = _erdlib.erd_sampler_create(
+            ctypes.byref(self._pointer),
+            handle._pointer,
+            period_ns,
+            capacity,
+            ctypes.byref(ed._ed),
+        )
+        if status.value != StatusCode.success.value:
+            raise Error("Error creating sampler", StatusCode(status.value), ed)
+        self._finalizer = weakref.finalize(
+            self, _erdlib.erd_sampler_destroy, self._pointer
+        )
+
+    def available(self) -> int:
+        """The number of samples not drained yet"""
+        count = ctypes.c_size_t()
+        _erdlib.erd_sampler_available(self._pointer, self._cursor, count)
+        return count.value
+
+    def drain(
+        self, time: Optional[Any] = None, energy: Optional[Any] = None
+    ) -> Tuple[Any, Any]:
+        """Copies the samples not drained yet, oldest first, into time, in
+        nanoseconds, and energy, in microjoules; when given, as many as fit are
+        copied and views of the part filled are returned, otherwise arrays of
+        the samples available are allocated"""
+        if time is None or energy is None:
+            count = self.available()
+            time = _empty(count, "q")
+            energy = _empty(count, "Q")
+        before = self._cursor
+        if _native is not None:
+            count, self._cursor = _native.sampler_drain(
+                self._pointer.value, self._cursor, time, energy
+            )
+        else:
+            taddr, size = _address(time)
+            eaddr, esize = _address(energy)
+            if size != esize:
+                raise ValueError("time and energy must have the same length")
+            cursor = ctypes.c_uint64(self._cursor)
+            copied = ctypes.c_size_t()
+            _erdlib.erd_sampler_drain(
+                self._pointer, cursor, taddr, eaddr, size, copied
+            )
+            count, self._cursor = copied.value, cursor.value
+        self.lost += self._cursor - before - count
+        return _head(time, count), _head(energy, count)
+
+    def errors(self) -> int:
+        """The number of failed reads since creation"""
+        errors = ctypes.c_uint64()
+        _erdlib.erd_sampler_errors(self._pointer, errors)
+        return errors.value
+
+    def stop(self) -> None:
+        """Stops sampling; the samples taken remain to be drained"""
+        _erdlib.erd_sampler_stop(self._pointer)
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, exc_type, exc_value, traceback) -> None:
+        self._finalizer()
+
+
+def obtain_readings_n(
+    handles: Sequence[Handle], time: Optional[Any] = None, energy: Optional[Any] = None
+) -> Tuple[Any, Any]:
+    """Reads each handle, such as one per domain, into the element of the same
+    index of time and energy; the outputs are allocated unless given"""
+    if time is None:
+        time = _empty(len(handles), "q")
+    if energy is None:
+        energy = _empty(len(handles), "Q")
+    if _native is not None:
+        try:
+            _native.obtain_readings([h._address for h in handles], time, energy)
+        except _native.error as e:
+            raise Error(
+                "Error obtaining readings: {}".format(e.args[1]), StatusCode(e.args[0])
+            )
+        return time, energy
+    if len(time) < len(handles) or len(energy) < len(handles):
+        raise ValueError("time and energy are too short")
+    pointers = (_erd_handle_t * len(handles))(*(h._pointer for h in handles))
+    ed = _ErrorDescriptor()
+    status: _erd_status_t = _erdlib.erd_obtain_readings_n(
+        pointers, len(handles), _address(time)[0], _address(energy)[0], ed._ed
+    )
+    if status.value != StatusCode.success.value:
+        raise Error("Error obtaining readings", StatusCode(status.value), ed)
+    return time, energy
+
+
 if __name__ == "__main__":
     import time
 
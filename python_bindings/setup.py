@@ -1,8 +1,23 @@
-from setuptools import setup
+import os
+
+from setuptools import Extension, setup
+
+include_dir = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "include")
 
 setup(
     name="erd-python",
     version="0.1",
     description="Python bindings to the simple energy queries",
     packages=["erd"],
+    # batch sampling without ctypes overhead; the bindings fall back to ctypes
+    # when it cannot be built
+    ext_modules=[
+        Extension(
+            "erd._native",
+            sources=["erd/_native.cpp"],
+            include_dirs=[include_dir],
+            extra_compile_args=["-std=c++17"],
+            optional=True,
+        )
+    ],
 )
@@ -0,0 +1,213 @@
+#include <erd/erd_sim.hpp>
+
+#include <cxxopts.hpp>
+#include <fmt/format.h>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// fixed width, so that every update overwrites the whole previous value
+constexpr int ENERGY_WIDTH = 20;
+
+volatile std::sig_atomic_t stop_requested = 0;
+
+void request_stop(int) { stop_requested = 1; }
+
+struct zone {
+  erd::attributes_t attr;
+  std::string path;
+  std::string name;
+  int energy_fd = -1;
+  std::unique_ptr<erd::detail::sim_counter> counter;
+};
+
+bool string_to_domain(std::string_view domain_str, erd::domain_t &domain) {
+  if (domain_str == "package") {
+    domain = erd::domain_t::package;
+  } else if (domain_str == "cores") {
+    domain = erd::domain_t::cores;
+  } else if (domain_str == "uncore") {
+    domain = erd::domain_t::uncore;
+  } else if (domain_str == "dram") {
+    domain = erd::domain_t::dram;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+const char *zone_name(erd::domain_t domain) {
+  switch (domain) {
+  case erd::domain_t::cores:
+    return "core";
+  case erd::domain_t::uncore:
+    return "uncore";
+  case erd::domain_t::dram:
+    return "dram";
+  default:
+    return "package";
+  }
+}
+
+void write_file(const std::string &path, const std::string &contents) {
+  int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd == -1 || write(fd, contents.data(), contents.size()) == -1) {
+    throw std::system_error(errno, std::system_category(), path);
+  }
+  close(fd);
+}
+
+void make_directory(const std::string &path) {
+  if (mkdir(path.c_str(), 0755) == -1 && errno != EEXIST) {
+    throw std::system_error(errno, std::system_category(), path);
+  }
+}
+
+void write_energy(const zone &z, erd::energy_t energy) {
+  std::string value = fmt::format("{:0{}}\n", energy.count(), ENERGY_WIDTH);
+  if (pwrite(z.energy_fd, value.data(), value.size(), 0) == -1) {
+    std::cerr << "Error writing " << z.path << ": " << std::strerror(errno)
+              << "\n";
+  }
+}
+
+// the layout of the intel-rapl zones under /sys/class/powercap: one zone per
+// package, with a subzone per other domain
+std::vector<zone> create_tree(const std::string &root, uint32_t sockets,
+                              const std::vector<erd::domain_t> &domains,
+                              const erd::sim_model_t &model) {
+  make_directory(root);
+  std::vector<zone> zones;
+  for (uint32_t skt = 0; skt < sockets; skt++) {
+    std::string package = fmt::format("{}/intel-rapl:{}", root, skt);
+    uint32_t subzone = 0;
+    for (erd::domain_t domain : domains) {
+      zone z;
+      z.attr = erd::attributes_t{domain, skt};
+      if (domain == erd::domain_t::package) {
+        z.path = package;
+        z.name = fmt::format("package-{}", skt);
+      } else {
+        z.path = fmt::format("{}:{}", package, subzone++);
+        z.name = zone_name(domain);
+      }
+      zones.push_back(std::move(z));
+    }
+  }
+  for (zone &z : zones) {
+    make_directory(z.path);
+    write_file(z.path + "/name", z.name + "\n");
+    write_file(z.path + "/max_energy_range_uj",
+               fmt::format("{}\n", model.max_energy.count()));
+    std::string energy = z.path + "/energy_uj";
+    z.energy_fd = open(energy.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (z.energy_fd == -1) {
+      throw std::system_error(errno, std::system_category(), energy);
+    }
+    z.counter = std::make_unique<erd::detail::sim_counter>(
+        model, model.seed ^ (uint64_t(z.attr.socket) << 8 |
+                             static_cast<uint64_t>(z.attr.domain)));
+    write_energy(z, erd::energy_t{});
+  }
+  return zones;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  cxxopts::Options options(
+      "Powercap simulator",
+      "Generates a powercap tree with counters following a power model");
+  options.add_options() //
+      ("r,root", "Directory to generate the tree in",
+       cxxopts::value<std::string>()->default_value("/tmp/erd-powercap")) //
+      ("s,sockets", "Number of sockets",
+       cxxopts::value<uint32_t>()->default_value("1")) //
+      ("d,domains", "Comma-separated domains - package, cores, uncore, dram",
+       cxxopts::value<std::string>()->default_value("package,cores,dram")) //
+      ("w,power", "Mean power, in watts",
+       cxxopts::value<double>()->default_value("50")) //
+      ("a,amplitude", "Amplitude of the power sine wave, in watts",
+       cxxopts::value<double>()->default_value("0")) //
+      ("p,period", "Period of the power sine wave, in milliseconds",
+       cxxopts::value<uint32_t>()->default_value("1000")) //
+      ("n,noise", "Standard deviation of the power noise, in watts",
+       cxxopts::value<double>()->default_value("0")) //
+      ("g,granularity", "Counter update interval, in microseconds",
+       cxxopts::value<uint32_t>()->default_value("1000")) //
+      ("m,max-energy", "Counter range, in microjoules",
+       cxxopts::value<uint64_t>()->default_value("262143328850")) //
+      ("seed", "Seed of the power noise",
+       cxxopts::value<uint64_t>()->default_value("0")) //
+      ("c,create-only", "Generate the tree and exit without updating it",
+       cxxopts::value<bool>()->default_value("false")) //
+      ("h,help", "Print usage");
+  auto result = options.parse(argc, argv);
+
+  if (result.count("help") > 0) {
+    std::cout << options.help() << std::endl;
+    return 0;
+  }
+
+  std::vector<erd::domain_t> domains;
+  std::istringstream domain_list{result["domains"].as<std::string>()};
+  for (std::string domain_str; std::getline(domain_list, domain_str, ',');) {
+    if (erd::domain_t domain; string_to_domain(domain_str, domain)) {
+      domains.push_back(domain);
+    } else {
+      std::cerr << "Invalid domain value: " << domain_str << "\n";
+      return 1;
+    }
+  }
+
+  erd::sim_model_t model;
+  model.power = result["power"].as<double>();
+  model.amplitude = result["amplitude"].as<double>();
+  model.period = std::chrono::milliseconds(result["period"].as<uint32_t>());
+  model.noise = result["noise"].as<double>();
+  model.granularity =
+      std::chrono::microseconds(result["granularity"].as<uint32_t>());
+  model.max_energy = erd::energy_t{result["max-energy"].as<uint64_t>()};
+  model.seed = result["seed"].as<uint64_t>();
+
+  const std::string root = result["root"].as<std::string>();
+  std::vector<zone> zones =
+      create_tree(root, result["sockets"].as<uint32_t>(), domains, model);
+  std::cout << "Root: " << root << "\n";
+  std::cout << "Zones: " << zones.size() << "\n";
+  std::cout << "Use with ERD_POWERCAP_ROOT=" << root << "\n";
+  if (result["create-only"].as<bool>()) {
+    return 0;
+  }
+
+  std::signal(SIGINT, request_stop);
+  std::signal(SIGTERM, request_stop);
+  auto next = erd::clock_t::now();
+  while (!stop_requested) {
+    auto now = erd::clock_t::now();
+    for (const zone &z : zones) {
+      write_energy(z, z.counter->read(now));
+    }
+    next += model.granularity;
+    if (next < now) {
+      next = now;
+    }
+    std::this_thread::sleep_until(next);
+  }
+  for (zone &z : zones) {
+    close(z.energy_fd);
+  }
+}
@@ -0,0 +1,123 @@
+#include <erd/accumulator.hpp>
+
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+namespace {
+
+constexpr erd::clock_t::duration MIN_PERIOD = std::chrono::milliseconds(1);
+constexpr erd::clock_t::duration INITIAL_PERIOD =
+    std::chrono::milliseconds(100);
+// reads per wrap period, so that the power may grow fourfold between reads
+// before the counter wraps twice
+constexpr long double READS_PER_WRAP = 4;
+
+erd::energy_t saturating_add(erd::energy_t lhs, erd::energy_t rhs) noexcept {
+  constexpr auto max = std::numeric_limits<erd::energy_t::rep>::max();
+  if (max - lhs.count() < rhs.count()) {
+    return erd::energy_t{max};
+  }
+  return lhs + rhs;
+}
+
+erd::clock_t::duration next_period(const erd::difference_t &diff,
+                                   erd::energy_t max_energy,
+                                   erd::clock_t::duration max_period) noexcept {
+  if (!diff.energy_consumed.count() || diff.duration <= diff.duration.zero()) {
+    return max_period;
+  }
+  long double wrap = static_cast<long double>(diff.duration.count()) *
+                     static_cast<long double>(max_energy.count()) /
+                     static_cast<long double>(diff.energy_consumed.count());
+  long double period = wrap / READS_PER_WRAP;
+  if (period >= static_cast<long double>(max_period.count())) {
+    return max_period;
+  }
+  return std::max(
+      erd::clock_t::duration{static_cast<erd::clock_t::rep>(period)},
+      MIN_PERIOD);
+}
+
+} // namespace
+
+namespace erd {
+
+accumulator_t::accumulator_t(reader_t reader, clock_t::duration max_period)
+    : reader_(std::move(reader)), max_period_(std::max(max_period, MIN_PERIOD)),
+      period_(std::min(max_period_, INITIAL_PERIOD).count()) {
+  if (std::error_code ec; !reader_.obtain_readings(last_, ec)) {
+    throw std::system_error(ec, "Error obtaining initial readings");
+  }
+  thread_ = std::thread{&accumulator_t::run, this};
+}
+
+accumulator_t::~accumulator_t() noexcept { stop(); }
+
+void accumulator_t::stop() noexcept {
+  {
+    std::lock_guard lock{mtx_};
+    stop_ = true;
+  }
+  cv_.notify_all();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+}
+
+bool accumulator_t::obtain_readings(readings_t &into,
+                                    std::error_code &ec) noexcept {
+  return update(into, ec);
+}
+
+difference_t accumulator_t::subtract(const readings_t &lhs,
+                                     const readings_t &rhs) noexcept {
+  return difference_t{lhs.timestamp - rhs.timestamp, lhs.energy - rhs.energy};
+}
+
+const reader_t &accumulator_t::reader() const noexcept { return reader_; }
+
+clock_t::duration accumulator_t::period() const noexcept {
+  return clock_t::duration{period_.load(std::memory_order_relaxed)};
+}
+
+std::uint64_t accumulator_t::errors() const noexcept {
+  return errors_.load(std::memory_order_relaxed);
+}
+
+bool accumulator_t::update(readings_t &into, std::error_code &ec) noexcept {
+  std::lock_guard lock{state_mtx_};
+  readings_t current;
+  if (!reader_.obtain_readings(current, ec)) {
+    return false;
+  }
+  difference_t diff = reader_.subtract(current, last_);
+  total_ = saturating_add(total_, diff.energy_consumed);
+  last_ = current;
+  period_.store(next_period(diff, reader_.max_energy(), max_period_).count(),
+                std::memory_order_relaxed);
+  into = readings_t{current.timestamp, total_};
+  return true;
+}
+
+void accumulator_t::run() noexcept {
+  bool failing = false;
+  std::unique_lock lock{mtx_};
+  while (!cv_.wait_for(lock, period(), [this] { return stop_; })) {
+    lock.unlock();
+    readings_t readings;
+    if (std::error_code ec; !update(readings, ec)) {
+      errors_.fetch_add(1, std::memory_order_relaxed);
+      // report only the first of consecutive failures
+      if (!failing) {
+        default_error_handler("Accumulator error obtaining readings", ec);
+      }
+      failing = true;
+    } else {
+      failing = false;
+    }
+    lock.lock();
+  }
+}
+
+} // namespace erd
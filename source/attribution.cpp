@@ -0,0 +1,401 @@
+#include <erd/attribution.hpp>
+
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr const char *DEFAULT_PROC_ROOT = "/proc";
+constexpr const char *DEFAULT_CGROUP_ROOT = "/sys/fs/cgroup";
+
+// holds /proc/stat up to its first line, or a line of /proc/<pid>/stat
+constexpr std::size_t STAT_BUFFER_SIZE = 1024;
+// fields of /proc/<pid>/stat after the command name, counting from the state
+constexpr std::size_t UTIME_FIELD = 11;
+constexpr std::size_t STIME_FIELD = 12;
+constexpr std::size_t STARTTIME_FIELD = 19;
+
+std::error_code get_errno() noexcept {
+  return std::error_code{errno, std::system_category()};
+}
+
+// reads a small file relative to a directory into buffer, null-terminated;
+// the number of bytes read, or -1
+ssize_t read_at(int dirfd, const char *path, char *buffer,
+                std::size_t size) noexcept {
+  int fd = openat(dirfd, path, O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    return -1;
+  }
+  ssize_t bytes = read(fd, buffer, size - 1);
+  int error = errno;
+  ::close(fd);
+  if (bytes == -1) {
+    errno = error;
+    return -1;
+  }
+  buffer[bytes] = '\0';
+  return bytes;
+}
+
+const char *skip_spaces(const char *from, const char *end) noexcept {
+  while (from < end && (*from == ' ' || *from == '\n')) {
+    from++;
+  }
+  return from;
+}
+
+const char *parse_field(const char *from, const char *end,
+                        std::uint64_t &value) noexcept {
+  from = skip_spaces(from, end);
+  auto [ptr, ec] = std::from_chars(from, end, value);
+  return ec == std::errc{} ? ptr : nullptr;
+}
+
+const char *skip_field(const char *from, const char *end) noexcept {
+  from = skip_spaces(from, end);
+  while (from < end && *from != ' ' && *from != '\n') {
+    from++;
+  }
+  return from;
+}
+
+// the first line of /proc/stat: "cpu" followed by the time spent in user,
+// nice, system, idle, iowait, irq, softirq and steal, in clock ticks; guest
+// time is included in user time
+bool parse_busy_ticks(const char *from, const char *end,
+                      std::uint64_t &busy) noexcept {
+  if (end - from < 4 || std::strncmp(from, "cpu ", 4) != 0) {
+    return false;
+  }
+  from += 4;
+  std::uint64_t fields[8];
+  for (std::uint64_t &field : fields) {
+    if (!(from = parse_field(from, end, field))) {
+      return false;
+    }
+  }
+  busy = fields[0] + fields[1] + fields[2] + fields[5] + fields[6] + fields[7];
+  return true;
+}
+
+// the command name may hold spaces and parentheses, so the fields are counted
+// from the last closing parenthesis
+bool parse_process_stat(const char *from, const char *end,
+                        std::uint64_t &start_time,
+                        std::uint64_t &ticks) noexcept {
+  const char *paren = nullptr;
+  for (const char *p = end; p > from; p--) {
+    if (p[-1] == ')') {
+      paren = p;
+      break;
+    }
+  }
+  if (!paren) {
+    return false;
+  }
+  from = paren;
+  std::uint64_t utime = 0;
+  std::uint64_t stime = 0;
+  for (std::size_t field = 0; field <= STARTTIME_FIELD; field++) {
+    std::uint64_t *into = field == UTIME_FIELD       ? &utime
+                          : field == STIME_FIELD     ? &stime
+                          : field == STARTTIME_FIELD ? &start_time
+                                                     : nullptr;
+    from = into ? parse_field(from, end, *into) : skip_field(from, end);
+    if (!from) {
+      return false;
+    }
+  }
+  ticks = utime + stime;
+  return true;
+}
+
+bool parse_usage(const char *from, const char *end,
+                 std::uint64_t &usage) noexcept {
+  constexpr std::string_view key = "usage_usec ";
+  for (const char *line = from; line < end;) {
+    if (std::string_view{line, static_cast<std::size_t>(end - line)}.substr(
+            0, key.size()) == key) {
+      return parse_field(line + key.size(), end, usage) != nullptr;
+    }
+    const char *newline = static_cast<const char *>(
+        std::memchr(line, '\n', static_cast<std::size_t>(end - line)));
+    if (!newline) {
+      break;
+    }
+    line = newline + 1;
+  }
+  return false;
+}
+
+bool parse_pid(const char *name, std::int32_t &pid) noexcept {
+  const char *end = name + std::strlen(name);
+  auto [ptr, ec] = std::from_chars(name, end, pid);
+  return ec == std::errc{} && ptr == end && pid > 0;
+}
+
+std::string root_from_env(const char *name, const char *fallback) {
+  const char *env = std::getenv(name);
+  return env && *env ? env : fallback;
+}
+
+} // namespace
+
+namespace erd {
+
+std::string attribution_t::default_proc_root() {
+  return root_from_env("ERD_PROC_ROOT", DEFAULT_PROC_ROOT);
+}
+
+std::string attribution_t::default_cgroup_root() {
+  return root_from_env("ERD_CGROUP_ROOT", DEFAULT_CGROUP_ROOT);
+}
+
+attribution_t::attribution_t(std::vector<reader_t> readers,
+                             std::vector<std::string> cgroups,
+                             const std::string &proc_root,
+                             const std::string &cgroup_root)
+    : readers_(std::move(readers)), readings_(readers_.size()),
+      next_readings_(readers_.size()), proc_dir_(opendir(proc_root.c_str())),
+      cgroup_fd_(-1),
+      ticks_per_second_(static_cast<double>(sysconf(_SC_CLK_TCK))),
+      cgroup_energy_(cgroups.size() * readers_.size()),
+      unattributed_(readers_.size()) {
+  if (!proc_dir_) {
+    throw std::system_error(get_errno(), "Error opening " + proc_root);
+  }
+  if (!cgroups.empty()) {
+    cgroup_fd_ = open(cgroup_root.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (cgroup_fd_ == -1) {
+      std::error_code ec = get_errno();
+      closedir(proc_dir_);
+      throw std::system_error(ec, "Error opening " + cgroup_root);
+    }
+  }
+  for (std::string &name : cgroups) {
+    std::string stat_path = name + "/cpu.stat";
+    cgroups_.push_back(
+        cgroup_t{std::move(name), std::move(stat_path), false, 0, false, 0});
+  }
+}
+
+attribution_t::~attribution_t() noexcept {
+  closedir(proc_dir_);
+  if (cgroup_fd_ >= 0) {
+    ::close(cgroup_fd_);
+  }
+}
+
+bool attribution_t::update(std::error_code &ec) noexcept {
+  // the counters and CPU time are read together, before the longer scan
+  std::uint64_t busy;
+  if (!read_busy_ticks(busy, ec)) {
+    return false;
+  }
+  for (std::size_t r = 0; r < readers_.size(); r++) {
+    if (!readers_[r].obtain_readings(next_readings_[r], ec)) {
+      return false;
+    }
+  }
+  if (!scan_processes(ec)) {
+    return false;
+  }
+
+  const std::size_t count = readers_.size();
+  // merges the scan with the previous table, carrying the energy of every
+  // process still running; PIDs are in order in both
+  try {
+    scan_energy_.assign(scan_.size() * count, 0.0);
+    scan_deltas_.resize(scan_.size());
+  } catch (const std::bad_alloc &) {
+    ec = std::make_error_code(std::errc::not_enough_memory);
+    return false;
+  }
+  std::uint64_t total_delta = 0;
+  for (std::size_t i = 0, j = 0; i < scan_.size(); i++) {
+    const process_t &process = scan_[i];
+    while (j < processes_.size() && processes_[j].pid < process.pid) {
+      j++;
+    }
+    std::uint64_t delta = 0;
+    if (j < processes_.size() && processes_[j].pid == process.pid &&
+        processes_[j].start_time == process.start_time) {
+      std::copy_n(process_energy_.begin() + j * count, count,
+                  scan_energy_.begin() + i * count);
+      if (process.cpu_ticks > processes_[j].cpu_ticks) {
+        delta = process.cpu_ticks - processes_[j].cpu_ticks;
+      }
+    } else if (!first_) {
+      // started since the previous update
+      delta = process.cpu_ticks;
+    }
+    scan_deltas_[i] = delta;
+    total_delta += delta;
+  }
+
+  for (cgroup_t &cgroup : cgroups_) {
+    cgroup.sampled = read_usage(cgroup, cgroup.sample_us);
+  }
+
+  // in case the scan saw more CPU time than /proc/stat, as they are not read
+  // at the same instant, nothing is attributed twice
+  std::uint64_t busy_delta = busy > busy_ticks_ ? busy - busy_ticks_ : 0;
+  double denominator =
+      static_cast<double>(std::max(busy_delta, total_delta));
+  std::lock_guard lock{mtx_};
+  for (std::size_t r = 0; !first_ && r < count; r++) {
+    double energy = static_cast<double>(
+        readers_[r]
+            .subtract(next_readings_[r], readings_[r])
+            .energy_consumed.count());
+    if (denominator == 0.0) {
+      unattributed_[r] += energy;
+      continue;
+    }
+    double per_tick = energy / denominator;
+    for (std::size_t i = 0; i < scan_.size(); i++) {
+      scan_energy_[i * count + r] +=
+          per_tick * static_cast<double>(scan_deltas_[i]);
+    }
+    unattributed_[r] +=
+        per_tick * static_cast<double>(denominator - total_delta);
+    double per_us = per_tick * ticks_per_second_ * 1e-6;
+    for (std::size_t c = 0; c < cgroups_.size(); c++) {
+      const cgroup_t &cgroup = cgroups_[c];
+      if (cgroup.sampled && cgroup.seen && cgroup.sample_us > cgroup.usage_us) {
+        cgroup_energy_[c * count + r] += std::min(
+            energy,
+            per_us * static_cast<double>(cgroup.sample_us - cgroup.usage_us));
+      }
+    }
+  }
+  // a cgroup that cannot be read starts over once it can
+  for (cgroup_t &cgroup : cgroups_) {
+    cgroup.seen = cgroup.sampled;
+    cgroup.usage_us = cgroup.sample_us;
+  }
+  processes_.swap(scan_);
+  process_energy_.swap(scan_energy_);
+  readings_.swap(next_readings_);
+  busy_ticks_ = busy;
+  first_ = false;
+  ec.clear();
+  return true;
+}
+
+bool attribution_t::process_energy(std::int32_t pid, std::size_t idx,
+                                   joules<double> &into) const noexcept {
+  std::lock_guard lock{mtx_};
+  auto it = std::lower_bound(
+      processes_.begin(), processes_.end(), pid,
+      [](const process_t &p, std::int32_t value) { return p.pid < value; });
+  if (it == processes_.end() || it->pid != pid || idx >= readers_.size()) {
+    return false;
+  }
+  auto i = static_cast<std::size_t>(it - processes_.begin());
+  into = microjoules<double>{process_energy_[i * readers_.size() + idx]};
+  return true;
+}
+
+bool attribution_t::cgroup_energy(std::string_view cgroup, std::size_t idx,
+                                  joules<double> &into) const noexcept {
+  if (idx >= readers_.size()) {
+    return false;
+  }
+  std::lock_guard lock{mtx_};
+  for (std::size_t c = 0; c < cgroups_.size(); c++) {
+    if (cgroups_[c].name == cgroup) {
+      into = microjoules<double>{cgroup_energy_[c * readers_.size() + idx]};
+      return true;
+    }
+  }
+  return false;
+}
+
+bool attribution_t::unattributed(std::size_t idx,
+                                 joules<double> &into) const noexcept {
+  if (idx >= readers_.size()) {
+    return false;
+  }
+  std::lock_guard lock{mtx_};
+  into = microjoules<double>{unattributed_[idx]};
+  return true;
+}
+
+const reader_t &attribution_t::reader(std::size_t idx) const noexcept {
+  return readers_[idx];
+}
+
+std::size_t attribution_t::size() const noexcept { return readers_.size(); }
+
+std::size_t attribution_t::process_count() const noexcept {
+  std::lock_guard lock{mtx_};
+  return processes_.size();
+}
+
+bool attribution_t::read_busy_ticks(std::uint64_t &into,
+                                    std::error_code &ec) noexcept {
+  char buffer[STAT_BUFFER_SIZE];
+  ssize_t bytes = read_at(dirfd(proc_dir_), "stat", buffer, sizeof(buffer));
+  if (bytes == -1) {
+    ec = get_errno();
+    return false;
+  }
+  if (!parse_busy_ticks(buffer, buffer + bytes, into)) {
+    ec = std::make_error_code(std::errc::bad_message);
+    return false;
+  }
+  return true;
+}
+
+// processes that exit while being scanned are skipped
+bool attribution_t::scan_processes(std::error_code &ec) noexcept {
+  scan_.clear();
+  rewinddir(proc_dir_);
+  char path[32];
+  char buffer[STAT_BUFFER_SIZE];
+  while (const dirent *entry = readdir(proc_dir_)) {
+    std::int32_t pid;
+    if (!parse_pid(entry->d_name, pid)) {
+      continue;
+    }
+    std::snprintf(path, sizeof(path), "%d/stat", pid);
+    ssize_t bytes = read_at(dirfd(proc_dir_), path, buffer, sizeof(buffer));
+    process_t process{pid, 0, 0};
+    if (bytes > 0 && parse_process_stat(buffer, buffer + bytes,
+                                        process.start_time,
+                                        process.cpu_ticks)) {
+      try {
+        scan_.push_back(process);
+      } catch (const std::bad_alloc &) {
+        ec = std::make_error_code(std::errc::not_enough_memory);
+        return false;
+      }
+    }
+  }
+  // procfs lists processes in order of PID, other trees need not
+  auto by_pid = [](const process_t &lhs, const process_t &rhs) {
+    return lhs.pid < rhs.pid;
+  };
+  if (!std::is_sorted(scan_.begin(), scan_.end(), by_pid)) {
+    std::sort(scan_.begin(), scan_.end(), by_pid);
+  }
+  return true;
+}
+
+bool attribution_t::read_usage(const cgroup_t &cgroup,
+                               std::uint64_t &into) noexcept {
+  char buffer[STAT_BUFFER_SIZE];
+  ssize_t bytes = read_at(cgroup_fd_, cgroup.stat_path.c_str(), buffer,
+                          sizeof(buffer));
+  return bytes > 0 && parse_usage(buffer, buffer + bytes, into);
+}
+
+} // namespace erd
@@ -0,0 +1,247 @@
+#include <erd/erd.hpp>
+#include <fmt/format.h>
+
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+std::vector<std::string> split_names(std::string_view list) {
+  std::vector<std::string> retval;
+  while (!list.empty()) {
+    size_t end = list.find(',');
+    if (std::string_view name = list.substr(0, end); !name.empty()) {
+      retval.emplace_back(name);
+    }
+    if (end == std::string_view::npos) {
+      break;
+    }
+    list.remove_prefix(end + 1);
+  }
+  return retval;
+}
+
+// domains read back to back, by a backend that does not batch reads or by
+// the backends selected for each
+class reader_backend_set_t final : public erd::backend_set_t {
+public:
+  reader_backend_set_t(std::string name, std::vector<erd::attributes_t> attrs,
+                       std::vector<std::unique_ptr<erd::backend_t>> backends)
+      : name_(std::move(name)), attrs_(std::move(attrs)),
+        backends_(std::move(backends)) {}
+
+  bool obtain_readings(erd::readings_set_t &into,
+                       std::error_code &ec) const noexcept override {
+    try {
+      into.energy.resize(backends_.size());
+    } catch (const std::bad_alloc &) {
+      ec = std::make_error_code(std::errc::not_enough_memory);
+      return false;
+    }
+    into.begin = erd::now();
+    for (size_t i = 0; i < backends_.size(); i++) {
+      erd::readings_t readings;
+      if (!backends_[i]->obtain_readings(readings, ec)) {
+        return false;
+      }
+      into.energy[i] = readings.energy;
+    }
+    into.end = erd::now();
+    return true;
+  }
+
+  erd::difference_t
+  subtract(std::size_t idx, const erd::readings_set_t &lhs,
+           const erd::readings_set_t &rhs) const noexcept override {
+    return backends_[idx]->subtract(lhs.readings(idx), rhs.readings(idx));
+  }
+
+  std::size_t size() const noexcept override { return backends_.size(); }
+
+  const std::vector<erd::attributes_t> &attributes() const noexcept override {
+    return attrs_;
+  }
+
+  const char *name() const noexcept override { return name_.c_str(); }
+
+private:
+  std::string name_;
+  std::vector<erd::attributes_t> attrs_;
+  std::vector<std::unique_ptr<erd::backend_t>> backends_;
+};
+
+} // namespace
+
+namespace erd {
+
+backend_registry_t &backend_registry_t::instance() {
+  static backend_registry_t registry;
+  return registry;
+}
+
+backend_registry_t::backend_registry_t() {
+#if defined(ERD_POWERCAP)
+  add<powercap_reader_t, powercap_reader_set_t>();
+#endif
+#if defined(ERD_MSR)
+  add<msr_reader_t>();
+#endif
+  // both accept any attributes, so trying them would hide that a domain or
+  // socket does not exist; without hardware backends, nop is all there is
+#if defined(ERD_POWERCAP) || defined(ERD_MSR)
+  add<nop_reader_t, nop_reader_set_t>(false);
+#else
+  add<nop_reader_t, nop_reader_set_t>();
+#endif
+  add<sim_reader_t>(false);
+}
+
+void backend_registry_t::add(std::string name, factory_t factory,
+                             bool probed, set_factory_t set_factory) {
+  std::lock_guard lock{mtx_};
+  entries_.push_back(entry_t{std::move(name), factory, probed, set_factory});
+}
+
+std::vector<std::string> backend_registry_t::probe_order() const {
+  if (const char *env = std::getenv("ERD_BACKEND"); env && *env) {
+    return split_names(env);
+  }
+  std::vector<std::string> order;
+  std::lock_guard lock{mtx_};
+  for (const entry_t &entry : entries_) {
+    if (entry.probed) {
+      order.push_back(entry.name);
+    }
+  }
+  return order;
+}
+
+backend_registry_t::entry_t
+backend_registry_t::find(std::string_view name) const {
+  std::lock_guard lock{mtx_};
+  for (const entry_t &entry : entries_) {
+    if (entry.name == name) {
+      return entry;
+    }
+  }
+  throw std::system_error(std::make_error_code(std::errc::invalid_argument),
+                          fmt::format("Unknown backend {}", name));
+}
+
+backend_registry_t::set_factory_t
+backend_registry_t::find_set_factory(std::string_view name) const {
+  std::lock_guard lock{mtx_};
+  for (const entry_t &entry : entries_) {
+    if (entry.name == name) {
+      return entry.set_factory;
+    }
+  }
+  return nullptr;
+}
+
+std::unique_ptr<backend_t>
+backend_registry_t::make(const attributes_t &attr) const {
+  std::vector<std::string> order = probe_order();
+  std::error_code ec = std::make_error_code(std::errc::no_such_device);
+  std::string reasons;
+  for (const std::string &name : order) {
+    try {
+      return make(name, attr);
+    } catch (const std::system_error &e) {
+      ec = e.code();
+      reasons += fmt::format("{}{}: {}", reasons.empty() ? "" : "; ", name,
+                             e.what());
+    }
+  }
+  throw std::system_error(ec,
+                          fmt::format("No backend available ({})", reasons));
+}
+
+std::unique_ptr<backend_t>
+backend_registry_t::make(std::string_view name,
+                         const attributes_t &attr) const {
+  return find(name).factory(attr);
+}
+
+std::unique_ptr<backend_set_t>
+backend_registry_t::make_set(const std::vector<attributes_t> &attrs) const {
+  std::vector<std::unique_ptr<backend_t>> backends;
+  for (const attributes_t &attr : attrs) {
+    backends.push_back(make(attr));
+  }
+  const char *name = backends.empty() ? any_backend_t::backend_name
+                                      : backends.front()->name();
+  for (const std::unique_ptr<backend_t> &backend : backends) {
+    if (std::strcmp(backend->name(), name) != 0) {
+      name = any_backend_t::backend_name;
+      break;
+    }
+  }
+  if (set_factory_t set_factory = find_set_factory(name)) {
+    try {
+      return set_factory(attrs);
+    } catch (const std::system_error &) {
+      // the readers work, one at a time
+    }
+  }
+  return std::make_unique<reader_backend_set_t>(name, attrs,
+                                                std::move(backends));
+}
+
+std::unique_ptr<backend_set_t>
+backend_registry_t::make_set(std::string_view name,
+                             const std::vector<attributes_t> &attrs) const {
+  entry_t entry = find(name);
+  if (entry.set_factory) {
+    return entry.set_factory(attrs);
+  }
+  std::vector<std::unique_ptr<backend_t>> backends;
+  for (const attributes_t &attr : attrs) {
+    backends.push_back(entry.factory(attr));
+  }
+  return std::make_unique<reader_backend_set_t>(std::move(entry.name), attrs,
+                                                std::move(backends));
+}
+
+std::vector<std::string> backend_registry_t::names() const {
+  std::lock_guard lock{mtx_};
+  std::vector<std::string> retval;
+  for (const entry_t &entry : entries_) {
+    retval.push_back(entry.name);
+  }
+  return retval;
+}
+
+any_backend_t::any_backend_t(const attributes_t &attr)
+    : impl_(backend_registry_t::instance().make(attr)) {}
+
+any_backend_t::any_backend_t(std::string_view backend,
+                             const attributes_t &attr)
+    : impl_(backend_registry_t::instance().make(backend, attr)) {}
+
+any_backend_t::any_backend_t(std::unique_ptr<backend_t> backend) noexcept
+    : impl_(std::move(backend)) {}
+
+any_backend_t::any_backend_t(const any_backend_t &other)
+    : impl_(other.impl_->clone()) {}
+
+any_backend_t &any_backend_t::operator=(const any_backend_t &other) {
+  impl_ = other.impl_->clone();
+  return *this;
+}
+
+any_reader_set_t::any_reader_set_t(const std::vector<attributes_t> &attrs)
+    : impl_(backend_registry_t::instance().make_set(attrs)) {}
+
+any_reader_set_t::any_reader_set_t(std::string_view backend,
+                                   const std::vector<attributes_t> &attrs)
+    : impl_(backend_registry_t::instance().make_set(backend, attrs)) {}
+
+any_reader_set_t::any_reader_set_t(const std::vector<std::uint32_t> &sockets,
+                                   const std::vector<domain_t> &domains)
+    : any_reader_set_t(make_attributes(sockets, domains)) {}
+
+any_reader_set_t::any_reader_set_t(std::unique_ptr<backend_set_t> set) noexcept
+    : impl_(std::move(set)) {}
+
+} // namespace erd
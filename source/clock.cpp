@@ -0,0 +1,328 @@
+#include <erd/clock.hpp>
+#include <erd/seqlock.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#define ERD_HAVE_TSC
+#endif
+
+namespace {
+
+constexpr auto relaxed = std::memory_order_relaxed;
+
+__extension__ typedef unsigned __int128 uint128_t;
+
+constexpr unsigned MULT_SHIFT = 32;
+constexpr auto CALIBRATION_PERIOD = std::chrono::milliseconds(10);
+constexpr auto ANCHOR_PERIOD = std::chrono::seconds(1);
+// clock_t ahead by more than this has stepped, such as after a suspend, and
+// is followed rather than slewed
+constexpr auto MAX_SLEW_OFFSET = std::chrono::milliseconds(1);
+// bounds the rate correction applied until the next anchor
+constexpr double MAX_SLEW_RATE = 500e-6;
+constexpr int BRACKET_ATTEMPTS = 5;
+
+std::int64_t to_ns(erd::time_point_t tp) noexcept {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             tp.time_since_epoch())
+      .count();
+}
+
+erd::time_point_t from_ns(std::int64_t ns) noexcept {
+  return erd::time_point_t{std::chrono::duration_cast<erd::clock_t::duration>(
+      std::chrono::nanoseconds{ns})};
+}
+
+std::uint64_t read_tsc() noexcept {
+#ifdef ERD_HAVE_TSC
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+bool has_invariant_tsc() noexcept {
+#ifdef ERD_HAVE_TSC
+  unsigned eax, ebx, ecx, edx;
+  if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx)) {
+    return false;
+  }
+  return edx & (1u << 8);
+#else
+  return false;
+#endif
+}
+
+// an unsynchronised counter across sockets makes the kernel fall back to
+// another clock source
+bool kernel_trusts_tsc() {
+  std::ifstream ifs{
+      "/sys/devices/system/clocksource/clocksource0/current_clocksource"};
+  std::string source;
+  if (!(ifs >> source)) {
+    return true;
+  }
+  return source == "tsc";
+}
+
+// a counter value and the clock_t time at that value, in nanoseconds
+struct clock_pair_t {
+  std::uint64_t ticks;
+  std::int64_t time;
+};
+
+// the pair whose counter bracket around the clock read is the narrowest
+clock_pair_t read_pair() noexcept {
+  clock_pair_t best{};
+  std::uint64_t best_width = std::numeric_limits<std::uint64_t>::max();
+  for (int i = 0; i < BRACKET_ATTEMPTS; i++) {
+    std::uint64_t before = read_tsc();
+    std::int64_t time = to_ns(erd::clock_t::now());
+    std::uint64_t after = read_tsc();
+    if (after - before < best_width) {
+      best_width = after - before;
+      best = clock_pair_t{before + (after - before) / 2, time};
+    }
+  }
+  return best;
+}
+
+// nanoseconds per tick are stored shifted left by MULT_SHIFT; the slewed rate
+// applies until the next anchor is due, and the measured rate after it, in
+// case no timestamp is taken for a while
+struct tsc_anchor_t {
+  std::uint64_t ticks;
+  std::int64_t time;
+  std::uint64_t mult;
+  std::uint64_t rate_mult;
+};
+
+std::uint64_t to_mult(double ns_per_tick) noexcept {
+  return static_cast<std::uint64_t>(
+      ns_per_tick * static_cast<double>(std::uint64_t{1} << MULT_SHIFT) + 0.5);
+}
+
+std::int64_t scale(std::uint64_t ticks, std::uint64_t mult) noexcept {
+  return static_cast<std::int64_t>((uint128_t{ticks} * mult) >> MULT_SHIFT);
+}
+
+struct tsc_state_t {
+  std::atomic<bool> calibrated{false};
+  std::atomic_flag writing = ATOMIC_FLAG_INIT;
+  // written once, before calibrated is set
+  clock_pair_t origin{};
+  std::uint64_t anchor_ticks = 0;
+  erd::seqlock_t<tsc_anchor_t> anchor;
+};
+
+tsc_state_t tsc_state;
+
+std::int64_t map_ticks(const tsc_anchor_t &anchor,
+                       std::uint64_t ticks) noexcept {
+  // another core may read a value slightly behind the anchor
+  auto delta = static_cast<std::int64_t>(ticks - anchor.ticks);
+  if (delta < 0) {
+    return anchor.time -
+           scale(static_cast<std::uint64_t>(-delta), anchor.rate_mult);
+  }
+  auto ticks_since = static_cast<std::uint64_t>(delta);
+  if (ticks_since <= tsc_state.anchor_ticks) {
+    return anchor.time + scale(ticks_since, anchor.mult);
+  }
+  return anchor.time + scale(tsc_state.anchor_ticks, anchor.mult) +
+         scale(ticks_since - tsc_state.anchor_ticks, anchor.rate_mult);
+}
+
+void calibrate() noexcept {
+  while (tsc_state.writing.test_and_set(std::memory_order_acquire)) {
+    std::this_thread::yield();
+  }
+  if (!tsc_state.calibrated.load(relaxed)) {
+    clock_pair_t first = read_pair();
+    std::this_thread::sleep_for(CALIBRATION_PERIOD);
+    clock_pair_t second = read_pair();
+    double ns_per_tick = static_cast<double>(second.time - first.time) /
+                         static_cast<double>(second.ticks - first.ticks);
+    tsc_state.origin = first;
+    auto period = std::chrono::nanoseconds{ANCHOR_PERIOD}.count();
+    tsc_state.anchor_ticks = static_cast<std::uint64_t>(
+        static_cast<double>(period) / ns_per_tick);
+    std::uint64_t mult = to_mult(ns_per_tick);
+    tsc_state.anchor.store(
+        tsc_anchor_t{second.ticks, second.time, mult, mult});
+    tsc_state.calibrated.store(true, std::memory_order_release);
+  }
+  tsc_state.writing.clear(std::memory_order_release);
+}
+
+// continues the current mapping from now on, with a rate chosen to meet
+// clock_t again by the next anchor; the rate itself is measured over the
+// whole time since calibration; the mapping only steps forward, so a counter
+// running ahead of clock_t is slowed down however far ahead it is
+tsc_anchor_t reanchor(const tsc_anchor_t &current) noexcept {
+  clock_pair_t actual = read_pair();
+  std::int64_t predicted = map_ticks(current, actual.ticks);
+  double rate = static_cast<double>(actual.time - tsc_state.origin.time) /
+                static_cast<double>(actual.ticks - tsc_state.origin.ticks);
+  tsc_anchor_t next{actual.ticks, predicted, to_mult(rate), to_mult(rate)};
+  std::int64_t offset = actual.time - predicted;
+  if (offset > std::chrono::nanoseconds{MAX_SLEW_OFFSET}.count()) {
+    next.time = actual.time;
+  } else {
+    double correction = static_cast<double>(offset) /
+                        static_cast<double>(tsc_state.anchor_ticks);
+    correction = std::clamp(correction, -rate * MAX_SLEW_RATE,
+                            rate * MAX_SLEW_RATE);
+    next.mult = to_mult(rate + correction);
+  }
+  tsc_state.anchor.store(next);
+  return next;
+}
+
+bool tsc_usable() noexcept {
+  static const bool usable = [] {
+    try {
+      return has_invariant_tsc() && kernel_trusts_tsc();
+    } catch (...) {
+      return false;
+    }
+  }();
+  return usable;
+}
+
+#ifndef ERD_USE_SYSTEM_CLOCK
+// the realtime clock minus clock_t, measured at time
+struct realtime_anchor_t {
+  std::int64_t time;
+  std::int64_t offset;
+};
+
+erd::seqlock_t<realtime_anchor_t> realtime_anchor;
+std::atomic_flag realtime_writing = ATOMIC_FLAG_INIT;
+
+realtime_anchor_t measure_realtime_offset() noexcept {
+  realtime_anchor_t best{};
+  std::int64_t best_width = std::numeric_limits<std::int64_t>::max();
+  for (int i = 0; i < BRACKET_ATTEMPTS; i++) {
+    std::int64_t before = to_ns(erd::clock_t::now());
+    auto realtime = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::system_clock::now().time_since_epoch())
+                        .count();
+    std::int64_t after = to_ns(erd::clock_t::now());
+    if (after - before < best_width) {
+      best_width = after - before;
+      std::int64_t middle = before + (after - before) / 2;
+      best = realtime_anchor_t{middle, realtime - middle};
+    }
+  }
+  return best;
+}
+#endif
+
+// selects the counter before main when requested in the environment
+const bool tsc_from_env = [] {
+  const char *env = std::getenv("ERD_CLOCK");
+  if (!env || std::strcmp(env, "tsc") != 0) {
+    return false;
+  }
+  std::error_code ec;
+  if (!erd::set_clock_source(erd::clock_source_t::tsc, ec)) {
+    erd::default_error_handler("ERD_CLOCK=tsc ignored", ec);
+    return false;
+  }
+  return true;
+}();
+
+} // namespace
+
+namespace erd {
+
+bool tsc_clock_t::available() noexcept { return tsc_usable(); }
+
+tsc_clock_t::time_point tsc_clock_t::now() noexcept {
+  if (!tsc_usable()) {
+    return clock_t::now();
+  }
+  if (!tsc_state.calibrated.load(std::memory_order_acquire)) {
+    calibrate();
+  }
+  std::uint64_t ticks = read_tsc();
+  tsc_anchor_t anchor = tsc_state.anchor.load();
+  if (ticks - anchor.ticks > tsc_state.anchor_ticks &&
+      static_cast<std::int64_t>(ticks - anchor.ticks) > 0 &&
+      !tsc_state.writing.test_and_set(std::memory_order_acquire)) {
+    anchor = reanchor(tsc_state.anchor.load());
+    tsc_state.writing.clear(std::memory_order_release);
+  }
+  return from_ns(map_ticks(anchor, ticks));
+}
+
+double tsc_clock_t::frequency() noexcept {
+  if (!tsc_usable()) {
+    return 0;
+  }
+  if (!tsc_state.calibrated.load(std::memory_order_acquire)) {
+    calibrate();
+  }
+  tsc_anchor_t anchor = tsc_state.anchor.load();
+  return 1e9 * static_cast<double>(std::uint64_t{1} << MULT_SHIFT) /
+         static_cast<double>(anchor.mult);
+}
+
+bool set_clock_source(clock_source_t source, std::error_code &ec) noexcept {
+  if (source == clock_source_t::tsc) {
+    if (!tsc_clock_t::available()) {
+      ec = std::make_error_code(std::errc::not_supported);
+      return false;
+    }
+    // calibrate now rather than in the first timestamp
+    tsc_clock_t::now();
+  }
+  detail::tsc_selected.store(source == clock_source_t::tsc, relaxed);
+  ec.clear();
+  return true;
+}
+
+clock_source_t clock_source() noexcept {
+  return detail::tsc_selected.load(relaxed) ? clock_source_t::tsc
+                                            : clock_source_t::standard;
+}
+
+std::chrono::system_clock::time_point to_realtime(time_point_t tp) noexcept {
+#ifdef ERD_USE_SYSTEM_CLOCK
+  return tp;
+#else
+  using std::chrono::system_clock;
+  std::int64_t time = to_ns(tp);
+  realtime_anchor_t anchor{};
+  bool stale = !realtime_anchor.version();
+  if (!stale) {
+    anchor = realtime_anchor.load();
+    stale = std::abs(time - anchor.time) >
+            std::chrono::nanoseconds{ANCHOR_PERIOD}.count();
+  }
+  if (stale && !realtime_writing.test_and_set(std::memory_order_acquire)) {
+    anchor = measure_realtime_offset();
+    realtime_anchor.store(anchor);
+    realtime_writing.clear(std::memory_order_release);
+  } else if (stale && !realtime_anchor.version()) {
+    // another thread is taking the first measurement
+    anchor = measure_realtime_offset();
+  }
+  return system_clock::time_point{
+      std::chrono::duration_cast<system_clock::duration>(
+          std::chrono::nanoseconds{time + anchor.offset})};
+#endif
+}
+
+} // namespace erd
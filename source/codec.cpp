@@ -0,0 +1,244 @@
+#include <erd/codec.hpp>
+
+namespace {
+
+// a 64-bit varint takes at most 10 bytes
+constexpr std::size_t MAX_VARINT_SIZE = 10;
+// every sample after the first takes at least a byte per field
+constexpr std::size_t MIN_SAMPLE_SIZE = 2;
+
+std::uint64_t zigzag(std::uint64_t value) noexcept {
+  return (value << 1) ^ (0 - (value >> 63));
+}
+
+std::uint64_t unzigzag(std::uint64_t value) noexcept {
+  return (value >> 1) ^ (0 - (value & 1));
+}
+
+std::uint8_t *put_varint(std::uint8_t *to, std::uint64_t value) noexcept {
+  while (value >= 0x80) {
+    *to++ = static_cast<std::uint8_t>(value | 0x80);
+    value >>= 7;
+  }
+  *to++ = static_cast<std::uint8_t>(value);
+  return to;
+}
+
+// without bounds checks, for when at least MAX_VARINT_SIZE bytes remain;
+// false if the varint is longer
+bool get_varint_fast(const std::uint8_t *&from, std::uint64_t &value) noexcept {
+  const std::uint8_t *p = from;
+  std::uint64_t byte = *p++;
+  value = byte & 0x7f;
+  for (unsigned shift = 7; byte & 0x80; shift += 7) {
+    if (shift > 63) {
+      return false;
+    }
+    byte = *p++;
+    value |= (byte & 0x7f) << shift;
+  }
+  from = p;
+  return true;
+}
+
+bool get_varint(const std::uint8_t *&from, const std::uint8_t *end,
+                std::uint64_t &value) noexcept {
+  if (end - from >= static_cast<std::ptrdiff_t>(MAX_VARINT_SIZE)) {
+    return get_varint_fast(from, value);
+  }
+  value = 0;
+  for (unsigned shift = 0; from < end && shift <= 63; shift += 7) {
+    std::uint64_t byte = *from++;
+    value |= (byte & 0x7f) << shift;
+    if (!(byte & 0x80)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Time and Energy map a sample index to its timestamp and energy; the
+// arithmetic is unsigned so that any pair of values has a delta
+template <typename Time, typename Energy>
+void encode_block(Time time, Energy energy, std::size_t count,
+                  std::vector<std::uint8_t> &out) {
+  std::size_t start = out.size();
+  out.resize(start + erd::codec::max_block_size(count));
+  std::uint8_t *to = out.data() + start;
+  to = put_varint(to, count);
+  if (count) {
+    auto prev_time = static_cast<std::uint64_t>(time(0));
+    std::uint64_t prev_energy = energy(0);
+    std::uint64_t prev_step = 0;
+    to = put_varint(to, zigzag(prev_time));
+    to = put_varint(to, prev_energy);
+    for (std::size_t i = 1; i < count; i++) {
+      auto t = static_cast<std::uint64_t>(time(i));
+      std::uint64_t e = energy(i);
+      std::uint64_t step = t - prev_time;
+      to = put_varint(to, zigzag(step - prev_step));
+      to = put_varint(to, zigzag(e - prev_energy));
+      prev_time = t;
+      prev_step = step;
+      prev_energy = e;
+    }
+  }
+  out.resize(static_cast<std::size_t>(to - out.data()));
+}
+
+bool read_count(const std::uint8_t *&data, const std::uint8_t *end,
+                std::size_t &count, std::error_code &ec) noexcept {
+  std::uint64_t value;
+  if (!get_varint(data, end, value)) {
+    ec = std::make_error_code(std::errc::bad_message);
+    return false;
+  }
+  // rejects counts the remaining bytes cannot hold before allocating for them
+  auto remaining = static_cast<std::uint64_t>(end - data);
+  if (value && value - 1 > remaining / MIN_SAMPLE_SIZE) {
+    ec = std::make_error_code(std::errc::bad_message);
+    return false;
+  }
+  count = static_cast<std::size_t>(value);
+  ec.clear();
+  return true;
+}
+
+// Store is called with each index, timestamp and energy in turn
+template <typename Store>
+bool decode_block(const std::uint8_t *&data, const std::uint8_t *end,
+                  std::size_t capacity, Store store,
+                  std::error_code &ec) noexcept {
+  const std::uint8_t *position = data;
+  std::size_t count;
+  if (!read_count(position, end, count, ec)) {
+    return false;
+  }
+  if (count > capacity) {
+    ec = std::make_error_code(std::errc::no_buffer_space);
+    return false;
+  }
+  if (!count) {
+    data = position;
+    return true;
+  }
+  std::uint64_t time;
+  std::uint64_t energy;
+  if (!get_varint(position, end, time) || !get_varint(position, end, energy)) {
+    ec = std::make_error_code(std::errc::bad_message);
+    return false;
+  }
+  time = unzigzag(time);
+  store(0, time, energy);
+  std::uint64_t step = 0;
+  std::size_t i = 1;
+  // a sample takes at most two varints, so the bounds need checking only
+  // near the end
+  constexpr auto max_sample_size =
+      static_cast<std::ptrdiff_t>(2 * MAX_VARINT_SIZE);
+  for (; i < count && end - position >= max_sample_size; i++) {
+    std::uint64_t dod;
+    std::uint64_t delta;
+    if (!get_varint_fast(position, dod) ||
+        !get_varint_fast(position, delta)) {
+      ec = std::make_error_code(std::errc::bad_message);
+      return false;
+    }
+    step += unzigzag(dod);
+    time += step;
+    energy += unzigzag(delta);
+    store(i, time, energy);
+  }
+  for (; i < count; i++) {
+    std::uint64_t dod;
+    std::uint64_t delta;
+    if (!get_varint(position, end, dod) ||
+        !get_varint(position, end, delta)) {
+      ec = std::make_error_code(std::errc::bad_message);
+      return false;
+    }
+    step += unzigzag(dod);
+    time += step;
+    energy += unzigzag(delta);
+    store(i, time, energy);
+  }
+  data = position;
+  ec.clear();
+  return true;
+}
+
+erd::readings_t to_readings(std::uint64_t time, std::uint64_t energy) noexcept {
+  return erd::readings_t{
+      erd::time_point_t{
+          erd::clock_t::duration{static_cast<erd::clock_t::rep>(time)}},
+      erd::energy_t{energy}};
+}
+
+} // namespace
+
+namespace erd::codec {
+
+std::size_t max_block_size(std::size_t count) noexcept {
+  return MAX_VARINT_SIZE * (1 + 2 * count);
+}
+
+void encode(const readings_t *samples, std::size_t count,
+            std::vector<std::uint8_t> &out) {
+  encode_block(
+      [samples](std::size_t i) {
+        return samples[i].timestamp.time_since_epoch().count();
+      },
+      [samples](std::size_t i) { return samples[i].energy.count(); }, count,
+      out);
+}
+
+void encode(const std::int64_t *time, const std::uint64_t *energy,
+            std::size_t count, std::vector<std::uint8_t> &out) {
+  encode_block([time](std::size_t i) { return time[i]; },
+               [energy](std::size_t i) { return energy[i]; }, count, out);
+}
+
+bool block_count(const std::uint8_t *data, std::size_t size, std::size_t &count,
+                 std::error_code &ec) noexcept {
+  return read_count(data, data + size, count, ec);
+}
+
+bool decode(const std::uint8_t *&data, const std::uint8_t *end,
+            readings_t *out, std::size_t capacity,
+            std::error_code &ec) noexcept {
+  return decode_block(
+      data, end, capacity,
+      [out](std::size_t i, std::uint64_t time, std::uint64_t energy) {
+        out[i] = to_readings(time, energy);
+      },
+      ec);
+}
+
+bool decode(const std::uint8_t *&data, const std::uint8_t *end,
+            std::int64_t *time, std::uint64_t *energy, std::size_t capacity,
+            std::error_code &ec) noexcept {
+  return decode_block(
+      data, end, capacity,
+      [time, energy](std::size_t i, std::uint64_t t, std::uint64_t e) {
+        time[i] = static_cast<std::int64_t>(t);
+        energy[i] = e;
+      },
+      ec);
+}
+
+bool decode(const std::uint8_t *&data, const std::uint8_t *end,
+            std::vector<readings_t> &out, std::error_code &ec) {
+  std::size_t count;
+  if (!block_count(data, static_cast<std::size_t>(end - data), count, ec)) {
+    return false;
+  }
+  std::size_t start = out.size();
+  out.resize(start + count);
+  if (!decode(data, end, out.data() + start, count, ec)) {
+    out.resize(start);
+    return false;
+  }
+  return true;
+}
+
+} // namespace erd::codec
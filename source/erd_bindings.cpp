@@ -1,9 +1,14 @@
 #include <erd/erd.h>
 #include <erd/erd.hpp>
+#include <erd/sampler.hpp>
 
+#include <algorithm>
+#include <array>
 #include <cassert>
 #include <cstring>
 #include <string_view>
+#include <thread>
+#include <vector>
 
 namespace {
 
@@ -55,6 +60,40 @@ erd_status_t default_exception_handler(erd_error_descriptor_t *ed) noexcept {
   }
 }
 
+erd_status_t read_error(erd_error_descriptor_t *ed, std::error_code ec) {
+  erd::default_error_handler("Error obtaining readings", ec);
+  if (ec.category() == std::system_category()) {
+    return system_error(ed, ec.message());
+  }
+  return generic_error(ed, ec.message());
+}
+
+// columns are converted to readings a block at a time on the stack, so the
+// batch kernels run on them without allocating; consecutive blocks share a
+// sample, so func receives every consecutive pair once
+constexpr size_t block_size = 256;
+
+template <typename Func>
+void for_each_block(const int64_t *time, const uint64_t *energy, size_t count,
+                    Func &&func) noexcept {
+  std::array<erd::readings_t, block_size> block;
+  for (size_t first = 0; first + 1 < count; first += block_size - 1) {
+    size_t n = std::min(block_size, count - first);
+    for (size_t i = 0; i < n; i++) {
+      block[i] = {erd::time_point_t{erd::clock_t::duration{time[first + i]}},
+                  erd::energy_t{energy[first + i]}};
+    }
+    func(block.data(), n, first);
+  }
+}
+
+erd::readings_t to_readings(const erd_readings_t &from) noexcept {
+  return {erd::time_point_t{erd::clock_t::duration{from.time}},
+          erd::energy_t{from.energy}};
+}
+
+using group_t = std::vector<erd::reader_t>;
+
 } // namespace
 
 erd_status_t erd_attr_create(erd_attr_t *attr, erd_error_descriptor_t *ed) {
@@ -121,11 +160,7 @@ erd_status_t erd_obtain_readings(erd_handle_t handle, erd_readings_t *into,
     const erd::reader_t &reader = *reinterpret_cast<erd::reader_t *>(handle);
     erd::readings_t readings;
     if (std::error_code ec; !reader.obtain_readings(readings, ec)) {
-      erd::default_error_handler("Error obtaining readings", ec);
-      if (ec.category() == std::system_category()) {
-        return system_error(ed, ec.message());
-      }
-      return generic_error(ed, ec.message());
+      return read_error(ed, ec);
     }
     into->time = readings.timestamp.time_since_epoch().count();
     into->energy = readings.energy.count();
@@ -143,11 +178,8 @@ erd_status_t erd_subtract_readings(erd_handle_t handle,
                                    erd_readings_t *result) {
   try {
     const erd::reader_t &reader = *reinterpret_cast<erd::reader_t *>(handle);
-    erd::readings_t left{erd::time_point_t{erd::clock_t::duration{lhs->time}},
-                         erd::energy_t{lhs->energy}};
-    erd::readings_t right{erd::time_point_t{erd::clock_t::duration{rhs->time}},
-                          erd::energy_t{rhs->energy}};
-    erd::difference_t diff = reader.subtract(left, right);
+    erd::difference_t diff =
+        reader.subtract(to_readings(*lhs), to_readings(*rhs));
     result->time = diff.duration.count();
     result->energy = diff.energy_consumed.count();
     result->tunit = ERD_NANOSECOND;
@@ -157,3 +189,286 @@ erd_status_t erd_subtract_readings(erd_handle_t handle,
   }
   return ERD_SUCCESS;
 }
+
+erd_status_t erd_sample_n(erd_handle_t handle, int64_t period_ns, size_t count,
+                          int64_t *time, uint64_t *energy, size_t *taken,
+                          erd_error_descriptor_t *ed) {
+  if (taken) {
+    *taken = 0;
+  }
+  if (period_ns < 0) {
+    fill_error_descriptor(ed, "Negative period");
+    return ERD_INVALID_ARGUMENT;
+  }
+  try {
+    const erd::reader_t &reader = *reinterpret_cast<erd::reader_t *>(handle);
+    std::chrono::nanoseconds period{period_ns};
+    erd::time_point_t next = erd::clock_t::now();
+    for (size_t i = 0; i < count; i++) {
+      if (i && period.count()) {
+        // skip the periods missed instead of sampling in bursts to catch up
+        next += std::chrono::duration_cast<erd::clock_t::duration>(period);
+        if (erd::time_point_t now = erd::clock_t::now(); next < now) {
+          next = now;
+        }
+        std::this_thread::sleep_until(next);
+      }
+      erd::readings_t readings;
+      if (std::error_code ec; !reader.obtain_readings(readings, ec)) {
+        return read_error(ed, ec);
+      }
+      time[i] = readings.timestamp.time_since_epoch().count();
+      energy[i] = readings.energy.count();
+      if (taken) {
+        *taken = i + 1;
+      }
+    }
+  } catch (...) {
+    return default_exception_handler(ed);
+  }
+  return ERD_SUCCESS;
+}
+
+erd_status_t erd_obtain_readings_n(const erd_handle_t *handles, size_t count,
+                                   int64_t *time, uint64_t *energy,
+                                   erd_error_descriptor_t *ed) {
+  try {
+    for (size_t i = 0; i < count; i++) {
+      const erd::reader_t &reader =
+          *reinterpret_cast<erd::reader_t *>(handles[i]);
+      erd::readings_t readings;
+      if (std::error_code ec; !reader.obtain_readings(readings, ec)) {
+        return read_error(ed, ec);
+      }
+      time[i] = readings.timestamp.time_since_epoch().count();
+      energy[i] = readings.energy.count();
+    }
+  } catch (...) {
+    return default_exception_handler(ed);
+  }
+  return ERD_SUCCESS;
+}
+
+erd_status_t erd_subtract_n(erd_handle_t handle, const int64_t *time,
+                            const uint64_t *energy, size_t count,
+                            int64_t *duration, uint64_t *consumed) {
+  const erd::reader_t &reader = *reinterpret_cast<erd::reader_t *>(handle);
+  std::array<erd::difference_t, block_size - 1> diffs;
+  for_each_block(time, energy, count,
+                 [&](const erd::readings_t *block, size_t n, size_t first) {
+                   reader.subtract_n(block, n, diffs.data());
+                   for (size_t i = 0; i + 1 < n; i++) {
+                     duration[first + i] = diffs[i].duration.count();
+                     consumed[first + i] = diffs[i].energy_consumed.count();
+                   }
+                 });
+  return ERD_SUCCESS;
+}
+
+erd_status_t erd_power_n(erd_handle_t handle, const int64_t *time,
+                         const uint64_t *energy, size_t count, double *watts) {
+  const erd::reader_t &reader = *reinterpret_cast<erd::reader_t *>(handle);
+  static_assert(sizeof(erd::watts<double>) == sizeof(double));
+  for_each_block(time, energy, count,
+                 [&](const erd::readings_t *block, size_t n, size_t first) {
+                   reader.power_series(
+                       block, n,
+                       reinterpret_cast<erd::watts<double> *>(watts + first));
+                 });
+  return ERD_SUCCESS;
+}
+
+erd_status_t erd_sampler_create(erd_sampler_t *sampler, erd_handle_t handle,
+                                int64_t period_ns, size_t capacity,
+                                erd_error_descriptor_t *ed) {
+  if (period_ns <= 0 || !capacity) {
+    fill_error_descriptor(ed, "Period and capacity must be positive");
+    return ERD_INVALID_ARGUMENT;
+  }
+  try {
+    const erd::reader_t &reader = *reinterpret_cast<erd::reader_t *>(handle);
+    auto period = std::chrono::duration_cast<erd::clock_t::duration>(
+        std::chrono::nanoseconds{period_ns});
+    *sampler = reinterpret_cast<erd_sampler_t>(
+        new erd::sampler_t{reader, period, capacity});
+  } catch (...) {
+    return default_exception_handler(ed);
+  }
+  return ERD_SUCCESS;
+}
+
+erd_status_t erd_sampler_destroy(erd_sampler_t sampler) {
+  if (sampler)
+    delete reinterpret_cast<erd::sampler_t *>(sampler);
+  return ERD_SUCCESS;
+}
+
+erd_status_t erd_sampler_stop(erd_sampler_t sampler) {
+  reinterpret_cast<erd::sampler_t *>(sampler)->stop();
+  return ERD_SUCCESS;
+}
+
+erd_status_t erd_sampler_drain(erd_sampler_t sampler, uint64_t *cursor,
+                               int64_t *time, uint64_t *energy, size_t size,
+                               size_t *count) {
+  const erd::sampler_t &s = *reinterpret_cast<erd::sampler_t *>(sampler);
+  std::array<erd::readings_t, block_size> block;
+  size_t total = 0;
+  while (total < size) {
+    size_t n = s.drain(*cursor, block.data(), 0,
+                       std::min(block_size, size - total));
+    if (!n) {
+      break;
+    }
+    for (size_t i = 0; i < n; i++) {
+      time[total + i] = block[i].timestamp.time_since_epoch().count();
+      energy[total + i] = block[i].energy.count();
+    }
+    total += n;
+  }
+  *count = total;
+  return ERD_SUCCESS;
+}
+
+erd_status_t erd_sampler_available(erd_sampler_t sampler, uint64_t cursor,
+                                   size_t *count) {
+  const erd::sampler_t::buffer_t &buffer =
+      reinterpret_cast<erd::sampler_t *>(sampler)->buffer();
+  std::uint64_t pending = buffer.head() - std::min(cursor, buffer.head());
+  *count = static_cast<size_t>(
+      std::min<std::uint64_t>(pending, buffer.capacity()));
+  return ERD_SUCCESS;
+}
+
+erd_status_t erd_sampler_errors(erd_sampler_t sampler, uint64_t *errors) {
+  *errors = reinterpret_cast<erd::sampler_t *>(sampler)->errors();
+  return ERD_SUCCESS;
+}
+
+erd_status_t erd_group_create(erd_group_t *group, erd_error_descriptor_t *ed) {
+  try {
+    *group = reinterpret_cast<erd_group_t>(new group_t{});
+  } catch (...) {
+    return alloc_error(ed, "Error allocating memory for group");
+  }
+  return ERD_SUCCESS;
+}
+
+erd_status_t erd_group_destroy(erd_group_t group) {
+  if (group)
+    delete reinterpret_cast<group_t *>(group);
+  return ERD_SUCCESS;
+}
+
+erd_status_t erd_group_add(erd_group_t group, erd_handle_t handle,
+                           erd_error_descriptor_t *ed) {
+  try {
+    reinterpret_cast<group_t *>(group)->push_back(
+        *reinterpret_cast<erd::reader_t *>(handle));
+  } catch (...) {
+    return default_exception_handler(ed);
+  }
+  return ERD_SUCCESS;
+}
+
+erd_status_t erd_group_size(erd_group_t group, size_t *size) {
+  *size = reinterpret_cast<group_t *>(group)->size();
+  return ERD_SUCCESS;
+}
+
+erd_status_t erd_group_obtain_readings(erd_group_t group, erd_readings_t *out,
+                                       size_t n, erd_error_descriptor_t *ed) {
+  const group_t &readers = *reinterpret_cast<group_t *>(group);
+  if (n != readers.size()) {
+    fill_error_descriptor(ed, "Size does not match the group");
+    return ERD_INVALID_ARGUMENT;
+  }
+  try {
+    for (size_t i = 0; i < n; i++) {
+      erd::readings_t readings;
+      if (std::error_code ec; !readers[i].obtain_readings(readings, ec)) {
+        return read_error(ed, ec);
+      }
+      out[i].time = readings.timestamp.time_since_epoch().count();
+      out[i].energy = readings.energy.count();
+      out[i].tunit = ERD_NANOSECOND;
+      out[i].eunit = ERD_MICROJOULE;
+    }
+  } catch (...) {
+    return default_exception_handler(ed);
+  }
+  return ERD_SUCCESS;
+}
+
+erd_status_t erd_group_subtract_n(erd_group_t group, const erd_readings_t *lhs,
+                                  const erd_readings_t *rhs,
+                                  erd_readings_t *out, size_t n) {
+  const group_t &readers = *reinterpret_cast<group_t *>(group);
+  if (n != readers.size()) {
+    return ERD_INVALID_ARGUMENT;
+  }
+  for (size_t i = 0; i < n; i++) {
+    erd::difference_t diff =
+        readers[i].subtract(to_readings(lhs[i]), to_readings(rhs[i]));
+    out[i].time = diff.duration.count();
+    out[i].energy = diff.energy_consumed.count();
+    out[i].tunit = ERD_NANOSECOND;
+    out[i].eunit = ERD_MICROJOULE;
+  }
+  return ERD_SUCCESS;
+}
+
+erd_status_t erd_stats_enable(int enable) {
+  erd::metrics_t::enable(enable != 0);
+  return ERD_SUCCESS;
+}
+
+erd_status_t erd_stats_get(erd_metric_t metric, erd_stats_t *into,
+                           erd_error_descriptor_t *ed) {
+  if (metric < ERD_METRIC_READ || metric > ERD_METRIC_STALENESS) {
+    fill_error_descriptor(ed, "Invalid metric");
+    return ERD_INVALID_ARGUMENT;
+  }
+  try {
+    erd::stats_t stats = erd::metrics_t::instance().snapshot();
+    auto m = static_cast<erd::metric_t>(metric);
+    const erd::histogram_t &h = stats.histogram(m);
+    into->count = h.count();
+    into->errors = stats.error_count(m);
+    into->min = h.min();
+    into->max = h.max();
+    into->mean = h.mean();
+    into->p50 = h.percentile(0.5);
+    into->p90 = h.percentile(0.9);
+    into->p99 = h.percentile(0.99);
+    into->p999 = h.percentile(0.999);
+  } catch (...) {
+    return default_exception_handler(ed);
+  }
+  return ERD_SUCCESS;
+}
+
+erd_status_t erd_stats_reset(void) {
+  erd::metrics_t::instance().reset();
+  return ERD_SUCCESS;
+}
+
+erd_status_t erd_set_clock(erd_clock_t clock, erd_error_descriptor_t *ed) {
+  erd::clock_source_t source;
+  switch (clock) {
+  case ERD_CLOCK_STANDARD:
+    source = erd::clock_source_t::standard;
+    break;
+  case ERD_CLOCK_TSC:
+    source = erd::clock_source_t::tsc;
+    break;
+  default:
+    fill_error_descriptor(ed, "Invalid clock");
+    return ERD_INVALID_ARGUMENT;
+  }
+  std::error_code ec;
+  if (!erd::set_clock_source(source, ec)) {
+    return system_error(ed, ec.message());
+  }
+  return ERD_SUCCESS;
+}
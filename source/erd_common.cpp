@@ -33,4 +33,16 @@ void default_error_handler(const char *msg, std::error_code ec) noexcept {
   return default_error_handler_v(msg, std::move(ec));
 }
 
+std::vector<attributes_t> make_attributes(const std::vector<uint32_t> &sockets,
+                                          const std::vector<domain_t> &domains) {
+  std::vector<attributes_t> retval;
+  retval.reserve(sockets.size() * domains.size());
+  for (uint32_t socket : sockets) {
+    for (domain_t domain : domains) {
+      retval.push_back(attributes_t{domain, socket});
+    }
+  }
+  return retval;
+}
+
 }
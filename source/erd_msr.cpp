@@ -0,0 +1,189 @@
+#include <erd/erd_msr.hpp>
+#include <erd/clock.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <iterator>
+
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+namespace {
+
+constexpr uint32_t MSR_RAPL_POWER_UNIT = 0x606;
+constexpr uint32_t MSR_PKG_ENERGY_STATUS = 0x611;
+constexpr uint32_t MSR_DRAM_ENERGY_STATUS = 0x619;
+constexpr uint32_t MSR_PP0_ENERGY_STATUS = 0x639;
+constexpr uint32_t MSR_PP1_ENERGY_STATUS = 0x641;
+
+// bits 12:8 of MSR_RAPL_POWER_UNIT; a count is 1/2^ESU joules
+constexpr uint32_t ENERGY_UNIT_SHIFT = 8;
+constexpr uint64_t ENERGY_UNIT_MASK = 0x1f;
+
+// Haswell-EP and later server parts count DRAM energy in 2^-16 J whatever
+// MSR_RAPL_POWER_UNIT says
+constexpr uint32_t SERVER_DRAM_ENERGY_UNIT = 16;
+constexpr uint32_t SERVER_DRAM_MODELS[] = {
+    0x3f, // Haswell-X
+    0x4f, // Broadwell-X
+    0x56, // Broadwell-D
+    0x55, // Skylake-X, Cascade Lake-X, Cooper Lake-X
+    0x57, // Xeon Phi Knights Landing
+    0x85, // Xeon Phi Knights Mill
+    0x6a, // Ice Lake-X
+    0x6c, // Ice Lake-D
+    0x8f, // Sapphire Rapids-X
+    0xcf, // Emerald Rapids-X
+    0xad, // Granite Rapids-X
+    0xae, // Granite Rapids-D
+    0xaf, // Sierra Forest-X
+};
+
+constexpr uint64_t COUNTER_RANGE = uint64_t(1) << 32;
+constexpr uint64_t MICROJOULES_PER_JOULE = 1000000;
+
+std::error_code get_errno() noexcept {
+  return std::error_code{errno, std::system_category()};
+}
+
+bool read_register(const erd::detail::file_descriptor &fd, uint32_t reg,
+                   uint64_t &into, std::error_code &ec) noexcept {
+  ssize_t ret = pread(int(fd), &into, sizeof(into), reg);
+  if (ret == -1) {
+    ec = get_errno();
+    return false;
+  }
+  if (ret != sizeof(into)) {
+    ec = std::make_error_code(std::errc::io_error);
+    return false;
+  }
+  ec.clear();
+  return true;
+}
+
+uint32_t get_status_register(erd::domain_t domain) {
+  switch (domain) {
+  case erd::domain_t::package:
+    return MSR_PKG_ENERGY_STATUS;
+  case erd::domain_t::cores:
+    return MSR_PP0_ENERGY_STATUS;
+  case erd::domain_t::uncore:
+    return MSR_PP1_ENERGY_STATUS;
+  case erd::domain_t::dram:
+    return MSR_DRAM_ENERGY_STATUS;
+  }
+  throw std::system_error(std::make_error_code(std::errc::invalid_argument),
+                          "Unknown domain");
+}
+
+std::string get_msr_device(uint32_t socket) {
+  char filename[128];
+  for (int i = 0;; i++) {
+    snprintf(filename, sizeof(filename),
+             "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", i);
+    if (access(filename, F_OK))
+      break;
+    FILE *file = fopen(filename, "r");
+    if (!file)
+      throw std::system_error(get_errno());
+    unsigned pkg;
+    int matched = fscanf(file, "%u", &pkg);
+    fclose(file);
+    if (matched == 1 && pkg == socket) {
+      snprintf(filename, sizeof(filename), "/dev/cpu/%d/msr", i);
+      return filename;
+    }
+  }
+  throw std::system_error(std::make_error_code(std::errc::no_such_device),
+                          "No CPU found in socket");
+}
+
+uint32_t get_energy_unit(const erd::detail::file_descriptor &fd,
+                         erd::domain_t domain, uint32_t cpu_model) {
+  if (domain == erd::domain_t::dram &&
+      std::find(std::begin(SERVER_DRAM_MODELS), std::end(SERVER_DRAM_MODELS),
+                cpu_model) != std::end(SERVER_DRAM_MODELS)) {
+    return SERVER_DRAM_ENERGY_UNIT;
+  }
+  uint64_t value;
+  if (std::error_code ec; !read_register(fd, MSR_RAPL_POWER_UNIT, value, ec))
+    throw std::system_error(ec, "Error reading MSR_RAPL_POWER_UNIT");
+  return static_cast<uint32_t>((value >> ENERGY_UNIT_SHIFT) & ENERGY_UNIT_MASK);
+}
+
+// the product stays below 2^52, since counts are below 2^32, but the result
+// is floored to whole microjoules, so it is up to 1 uJ short
+erd::energy_t to_microjoules(uint64_t count, uint32_t unit) noexcept {
+  return erd::energy_t{(count * MICROJOULES_PER_JOULE) >> unit};
+}
+
+} // namespace
+
+namespace erd {
+
+namespace detail {
+
+std::uint32_t intel_cpu_model() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+  unsigned eax, ebx, ecx, edx;
+  // "GenuineIntel", split across ebx, edx and ecx
+  if (!__get_cpuid(0, &eax, &ebx, &ecx, &edx) || ebx != 0x756e6547 ||
+      edx != 0x49656e69 || ecx != 0x6c65746e ||
+      !__get_cpuid(1, &eax, &ebx, &ecx, &edx) || ((eax >> 8) & 0xf) != 6) {
+    return 0;
+  }
+  return ((eax >> 4) & 0xf) | ((eax >> 12) & 0xf0);
+#else
+  return 0;
+#endif
+}
+
+} // namespace detail
+
+msr_reader_t::msr_reader_t(attributes_t attr)
+    : msr_reader_t(attr, get_msr_device(attr.socket)) {}
+
+msr_reader_t::msr_reader_t(attributes_t attr, const std::string &device,
+                           std::uint32_t cpu_model)
+    : attr_(attr), device_(device),
+      status_register_(get_status_register(attr.domain)),
+      energy_unit_(get_energy_unit(device_, attr.domain, cpu_model)),
+      maxvalue_(to_microjoules(COUNTER_RANGE, energy_unit_)) {
+  // a domain the part lacks, such as PP1 on servers or DRAM on client parts,
+  // fails here rather than on every read, so that the registry moves on
+  uint64_t value;
+  if (std::error_code ec; !read_register(device_, status_register_, value, ec))
+    throw std::system_error(ec, "Error reading the energy status register");
+}
+
+bool msr_reader_t::obtain_readings(readings_t &into,
+                                   std::error_code &ec) const noexcept {
+  uint64_t value;
+  if (!read_register(device_, status_register_, value, ec)) {
+    return false;
+  }
+  // the upper half of the register is reserved
+  into.timestamp = now();
+  into.energy = to_microjoules(value & (COUNTER_RANGE - 1), energy_unit_);
+  return true;
+}
+
+// both readings and maxvalue_ are floored, so a difference is off by up to
+// 1 uJ, and by up to 2 uJ when the counter wrapped
+difference_t msr_reader_t::subtract(const readings_t &lhs,
+                                    const readings_t &rhs) const noexcept {
+  if (rhs.energy > lhs.energy) {
+    return difference_t{lhs.timestamp - rhs.timestamp,
+                        maxvalue_ + lhs.energy - rhs.energy};
+  }
+  return difference_t{lhs.timestamp - rhs.timestamp, lhs.energy - rhs.energy};
+}
+
+const attributes_t &msr_reader_t::attributes() const noexcept { return attr_; }
+
+energy_t msr_reader_t::max_energy() const noexcept { return maxvalue_; }
+
+} // namespace erd
@@ -1,24 +1,70 @@
 #include <erd/erd_nop.hpp>
+#include <erd/clock.hpp>
+
+#include <limits>
 
 namespace erd {
 
-reader_t::reader_t(attributes_t attr) : attr_(attr) {}
+nop_reader_t::nop_reader_t(attributes_t attr) : attr_(attr) {}
 
-bool reader_t::obtain_readings(readings_t &into,
-                               std::error_code &ec) const noexcept {
+bool nop_reader_t::obtain_readings(readings_t &into,
+                                   std::error_code &ec) const noexcept {
   // suppress "can be made static warning"
   (void)attr_;
-  into.timestamp = clock_t::now();
+  into.timestamp = now();
   into.energy = energy_t{};
+  ec.clear();
   return true;
 }
 
-difference_t reader_t::subtract(const readings_t &lhs,
-                                const readings_t &rhs) const noexcept {
+difference_t nop_reader_t::subtract(const readings_t &lhs,
+                                    const readings_t &rhs) const noexcept {
   (void)attr_;
   return difference_t{lhs.timestamp - rhs.timestamp, energy_t{}};
 }
 
-const attributes_t &reader_t::attributes() const noexcept { return attr_; }
+const attributes_t &nop_reader_t::attributes() const noexcept { return attr_; }
+
+energy_t nop_reader_t::max_energy() const noexcept {
+  (void)attr_;
+  return energy_t{std::numeric_limits<energy_t::rep>::max()};
+}
+
+nop_reader_set_t::nop_reader_set_t(std::vector<attributes_t> attrs)
+    : attrs_(std::move(attrs)) {}
+
+nop_reader_set_t::nop_reader_set_t(const std::vector<std::uint32_t> &sockets,
+                                   const std::vector<domain_t> &domains)
+    : nop_reader_set_t(make_attributes(sockets, domains)) {}
+
+bool nop_reader_set_t::obtain_readings(readings_set_t &into,
+                                       std::error_code &ec) const noexcept {
+  try {
+    into.energy.assign(attrs_.size(), energy_t{});
+  } catch (const std::bad_alloc &) {
+    ec = std::make_error_code(std::errc::not_enough_memory);
+    return false;
+  }
+  into.begin = now();
+  into.end = into.begin;
+  ec.clear();
+  return true;
+}
+
+difference_t nop_reader_set_t::subtract(std::size_t idx,
+                                        const readings_set_t &lhs,
+                                        const readings_set_t &rhs) const
+    noexcept {
+  (void)idx;
+  (void)attrs_;
+  return difference_t{lhs.end - rhs.end, energy_t{}};
+}
+
+std::size_t nop_reader_set_t::size() const noexcept { return attrs_.size(); }
+
+const std::vector<attributes_t> &
+nop_reader_set_t::attributes() const noexcept {
+  return attrs_;
+}
 
 } // namespace erd
@@ -1,21 +1,26 @@
+#include <erd/clock.hpp>
 #include <erd/erd_powercap.hpp>
+#include <erd/topology.hpp>
 #include <fmt/format.h>
 
+#include <algorithm>
+#include <atomic>
 #include <charconv>
-#include <fstream>
-#include <iostream>
-#include <set>
+#include <cstdlib>
+#include <cstring>
 #include <utility>
 
 #include <fcntl.h>
 #include <unistd.h>
 
-namespace {
+#if defined(ERD_IO_URING)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
 
-constexpr char DOMAIN_PKG_PREFIX[] = "package";
-constexpr char DOMAIN_PP0[] = "core";
-constexpr char DOMAIN_PP1[] = "uncore";
-constexpr char DOMAIN_DRAM[] = "dram";
+namespace {
 
 std::error_code get_errno() noexcept {
   return std::error_code{errno, std::system_category()};
@@ -29,276 +34,526 @@ ssize_t read_buff(int fd, char *buffer, size_t buffsz) noexcept {
   return ret;
 }
 
+constexpr size_t MAX_UINT64_SZ = 24;
+
+bool parse_uint64(const char *buffer, size_t size, uint64_t &into,
+                  std::error_code &ec) noexcept {
+  auto [ptr, errcode] = std::from_chars(buffer, buffer + size, into);
+  if (ec = std::make_error_code(errcode); ec) {
+    return false;
+  }
+  ec.clear();
+  return true;
+}
+
 bool read_uint64(const erd::detail::file_descriptor &fd, uint64_t &into,
                  std::error_code &ec) noexcept {
-  constexpr size_t MAX_UINT64_SZ = 24;
   char buffer[MAX_UINT64_SZ];
   ssize_t bytes_read = read_buff(int(fd), buffer, MAX_UINT64_SZ);
   if (bytes_read <= 0) {
     ec = get_errno();
     return false;
   }
-  auto [ptr, errcode] = std::from_chars(buffer, buffer + bytes_read, into);
-  if (ec = std::make_error_code(errcode); ec) {
-    return false;
+  return parse_uint64(buffer, bytes_read, into, ec);
+}
+
+const erd::zone_t &get_zone(const erd::attributes_t &attr) {
+  const erd::topology_t &topology = erd::topology_t::instance();
+  if (attr.socket >= topology.sockets()) {
+    auto ec = std::make_error_code(std::errc::invalid_argument);
+    erd::default_error_handler(
+        fmt::format("System has {} sockets but socket {} in argument",
+                    topology.sockets(), attr.socket)
+            .c_str(),
+        ec);
+    throw std::system_error(ec);
   }
-  ec.clear();
-  return true;
+  const erd::zone_t *zone = topology.find(attr);
+  if (!zone) {
+    auto ec = std::make_error_code(std::errc::invalid_argument);
+    erd::default_error_handler(
+        fmt::format("No valid domain was found for socket {}", attr.socket)
+            .c_str(),
+        ec);
+    throw std::system_error(ec);
+  }
+  erd::default_output(
+      fmt::format("Found domain {} of socket {}", zone->path, attr.socket)
+          .c_str());
+  return *zone;
 }
 
-bool file_exists(std::string_view path) noexcept {
-  return !access(path.data(), F_OK);
+erd::detail::file_descriptor get_sensor_fd(const std::string &prefix) {
+  return erd::detail::file_descriptor{prefix + "/energy_uj"};
 }
 
-bool count_sockets(uint32_t &into, std::error_code &ec) {
-  char filename[128];
-  std::set<uint32_t> packages;
-  for (int i = 0;; i++) {
-    snprintf(filename, sizeof(filename),
-             "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", i);
-    if (!file_exists(filename))
-      break;
-    uint64_t pkg;
-    if (!read_uint64(erd::detail::file_descriptor{filename}, pkg, ec)) {
-      return false;
-    }
-    packages.insert(static_cast<uint32_t>(pkg));
-  };
-  ec.clear();
-  into = static_cast<uint32_t>(packages.size());
-  return true;
+// the counters of the dies of a package wrap around at the same value, so
+// their sum modulo it wraps around like a single counter
+erd::energy_t add_wrapped(erd::energy_t lhs, erd::energy_t rhs,
+                          erd::energy_t maxvalue) noexcept {
+  if (!maxvalue.count()) {
+    return lhs + rhs;
+  }
+  return erd::energy_t{(lhs.count() + rhs.count()) % maxvalue.count()};
 }
 
-bool is_package_domain(const char *name) noexcept {
-  return !std::strncmp(DOMAIN_PKG_PREFIX, name, sizeof(DOMAIN_PKG_PREFIX) - 1);
+std::vector<erd::detail::file_descriptor>
+get_die_sensor_fds(const erd::zone_t &zone) {
+  std::vector<erd::detail::file_descriptor> retval;
+  retval.reserve(zone.dies.size());
+  for (const std::string &die : zone.dies) {
+    retval.push_back(get_sensor_fd(die));
+  }
+  return retval;
 }
 
-bool domain_from_name(const char *name, erd::domain_t &into,
-                      std::error_code &ec) noexcept {
-  ec.clear();
-  if (is_package_domain(name)) {
-    into = erd::domain_t::package;
-  } else if (!std::strncmp(DOMAIN_PP0, name, sizeof(DOMAIN_PP0) - 1)) {
-    into = erd::domain_t::cores;
-  } else if (!std::strncmp(DOMAIN_PP1, name, sizeof(DOMAIN_PP1) - 1)) {
-    into = erd::domain_t::uncore;
-  } else if (!std::strncmp(DOMAIN_DRAM, name, sizeof(DOMAIN_DRAM) - 1)) {
-    into = erd::domain_t::dram;
-  } else {
-    ec = std::make_error_code(std::errc::invalid_argument);
+erd::difference_t subtract_wrapped(const erd::readings_t &lhs,
+                                   const erd::readings_t &rhs,
+                                   erd::energy_t maxvalue) noexcept {
+  // potential overflow occured
+  if (rhs.energy > lhs.energy) {
+    erd::energy_t new_energy = maxvalue + lhs.energy;
+    return erd::difference_t{lhs.timestamp - rhs.timestamp,
+                             new_energy - rhs.energy};
   }
-  if (ec) {
-    erd::default_error_handler("No domain name matches available matches", ec);
-    return false;
+  return erd::difference_t{lhs.timestamp - rhs.timestamp,
+                           lhs.energy - rhs.energy};
+}
+
+std::vector<const erd::zone_t *>
+get_zones(const std::vector<erd::attributes_t> &attrs) {
+  std::vector<const erd::zone_t *> retval;
+  retval.reserve(attrs.size());
+  for (const erd::attributes_t &attr : attrs) {
+    retval.push_back(&get_zone(attr));
   }
-  return true;
+  return retval;
 }
 
-bool domain_from_path(const char *prefix, erd::domain_t &into,
-                      std::error_code &ec) {
-  // open the <prefix>/name file, read the name and obtain the domain
-  char name[32];
-  char filename[128];
-  snprintf(filename, sizeof(filename), "%s/name", prefix);
-  erd::detail::file_descriptor fd{filename};
+// the file of each zone, followed by those of its other dies
+std::vector<erd::detail::file_descriptor>
+get_sensor_fds(const std::vector<const erd::zone_t *> &zones) {
+  std::vector<erd::detail::file_descriptor> retval;
+  retval.reserve(zones.size());
+  for (const erd::zone_t *zone : zones) {
+    retval.push_back(get_sensor_fd(zone->path));
+    for (const std::string &die : zone->dies) {
+      retval.push_back(get_sensor_fd(die));
+    }
+  }
+  return retval;
+}
 
-  if (read_buff(int(fd), name, sizeof(name)) < 0) {
-    ec = get_errno();
-    return false;
+std::vector<std::size_t>
+get_sensor_counts(const std::vector<const erd::zone_t *> &zones) {
+  std::vector<std::size_t> retval;
+  retval.reserve(zones.size());
+  for (const erd::zone_t *zone : zones) {
+    retval.push_back(1 + zone->dies.size());
   }
-  if (!domain_from_name(name, into, ec)) {
+  return retval;
+}
+
+std::vector<erd::energy_t>
+get_sensor_max_values(const std::vector<const erd::zone_t *> &zones) {
+  std::vector<erd::energy_t> retval;
+  retval.reserve(zones.size());
+  for (const erd::zone_t *zone : zones) {
+    retval.push_back(zone->max_energy);
+  }
+  return retval;
+}
+
+#if defined(ERD_IO_URING)
+bool io_uring_disabled() noexcept {
+  const char *env = std::getenv("ERD_IO_URING");
+  return env && !std::strcmp(env, "0");
+}
+#endif
+
+bool resize_energy(std::vector<erd::energy_t> &energy, size_t size,
+                   std::error_code &ec) noexcept {
+  if (energy.size() == size)
+    return true;
+  try {
+    energy.resize(size);
+  } catch (const std::bad_alloc &) {
+    ec = std::make_error_code(std::errc::not_enough_memory);
     return false;
   }
-  ec.clear();
   return true;
 }
 
-bool get_package_number(const char *base, uint32_t &into, std::error_code &ec) {
-  char name[32];
-  char filename[128];
-  // read the <domain>/name content
-  snprintf(filename, sizeof(filename), "%s/name", base);
-  erd::detail::file_descriptor fd{filename};
-  ssize_t namelen = read_buff(int(fd), name, sizeof(name));
-  if (namelen < 0) {
+} // namespace
+
+namespace erd::detail {
+
+#if defined(ERD_IO_URING)
+
+// minimal io_uring instance, without liburing: every file is registered and
+// read into its own slot of a single registered buffer
+struct batch_reader::ring {
+  static constexpr size_t slot_size = MAX_UINT64_SZ;
+
+  int fd = -1;
+  unsigned count = 0;
+  void *sq_ptr = MAP_FAILED;
+  size_t sq_size = 0;
+  void *cq_ptr = MAP_FAILED;
+  size_t cq_size = 0;
+  io_uring_sqe *sqes = static_cast<io_uring_sqe *>(MAP_FAILED);
+  size_t sqes_size = 0;
+
+  unsigned *sq_head = nullptr;
+  unsigned *sq_tail = nullptr;
+  unsigned *sq_mask = nullptr;
+  unsigned *sq_array = nullptr;
+  unsigned *cq_head = nullptr;
+  unsigned *cq_tail = nullptr;
+  unsigned *cq_mask = nullptr;
+  io_uring_cqe *cqes = nullptr;
+
+  std::unique_ptr<char[]> buffer;
+
+  // set once a system call fails, since the completions of the batch may then
+  // still arrive and be taken by the next one for its own; the ring is not
+  // used again
+  std::atomic<bool> broken{false};
+
+  ring(const std::vector<file_descriptor> &fds, std::error_code &ec) noexcept;
+  ~ring() noexcept;
+
+  ring(const ring &) = delete;
+  ring &operator=(const ring &) = delete;
+
+  bool read(energy_t *into, std::error_code &ec) noexcept;
+  bool enter(unsigned min_complete, std::error_code &ec) noexcept;
+};
+
+batch_reader::ring::ring(const std::vector<file_descriptor> &fds,
+                         std::error_code &ec) noexcept {
+  io_uring_params params{};
+  count = static_cast<unsigned>(fds.size());
+  fd = static_cast<int>(syscall(__NR_io_uring_setup, count, &params));
+  if (fd < 0) {
     ec = get_errno();
-    return false;
+    return;
   }
-  // check whether the contents follow the package-<number> pattern
-  if (!is_package_domain(name)) {
-    ec = std::make_error_code(std::errc::invalid_argument);
-    erd::default_error_handler(
-        fmt::format("Domain {} does not point to a package domain", base)
-            .c_str(),
-        ec);
-    return false;
+
+  sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  if (params.features & IORING_FEAT_SINGLE_MMAP) {
+    sq_size = cq_size = std::max(sq_size, cq_size);
   }
-  // offset package- to point to the package number;
-  // null-terminator counts as the dash
-  const char *pkg_num_start = name + sizeof(DOMAIN_PKG_PREFIX);
-  auto [p, err] = std::from_chars(pkg_num_start, name + namelen, into, 10);
-  if (ec = std::make_error_code(err); ec) {
-    return false;
+  sq_ptr = mmap(nullptr, sq_size, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+  if (sq_ptr == MAP_FAILED) {
+    ec = get_errno();
+    return;
+  }
+  if (params.features & IORING_FEAT_SINGLE_MMAP) {
+    cq_ptr = sq_ptr;
+  } else {
+    cq_ptr = mmap(nullptr, cq_size, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    if (cq_ptr == MAP_FAILED) {
+      ec = get_errno();
+      return;
+    }
+  }
+  sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+  sqes = static_cast<io_uring_sqe *>(mmap(nullptr, sqes_size,
+                                          PROT_READ | PROT_WRITE,
+                                          MAP_SHARED | MAP_POPULATE, fd,
+                                          IORING_OFF_SQES));
+  if (sqes == MAP_FAILED) {
+    ec = get_errno();
+    return;
+  }
+
+  char *sq = static_cast<char *>(sq_ptr);
+  char *cq = static_cast<char *>(cq_ptr);
+  sq_head = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+  sq_tail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+  sq_mask = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+  sq_array = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+  cq_head = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+  cq_tail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+  cq_mask = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+  cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+
+  std::vector<int> raw_fds;
+  try {
+    buffer = std::make_unique<char[]>(count * slot_size);
+    raw_fds.reserve(count);
+  } catch (const std::bad_alloc &) {
+    ec = std::make_error_code(std::errc::not_enough_memory);
+    return;
+  }
+  for (const file_descriptor &f : fds) {
+    raw_fds.push_back(int(f));
+  }
+  if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_FILES,
+              raw_fds.data(), count) < 0) {
+    ec = get_errno();
+    return;
+  }
+  iovec iov{buffer.get(), count * slot_size};
+  if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_BUFFERS, &iov, 1) <
+      0) {
+    ec = get_errno();
+    return;
   }
   ec.clear();
-  return true;
 }
 
-bool get_sensor_file_prefix(const erd::attributes_t &attr, char *path,
-                            size_t sz, std::error_code &ec) {
-  uint32_t num_sockets;
-  if (!count_sockets(num_sockets, ec)) {
-    return false;
+batch_reader::ring::~ring() noexcept {
+  if (sqes != MAP_FAILED)
+    munmap(sqes, sqes_size);
+  if (cq_ptr != MAP_FAILED && cq_ptr != sq_ptr)
+    munmap(cq_ptr, cq_size);
+  if (sq_ptr != MAP_FAILED)
+    munmap(sq_ptr, sq_size);
+  if (fd >= 0 && close(fd) == -1)
+    perror("batch_reader: error closing io_uring");
+}
+
+bool batch_reader::ring::read(energy_t *into, std::error_code &ec) noexcept {
+  // the ring was sized for all files, so every submission fits at once
+  unsigned tail = *sq_tail;
+  for (unsigned i = 0; i < count; i++) {
+    unsigned idx = (tail + i) & *sq_mask;
+    io_uring_sqe &sqe = sqes[idx];
+    sqe = io_uring_sqe{};
+    sqe.opcode = IORING_OP_READ_FIXED;
+    sqe.flags = IOSQE_FIXED_FILE;
+    sqe.fd = static_cast<int>(i);
+    sqe.addr = reinterpret_cast<uint64_t>(buffer.get() + i * slot_size);
+    sqe.len = slot_size - 1;
+    sqe.off = 0;
+    sqe.buf_index = 0;
+    sqe.user_data = i;
+    sq_array[idx] = idx;
   }
-  if (attr.socket >= num_sockets) {
-    ec = std::make_error_code(std::errc::invalid_argument);
-    erd::default_error_handler(
-        fmt::format("System has {} sockets but socket {} in argument",
-                    num_sockets, attr.socket)
-            .c_str(),
-        ec);
+  __atomic_store_n(sq_tail, tail + count, __ATOMIC_RELEASE);
+
+  if (!enter(count, ec)) {
     return false;
   }
-  for (uint32_t skt = 0; skt < num_sockets; skt++) {
-    int written =
-        snprintf(path, sz, "/sys/class/powercap/intel-rapl/intel-rapl:%u", skt);
-    if (file_exists(path)) {
-      uint32_t pkg_number;
-      if (!get_package_number(path, pkg_number, ec)) {
+
+  bool success = true;
+  unsigned completed = 0;
+  while (completed < count) {
+    unsigned head = *cq_head;
+    unsigned available = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE) - head;
+    if (!available) {
+      if (!enter(count - completed, ec)) {
         return false;
       }
-      if (pkg_number == attr.socket) {
-        if (attr.domain == erd::domain_t::package) {
-          erd::default_output(
-              fmt::format("Found domain {} of socket {}", path, pkg_number)
-                  .c_str());
-          return true;
-        }
-        for (uint32_t domain_count = 0;
-             domain_count < static_cast<uint32_t>(erd::domain_t::dram);
-             ++domain_count) {
-          snprintf(path + written, sz - written, "/intel-rapl:%u:%u", skt,
-                   domain_count);
-          if (file_exists(path)) {
-            if (erd::domain_t dmn; !domain_from_path(path, dmn, ec)) {
-              return false;
-            } else if (dmn == attr.domain) {
-              erd::default_output(
-                  fmt::format("Found domain {} of socket {}", path, pkg_number)
-                      .c_str());
-              return true;
-            }
-          }
-        }
-        ec = std::make_error_code(std::errc::invalid_argument);
-        erd::default_error_handler(
-            fmt::format("No valid domain was found for socket {}", pkg_number)
-                .c_str(),
-            ec);
-        return false;
+      continue;
+    }
+    for (unsigned i = 0; i < available; i++) {
+      const io_uring_cqe &cqe = cqes[(head + i) & *cq_mask];
+      if (!success) {
+        continue;
       }
+      if (cqe.res <= 0) {
+        ec = std::error_code{-cqe.res, std::system_category()};
+        success = false;
+        continue;
+      }
+      uint64_t value;
+      if (!parse_uint64(buffer.get() + cqe.user_data * slot_size,
+                        static_cast<size_t>(cqe.res), value, ec)) {
+        success = false;
+        continue;
+      }
+      into[cqe.user_data] = energy_t{value};
     }
+    completed += available;
+    __atomic_store_n(cq_head, head + available, __ATOMIC_RELEASE);
   }
-  ec = std::make_error_code(std::errc::invalid_argument);
-  erd::default_error_handler(
-      fmt::format("No matching socket found for {}", attr.socket).c_str(), ec);
-  return false;
+  return success;
 }
 
-std::string get_sensor_file_prefix(const erd::attributes_t &attr) {
-  char path[128];
-  if (std::error_code ec;
-      !get_sensor_file_prefix(attr, path, sizeof(path), ec)) {
-    throw std::system_error(ec);
-  }
-  return path;
-}
-
-uint64_t get_sensor_max_value(const std::string &prefix) {
-  erd::detail::file_descriptor fd{prefix + "/max_energy_range_uj"};
-  uint64_t value;
-  if (std::error_code ec; !read_uint64(fd, value, ec)) {
-    throw std::system_error(ec);
+// submits what the kernel has not consumed yet and waits for completions,
+// again when interrupted by a signal
+bool batch_reader::ring::enter(unsigned min_complete,
+                               std::error_code &ec) noexcept {
+  for (;;) {
+    unsigned pending =
+        *sq_tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+    if (syscall(__NR_io_uring_enter, fd, pending, min_complete,
+                IORING_ENTER_GETEVENTS, nullptr, 0) >= 0) {
+      return true;
+    }
+    if (errno != EINTR) {
+      ec = get_errno();
+      broken = true;
+      return false;
+    }
   }
-  return value;
 }
 
-erd::detail::file_descriptor get_sensor_fd(const std::string &prefix) {
-  return erd::detail::file_descriptor{prefix + "/energy_uj"};
-}
+#else
 
-} // namespace
+struct batch_reader::ring {
+  std::atomic<bool> broken{true};
 
-namespace erd::detail {
+  bool read(energy_t *, std::error_code &) noexcept { return false; }
+};
 
-file_descriptor::file_descriptor(const std::string &path)
-    : file_descriptor(path.c_str()) {}
+#endif // defined(ERD_IO_URING)
 
-file_descriptor::file_descriptor(const char *file)
-    : value_(open(file, O_RDONLY)) {
-  if (value_ == -1)
-    throw std::system_error(get_errno());
+batch_reader::batch_reader(std::vector<file_descriptor> fds)
+    : fds_(std::move(fds)) {
+#if defined(ERD_IO_URING)
+  if (fds_.empty() || io_uring_disabled())
+    return;
+  std::error_code ec;
+  auto r = std::make_unique<ring>(fds_, ec);
+  if (ec) {
+    erd::default_error_handler("io_uring unavailable, falling back to pread",
+                               ec);
+    return;
+  }
+  ring_ = std::move(r);
+  ring_mtx_ = std::make_unique<std::mutex>();
+#endif
 }
 
-file_descriptor::file_descriptor(const file_descriptor &other)
-    : value_(dup(other.value_)) {
-  if (value_ == -1)
-    throw std::system_error(get_errno());
-}
+batch_reader::~batch_reader() noexcept = default;
 
-file_descriptor::file_descriptor(file_descriptor &&other) noexcept
-    : value_(std::exchange(other.value_, -1)) {}
+batch_reader::batch_reader(batch_reader &&other) noexcept = default;
 
-file_descriptor &file_descriptor::operator=(const file_descriptor &other) {
-  *this = file_descriptor{other};
-  return *this;
-}
+batch_reader &batch_reader::operator=(batch_reader &&other) noexcept = default;
 
-file_descriptor::~file_descriptor() noexcept {
-  if (value_ >= 0 && close(value_) == -1)
-    perror("file_descriptor: error closing file");
+bool batch_reader::read(energy_t *into, std::error_code &ec) const noexcept {
+  // the ring cannot be shared by concurrent callers; a contended reader takes
+  // the pread path rather than waiting for the other batch to complete
+  if (uses_io_uring()) {
+    if (std::unique_lock lock{*ring_mtx_, std::try_to_lock}; lock) {
+      if (bool success = ring_->read(into, ec); success || !ring_->broken) {
+        return success;
+      }
+      erd::default_error_handler("io_uring failed, falling back to pread",
+                                 ec);
+    }
+  }
+  return read_sync(into, ec);
 }
 
-file_descriptor &file_descriptor::operator=(file_descriptor &&other) noexcept {
-  value_ = std::exchange(other.value_, -1);
-  return *this;
+bool batch_reader::read_sync(energy_t *into,
+                             std::error_code &ec) const noexcept {
+  for (size_t i = 0; i < fds_.size(); i++) {
+    uint64_t value;
+    if (!read_uint64(fds_[i], value, ec)) {
+      return false;
+    }
+    into[i] = energy_t{value};
+  }
+  return true;
 }
 
-file_descriptor::operator int() const noexcept { return value_; }
+std::size_t batch_reader::size() const noexcept { return fds_.size(); }
+
+bool batch_reader::uses_io_uring() const noexcept {
+  return ring_ && !ring_->broken;
+}
 
 } // namespace erd::detail
 
 namespace erd {
 
-reader_t::reader_t(attributes_t attr)
-    : reader_t(std::move(attr), get_sensor_file_prefix(attr)) {}
+powercap_reader_t::powercap_reader_t(attributes_t attr)
+    : powercap_reader_t(std::move(attr), get_zone(attr)) {}
 
-reader_t::reader_t(attributes_t &&attr, const std::string &prefix)
-    : attr_(std::move(attr)), sensor_(get_sensor_fd(prefix)),
-      maxvalue_(get_sensor_max_value(prefix)) {}
+powercap_reader_t::powercap_reader_t(attributes_t &&attr, const zone_t &zone)
+    : attr_(std::move(attr)), sensor_(get_sensor_fd(zone.path)),
+      dies_(get_die_sensor_fds(zone)), maxvalue_(zone.max_energy) {}
 
-bool reader_t::obtain_readings(readings_t &into,
-                               std::error_code &ec) const noexcept {
-  if (uint64_t energy_value; read_uint64(sensor_, energy_value, ec)) {
-    into.timestamp = clock_t::now();
-    into.energy = energy_t{energy_value};
-    return true;
+bool powercap_reader_t::obtain_readings(readings_t &into,
+                                        std::error_code &ec) const noexcept {
+  uint64_t energy_value;
+  if (!read_uint64(sensor_, energy_value, ec)) {
+    return false;
   }
-  return false;
+  energy_t energy{energy_value};
+  for (const detail::file_descriptor &die : dies_) {
+    if (!read_uint64(die, energy_value, ec)) {
+      return false;
+    }
+    energy = add_wrapped(energy, energy_t{energy_value}, maxvalue_);
+  }
+  into.timestamp = now();
+  into.energy = energy;
+  return true;
 }
 
-difference_t reader_t::subtract(const readings_t &lhs,
-                                const readings_t &rhs) const noexcept {
+difference_t powercap_reader_t::subtract(const readings_t &lhs,
+                                         const readings_t &rhs) const noexcept {
+  return subtract_wrapped(lhs, rhs, maxvalue_);
+}
 
-  // potential overflow occured
-  if (rhs.energy > lhs.energy) {
-    energy_t new_energy = maxvalue_ + lhs.energy;
-    return difference_t{lhs.timestamp - rhs.timestamp, new_energy - rhs.energy};
+const attributes_t &powercap_reader_t::attributes() const noexcept {
+  return attr_;
+}
+
+energy_t powercap_reader_t::max_energy() const noexcept { return maxvalue_; }
+
+powercap_reader_set_t::powercap_reader_set_t(std::vector<attributes_t> attrs)
+    : powercap_reader_set_t(std::move(attrs), get_zones(attrs)) {}
+
+powercap_reader_set_t::powercap_reader_set_t(
+    std::vector<attributes_t> &&attrs, const std::vector<const zone_t *> &zones)
+    : attrs_(std::move(attrs)), maxvalues_(get_sensor_max_values(zones)),
+      counts_(get_sensor_counts(zones)), sensors_(get_sensor_fds(zones)) {}
+
+powercap_reader_set_t::powercap_reader_set_t(
+    const std::vector<std::uint32_t> &sockets,
+    const std::vector<domain_t> &domains)
+    : powercap_reader_set_t(make_attributes(sockets, domains)) {}
+
+bool powercap_reader_set_t::obtain_readings(readings_set_t &into,
+                                            std::error_code &ec) const
+    noexcept {
+  if (!resize_energy(into.energy, sensors_.size(), ec)) {
+    return false;
+  }
+  into.begin = now();
+  if (!sensors_.read(into.energy.data(), ec)) {
+    return false;
   }
-  return difference_t{lhs.timestamp - rhs.timestamp, lhs.energy - rhs.energy};
+  into.end = now();
+  if (sensors_.size() > attrs_.size()) {
+    // the counters of the other dies of a zone follow its own
+    for (std::size_t i = 0, sensor = 0; i < attrs_.size(); i++) {
+      energy_t energy = into.energy[sensor++];
+      for (std::size_t die = 1; die < counts_[i]; die++) {
+        energy = add_wrapped(energy, into.energy[sensor++], maxvalues_[i]);
+      }
+      into.energy[i] = energy;
+    }
+    into.energy.resize(attrs_.size());
+  }
+  return true;
 }
 
-const attributes_t &reader_t::attributes() const noexcept { return attr_; }
+difference_t powercap_reader_set_t::subtract(std::size_t idx,
+                                             const readings_set_t &lhs,
+                                             const readings_set_t &rhs) const
+    noexcept {
+  return subtract_wrapped(lhs.readings(idx), rhs.readings(idx),
+                          maxvalues_[idx]);
+}
+
+std::size_t powercap_reader_set_t::size() const noexcept {
+  return attrs_.size();
+}
 
+const std::vector<attributes_t> &
+powercap_reader_set_t::attributes() const noexcept {
+  return attrs_;
+}
 
 } // namespace erd
@@ -0,0 +1,141 @@
+#include <erd/erd_sim.hpp>
+#include <erd/clock.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <string>
+#include <type_traits>
+
+namespace {
+
+// beyond this many pending updates, the bulk is applied at the mean power
+constexpr uint64_t MAX_SIMULATED_UPDATES = 100000;
+constexpr double MICROJOULES_PER_JOULE = 1e6;
+constexpr double TWO_PI = 6.283185307179586;
+
+template <typename T> void env_override(const char *name, T &value) {
+  const char *env = std::getenv(name);
+  if (!env || !*env) {
+    return;
+  }
+  try {
+    if constexpr (std::is_floating_point_v<T>) {
+      value = std::stod(env);
+    } else {
+      value = static_cast<T>(std::stoull(env));
+    }
+  } catch (const std::exception &) {
+    throw std::system_error(std::make_error_code(std::errc::invalid_argument),
+                            name);
+  }
+}
+
+double seconds(erd::clock_t::duration d) noexcept {
+  return std::chrono::duration<double>(d).count();
+}
+
+} // namespace
+
+namespace erd {
+
+sim_model_t sim_model_t::from_env() {
+  sim_model_t model;
+  env_override("ERD_SIM_POWER", model.power);
+  env_override("ERD_SIM_AMPLITUDE", model.amplitude);
+  env_override("ERD_SIM_NOISE", model.noise);
+  env_override("ERD_SIM_SEED", model.seed);
+  uint64_t period_ms = 0;
+  uint64_t granularity_us = 0;
+  uint64_t max_energy = 0;
+  env_override("ERD_SIM_PERIOD_MS", period_ms);
+  env_override("ERD_SIM_GRANULARITY_US", granularity_us);
+  env_override("ERD_SIM_MAX_ENERGY", max_energy);
+  if (period_ms) {
+    model.period = std::chrono::milliseconds(period_ms);
+  }
+  if (granularity_us) {
+    model.granularity = std::chrono::microseconds(granularity_us);
+  }
+  if (max_energy) {
+    model.max_energy = energy_t{max_energy};
+  }
+  return model;
+}
+
+namespace detail {
+
+sim_counter::sim_counter(const sim_model_t &model, std::uint64_t seed)
+    : model_(model), start_(clock_t::now()), rng_(seed),
+      noise_(0, std::max(model.noise, 0.0)) {
+  if (model_.granularity <= clock_t::duration::zero() ||
+      !model_.max_energy.count()) {
+    throw std::system_error(std::make_error_code(std::errc::invalid_argument),
+                            "Invalid simulation model");
+  }
+}
+
+energy_t sim_counter::read(time_point_t now) noexcept {
+  std::lock_guard lock{mtx_};
+  auto elapsed = std::max(now - start_, clock_t::duration::zero());
+  advance(static_cast<uint64_t>(elapsed / model_.granularity));
+  return energy_t{energy_ % model_.max_energy.count()};
+}
+
+void sim_counter::advance(std::uint64_t updates) noexcept {
+  const double step = seconds(model_.granularity);
+  double energy = remainder_;
+  if (updates - updates_ > MAX_SIMULATED_UPDATES) {
+    uint64_t bulk = updates - updates_ - MAX_SIMULATED_UPDATES;
+    energy += std::max(model_.power, 0.0) * step * static_cast<double>(bulk) *
+              MICROJOULES_PER_JOULE;
+    updates_ += bulk;
+  }
+  const double period = seconds(model_.period);
+  for (; updates_ < updates; updates_++) {
+    double power = model_.power + noise_(rng_);
+    if (model_.amplitude && period > 0) {
+      double t = step * static_cast<double>(updates_);
+      power += model_.amplitude * std::sin(TWO_PI * t / period);
+    }
+    energy += std::max(power, 0.0) * step * MICROJOULES_PER_JOULE;
+  }
+  double whole = std::floor(energy);
+  energy_ += static_cast<uint64_t>(whole);
+  remainder_ = energy - whole;
+}
+
+} // namespace detail
+
+sim_reader_t::sim_reader_t(attributes_t attr)
+    : sim_reader_t(attr, sim_model_t::from_env()) {}
+
+// every zone draws its own noise
+sim_reader_t::sim_reader_t(attributes_t attr, const sim_model_t &model)
+    : attr_(attr), maxvalue_(model.max_energy),
+      counter_(std::make_shared<detail::sim_counter>(
+          model, model.seed ^ (uint64_t(attr.socket) << 8 |
+                               static_cast<uint64_t>(attr.domain)))) {}
+
+bool sim_reader_t::obtain_readings(readings_t &into,
+                                   std::error_code &ec) const noexcept {
+  into.timestamp = now();
+  into.energy = counter_->read(into.timestamp);
+  ec.clear();
+  return true;
+}
+
+difference_t sim_reader_t::subtract(const readings_t &lhs,
+                                    const readings_t &rhs) const noexcept {
+  if (rhs.energy > lhs.energy) {
+    return difference_t{lhs.timestamp - rhs.timestamp,
+                        maxvalue_ + lhs.energy - rhs.energy};
+  }
+  return difference_t{lhs.timestamp - rhs.timestamp, lhs.energy - rhs.energy};
+}
+
+const attributes_t &sim_reader_t::attributes() const noexcept { return attr_; }
+
+energy_t sim_reader_t::max_energy() const noexcept { return maxvalue_; }
+
+} // namespace erd
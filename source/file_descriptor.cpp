@@ -0,0 +1,55 @@
+#include <erd/file_descriptor.hpp>
+
+#include <cstdio>
+#include <system_error>
+#include <utility>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+std::error_code get_errno() noexcept {
+  return std::error_code{errno, std::system_category()};
+}
+
+} // namespace
+
+namespace erd::detail {
+
+file_descriptor::file_descriptor(const std::string &path)
+    : file_descriptor(path.c_str()) {}
+
+file_descriptor::file_descriptor(const char *file)
+    : value_(open(file, O_RDONLY)) {
+  if (value_ == -1)
+    throw std::system_error(get_errno());
+}
+
+file_descriptor::file_descriptor(const file_descriptor &other)
+    : value_(dup(other.value_)) {
+  if (value_ == -1)
+    throw std::system_error(get_errno());
+}
+
+file_descriptor::file_descriptor(file_descriptor &&other) noexcept
+    : value_(std::exchange(other.value_, -1)) {}
+
+file_descriptor &file_descriptor::operator=(const file_descriptor &other) {
+  *this = file_descriptor{other};
+  return *this;
+}
+
+file_descriptor::~file_descriptor() noexcept {
+  if (value_ >= 0 && close(value_) == -1)
+    perror("file_descriptor: error closing file");
+}
+
+file_descriptor &file_descriptor::operator=(file_descriptor &&other) noexcept {
+  value_ = std::exchange(other.value_, -1);
+  return *this;
+}
+
+file_descriptor::operator int() const noexcept { return value_; }
+
+} // namespace erd::detail
@@ -1,10 +1,41 @@
+#include <erd/codec.hpp>
 #include <erd/ipc/message.hpp>
 
 #include <cstdlib>
 #include <cstring>
+#include <limits>
+#include <stdexcept>
 
 namespace {
 
+constexpr uint32_t READINGS_BYTE_COUNT = 20;
+// the batch size was appended later, and is one if absent
+constexpr uint32_t SUBSCRIPTION_BASE_BYTE_COUNT =
+    sizeof(int64_t) + sizeof(erd::ipc::subscription_mode_t);
+constexpr uint32_t SUBSCRIPTION_BYTE_COUNT =
+    SUBSCRIPTION_BASE_BYTE_COUNT + sizeof(uint32_t);
+constexpr size_t REQUEST_OPERATION_HEADER_SIZE =
+    sizeof(erd::ipc::operation_type_t) + sizeof(uint32_t);
+constexpr size_t RESPONSE_OPERATION_HEADER_SIZE =
+    sizeof(erd::ipc::operation_type_t) + sizeof(erd::ipc::status_code_t) +
+    sizeof(uint32_t);
+// per metric: errors, sum, min, max and the number of non-empty buckets,
+// followed by an index and a count per non-empty bucket
+constexpr size_t STATS_METRIC_BYTE_COUNT =
+    4 * sizeof(uint64_t) + sizeof(uint32_t);
+constexpr size_t STATS_BUCKET_BYTE_COUNT = sizeof(uint32_t) + sizeof(uint64_t);
+// a count, followed by the domain, socket and microjoules of each entry
+constexpr size_t ATTRIBUTED_ENERGY_BYTE_COUNT =
+    2 * sizeof(uint32_t) + sizeof(uint64_t);
+// the domain and socket, appended to the payload of operations for a domain
+// other than the default
+constexpr uint32_t ATTRIBUTES_BYTE_COUNT = 2 * sizeof(uint32_t);
+// the age of the readings, appended to obtain_readings responses later
+constexpr uint32_t AGE_BYTE_COUNT = sizeof(int64_t);
+// a count, followed by the domain, socket, status and readings of each entry
+constexpr size_t SNAPSHOT_ENTRY_BYTE_COUNT =
+    3 * sizeof(uint32_t) + READINGS_BYTE_COUNT;
+
 template <typename T> T retrieve_field(const char *from) {
   T val;
   std::memcpy(&val, from, sizeof(val));
@@ -83,6 +114,25 @@ bool deserialize_readings(const char *position, erd::readings_t &into,
   return true;
 }
 
+bool deserialize_difference(const char *position, erd::difference_t &into,
+                            std::error_code &ec) noexcept {
+  auto time = ::retrieve_field_advance<int64_t>(position);
+  auto energy = ::retrieve_field_advance<uint64_t>(position);
+  auto tunit = ::retrieve_field_advance<erd::ipc::unit_time_t>(position);
+  auto eunit = ::retrieve_field_advance<erd::ipc::unit_energy_t>(position);
+
+  if (!::units_to_duration(into.duration, tunit, time)) {
+    ec = std::make_error_code(std::errc::bad_message);
+    return false;
+  }
+  if (!::units_to_energy(into.energy_consumed, eunit, energy)) {
+    ec = std::make_error_code(std::errc::bad_message);
+    return false;
+  }
+  ec.clear();
+  return true;
+}
+
 size_t serialize_readings(char *position, const erd::readings_t &data) {
   const char *start = position;
   ::insert_field_advance(position, data.timestamp.time_since_epoch().count());
@@ -92,6 +142,63 @@ size_t serialize_readings(char *position, const erd::readings_t &data) {
   return position - start;
 }
 
+size_t serialize_difference(char *position, const erd::difference_t &data) {
+  const char *start = position;
+  ::insert_field_advance(position, data.duration.count());
+  ::insert_field_advance(position, data.energy_consumed.count());
+  ::insert_field_advance(position, erd::ipc::unit_time_t::nanosecond);
+  ::insert_field_advance(position, erd::ipc::unit_energy_t::microjoule);
+  return position - start;
+}
+
+void serialize_attributes(char *&position, const erd::attributes_t &attr) {
+  ::insert_field_advance(position, static_cast<uint32_t>(attr.domain));
+  ::insert_field_advance(position, attr.socket);
+}
+
+erd::attributes_t deserialize_attributes(const char *&position) noexcept {
+  erd::attributes_t attr;
+  attr.domain =
+      static_cast<erd::domain_t>(::retrieve_field_advance<uint32_t>(position));
+  attr.socket = ::retrieve_field_advance<uint32_t>(position);
+  return attr;
+}
+
+size_t stats_byte_count(const erd::stats_t &data) noexcept {
+  size_t bytes = sizeof(uint32_t);
+  for (const erd::histogram_t &h : data.histograms) {
+    bytes += STATS_METRIC_BYTE_COUNT;
+    for (size_t i = 0; i < erd::histogram_t::bucket_count; i++) {
+      if (h.bucket(i)) {
+        bytes += STATS_BUCKET_BYTE_COUNT;
+      }
+    }
+  }
+  return bytes;
+}
+
+void serialize_stats(char *position, const erd::stats_t &data) {
+  ::insert_field_advance(position, static_cast<uint32_t>(erd::metric_count));
+  for (size_t m = 0; m < erd::metric_count; m++) {
+    const erd::histogram_t &h = data.histograms[m];
+    ::insert_field_advance(position, data.errors[m]);
+    ::insert_field_advance(position, h.sum());
+    ::insert_field_advance(position, h.min());
+    ::insert_field_advance(position, h.max());
+    char *count_position = position;
+    position += sizeof(uint32_t);
+    uint32_t count = 0;
+    for (size_t i = 0; i < erd::histogram_t::bucket_count; i++) {
+      if (uint64_t value = h.bucket(i)) {
+        ::insert_field_advance(position, static_cast<uint32_t>(i));
+        ::insert_field_advance(position, value);
+        count++;
+      }
+    }
+    ::insert_field(count_position, count);
+  }
+}
+
 } // namespace
 
 namespace erd::ipc {
@@ -132,33 +239,14 @@ bool message_response::difference(erd::difference_t &into,
     return false;
   }
 
-  const char *position = buffer_ + sizeof(status_code_t);
-  auto time = ::retrieve_field_advance<int64_t>(position);
-  auto energy = ::retrieve_field_advance<uint64_t>(position);
-  auto tunit = ::retrieve_field_advance<unit_time_t>(position);
-  auto eunit = ::retrieve_field_advance<unit_energy_t>(position);
-
-  if (!::units_to_duration(into.duration, tunit, time)) {
-    ec = std::make_error_code(std::errc::bad_message);
-    return false;
-  }
-  if (!::units_to_energy(into.energy_consumed, eunit, energy)) {
-    ec = std::make_error_code(std::errc::bad_message);
-    return false;
-  }
-  ec.clear();
-  return true;
+  return ::deserialize_difference(buffer_ + sizeof(status_code_t), into, ec);
 }
 
 void message_response::serialize(status_code_t status,
                                  const difference_t &data) noexcept {
   detail::message_common::serialize(operation_type_t::subtract);
-  char *position = buffer_ + sizeof(status_code_t);
   ::insert_field(buffer_, status);
-  ::insert_field_advance(position, data.duration.count());
-  ::insert_field_advance(position, data.energy_consumed.count());
-  ::insert_field_advance(position, erd::ipc::unit_time_t::nanosecond);
-  ::insert_field_advance(position, erd::ipc::unit_energy_t::microjoule);
+  ::serialize_difference(buffer_ + sizeof(status), data);
 }
 
 void message_response::serialize(status_code_t status,
@@ -177,7 +265,6 @@ bool message_request::readings(readings_t &lhs, readings_t &rhs,
   if (!::deserialize_readings(buffer_, lhs, ec)) {
     return false;
   }
-  constexpr uint32_t READINGS_BYTE_COUNT = 20;
   return ::deserialize_readings(buffer_ + READINGS_BYTE_COUNT, rhs, ec);
 }
 
@@ -193,4 +280,539 @@ void message_request::serialize(const readings_t &lhs,
   ::serialize_readings(position, rhs);
 }
 
+bool request_operation_t::readings(readings_t &lhs, readings_t &rhs,
+                                   std::error_code &ec) const noexcept {
+  if (type != operation_type_t::subtract ||
+      length < 2 * READINGS_BYTE_COUNT) {
+    ec = std::make_error_code(std::errc::bad_message);
+    return false;
+  }
+  if (!::deserialize_readings(payload, lhs, ec)) {
+    return false;
+  }
+  return ::deserialize_readings(payload + READINGS_BYTE_COUNT, rhs, ec);
+}
+
+bool request_operation_t::subscription(std::chrono::nanoseconds &interval,
+                                       subscription_mode_t &mode,
+                                       uint32_t &batch,
+                                       std::error_code &ec) const noexcept {
+  if (type != operation_type_t::subscribe ||
+      length < SUBSCRIPTION_BASE_BYTE_COUNT) {
+    ec = std::make_error_code(std::errc::bad_message);
+    return false;
+  }
+  const char *position = payload;
+  interval = std::chrono::nanoseconds{
+      ::retrieve_field_advance<int64_t>(position)};
+  mode = ::retrieve_field_advance<subscription_mode_t>(position);
+  batch = length < SUBSCRIPTION_BYTE_COUNT
+              ? 1
+              : ::retrieve_field_advance<uint32_t>(position);
+  if (interval.count() <= 0 || (mode != subscription_mode_t::readings &&
+                                mode != subscription_mode_t::difference &&
+                                mode != subscription_mode_t::samples) ||
+      batch == 0 || batch > max_subscription_batch) {
+    ec = std::make_error_code(std::errc::invalid_argument);
+    return false;
+  }
+  ec.clear();
+  return true;
+}
+
+bool request_operation_t::attribution(attribution_target_t &target,
+                                      int32_t &pid, std::string_view &cgroup,
+                                      std::error_code &ec) const noexcept {
+  if (type != operation_type_t::attribution ||
+      length < sizeof(attribution_target_t)) {
+    ec = std::make_error_code(std::errc::bad_message);
+    return false;
+  }
+  const char *position = payload;
+  target = ::retrieve_field_advance<attribution_target_t>(position);
+  uint32_t remaining = length - sizeof(target);
+  if (target == attribution_target_t::process && remaining >= sizeof(pid)) {
+    pid = ::retrieve_field<int32_t>(position);
+  } else if (target == attribution_target_t::cgroup) {
+    cgroup = std::string_view{position, remaining};
+  } else {
+    ec = std::make_error_code(std::errc::bad_message);
+    return false;
+  }
+  ec.clear();
+  return true;
+}
+
+bool request_operation_t::attributes(attributes_t &into) const noexcept {
+  uint32_t offset;
+  switch (type) {
+  case operation_type_t::obtain_readings:
+    offset = 0;
+    break;
+  case operation_type_t::subtract:
+    offset = 2 * READINGS_BYTE_COUNT;
+    break;
+  case operation_type_t::subscribe:
+    offset = SUBSCRIPTION_BYTE_COUNT;
+    break;
+  default:
+    return false;
+  }
+  if (length < offset + ATTRIBUTES_BYTE_COUNT) {
+    return false;
+  }
+  const char *position = payload + offset;
+  into = ::deserialize_attributes(position);
+  return true;
+}
+
+bool response_operation_t::readings(readings_t &into,
+                                    std::error_code &ec) const noexcept {
+  if (type != operation_type_t::obtain_readings ||
+      length < READINGS_BYTE_COUNT) {
+    ec = std::make_error_code(std::errc::bad_message);
+    return false;
+  }
+  return ::deserialize_readings(payload, into, ec);
+}
+
+bool response_operation_t::age(std::chrono::nanoseconds &into) const noexcept {
+  if (type != operation_type_t::obtain_readings ||
+      length < READINGS_BYTE_COUNT + AGE_BYTE_COUNT) {
+    return false;
+  }
+  into = std::chrono::nanoseconds{
+      ::retrieve_field<int64_t>(payload + READINGS_BYTE_COUNT)};
+  return true;
+}
+
+bool response_operation_t::difference(difference_t &into,
+                                      std::error_code &ec) const noexcept {
+  if (type != operation_type_t::subtract || length < READINGS_BYTE_COUNT) {
+    ec = std::make_error_code(std::errc::bad_message);
+    return false;
+  }
+  return ::deserialize_difference(payload, into, ec);
+}
+
+bool response_operation_t::samples(std::vector<readings_t> &into,
+                                   std::error_code &ec) const {
+  if (type != operation_type_t::samples) {
+    ec = std::make_error_code(std::errc::bad_message);
+    return false;
+  }
+  const auto *data = reinterpret_cast<const uint8_t *>(payload);
+  into.clear();
+  return codec::decode(data, data + length, into, ec);
+}
+
+bool response_operation_t::attribution(std::vector<attributed_energy_t> &into,
+                                       std::error_code &ec) const {
+  if (type != operation_type_t::attribution || length < sizeof(uint32_t)) {
+    ec = std::make_error_code(std::errc::bad_message);
+    return false;
+  }
+  const char *position = payload;
+  auto count = ::retrieve_field_advance<uint32_t>(position);
+  if ((length - sizeof(count)) / ATTRIBUTED_ENERGY_BYTE_COUNT < count) {
+    ec = std::make_error_code(std::errc::bad_message);
+    return false;
+  }
+  into.clear();
+  for (uint32_t i = 0; i < count; i++) {
+    attributed_energy_t entry;
+    entry.attributes = ::deserialize_attributes(position);
+    entry.energy = energy_t{::retrieve_field_advance<uint64_t>(position)};
+    into.push_back(entry);
+  }
+  ec.clear();
+  return true;
+}
+
+bool response_operation_t::snapshot(std::vector<snapshot_entry_t> &into,
+                                    std::error_code &ec) const {
+  if (type != operation_type_t::snapshot || length < sizeof(uint32_t)) {
+    ec = std::make_error_code(std::errc::bad_message);
+    return false;
+  }
+  const char *position = payload;
+  auto count = ::retrieve_field_advance<uint32_t>(position);
+  if ((length - sizeof(count)) / SNAPSHOT_ENTRY_BYTE_COUNT < count) {
+    ec = std::make_error_code(std::errc::bad_message);
+    return false;
+  }
+  into.clear();
+  for (uint32_t i = 0; i < count; i++) {
+    snapshot_entry_t entry;
+    entry.attributes = ::deserialize_attributes(position);
+    entry.status = ::retrieve_field_advance<status_code_t>(position);
+    // the readings of a failed read are not meaningful
+    if (entry.status != status_code_t::success) {
+      entry.readings = readings_t{};
+    } else if (!::deserialize_readings(position, entry.readings, ec)) {
+      return false;
+    }
+    position += READINGS_BYTE_COUNT;
+    into.push_back(entry);
+  }
+  ec.clear();
+  return true;
+}
+
+// metrics unknown to this side are skipped, so that newer daemons may add some
+bool response_operation_t::stats(stats_t &into,
+                                 std::error_code &ec) const noexcept {
+  if (type != operation_type_t::stats || length < sizeof(uint32_t)) {
+    ec = std::make_error_code(std::errc::bad_message);
+    return false;
+  }
+  const char *position = payload;
+  const char *end = payload + length;
+  auto metrics = ::retrieve_field_advance<uint32_t>(position);
+  into = stats_t{};
+  for (uint32_t m = 0; m < metrics; m++) {
+    if (size_t(end - position) < STATS_METRIC_BYTE_COUNT) {
+      ec = std::make_error_code(std::errc::bad_message);
+      return false;
+    }
+    auto errors = ::retrieve_field_advance<uint64_t>(position);
+    auto sum = ::retrieve_field_advance<uint64_t>(position);
+    auto min = ::retrieve_field_advance<uint64_t>(position);
+    auto max = ::retrieve_field_advance<uint64_t>(position);
+    auto count = ::retrieve_field_advance<uint32_t>(position);
+    if (size_t(end - position) / STATS_BUCKET_BYTE_COUNT < count) {
+      ec = std::make_error_code(std::errc::bad_message);
+      return false;
+    }
+    if (m >= metric_count) {
+      position += count * STATS_BUCKET_BYTE_COUNT;
+      continue;
+    }
+    histogram_t &h = into.histograms[m];
+    for (uint32_t i = 0; i < count; i++) {
+      auto index = ::retrieve_field_advance<uint32_t>(position);
+      auto value = ::retrieve_field_advance<uint64_t>(position);
+      if (index >= histogram_t::bucket_count) {
+        ec = std::make_error_code(std::errc::bad_message);
+        return false;
+      }
+      h.add_bucket(index, value);
+    }
+    h.set_summary(sum, min, max);
+    into.errors[m] = errors;
+  }
+  ec.clear();
+  return true;
+}
+
+namespace detail {
+
+void frame_common::begin(uint32_t request_id) {
+  buffer_.assign(frame_header_t::size, 0);
+  header_ = frame_header_t{};
+  header_.request_id = request_id;
+  offset_ = frame_header_t::size;
+  consumed_ = 0;
+}
+
+void frame_common::finish() noexcept {
+  header_.length = static_cast<uint32_t>(buffer_.size() - frame_header_t::size);
+  char *position = buffer_.data();
+  ::insert_field_advance(position, header_.magic);
+  ::insert_field_advance(position, header_.version);
+  ::insert_field_advance(position, header_.count);
+  ::insert_field_advance(position, header_.length);
+  ::insert_field_advance(position, header_.request_id);
+}
+
+char *frame_common::header_buffer() {
+  buffer_.resize(frame_header_t::size);
+  return buffer_.data();
+}
+
+bool frame_common::prepare_payload(std::error_code &ec) {
+  const char *position = buffer_.data();
+  header_.magic = ::retrieve_field_advance<uint32_t>(position);
+  header_.version = ::retrieve_field_advance<uint16_t>(position);
+  header_.count = ::retrieve_field_advance<uint16_t>(position);
+  header_.length = ::retrieve_field_advance<uint32_t>(position);
+  header_.request_id = ::retrieve_field_advance<uint32_t>(position);
+  if (header_.magic != frame_magic || header_.version != frame_version ||
+      header_.length > frame_header_t::max_length) {
+    ec = std::make_error_code(std::errc::bad_message);
+    return false;
+  }
+  buffer_.resize(frame_header_t::size + header_.length);
+  offset_ = frame_header_t::size;
+  consumed_ = 0;
+  ec.clear();
+  return true;
+}
+
+char *frame_common::payload_buffer() noexcept {
+  return buffer_.data() + frame_header_t::size;
+}
+
+size_t frame_common::payload_size() const noexcept { return header_.length; }
+
+const frame_header_t &frame_common::header() const noexcept { return header_; }
+
+const char *frame_common::data() const noexcept { return buffer_.data(); }
+
+size_t frame_common::size() const noexcept { return buffer_.size(); }
+
+char *frame_common::append(size_t bytes) {
+  if (header_.count == std::numeric_limits<uint16_t>::max()) {
+    throw std::length_error("Too many operations in frame");
+  }
+  header_.count++;
+  size_t position = buffer_.size();
+  buffer_.resize(position + bytes);
+  return buffer_.data() + position;
+}
+
+const char *frame_common::consume(size_t bytes, std::error_code &ec) noexcept {
+  if (buffer_.size() - offset_ < bytes) {
+    ec = std::make_error_code(std::errc::bad_message);
+    return nullptr;
+  }
+  const char *position = buffer_.data() + offset_;
+  offset_ += bytes;
+  return position;
+}
+
+} // namespace detail
+
+void request_frame::add_obtain_readings() {
+  char *position = append(REQUEST_OPERATION_HEADER_SIZE);
+  ::insert_field_advance(position, operation_type_t::obtain_readings);
+  ::insert_field_advance(position, uint32_t{0});
+}
+
+void request_frame::add_obtain_readings(const attributes_t &attr) {
+  char *position =
+      append(REQUEST_OPERATION_HEADER_SIZE + ATTRIBUTES_BYTE_COUNT);
+  ::insert_field_advance(position, operation_type_t::obtain_readings);
+  ::insert_field_advance(position, ATTRIBUTES_BYTE_COUNT);
+  ::serialize_attributes(position, attr);
+}
+
+void request_frame::add_subtract(const readings_t &lhs, const readings_t &rhs) {
+  char *position =
+      append(REQUEST_OPERATION_HEADER_SIZE + 2 * READINGS_BYTE_COUNT);
+  ::insert_field_advance(position, operation_type_t::subtract);
+  ::insert_field_advance(position, 2 * READINGS_BYTE_COUNT);
+  position += ::serialize_readings(position, lhs);
+  ::serialize_readings(position, rhs);
+}
+
+void request_frame::add_subtract(const readings_t &lhs, const readings_t &rhs,
+                                 const attributes_t &attr) {
+  constexpr uint32_t bytes = 2 * READINGS_BYTE_COUNT + ATTRIBUTES_BYTE_COUNT;
+  char *position = append(REQUEST_OPERATION_HEADER_SIZE + bytes);
+  ::insert_field_advance(position, operation_type_t::subtract);
+  ::insert_field_advance(position, bytes);
+  position += ::serialize_readings(position, lhs);
+  position += ::serialize_readings(position, rhs);
+  ::serialize_attributes(position, attr);
+}
+
+void request_frame::add_subscribe(std::chrono::nanoseconds interval,
+                                  subscription_mode_t mode, uint32_t batch) {
+  char *position = append(REQUEST_OPERATION_HEADER_SIZE +
+                          SUBSCRIPTION_BYTE_COUNT);
+  ::insert_field_advance(position, operation_type_t::subscribe);
+  ::insert_field_advance(position, SUBSCRIPTION_BYTE_COUNT);
+  ::insert_field_advance(position, static_cast<int64_t>(interval.count()));
+  ::insert_field_advance(position, mode);
+  ::insert_field_advance(position, batch);
+}
+
+void request_frame::add_subscribe(std::chrono::nanoseconds interval,
+                                  subscription_mode_t mode, uint32_t batch,
+                                  const attributes_t &attr) {
+  constexpr uint32_t bytes = SUBSCRIPTION_BYTE_COUNT + ATTRIBUTES_BYTE_COUNT;
+  char *position = append(REQUEST_OPERATION_HEADER_SIZE + bytes);
+  ::insert_field_advance(position, operation_type_t::subscribe);
+  ::insert_field_advance(position, bytes);
+  ::insert_field_advance(position, static_cast<int64_t>(interval.count()));
+  ::insert_field_advance(position, mode);
+  ::insert_field_advance(position, batch);
+  ::serialize_attributes(position, attr);
+}
+
+void request_frame::add_unsubscribe() {
+  char *position = append(REQUEST_OPERATION_HEADER_SIZE);
+  ::insert_field_advance(position, operation_type_t::unsubscribe);
+  ::insert_field_advance(position, uint32_t{0});
+}
+
+void request_frame::add_stats() {
+  char *position = append(REQUEST_OPERATION_HEADER_SIZE);
+  ::insert_field_advance(position, operation_type_t::stats);
+  ::insert_field_advance(position, uint32_t{0});
+}
+
+void request_frame::add_attribution(int32_t pid) {
+  constexpr uint32_t bytes = sizeof(attribution_target_t) + sizeof(pid);
+  char *position = append(REQUEST_OPERATION_HEADER_SIZE + bytes);
+  ::insert_field_advance(position, operation_type_t::attribution);
+  ::insert_field_advance(position, bytes);
+  ::insert_field_advance(position, attribution_target_t::process);
+  ::insert_field_advance(position, pid);
+}
+
+void request_frame::add_attribution(std::string_view cgroup) {
+  auto bytes =
+      static_cast<uint32_t>(sizeof(attribution_target_t) + cgroup.size());
+  char *position = append(REQUEST_OPERATION_HEADER_SIZE + bytes);
+  ::insert_field_advance(position, operation_type_t::attribution);
+  ::insert_field_advance(position, bytes);
+  ::insert_field_advance(position, attribution_target_t::cgroup);
+  std::memcpy(position, cgroup.data(), cgroup.size());
+}
+
+void request_frame::add_snapshot() {
+  char *position = append(REQUEST_OPERATION_HEADER_SIZE);
+  ::insert_field_advance(position, operation_type_t::snapshot);
+  ::insert_field_advance(position, uint32_t{0});
+}
+
+bool request_frame::next(request_operation_t &op,
+                         std::error_code &ec) noexcept {
+  if (offset_ == buffer_.size()) {
+    ec.clear();
+    return false;
+  }
+  // the response holds one operation per request operation, so it could not
+  // be built for more than the header may count
+  if (consumed_ == header_.count) {
+    ec = std::make_error_code(std::errc::bad_message);
+    return false;
+  }
+  const char *position = consume(REQUEST_OPERATION_HEADER_SIZE, ec);
+  if (!position) {
+    return false;
+  }
+  op.type = ::retrieve_field_advance<operation_type_t>(position);
+  op.length = ::retrieve_field_advance<uint32_t>(position);
+  op.payload = consume(op.length, ec);
+  consumed_++;
+  return op.payload != nullptr;
+}
+
+bool request_frame::validate(request_operation_t &op,
+                             std::error_code &ec) noexcept {
+  size_t offset = offset_;
+  uint32_t consumed = consumed_;
+  while (next(op, ec)) {
+  }
+  offset_ = offset;
+  consumed_ = consumed;
+  return !ec;
+}
+
+void response_frame::add(status_code_t status, const readings_t &data) {
+  char *position = append(RESPONSE_OPERATION_HEADER_SIZE + READINGS_BYTE_COUNT);
+  ::insert_field_advance(position, operation_type_t::obtain_readings);
+  ::insert_field_advance(position, status);
+  ::insert_field_advance(position, READINGS_BYTE_COUNT);
+  ::serialize_readings(position, data);
+}
+
+void response_frame::add(status_code_t status, const readings_t &data,
+                         std::chrono::nanoseconds age) {
+  constexpr uint32_t bytes = READINGS_BYTE_COUNT + AGE_BYTE_COUNT;
+  char *position = append(RESPONSE_OPERATION_HEADER_SIZE + bytes);
+  ::insert_field_advance(position, operation_type_t::obtain_readings);
+  ::insert_field_advance(position, status);
+  ::insert_field_advance(position, bytes);
+  position += ::serialize_readings(position, data);
+  ::insert_field_advance(position, static_cast<int64_t>(age.count()));
+}
+
+void response_frame::add(status_code_t status, const difference_t &data) {
+  char *position = append(RESPONSE_OPERATION_HEADER_SIZE + READINGS_BYTE_COUNT);
+  ::insert_field_advance(position, operation_type_t::subtract);
+  ::insert_field_advance(position, status);
+  ::insert_field_advance(position, READINGS_BYTE_COUNT);
+  ::serialize_difference(position, data);
+}
+
+void response_frame::add(status_code_t status, const stats_t &data) {
+  auto bytes = static_cast<uint32_t>(::stats_byte_count(data));
+  char *position = append(RESPONSE_OPERATION_HEADER_SIZE + bytes);
+  ::insert_field_advance(position, operation_type_t::stats);
+  ::insert_field_advance(position, status);
+  ::insert_field_advance(position, bytes);
+  ::serialize_stats(position, data);
+}
+
+void response_frame::add(status_code_t status, const readings_t *samples,
+                         size_t count) {
+  std::vector<uint8_t> block;
+  codec::encode(samples, count, block);
+  auto bytes = static_cast<uint32_t>(block.size());
+  char *position = append(RESPONSE_OPERATION_HEADER_SIZE + bytes);
+  ::insert_field_advance(position, operation_type_t::samples);
+  ::insert_field_advance(position, status);
+  ::insert_field_advance(position, bytes);
+  std::memcpy(position, block.data(), bytes);
+}
+
+void response_frame::add(status_code_t status,
+                         const std::vector<attributed_energy_t> &energy) {
+  auto bytes = static_cast<uint32_t>(
+      sizeof(uint32_t) + energy.size() * ATTRIBUTED_ENERGY_BYTE_COUNT);
+  char *position = append(RESPONSE_OPERATION_HEADER_SIZE + bytes);
+  ::insert_field_advance(position, operation_type_t::attribution);
+  ::insert_field_advance(position, status);
+  ::insert_field_advance(position, bytes);
+  ::insert_field_advance(position, static_cast<uint32_t>(energy.size()));
+  for (const attributed_energy_t &entry : energy) {
+    ::serialize_attributes(position, entry.attributes);
+    ::insert_field_advance(position, entry.energy.count());
+  }
+}
+
+void response_frame::add(status_code_t status,
+                         const std::vector<snapshot_entry_t> &entries) {
+  auto bytes = static_cast<uint32_t>(
+      sizeof(uint32_t) + entries.size() * SNAPSHOT_ENTRY_BYTE_COUNT);
+  char *position = append(RESPONSE_OPERATION_HEADER_SIZE + bytes);
+  ::insert_field_advance(position, operation_type_t::snapshot);
+  ::insert_field_advance(position, status);
+  ::insert_field_advance(position, bytes);
+  ::insert_field_advance(position, static_cast<uint32_t>(entries.size()));
+  for (const snapshot_entry_t &entry : entries) {
+    ::serialize_attributes(position, entry.attributes);
+    ::insert_field_advance(position, entry.status);
+    position += ::serialize_readings(position, entry.readings);
+  }
+}
+
+void response_frame::add(operation_type_t optype, status_code_t status) {
+  char *position = append(RESPONSE_OPERATION_HEADER_SIZE);
+  ::insert_field_advance(position, optype);
+  ::insert_field_advance(position, status);
+  ::insert_field_advance(position, uint32_t{0});
+}
+
+bool response_frame::next(response_operation_t &op,
+                          std::error_code &ec) noexcept {
+  if (offset_ == buffer_.size()) {
+    ec.clear();
+    return false;
+  }
+  const char *position = consume(RESPONSE_OPERATION_HEADER_SIZE, ec);
+  if (!position) {
+    return false;
+  }
+  op.type = ::retrieve_field_advance<operation_type_t>(position);
+  op.status = ::retrieve_field_advance<status_code_t>(position);
+  op.length = ::retrieve_field_advance<uint32_t>(position);
+  op.payload = consume(op.length, ec);
+  return op.payload != nullptr;
+}
+
 } // namespace erd::ipc
@@ -0,0 +1,260 @@
+#include <erd/metrics.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+constexpr auto relaxed = std::memory_order_relaxed;
+
+// single writer, so a load and a store avoid the cost of a locked increment
+void add_relaxed(std::atomic<std::uint64_t> &counter,
+                 std::uint64_t value) noexcept {
+  counter.store(counter.load(relaxed) + value, relaxed);
+}
+
+std::uint64_t to_value(erd::clock_t::duration value) noexcept {
+  auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(value);
+  return ns.count() > 0 ? static_cast<std::uint64_t>(ns.count()) : 0;
+}
+
+// enables the metrics before main when requested in the environment
+const bool enabled_from_env = [] {
+  const char *env = std::getenv("ERD_STATS");
+  bool enabled = env && std::strcmp(env, "1") == 0;
+  if (enabled) {
+    erd::metrics_t::enable(true);
+  }
+  return enabled;
+}();
+
+} // namespace
+
+namespace erd {
+
+namespace detail {
+
+// registers the storage of a thread on its first record and folds it into the
+// retired totals when the thread exits
+struct thread_metrics_slot {
+  std::unique_ptr<thread_metrics> storage;
+
+  ~thread_metrics_slot() noexcept {
+    if (storage) {
+      metrics_t::instance().retire(storage.get());
+    }
+  }
+};
+
+void thread_metrics::clear() noexcept {
+  for (histogram &h : histograms) {
+    for (auto &b : h.buckets) {
+      b.store(0, relaxed);
+    }
+    h.sum.store(0, relaxed);
+    h.min.store(std::numeric_limits<std::uint64_t>::max(), relaxed);
+    h.max.store(0, relaxed);
+  }
+  for (auto &e : errors) {
+    e.store(0, relaxed);
+  }
+}
+
+void thread_metrics::add_to(stats_t &stats) const noexcept {
+  for (size_t m = 0; m < metric_count; m++) {
+    const histogram &h = histograms[m];
+    histogram_t local;
+    for (size_t i = 0; i < histogram_t::bucket_count; i++) {
+      if (std::uint64_t count = h.buckets[i].load(relaxed)) {
+        local.add_bucket(i, count);
+      }
+    }
+    local.set_summary(h.sum.load(relaxed), h.min.load(relaxed),
+                      h.max.load(relaxed));
+    stats.histograms[m].merge(local);
+    stats.errors[m] += errors[m].load(relaxed);
+  }
+}
+
+} // namespace detail
+
+std::size_t histogram_t::bucket_index(std::uint64_t value) noexcept {
+  if (value < sub_bucket_count) {
+    return static_cast<std::size_t>(value);
+  }
+  unsigned exponent = 63 - static_cast<unsigned>(__builtin_clzll(value));
+  unsigned shift = exponent - sub_bucket_bits;
+  return (exponent - sub_bucket_bits + 1) * sub_bucket_count +
+         ((value >> shift) & (sub_bucket_count - 1));
+}
+
+std::uint64_t histogram_t::bucket_lower(std::size_t index) noexcept {
+  if (index < sub_bucket_count) {
+    return index;
+  }
+  unsigned shift = static_cast<unsigned>(index / sub_bucket_count) - 1;
+  return (sub_bucket_count + index % sub_bucket_count) << shift;
+}
+
+std::uint64_t histogram_t::bucket_upper(std::size_t index) noexcept {
+  if (index + 1 == bucket_count) {
+    return std::numeric_limits<std::uint64_t>::max();
+  }
+  return bucket_lower(index + 1) - 1;
+}
+
+void histogram_t::record(std::uint64_t value, std::uint64_t count) noexcept {
+  buckets_[bucket_index(value)] += count;
+  count_ += count;
+  sum_ += value * count;
+  min_ = std::min(min_, value);
+  max_ = std::max(max_, value);
+}
+
+void histogram_t::merge(const histogram_t &other) noexcept {
+  for (size_t i = 0; i < bucket_count; i++) {
+    buckets_[i] += other.buckets_[i];
+  }
+  count_ += other.count_;
+  sum_ += other.sum_;
+  min_ = std::min(min_, other.min_);
+  max_ = std::max(max_, other.max_);
+}
+
+void histogram_t::reset() noexcept { *this = histogram_t{}; }
+
+void histogram_t::add_bucket(std::size_t index, std::uint64_t count) noexcept {
+  buckets_[index] += count;
+  count_ += count;
+}
+
+void histogram_t::set_summary(std::uint64_t sum, std::uint64_t min,
+                              std::uint64_t max) noexcept {
+  sum_ = sum;
+  min_ = min;
+  max_ = max;
+}
+
+std::uint64_t histogram_t::count() const noexcept { return count_; }
+
+std::uint64_t histogram_t::sum() const noexcept { return sum_; }
+
+std::uint64_t histogram_t::min() const noexcept { return count_ ? min_ : 0; }
+
+std::uint64_t histogram_t::max() const noexcept { return max_; }
+
+double histogram_t::mean() const noexcept {
+  return count_ ? static_cast<double>(sum_) / static_cast<double>(count_) : 0;
+}
+
+std::uint64_t histogram_t::percentile(double q) const noexcept {
+  if (!count_) {
+    return 0;
+  }
+  q = std::clamp(q, 0.0, 1.0);
+  auto rank = std::max<std::uint64_t>(
+      1, static_cast<std::uint64_t>(q * static_cast<double>(count_) + 0.5));
+  std::uint64_t seen = 0;
+  for (size_t i = 0; i < bucket_count; i++) {
+    seen += buckets_[i];
+    if (seen >= rank) {
+      return std::min(std::max(bucket_upper(i), min()), max_);
+    }
+  }
+  return max_;
+}
+
+std::uint64_t histogram_t::bucket(std::size_t index) const noexcept {
+  return buckets_[index];
+}
+
+const histogram_t &stats_t::histogram(metric_t metric) const noexcept {
+  return histograms[static_cast<size_t>(metric)];
+}
+
+std::uint64_t stats_t::error_count(metric_t metric) const noexcept {
+  return errors[static_cast<size_t>(metric)];
+}
+
+metrics_t &metrics_t::instance() {
+  static metrics_t metrics;
+  return metrics;
+}
+
+void metrics_t::enable(bool value) noexcept {
+  detail::metrics_enabled.store(value, relaxed);
+}
+
+detail::thread_metrics *metrics_t::local() noexcept {
+  thread_local detail::thread_metrics_slot slot;
+  detail::thread_metrics *tm = slot.storage.get();
+  if (!tm) {
+    try {
+      slot.storage = std::make_unique<detail::thread_metrics>();
+    } catch (const std::bad_alloc &) {
+      return nullptr;
+    }
+    tm = slot.storage.get();
+    tm->clear();
+    tm->generation.store(generation_.load(relaxed), relaxed);
+    std::lock_guard lock{mtx_};
+    threads_.push_back(tm);
+  } else if (std::uint64_t generation = generation_.load(relaxed);
+             tm->generation.load(relaxed) != generation) {
+    tm->clear();
+    tm->generation.store(generation, relaxed);
+  }
+  return tm;
+}
+
+void metrics_t::retire(detail::thread_metrics *tm) noexcept {
+  std::lock_guard lock{mtx_};
+  if (tm->generation.load(relaxed) == generation_.load(relaxed)) {
+    tm->add_to(retired_);
+  }
+  threads_.erase(std::find(threads_.begin(), threads_.end(), tm));
+}
+
+void metrics_t::record(metric_t metric, clock_t::duration value) noexcept {
+  detail::thread_metrics *tm = local();
+  if (!tm) {
+    return;
+  }
+  std::uint64_t v = to_value(value);
+  auto &h = tm->histograms[static_cast<size_t>(metric)];
+  add_relaxed(h.buckets[histogram_t::bucket_index(v)], 1);
+  add_relaxed(h.sum, v);
+  if (v < h.min.load(relaxed)) {
+    h.min.store(v, relaxed);
+  }
+  if (v > h.max.load(relaxed)) {
+    h.max.store(v, relaxed);
+  }
+}
+
+void metrics_t::record_error(metric_t metric) noexcept {
+  if (detail::thread_metrics *tm = local()) {
+    add_relaxed(tm->errors[static_cast<size_t>(metric)], 1);
+  }
+}
+
+stats_t metrics_t::snapshot() const {
+  std::lock_guard lock{mtx_};
+  stats_t stats = retired_;
+  std::uint64_t generation = generation_.load(relaxed);
+  for (const detail::thread_metrics *tm : threads_) {
+    if (tm->generation.load(relaxed) == generation) {
+      tm->add_to(stats);
+    }
+  }
+  return stats;
+}
+
+void metrics_t::reset() noexcept {
+  std::lock_guard lock{mtx_};
+  generation_.fetch_add(1, relaxed);
+  retired_ = stats_t{};
+}
+
+} // namespace erd
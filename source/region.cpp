@@ -0,0 +1,255 @@
+#include <erd/region.hpp>
+#include <erd/sampler.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <utility>
+
+namespace {
+
+constexpr auto relaxed = std::memory_order_relaxed;
+
+// single writer, so a load and a store avoid the cost of a locked increment
+void add_relaxed(std::atomic<std::uint64_t> &counter,
+                 std::uint64_t value) noexcept {
+  counter.store(counter.load(relaxed) + value, relaxed);
+}
+
+std::atomic<std::uint64_t> next_id{1};
+
+} // namespace
+
+namespace erd {
+
+namespace detail {
+
+// written only by the thread holding it, read by whoever reports
+struct region_entry {
+  std::atomic<const char *> label{nullptr};
+  std::atomic<std::uint64_t> count{0};
+  std::atomic<std::uint64_t> errors{0};
+  std::atomic<std::uint64_t> duration{0}; // nanoseconds
+  std::atomic<std::uint64_t> energy{0};   // microjoules
+};
+
+// open addressing on the label address, at most half full
+struct region_table {
+  std::unique_ptr<region_entry[]> entries;
+  std::size_t mask;
+  // only touched by the thread holding the table
+  std::size_t used = 0;
+  std::atomic<std::uint64_t> dropped{0};
+  // cleared when its thread exits, so another may take it over
+  std::atomic<bool> held{true};
+  // set when the profiler is destroyed, so threads let go of it
+  std::atomic<bool> closed{false};
+
+  explicit region_table(std::size_t max_labels) {
+    std::size_t size = 2;
+    while (size < 2 * max_labels) {
+      size *= 2;
+    }
+    entries = std::make_unique<region_entry[]>(size);
+    mask = size - 1;
+  }
+
+  region_entry *find(const char *label, std::size_t max_labels) noexcept {
+    auto hash = static_cast<std::uint64_t>(
+                    reinterpret_cast<std::uintptr_t>(label)) *
+                0x9e3779b97f4a7c15ull;
+    for (std::size_t i = static_cast<std::size_t>(hash >> 32);; i++) {
+      region_entry &e = entries[i & mask];
+      const char *l = e.label.load(relaxed);
+      if (l == label) {
+        return &e;
+      }
+      if (!l) {
+        if (used == max_labels) {
+          return nullptr;
+        }
+        used++;
+        e.label.store(label, std::memory_order_release);
+        return &e;
+      }
+    }
+  }
+};
+
+// the tables of a thread, one per profiler it recorded into; the last one
+// used is checked first
+struct thread_regions {
+  std::uint64_t last_id = 0;
+  region_table *last = nullptr;
+  std::vector<std::pair<std::uint64_t, std::shared_ptr<region_table>>> tables;
+
+  ~thread_regions() noexcept {
+    for (auto &[id, table] : tables) {
+      table->held.store(false, std::memory_order_release);
+    }
+  }
+
+  region_table *find(std::uint64_t id) noexcept {
+    if (last_id == id) {
+      return last;
+    }
+    tables.erase(std::remove_if(tables.begin(), tables.end(),
+                                [](const auto &t) {
+                                  return t.second->closed.load(relaxed);
+                                }),
+                 tables.end());
+    for (auto &[tid, table] : tables) {
+      if (tid == id) {
+        last_id = id;
+        last = table.get();
+        return last;
+      }
+    }
+    return nullptr;
+  }
+};
+
+thread_local thread_regions local_regions;
+
+} // namespace detail
+
+profiler_t::profiler_t(reader_t reader, std::size_t max_labels)
+    : reader_(std::move(reader)),
+      max_labels_(std::max<std::size_t>(max_labels, 1)),
+      id_(next_id.fetch_add(1, relaxed)) {}
+
+profiler_t::profiler_t(const sampler_t &sampler, std::size_t idx,
+                       std::size_t max_labels)
+    : sampler_(&sampler), idx_(idx),
+      max_labels_(std::max<std::size_t>(max_labels, 1)),
+      id_(next_id.fetch_add(1, relaxed)) {}
+
+profiler_t::~profiler_t() noexcept {
+  std::lock_guard lock{mtx_};
+  for (auto &table : tables_) {
+    table->closed.store(true, relaxed);
+  }
+}
+
+const reader_t &profiler_t::reader() const noexcept {
+  return sampler_ ? sampler_->reader(idx_) : *reader_;
+}
+
+bool profiler_t::read(readings_t &into) const noexcept {
+  if (sampler_) {
+    return sampler_->latest(into, idx_);
+  }
+  std::error_code ec;
+  return reader_->obtain_readings(into, ec);
+}
+
+detail::region_table *profiler_t::local() noexcept {
+  detail::thread_regions &local = detail::local_regions;
+  if (detail::region_table *table = local.find(id_)) {
+    return table;
+  }
+  try {
+    std::shared_ptr<detail::region_table> table;
+    {
+      std::lock_guard lock{mtx_};
+      for (auto &t : tables_) {
+        if (!t->held.load(std::memory_order_acquire)) {
+          t->held.store(true, relaxed);
+          table = t;
+          break;
+        }
+      }
+      if (!table) {
+        table = std::make_shared<detail::region_table>(max_labels_);
+        tables_.push_back(table);
+      }
+    }
+    // held until the thread exits, even if it cannot be tracked
+    local.tables.emplace_back(id_, table);
+    local.last_id = id_;
+    local.last = table.get();
+    return local.last;
+  } catch (const std::bad_alloc &) {
+    return nullptr;
+  }
+}
+
+void profiler_t::record(const char *label, const difference_t *diff) noexcept {
+  detail::region_table *table = local();
+  if (!table) {
+    return;
+  }
+  detail::region_entry *e = table->find(label, max_labels_);
+  if (!e) {
+    add_relaxed(table->dropped, 1);
+    return;
+  }
+  if (!diff) {
+    add_relaxed(e->errors, 1);
+    return;
+  }
+  auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                diff->duration)
+                .count();
+  add_relaxed(e->count, 1);
+  add_relaxed(e->duration, ns > 0 ? static_cast<std::uint64_t>(ns) : 0);
+  add_relaxed(e->energy, diff->energy_consumed.count());
+}
+
+std::vector<region_stats_t> profiler_t::report() const {
+  std::vector<region_stats_t> stats;
+  std::lock_guard lock{mtx_};
+  for (const auto &table : tables_) {
+    for (std::size_t i = 0; i <= table->mask; i++) {
+      const detail::region_entry &e = table->entries[i];
+      const char *label = e.label.load(std::memory_order_acquire);
+      if (!label) {
+        continue;
+      }
+      auto it = std::find_if(stats.begin(), stats.end(), [label](auto &s) {
+        return std::strcmp(s.label.c_str(), label) == 0;
+      });
+      if (it == stats.end()) {
+        it = stats.insert(stats.end(), region_stats_t{label, 0, 0, {}, {}});
+      }
+      it->count += e.count.load(relaxed);
+      it->errors += e.errors.load(relaxed);
+      it->duration += std::chrono::duration_cast<clock_t::duration>(
+          std::chrono::nanoseconds(e.duration.load(relaxed)));
+      it->energy += energy_t{e.energy.load(relaxed)};
+    }
+  }
+  std::sort(stats.begin(), stats.end(), [](const auto &lhs, const auto &rhs) {
+    return lhs.label.compare(rhs.label) < 0;
+  });
+  return stats;
+}
+
+std::uint64_t profiler_t::dropped() const noexcept {
+  std::lock_guard lock{mtx_};
+  std::uint64_t total = 0;
+  for (const auto &table : tables_) {
+    total += table->dropped.load(relaxed);
+  }
+  return total;
+}
+
+region_t::region_t(profiler_t &profiler, const char *label) noexcept
+    : profiler_(&profiler), label_(label), start_{},
+      started_(profiler.read(start_)) {}
+
+void region_t::stop() noexcept {
+  if (!profiler_) {
+    return;
+  }
+  readings_t end;
+  if (started_ && profiler_->read(end)) {
+    difference_t diff = profiler_->reader().subtract(end, start_);
+    profiler_->record(label_, &diff);
+  } else {
+    profiler_->record(label_, nullptr);
+  }
+  profiler_ = nullptr;
+}
+
+} // namespace erd
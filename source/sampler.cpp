@@ -0,0 +1,95 @@
+#include <erd/sampler.hpp>
+
+#include <utility>
+
+namespace erd {
+
+sampler_t::sampler_t(reader_t reader, clock_t::duration period,
+                     std::size_t capacity)
+    : sampler_t(std::vector<reader_t>{std::move(reader)}, period, capacity) {}
+
+sampler_t::sampler_t(std::vector<reader_t> readers, clock_t::duration period,
+                     std::size_t capacity)
+    : readers_(std::move(readers)), period_(period) {
+  for (size_t i = 0; i < readers_.size(); i++) {
+    buffers_.emplace_back(capacity);
+  }
+  thread_ = std::thread{&sampler_t::run, this};
+}
+
+sampler_t::~sampler_t() noexcept { stop(); }
+
+void sampler_t::stop() noexcept {
+  {
+    std::lock_guard lock{mtx_};
+    stop_ = true;
+  }
+  cv_.notify_all();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+}
+
+bool sampler_t::latest(readings_t &into, std::size_t idx) const noexcept {
+  if (!buffers_[idx].latest(into)) {
+    return false;
+  }
+  if (metrics_t::enabled()) {
+    metrics_t::instance().record(metric_t::staleness,
+                                 clock_t::now() - into.timestamp);
+  }
+  return true;
+}
+
+const sampler_t::buffer_t &sampler_t::buffer(std::size_t idx) const noexcept {
+  return buffers_[idx];
+}
+
+const reader_t &sampler_t::reader(std::size_t idx) const noexcept {
+  return readers_[idx];
+}
+
+std::size_t sampler_t::size() const noexcept { return readers_.size(); }
+
+clock_t::duration sampler_t::period() const noexcept { return period_; }
+
+std::uint64_t sampler_t::errors() const noexcept {
+  return errors_.load(std::memory_order_relaxed);
+}
+
+void sampler_t::run() noexcept {
+  bool failing = false;
+  time_point_t next = clock_t::now();
+  std::unique_lock lock{mtx_};
+  while (!stop_) {
+    lock.unlock();
+    bool failed = false;
+    for (size_t i = 0; i < readers_.size(); i++) {
+      readings_t readings;
+      if (std::error_code ec; !readers_[i].obtain_readings(readings, ec)) {
+        errors_.fetch_add(1, std::memory_order_relaxed);
+        // report only the first of consecutive failures
+        if (!failing) {
+          default_error_handler("Sampler error obtaining readings", ec);
+        }
+        failed = true;
+        continue;
+      }
+      buffers_[i].push(readings);
+    }
+    failing = failed;
+
+    // skip the periods missed instead of sampling in bursts to catch up
+    next += period_;
+    if (time_point_t now = clock_t::now(); next < now) {
+      next = now;
+    }
+    lock.lock();
+    if (!cv_.wait_until(lock, next, [this] { return stop_; }) &&
+        metrics_t::enabled()) {
+      metrics_t::instance().record(metric_t::wakeup, clock_t::now() - next);
+    }
+  }
+}
+
+} // namespace erd
@@ -0,0 +1,230 @@
+#include <erd/series.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define ERD_HAVE_AVX2
+#endif
+
+namespace {
+
+using erd::difference_t;
+using erd::readings_t;
+
+// the vector kernels treat samples and differences as pairs of 64-bit words
+static_assert(std::is_standard_layout_v<readings_t> &&
+              sizeof(readings_t) == 2 * sizeof(std::uint64_t) &&
+              offsetof(readings_t, energy) == sizeof(std::uint64_t));
+static_assert(std::is_standard_layout_v<difference_t> &&
+              sizeof(difference_t) == 2 * sizeof(std::uint64_t) &&
+              offsetof(difference_t, energy_consumed) == sizeof(std::uint64_t));
+static_assert(sizeof(erd::watts<double>) == sizeof(double));
+static_assert(sizeof(erd::energy_t::rep) == sizeof(std::uint64_t) &&
+              sizeof(erd::clock_t::rep) == sizeof(std::uint64_t));
+
+// watts in a microjoule per clock tick
+constexpr double WATTS_PER_RATE =
+    1e-6 * static_cast<double>(erd::clock_t::period::den) /
+    static_cast<double>(erd::clock_t::period::num);
+
+std::uint64_t wrapped_delta(std::uint64_t lhs, std::uint64_t rhs,
+                            std::uint64_t max) noexcept {
+  return lhs - rhs + (rhs > lhs ? max : 0);
+}
+
+double to_watts(std::uint64_t energy, erd::clock_t::rep duration) noexcept {
+  return static_cast<double>(energy) / static_cast<double>(duration) *
+         WATTS_PER_RATE;
+}
+
+void subtract_scalar(const readings_t *samples, std::size_t pairs,
+                     std::uint64_t max, difference_t *out) noexcept {
+  for (std::size_t i = 0; i < pairs; i++) {
+    out[i] = difference_t{
+        samples[i + 1].timestamp - samples[i].timestamp,
+        erd::energy_t{wrapped_delta(samples[i + 1].energy.count(),
+                                    samples[i].energy.count(), max)}};
+  }
+}
+
+void power_scalar(const readings_t *samples, std::size_t pairs,
+                  std::uint64_t max, erd::watts<double> *out) noexcept {
+  for (std::size_t i = 0; i < pairs; i++) {
+    out[i] = erd::watts<double>{
+        to_watts(wrapped_delta(samples[i + 1].energy.count(),
+                               samples[i].energy.count(), max),
+                 (samples[i + 1].timestamp - samples[i].timestamp).count())};
+  }
+}
+
+void power_scalar(const difference_t *diffs, std::size_t count,
+                  erd::watts<double> *out) noexcept {
+  for (std::size_t i = 0; i < count; i++) {
+    out[i] = erd::watts<double>{
+        to_watts(diffs[i].energy_consumed.count(), diffs[i].duration.count())};
+  }
+}
+
+#ifdef ERD_HAVE_AVX2
+
+#define ERD_AVX2 __attribute__((target("avx2")))
+
+// four consecutive differences, with lanes in the order 0, 2, 1, 3 as left by
+// de-interleaving the pairs within each 128-bit half
+struct deltas_t {
+  __m256i time;
+  __m256i energy;
+};
+
+ERD_AVX2 inline __m256i load(const void *ptr) noexcept {
+  return _mm256_loadu_si256(static_cast<const __m256i *>(ptr));
+}
+
+ERD_AVX2 inline deltas_t deltas(const readings_t *samples,
+                                __m256i max) noexcept {
+  const __m256i sign =
+      _mm256_set1_epi64x(std::numeric_limits<long long>::min());
+  __m256i rhs_lo = load(samples);
+  __m256i rhs_hi = load(samples + 2);
+  __m256i lhs_lo = load(samples + 1);
+  __m256i lhs_hi = load(samples + 3);
+  __m256i rhs_energy = _mm256_unpackhi_epi64(rhs_lo, rhs_hi);
+  __m256i lhs_energy = _mm256_unpackhi_epi64(lhs_lo, lhs_hi);
+  // no unsigned comparison exists, so both sides are offset by 2^63
+  __m256i wrapped =
+      _mm256_cmpgt_epi64(_mm256_xor_si256(rhs_energy, sign),
+                         _mm256_xor_si256(lhs_energy, sign));
+  return deltas_t{
+      _mm256_sub_epi64(_mm256_unpacklo_epi64(lhs_lo, lhs_hi),
+                       _mm256_unpacklo_epi64(rhs_lo, rhs_hi)),
+      _mm256_add_epi64(_mm256_sub_epi64(lhs_energy, rhs_energy),
+                       _mm256_and_si256(wrapped, max))};
+}
+
+// converts to watts in order, unless a value is negative or at least 2^52,
+// which the exponent trick used instead of a missing conversion cannot take
+ERD_AVX2 inline bool watts(const deltas_t &d, double *out) noexcept {
+  __m256i high = _mm256_srli_epi64(_mm256_or_si256(d.time, d.energy), 52);
+  if (!_mm256_testz_si256(high, high)) {
+    return false;
+  }
+  const __m256i exponent = _mm256_set1_epi64x(0x4330000000000000);
+  const __m256d offset = _mm256_set1_pd(4503599627370496.0);
+  __m256d time = _mm256_sub_pd(
+      _mm256_castsi256_pd(_mm256_or_si256(d.time, exponent)), offset);
+  __m256d energy = _mm256_sub_pd(
+      _mm256_castsi256_pd(_mm256_or_si256(d.energy, exponent)), offset);
+  __m256d w = _mm256_mul_pd(_mm256_div_pd(energy, time),
+                            _mm256_set1_pd(WATTS_PER_RATE));
+  _mm256_storeu_pd(out, _mm256_permute4x64_pd(w, 0xd8));
+  return true;
+}
+
+ERD_AVX2 void subtract_avx2(const readings_t *samples, std::size_t pairs,
+                            std::uint64_t max, difference_t *out) noexcept {
+  const __m256i vmax = _mm256_set1_epi64x(static_cast<long long>(max));
+  std::size_t i = 0;
+  for (; i + 4 <= pairs; i += 4) {
+    deltas_t d = deltas(samples + i, vmax);
+    // interleaving again restores the order of the lanes
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i),
+                        _mm256_unpacklo_epi64(d.time, d.energy));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i + 2),
+                        _mm256_unpackhi_epi64(d.time, d.energy));
+  }
+  subtract_scalar(samples + i, pairs - i, max, out + i);
+}
+
+ERD_AVX2 void power_avx2(const readings_t *samples, std::size_t pairs,
+                         std::uint64_t max, erd::watts<double> *out) noexcept {
+  const __m256i vmax = _mm256_set1_epi64x(static_cast<long long>(max));
+  std::size_t i = 0;
+  for (; i + 4 <= pairs; i += 4) {
+    auto *dest = reinterpret_cast<double *>(out + i);
+    if (!watts(deltas(samples + i, vmax), dest)) {
+      power_scalar(samples + i, 4, max, out + i);
+    }
+  }
+  power_scalar(samples + i, pairs - i, max, out + i);
+}
+
+ERD_AVX2 void power_avx2(const difference_t *diffs, std::size_t count,
+                         erd::watts<double> *out) noexcept {
+  std::size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    __m256i lo = load(diffs + i);
+    __m256i hi = load(diffs + i + 2);
+    deltas_t d{_mm256_unpacklo_epi64(lo, hi), _mm256_unpackhi_epi64(lo, hi)};
+    if (!watts(d, reinterpret_cast<double *>(out + i))) {
+      power_scalar(diffs + i, 4, out + i);
+    }
+  }
+  power_scalar(diffs + i, count - i, out + i);
+}
+
+#undef ERD_AVX2
+
+#endif // ERD_HAVE_AVX2
+
+bool use_avx2() noexcept {
+#ifdef ERD_HAVE_AVX2
+  static const bool supported = [] {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") != 0;
+  }();
+  return supported;
+#else
+  return false;
+#endif
+}
+
+} // namespace
+
+namespace erd {
+
+void subtract_n(const readings_t *samples, std::size_t count,
+                energy_t max_energy, difference_t *out) noexcept {
+  if (count < 2) {
+    return;
+  }
+#ifdef ERD_HAVE_AVX2
+  if (use_avx2()) {
+    subtract_avx2(samples, count - 1, max_energy.count(), out);
+    return;
+  }
+#endif
+  subtract_scalar(samples, count - 1, max_energy.count(), out);
+}
+
+void power_series(const readings_t *samples, std::size_t count,
+                  energy_t max_energy, watts<double> *out) noexcept {
+  if (count < 2) {
+    return;
+  }
+#ifdef ERD_HAVE_AVX2
+  if (use_avx2()) {
+    power_avx2(samples, count - 1, max_energy.count(), out);
+    return;
+  }
+#endif
+  power_scalar(samples, count - 1, max_energy.count(), out);
+}
+
+void power_series(const difference_t *diffs, std::size_t count,
+                  watts<double> *out) noexcept {
+#ifdef ERD_HAVE_AVX2
+  if (use_avx2()) {
+    power_avx2(diffs, count, out);
+    return;
+  }
+#endif
+  power_scalar(diffs, count, out);
+}
+
+bool series_vectorised() noexcept { return use_avx2(); }
+
+} // namespace erd
@@ -0,0 +1,258 @@
+#include <erd/ipc/shared_readings.hpp>
+
+#include <atomic>
+#include <cerrno>
+#include <new>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+// the header and entries are shared between processes, so their atomics must
+// not rely on a lock of this one
+static_assert(std::atomic<uint64_t>::is_always_lock_free);
+
+// bounds the wait for a writer that died in the middle of a store
+constexpr int MAX_LOAD_ATTEMPTS = 1024;
+
+std::error_code get_errno() noexcept {
+  return std::error_code{errno, std::system_category()};
+}
+
+constexpr size_t entries_offset() noexcept {
+  constexpr size_t align = alignof(erd::ipc::detail::shared_entry_t);
+  return (sizeof(erd::ipc::detail::shared_header_t) + align - 1) / align *
+         align;
+}
+
+constexpr size_t segment_size(size_t count) noexcept {
+  return entries_offset() + count * sizeof(erd::ipc::detail::shared_entry_t);
+}
+
+class shm_descriptor {
+  int value_;
+
+public:
+  shm_descriptor(const char *name, int flags, mode_t mode)
+      : value_(shm_open(name, flags, mode)) {
+    if (value_ == -1)
+      throw std::system_error(get_errno());
+  }
+  ~shm_descriptor() noexcept {
+    if (close(value_) == -1)
+      perror("shm_descriptor: error closing shared memory object");
+  }
+
+  shm_descriptor(const shm_descriptor &) = delete;
+  shm_descriptor &operator=(const shm_descriptor &) = delete;
+
+  explicit operator int() const noexcept { return value_; }
+};
+
+void *map_segment(int fd, size_t size, int prot) {
+  void *address = mmap(nullptr, size, prot, MAP_SHARED, fd, 0);
+  if (address == MAP_FAILED)
+    throw std::system_error(get_errno());
+  return address;
+}
+
+// a segment left by a previous writer is unlinked rather than truncated, since
+// readers may still have it mapped and would fault on the truncated pages;
+// they keep the old object until they reopen the name
+erd::ipc::detail::shared_mapping create_segment(const std::string &name,
+                                                size_t count, uint64_t &device,
+                                                uint64_t &inode) {
+  if (shm_unlink(name.c_str()) == -1 && errno != ENOENT)
+    throw std::system_error(get_errno());
+  shm_descriptor fd{name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644};
+  struct stat st;
+  if (fstat(int(fd), &st) == -1)
+    throw std::system_error(get_errno());
+  device = st.st_dev;
+  inode = st.st_ino;
+  size_t size = segment_size(count);
+  if (ftruncate(int(fd), static_cast<off_t>(size)) == -1)
+    throw std::system_error(get_errno());
+  return erd::ipc::detail::shared_mapping{
+      map_segment(int(fd), size, PROT_READ | PROT_WRITE), size};
+}
+
+erd::ipc::detail::shared_mapping open_segment(const std::string &name) {
+  using erd::ipc::detail::shared_header_t;
+  shm_descriptor fd{name.c_str(), O_RDONLY, 0};
+  struct stat st;
+  if (fstat(int(fd), &st) == -1)
+    throw std::system_error(get_errno());
+  auto size = static_cast<size_t>(st.st_size);
+  if (size < entries_offset())
+    throw std::system_error(std::make_error_code(std::errc::bad_message),
+                            "Shared memory segment too small");
+  erd::ipc::detail::shared_mapping mapping{
+      map_segment(int(fd), size, PROT_READ), size};
+  const auto *header = static_cast<const shared_header_t *>(mapping.get());
+  if (header->magic.load(std::memory_order_acquire) !=
+          shared_header_t::magic_value ||
+      header->version != shared_header_t::version_value)
+    throw std::system_error(std::make_error_code(std::errc::bad_message),
+                            "Invalid shared memory segment");
+  if (size < segment_size(header->count))
+    throw std::system_error(std::make_error_code(std::errc::bad_message),
+                            "Truncated shared memory segment");
+  return mapping;
+}
+
+size_t count_of(const erd::ipc::detail::shared_mapping &mapping) noexcept {
+  return static_cast<const erd::ipc::detail::shared_header_t *>(mapping.get())
+      ->count;
+}
+
+// whether the name still refers to the object with the given identity
+bool names_object(const std::string &name, uint64_t device,
+                  uint64_t inode) noexcept {
+  int fd = shm_open(name.c_str(), O_RDONLY, 0);
+  if (fd == -1)
+    return false;
+  struct stat st;
+  bool same = fstat(fd, &st) == 0 && st.st_dev == device && st.st_ino == inode;
+  close(fd);
+  return same;
+}
+
+template <typename Entry> Entry *entries_of(void *segment) noexcept {
+  return reinterpret_cast<Entry *>(static_cast<char *>(segment) +
+                                   entries_offset());
+}
+
+} // namespace
+
+namespace erd::ipc {
+
+namespace detail {
+
+shared_mapping::shared_mapping(void *address, std::size_t size) noexcept
+    : address_(address), size_(size) {}
+
+shared_mapping::~shared_mapping() noexcept {
+  if (address_ && munmap(address_, size_) == -1)
+    perror("shared_mapping: error unmapping shared memory");
+}
+
+shared_mapping::shared_mapping(shared_mapping &&other) noexcept
+    : address_(std::exchange(other.address_, nullptr)),
+      size_(std::exchange(other.size_, 0)) {}
+
+shared_mapping &shared_mapping::operator=(shared_mapping &&other) noexcept {
+  std::swap(address_, other.address_);
+  std::swap(size_, other.size_);
+  return *this;
+}
+
+void *shared_mapping::get() const noexcept { return address_; }
+
+std::size_t shared_mapping::size() const noexcept { return size_; }
+
+} // namespace detail
+
+shared_readings_writer::shared_readings_writer(std::string name,
+                                               std::vector<attributes_t> attrs)
+    : name_(std::move(name)), device_(0), inode_(0),
+      mapping_(create_segment(name_, attrs.size(), device_, inode_)),
+      entries_(entries_of<detail::shared_entry_t>(mapping_.get())),
+      count_(attrs.size()) {
+  for (size_t i = 0; i < count_; i++) {
+    auto *entry = new (entries_ + i) detail::shared_entry_t{};
+    entry->domain = static_cast<uint32_t>(attrs[i].domain);
+    entry->socket = attrs[i].socket;
+  }
+  auto *header = new (mapping_.get()) detail::shared_header_t{};
+  header->version = detail::shared_header_t::version_value;
+  header->count = static_cast<uint32_t>(count_);
+  // the magic value marks the segment as initialised
+  header->magic.store(detail::shared_header_t::magic_value,
+                      std::memory_order_release);
+}
+
+shared_readings_writer::~shared_readings_writer() noexcept {
+  // a later writer of the same name may have replaced it, and its segment
+  // must outlive this one
+  if (!names_object(name_, device_, inode_))
+    return;
+  if (shm_unlink(name_.c_str()) == -1 && errno != ENOENT)
+    perror("shared_readings_writer: error unlinking shared memory");
+}
+
+void shared_readings_writer::publish(std::size_t idx,
+                                     const readings_t &readings) noexcept {
+  auto time = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      readings.timestamp.time_since_epoch());
+  entries_[idx].sample.store(
+      detail::shared_sample_t{time.count(), readings.energy.count()});
+}
+
+std::size_t shared_readings_writer::size() const noexcept { return count_; }
+
+const std::string &shared_readings_writer::name() const noexcept {
+  return name_;
+}
+
+shared_readings_reader::shared_readings_reader(const std::string &name)
+    : mapping_(open_segment(name)),
+      entries_(entries_of<const detail::shared_entry_t>(mapping_.get())),
+      count_(count_of(mapping_)) {}
+
+bool shared_readings_reader::obtain_readings(readings_t &into,
+                                             std::error_code &ec,
+                                             std::size_t idx) const
+    noexcept {
+  if (idx >= count_) {
+    ec = std::make_error_code(std::errc::invalid_argument);
+    return false;
+  }
+  const auto &sample = entries_[idx].sample;
+  if (!sample.version()) {
+    ec = std::make_error_code(std::errc::resource_unavailable_try_again);
+    return false;
+  }
+  detail::shared_sample_t value;
+  for (int i = 0; i < MAX_LOAD_ATTEMPTS; i++) {
+    if (sample.try_load(value)) {
+      into.timestamp = time_point_t{
+          std::chrono::duration_cast<clock_t::duration>(
+              std::chrono::nanoseconds{value.time})};
+      into.energy = energy_t{value.energy};
+      ec.clear();
+      return true;
+    }
+  }
+  ec = std::make_error_code(std::errc::resource_unavailable_try_again);
+  return false;
+}
+
+std::size_t
+shared_readings_reader::find(const attributes_t &attr) const noexcept {
+  for (size_t i = 0; i < count_; i++) {
+    if (entries_[i].domain == static_cast<uint32_t>(attr.domain) &&
+        entries_[i].socket == attr.socket) {
+      return i;
+    }
+  }
+  return count_;
+}
+
+attributes_t shared_readings_reader::attributes(std::size_t idx) const
+    noexcept {
+  return attributes_t{static_cast<domain_t>(entries_[idx].domain),
+                      entries_[idx].socket};
+}
+
+uint64_t shared_readings_reader::version(std::size_t idx) const noexcept {
+  return entries_[idx].sample.version();
+}
+
+std::size_t shared_readings_reader::size() const noexcept { return count_; }
+
+} // namespace erd::ipc
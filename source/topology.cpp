@@ -0,0 +1,314 @@
+#include <erd/topology.hpp>
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <set>
+#include <tuple>
+#include <utility>
+
+#include <dirent.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr char DEFAULT_POWERCAP_ROOT[] = "/sys/class/powercap";
+constexpr char ZONE_PREFIX[] = "intel-rapl:";
+constexpr char BOOT_ID_FILE[] = "/proc/sys/kernel/random/boot_id";
+constexpr char CACHE_MAGIC[] = "erd-topology";
+constexpr int CACHE_VERSION = 3;
+
+constexpr char DOMAIN_PKG_PREFIX[] = "package-";
+constexpr char DOMAIN_DIE_INFIX[] = "-die-";
+constexpr char DOMAIN_PP0[] = "core";
+constexpr char DOMAIN_PP1[] = "uncore";
+constexpr char DOMAIN_DRAM[] = "dram";
+
+std::error_code get_errno() noexcept {
+  return std::error_code{errno, std::system_category()};
+}
+
+bool starts_with(std::string_view str, std::string_view prefix) noexcept {
+  return str.substr(0, prefix.size()) == prefix;
+}
+
+// first line of a sysfs file, or an empty string if it cannot be read
+std::string read_line(const std::string &path) {
+  std::ifstream file{path};
+  std::string line;
+  std::getline(file, line);
+  return line;
+}
+
+// empty if unknown, in which case caches are never loaded
+std::string boot_id() { return read_line(BOOT_ID_FILE); }
+
+bool domain_from_name(std::string_view name, erd::domain_t &into) noexcept {
+  if (starts_with(name, DOMAIN_PKG_PREFIX)) {
+    into = erd::domain_t::package;
+  } else if (name == DOMAIN_PP0) {
+    into = erd::domain_t::cores;
+  } else if (name == DOMAIN_PP1) {
+    into = erd::domain_t::uncore;
+  } else if (name == DOMAIN_DRAM) {
+    into = erd::domain_t::dram;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+// package-N, or package-N-die-M on packages with several dies
+bool package_from_name(std::string_view name, uint32_t &package,
+                       uint32_t &die) noexcept {
+  if (!starts_with(name, DOMAIN_PKG_PREFIX)) {
+    return false;
+  }
+  const char *first = name.data() + sizeof(DOMAIN_PKG_PREFIX) - 1;
+  const char *last = name.data() + name.size();
+  auto [ptr, err] = std::from_chars(first, last, package);
+  if (err != std::errc{}) {
+    return false;
+  }
+  die = 0;
+  if (ptr == last) {
+    return true;
+  }
+  std::string_view rest{ptr, static_cast<size_t>(last - ptr)};
+  if (!starts_with(rest, DOMAIN_DIE_INFIX)) {
+    return false;
+  }
+  first = ptr + sizeof(DOMAIN_DIE_INFIX) - 1;
+  auto result = std::from_chars(first, last, die);
+  return result.ec == std::errc{} && result.ptr == last;
+}
+
+// the X of intel-rapl:X and intel-rapl:X:Y
+bool zone_index(std::string_view entry, uint32_t &into) noexcept {
+  const char *first = entry.data() + sizeof(ZONE_PREFIX) - 1;
+  auto [ptr, err] =
+      std::from_chars(first, entry.data() + entry.size(), into);
+  return err == std::errc{};
+}
+
+struct zone_entry {
+  std::string path;
+  uint32_t index;
+  std::string name;
+};
+
+// the package and die of a top-level zone
+struct die_entry {
+  uint32_t index;
+  uint32_t package;
+  uint32_t die;
+};
+
+std::vector<zone_entry> list_zones(const char *root) {
+  std::unique_ptr<DIR, int (*)(DIR *)> dir{opendir(root), closedir};
+  if (!dir)
+    throw std::system_error(get_errno(), root);
+  std::vector<zone_entry> entries;
+  while (const dirent *ent = readdir(dir.get())) {
+    std::string_view entry = ent->d_name;
+    uint32_t index;
+    if (!starts_with(entry, ZONE_PREFIX) || !zone_index(entry, index)) {
+      continue;
+    }
+    std::string path = fmt::format("{}/{}", root, entry);
+    entries.push_back({path, index, read_line(path + "/name")});
+  }
+  return entries;
+}
+
+uint64_t parse_uint64(const std::string &value) noexcept {
+  uint64_t retval = 0;
+  std::from_chars(value.data(), value.data() + value.size(), retval);
+  return retval;
+}
+
+} // namespace
+
+namespace erd {
+
+topology_t::topology_t(std::vector<zone_t> zones) : zones_(std::move(zones)) {}
+
+std::string topology_t::default_root() {
+  const char *env = std::getenv("ERD_POWERCAP_ROOT");
+  return env && *env ? env : DEFAULT_POWERCAP_ROOT;
+}
+
+topology_t topology_t::discover(const std::string &root) {
+  std::vector<zone_entry> entries = list_zones(root.c_str());
+  // subzones belong to the die of the top-level zone with the same index
+  std::vector<die_entry> dies;
+  for (const zone_entry &e : entries) {
+    if (uint32_t pkg, die; package_from_name(e.name, pkg, die)) {
+      dies.push_back({e.index, pkg, die});
+    }
+  }
+  std::vector<std::pair<zone_t, uint32_t>> found;
+  for (zone_entry &e : entries) {
+    domain_t domain;
+    if (!domain_from_name(e.name, domain)) {
+      continue;
+    }
+    auto die = std::find_if(dies.begin(), dies.end(),
+                            [&e](auto &d) { return d.index == e.index; });
+    if (die == dies.end()) {
+      continue;
+    }
+    energy_t max_energy{
+        parse_uint64(read_line(e.path + "/max_energy_range_uj"))};
+    found.emplace_back(zone_t{attributes_t{domain, die->package},
+                              std::move(e.path), std::move(e.name),
+                              max_energy, {}},
+                       die->die);
+  }
+  std::sort(found.begin(), found.end(), [](const auto &l, const auto &r) {
+    return std::make_tuple(l.first.attr.socket, l.first.attr.domain,
+                           l.second) <
+           std::make_tuple(r.first.attr.socket, r.first.attr.domain,
+                           r.second);
+  });
+  // the zones of the other dies join that of the first
+  std::vector<zone_t> zones;
+  for (auto &[zone, die] : found) {
+    if (zones.empty() || zones.back().attr.socket != zone.attr.socket ||
+        zones.back().attr.domain != zone.attr.domain) {
+      zones.push_back(std::move(zone));
+    } else if (zones.back().max_energy == zone.max_energy) {
+      zones.back().dies.push_back(std::move(zone.path));
+    }
+  }
+  return topology_t{std::move(zones)};
+}
+
+const topology_t &topology_t::instance() {
+  static const topology_t topology = [] {
+    const char *cache = std::getenv("ERD_TOPOLOGY_CACHE");
+    if (!cache || !*cache) {
+      return discover(default_root());
+    }
+    topology_t retval;
+    if (std::error_code ec; load(cache, retval, ec)) {
+      return retval;
+    }
+    retval = discover(default_root());
+    if (std::error_code ec; !retval.save(cache, ec)) {
+      default_error_handler("Error writing topology cache", ec);
+    }
+    return retval;
+  }();
+  return topology;
+}
+
+bool topology_t::load(const std::string &file, topology_t &into,
+                      std::error_code &ec) {
+  std::ifstream in{file};
+  if (!in) {
+    ec = std::make_error_code(std::errc::no_such_file_or_directory);
+    return false;
+  }
+  std::string magic;
+  int version;
+  std::string boot;
+  std::string root;
+  size_t count;
+  if (!(in >> magic >> version >> std::quoted(boot) >> std::quoted(root) >>
+        count) ||
+      magic != CACHE_MAGIC || version != CACHE_VERSION ||
+      boot.compare(boot_id()) || root.compare(default_root())) {
+    ec = std::make_error_code(std::errc::invalid_argument);
+    return false;
+  }
+  std::vector<zone_t> zones;
+  for (size_t i = 0; i < count; i++) {
+    zone_t zone;
+    int domain;
+    uint64_t max_energy;
+    size_t dies;
+    if (!(in >> zone.attr.socket >> domain >> max_energy >>
+          std::quoted(zone.path) >> std::quoted(zone.name) >> dies) ||
+        domain < 0 || domain > static_cast<int>(domain_t::dram)) {
+      ec = std::make_error_code(std::errc::invalid_argument);
+      return false;
+    }
+    for (size_t j = 0; j < dies; j++) {
+      if (!(in >> std::quoted(zone.dies.emplace_back()))) {
+        ec = std::make_error_code(std::errc::invalid_argument);
+        return false;
+      }
+    }
+    zone.attr.domain = static_cast<domain_t>(domain);
+    zone.max_energy = energy_t{max_energy};
+    zones.push_back(std::move(zone));
+  }
+  into = topology_t{std::move(zones)};
+  ec.clear();
+  return true;
+}
+
+// written to a temporary file first, so that concurrent processes never load
+// a partial cache
+bool topology_t::save(const std::string &file, std::error_code &ec) const {
+  std::string tmp = fmt::format("{}.{}", file, getpid());
+  {
+    std::ofstream out{tmp, std::ios::trunc};
+    std::string boot = boot_id();
+    // paths are quoted, since they may hold spaces
+    out << CACHE_MAGIC << ' ' << CACHE_VERSION << ' '
+        << std::quoted(boot.empty() ? "-" : boot) << ' '
+        << std::quoted(default_root()) << ' ' << zones_.size() << '\n';
+    for (const zone_t &zone : zones_) {
+      out << zone.attr.socket << ' ' << static_cast<int>(zone.attr.domain)
+          << ' ' << zone.max_energy.count() << ' ' << std::quoted(zone.path)
+          << ' ' << std::quoted(zone.name) << ' ' << zone.dies.size();
+      for (const std::string &die : zone.dies) {
+        out << ' ' << std::quoted(die);
+      }
+      out << '\n';
+    }
+    if (!out.flush()) {
+      ec = std::make_error_code(std::errc::io_error);
+      std::remove(tmp.c_str());
+      return false;
+    }
+  }
+  if (std::rename(tmp.c_str(), file.c_str())) {
+    ec = get_errno();
+    std::remove(tmp.c_str());
+    return false;
+  }
+  ec.clear();
+  return true;
+}
+
+const zone_t *topology_t::find(const attributes_t &attr) const noexcept {
+  for (const zone_t &zone : zones_) {
+    if (zone.attr.domain == attr.domain && zone.attr.socket == attr.socket) {
+      return &zone;
+    }
+  }
+  return nullptr;
+}
+
+const std::vector<zone_t> &topology_t::zones() const noexcept {
+  return zones_;
+}
+
+std::uint32_t topology_t::sockets() const noexcept {
+  std::set<uint32_t> packages;
+  for (const zone_t &zone : zones_) {
+    packages.insert(zone.attr.socket);
+  }
+  return static_cast<uint32_t>(packages.size());
+}
+
+} // namespace erd
@@ -0,0 +1,655 @@
+#include <erd/clock.hpp>
+#include <erd/codec.hpp>
+#include <erd/trace.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <iterator>
+#include <limits>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace {
+
+using erd::detail::trace_chunk_header_t;
+using erd::detail::trace_footer_t;
+using erd::detail::trace_header_t;
+using erd::detail::trace_index_entry_t;
+using erd::detail::trace_series_entry_t;
+
+// bounds the interval between drains of a sampler, and so what a crash loses
+constexpr erd::clock_t::duration MAX_RECORD_PERIOD = std::chrono::seconds(1);
+
+std::error_code get_errno() noexcept {
+  return std::error_code{errno, std::system_category()};
+}
+
+std::int64_t to_ns(erd::time_point_t tp) noexcept {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             tp.time_since_epoch())
+      .count();
+}
+
+erd::time_point_t from_ns(std::int64_t ns) noexcept {
+  return erd::time_point_t{std::chrono::duration_cast<erd::clock_t::duration>(
+      std::chrono::nanoseconds{ns})};
+}
+
+// the unbounded ends of a query range are not representable in nanoseconds
+std::int64_t bound_to_ns(erd::time_point_t tp) noexcept {
+  if (tp == erd::time_point_t::min()) {
+    return std::numeric_limits<std::int64_t>::min();
+  }
+  if (tp == erd::time_point_t::max()) {
+    return std::numeric_limits<std::int64_t>::max();
+  }
+  return to_ns(tp);
+}
+
+constexpr std::uint64_t chunk_bytes(std::uint64_t count) noexcept {
+  return sizeof(trace_chunk_header_t) +
+         count * (sizeof(std::int64_t) + sizeof(std::uint64_t));
+}
+
+// rounds up to the alignment of every offset in a trace
+constexpr std::uint64_t padded(std::uint64_t size) noexcept {
+  return (size + 7) & ~std::uint64_t{7};
+}
+
+constexpr std::uint64_t chunks_offset(std::uint64_t series_count) noexcept {
+  return sizeof(trace_header_t) + series_count * sizeof(trace_series_entry_t);
+}
+
+// writes every byte, resuming after interruptions and short writes
+bool write_all(int fd, iovec *iov, int iovcnt, std::error_code &ec) noexcept {
+  while (iovcnt > 0) {
+    ssize_t written = writev(fd, iov, iovcnt);
+    if (written == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      ec = get_errno();
+      return false;
+    }
+    auto left = static_cast<std::size_t>(written);
+    while (iovcnt > 0 && left >= iov->iov_len) {
+      left -= iov->iov_len;
+      iov++;
+      iovcnt--;
+    }
+    if (iovcnt > 0) {
+      iov->iov_base = static_cast<char *>(iov->iov_base) + left;
+      iov->iov_len -= left;
+    }
+  }
+  ec.clear();
+  return true;
+}
+
+int create_file(const std::string &path) {
+  int fd = open(path.c_str(), O_CREAT | O_TRUNC | O_WRONLY | O_CLOEXEC, 0644);
+  if (fd == -1) {
+    throw std::system_error(get_errno(), "Error creating trace " + path);
+  }
+  return fd;
+}
+
+void close_file(int fd) noexcept {
+  if (fd >= 0 && ::close(fd) == -1) {
+    perror("trace_writer_t: error closing file");
+  }
+}
+
+[[noreturn]] void throw_invalid(const char *msg) {
+  throw std::system_error(std::make_error_code(std::errc::bad_message), msg);
+}
+
+erd::ipc::detail::shared_mapping map_file(const std::string &path) {
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    throw std::system_error(get_errno(), "Error opening trace " + path);
+  }
+  struct stat st;
+  if (fstat(fd, &st) == -1) {
+    std::error_code ec = get_errno();
+    ::close(fd);
+    throw std::system_error(ec, "Error opening trace " + path);
+  }
+  auto size = static_cast<std::size_t>(st.st_size);
+  if (size < sizeof(trace_header_t)) {
+    ::close(fd);
+    throw_invalid("Trace too small");
+  }
+  void *address = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  std::error_code ec = get_errno();
+  ::close(fd);
+  if (address == MAP_FAILED) {
+    throw std::system_error(ec, "Error mapping trace " + path);
+  }
+  return erd::ipc::detail::shared_mapping{address, size};
+}
+
+template <typename T>
+const T *at(const erd::ipc::detail::shared_mapping &mapping,
+            std::uint64_t offset) noexcept {
+  return reinterpret_cast<const T *>(static_cast<const char *>(mapping.get()) +
+                                     offset);
+}
+
+// whether the chunk described by chunk lies at offset within end, and if so
+// its size; the size of a compressed chunk is read from the mapping
+bool valid_chunk(const erd::ipc::detail::shared_mapping &mapping,
+                 const trace_chunk_header_t &chunk, std::uint64_t offset,
+                 std::uint64_t end, std::uint32_t series_count,
+                 erd::trace_encoding_t encoding,
+                 std::uint64_t &bytes) noexcept {
+  if (chunk.series >= series_count || !chunk.count || offset > end) {
+    return false;
+  }
+  if (encoding == erd::trace_encoding_t::raw) {
+    bytes = chunk_bytes(chunk.count);
+    return bytes <= end - offset;
+  }
+  constexpr std::uint64_t prefix =
+      sizeof(trace_chunk_header_t) + sizeof(std::uint64_t);
+  if (end - offset < prefix) {
+    return false;
+  }
+  std::uint64_t size =
+      *at<std::uint64_t>(mapping, offset + sizeof(trace_chunk_header_t));
+  if (size > end - offset - prefix) {
+    return false;
+  }
+  bytes = padded(prefix + size);
+  return bytes <= end - offset;
+}
+
+// the index written on close, if intact
+bool read_index(const erd::ipc::detail::shared_mapping &mapping,
+                std::uint64_t size, std::uint32_t series_count,
+                erd::trace_encoding_t encoding,
+                std::vector<trace_index_entry_t> &index) {
+  std::uint64_t first = chunks_offset(series_count);
+  if (size < first + sizeof(trace_footer_t)) {
+    return false;
+  }
+  const auto &footer =
+      *at<trace_footer_t>(mapping, size - sizeof(trace_footer_t));
+  std::uint64_t end = size - sizeof(trace_footer_t);
+  if (footer.magic != trace_footer_t::magic_value ||
+      footer.index_offset < first || footer.index_offset > end ||
+      footer.chunk_count >
+          (end - footer.index_offset) / sizeof(trace_index_entry_t)) {
+    return false;
+  }
+  const auto *entries =
+      at<trace_index_entry_t>(mapping, footer.index_offset);
+  for (std::uint64_t i = 0; i < footer.chunk_count; i++) {
+    std::uint64_t bytes;
+    if (!valid_chunk(mapping, entries[i].chunk, entries[i].offset,
+                     footer.index_offset, series_count, encoding, bytes)) {
+      return false;
+    }
+  }
+  index.assign(entries, entries + footer.chunk_count);
+  return true;
+}
+
+// walks the chunks of a trace whose writer did not close it
+std::vector<trace_index_entry_t>
+scan_chunks(const erd::ipc::detail::shared_mapping &mapping,
+            std::uint64_t size, std::uint32_t series_count,
+            erd::trace_encoding_t encoding) {
+  std::vector<trace_index_entry_t> index;
+  std::uint64_t offset = chunks_offset(series_count);
+  while (size - offset >= sizeof(trace_chunk_header_t)) {
+    const auto &chunk = *at<trace_chunk_header_t>(mapping, offset);
+    std::uint64_t bytes;
+    if (!valid_chunk(mapping, chunk, offset, size, series_count, encoding,
+                     bytes)) {
+      break;
+    }
+    index.push_back(trace_index_entry_t{chunk, offset});
+    offset += bytes;
+  }
+  return index;
+}
+
+std::vector<erd::trace_series_t> series_of(const erd::sampler_t &sampler) {
+  std::vector<erd::trace_series_t> retval;
+  retval.reserve(sampler.size());
+  for (std::size_t i = 0; i < sampler.size(); i++) {
+    retval.push_back(erd::trace_series_t{
+        sampler.reader(i).attributes(), sampler.reader(i).max_energy()});
+  }
+  return retval;
+}
+
+} // namespace
+
+namespace erd {
+
+readings_t trace_span_t::readings(std::size_t idx) const noexcept {
+  return readings_t{from_ns(time[idx]), energy_t{energy[idx]}};
+}
+
+trace_writer_t::trace_writer_t(const std::string &path,
+                               std::vector<trace_series_t> series,
+                               std::size_t chunk_size,
+                               trace_encoding_t encoding)
+    : fd_(-1), series_(std::move(series)),
+      chunk_size_(std::clamp<std::size_t>(
+          chunk_size, 1, std::numeric_limits<std::uint32_t>::max())),
+      encoding_(encoding), buffers_(series_.size()),
+      offset_(chunks_offset(series_.size())) {
+  for (detail::trace_buffer_t &buffer : buffers_) {
+    buffer.time.reserve(chunk_size_);
+    buffer.energy.reserve(chunk_size_);
+  }
+  if (encoding_ == trace_encoding_t::compressed) {
+    encoded_.reserve(padded(codec::max_block_size(chunk_size_)));
+  }
+  detail::trace_header_t header{};
+  header.magic = detail::trace_header_t::magic_value;
+  header.version = detail::trace_header_t::version_value;
+  header.series_count = static_cast<std::uint32_t>(series_.size());
+  header.chunk_size = static_cast<std::uint32_t>(chunk_size_);
+  header.encoding = static_cast<std::uint32_t>(encoding_);
+  time_point_t now = clock_t::now();
+  header.realtime_offset =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          to_realtime(now).time_since_epoch())
+          .count() -
+      to_ns(now);
+  std::vector<detail::trace_series_entry_t> entries;
+  entries.reserve(series_.size());
+  for (const trace_series_t &s : series_) {
+    entries.push_back(detail::trace_series_entry_t{
+        static_cast<std::uint32_t>(s.attributes.domain), s.attributes.socket,
+        s.max_energy.count()});
+  }
+  fd_ = create_file(path);
+  iovec iov[] = {
+      {&header, sizeof(header)},
+      {entries.data(), entries.size() * sizeof(entries[0])},
+  };
+  if (std::error_code ec; !write_all(fd_, iov, 2, ec)) {
+    close_file(fd_);
+    throw std::system_error(ec, "Error writing trace header");
+  }
+}
+
+trace_writer_t::~trace_writer_t() noexcept {
+  if (fd_ < 0) {
+    return;
+  }
+  if (std::error_code ec; !close(ec)) {
+    default_error_handler("Error closing trace", ec);
+    close_file(fd_);
+  }
+}
+
+trace_writer_t::trace_writer_t(trace_writer_t &&other) noexcept
+    : fd_(std::exchange(other.fd_, -1)), series_(std::move(other.series_)),
+      chunk_size_(other.chunk_size_), encoding_(other.encoding_),
+      buffers_(std::move(other.buffers_)), index_(std::move(other.index_)),
+      encoded_(std::move(other.encoded_)), offset_(other.offset_),
+      error_(other.error_) {}
+
+trace_writer_t &trace_writer_t::operator=(trace_writer_t &&other) noexcept {
+  std::swap(fd_, other.fd_);
+  std::swap(series_, other.series_);
+  std::swap(chunk_size_, other.chunk_size_);
+  std::swap(encoding_, other.encoding_);
+  std::swap(buffers_, other.buffers_);
+  std::swap(index_, other.index_);
+  std::swap(encoded_, other.encoded_);
+  std::swap(offset_, other.offset_);
+  std::swap(error_, other.error_);
+  return *this;
+}
+
+bool trace_writer_t::append(std::size_t idx, const readings_t &readings,
+                            std::error_code &ec) noexcept {
+  if (fd_ < 0 || idx >= buffers_.size()) {
+    ec = std::make_error_code(fd_ < 0 ? std::errc::bad_file_descriptor
+                                      : std::errc::invalid_argument);
+    return false;
+  }
+  if (error_) {
+    ec = error_;
+    return false;
+  }
+  detail::trace_buffer_t &buffer = buffers_[idx];
+  buffer.time.push_back(to_ns(readings.timestamp));
+  buffer.energy.push_back(readings.energy.count());
+  if (buffer.time.size() >= chunk_size_) {
+    return write_chunk(idx, ec);
+  }
+  ec.clear();
+  return true;
+}
+
+bool trace_writer_t::flush(std::error_code &ec) noexcept {
+  if (fd_ < 0) {
+    ec = std::make_error_code(std::errc::bad_file_descriptor);
+    return false;
+  }
+  if (error_) {
+    ec = error_;
+    return false;
+  }
+  for (std::size_t i = 0; i < buffers_.size(); i++) {
+    if (!buffers_[i].time.empty() && !write_chunk(i, ec)) {
+      return false;
+    }
+  }
+  ec.clear();
+  return true;
+}
+
+bool trace_writer_t::close(std::error_code &ec) noexcept {
+  if (!flush(ec)) {
+    // an index cannot be trusted after a failed write, so the file is left
+    // to be read by scanning its chunks
+    if (error_) {
+      close_file(std::exchange(fd_, -1));
+    }
+    return false;
+  }
+  detail::trace_footer_t footer{offset_, index_.size(),
+                                detail::trace_footer_t::magic_value};
+  iovec iov[] = {
+      {index_.data(), index_.size() * sizeof(index_[0])},
+      {&footer, sizeof(footer)},
+  };
+  if (!write_all(fd_, iov, 2, ec)) {
+    error_ = ec;
+    close_file(std::exchange(fd_, -1));
+    return false;
+  }
+  if (::close(std::exchange(fd_, -1)) == -1) {
+    ec = get_errno();
+    return false;
+  }
+  return true;
+}
+
+const trace_series_t &trace_writer_t::series(std::size_t idx) const noexcept {
+  return series_[idx];
+}
+
+std::size_t trace_writer_t::size() const noexcept { return series_.size(); }
+
+bool trace_writer_t::write_chunk(std::size_t idx,
+                                 std::error_code &ec) noexcept {
+  detail::trace_buffer_t &buffer = buffers_[idx];
+  auto count = static_cast<std::uint32_t>(buffer.time.size());
+  detail::trace_chunk_header_t chunk{static_cast<std::uint32_t>(idx), count,
+                                     buffer.time.front(), buffer.time.back()};
+  std::uint64_t block_size = 0;
+  iovec iov[] = {
+      {&chunk, sizeof(chunk)},
+      {buffer.time.data(), count * sizeof(std::int64_t)},
+      {buffer.energy.data(), count * sizeof(std::uint64_t)},
+  };
+  if (encoding_ == trace_encoding_t::compressed) {
+    encoded_.clear();
+    codec::encode(buffer.time.data(), buffer.energy.data(), count, encoded_);
+    block_size = encoded_.size();
+    // zeroes the padding
+    encoded_.resize(padded(sizeof(block_size) + block_size) -
+                    sizeof(block_size));
+    iov[1] = {&block_size, sizeof(block_size)};
+    iov[2] = {encoded_.data(), encoded_.size()};
+  }
+  if (!write_all(fd_, iov, 3, ec)) {
+    error_ = ec;
+    return false;
+  }
+  index_.push_back(detail::trace_index_entry_t{chunk, offset_});
+  offset_ += sizeof(chunk) + iov[1].iov_len + iov[2].iov_len;
+  buffer.time.clear();
+  buffer.energy.clear();
+  return true;
+}
+
+trace_reader_t::trace_reader_t(const std::string &path)
+    : mapping_(map_file(path)) {
+  std::uint64_t size = mapping_.size();
+  const auto &header = *at<detail::trace_header_t>(mapping_, 0);
+  if (header.magic != detail::trace_header_t::magic_value ||
+      header.version != detail::trace_header_t::version_value) {
+    throw_invalid("Invalid trace");
+  }
+  if (size < chunks_offset(header.series_count)) {
+    throw_invalid("Truncated trace");
+  }
+  if (header.encoding >
+      static_cast<std::uint32_t>(trace_encoding_t::compressed)) {
+    throw_invalid("Unsupported trace encoding");
+  }
+  realtime_offset_ = header.realtime_offset;
+  encoding_ = static_cast<trace_encoding_t>(header.encoding);
+  const auto *entries =
+      at<detail::trace_series_entry_t>(mapping_, sizeof(header));
+  for (std::uint32_t i = 0; i < header.series_count; i++) {
+    series_.push_back(trace_series_t{
+        attributes_t{static_cast<domain_t>(entries[i].domain),
+                     entries[i].socket},
+        energy_t{entries[i].max_energy}});
+  }
+  std::vector<detail::trace_index_entry_t> index;
+  complete_ =
+      read_index(mapping_, size, header.series_count, encoding_, index);
+  if (!complete_) {
+    index = scan_chunks(mapping_, size, header.series_count, encoding_);
+  }
+  chunks_.resize(series_.size());
+  for (const detail::trace_index_entry_t &entry : index) {
+    chunks_[entry.chunk.series].push_back(entry);
+  }
+  if (encoding_ == trace_encoding_t::compressed) {
+    decoded_.resize(series_.size());
+    for (std::size_t i = 0; i < series_.size(); i++) {
+      decoded_[i].resize(chunks_[i].size());
+    }
+  }
+}
+
+const trace_series_t &trace_reader_t::series(std::size_t idx) const noexcept {
+  return series_[idx];
+}
+
+std::size_t trace_reader_t::size() const noexcept { return series_.size(); }
+
+std::size_t trace_reader_t::sample_count(std::size_t idx) const noexcept {
+  std::size_t count = 0;
+  for (const detail::trace_index_entry_t &entry : chunks_[idx]) {
+    count += entry.chunk.count;
+  }
+  return count;
+}
+
+std::vector<trace_span_t> trace_reader_t::spans(std::size_t idx,
+                                                time_point_t from,
+                                                time_point_t to) const {
+  std::int64_t first = bound_to_ns(from);
+  std::int64_t last = bound_to_ns(to);
+  const auto &chunks = chunks_[idx];
+  // chunks are in time order, so those overlapping the range are contiguous
+  auto it = std::partition_point(
+      chunks.begin(), chunks.end(),
+      [first](const detail::trace_index_entry_t &entry) {
+        return entry.chunk.last < first;
+      });
+  std::vector<trace_span_t> retval;
+  for (; it != chunks.end() && it->chunk.first <= last; ++it) {
+    trace_span_t whole =
+        span(idx, static_cast<std::size_t>(it - chunks.begin()));
+    const std::int64_t *begin =
+        std::lower_bound(whole.time, whole.time + whole.count, first);
+    const std::int64_t *end =
+        std::upper_bound(begin, whole.time + whole.count, last);
+    if (begin == end) {
+      continue;
+    }
+    auto offset = static_cast<std::size_t>(begin - whole.time);
+    retval.push_back(trace_span_t{begin, whole.energy + offset,
+                                  static_cast<std::size_t>(end - begin)});
+  }
+  return retval;
+}
+
+std::vector<readings_t> trace_reader_t::readings(std::size_t idx,
+                                                 time_point_t from,
+                                                 time_point_t to) const {
+  std::vector<trace_span_t> found = spans(idx, from, to);
+  std::size_t count = 0;
+  for (const trace_span_t &s : found) {
+    count += s.count;
+  }
+  std::vector<readings_t> retval;
+  retval.reserve(count);
+  for (const trace_span_t &s : found) {
+    for (std::size_t i = 0; i < s.count; i++) {
+      retval.push_back(s.readings(i));
+    }
+  }
+  return retval;
+}
+
+std::chrono::system_clock::time_point
+trace_reader_t::realtime(time_point_t tp) const noexcept {
+  using std::chrono::system_clock;
+  return system_clock::time_point{
+      std::chrono::duration_cast<system_clock::duration>(
+          std::chrono::nanoseconds{to_ns(tp) + realtime_offset_})};
+}
+
+bool trace_reader_t::complete() const noexcept { return complete_; }
+
+trace_encoding_t trace_reader_t::encoding() const noexcept { return encoding_; }
+
+trace_span_t trace_reader_t::span(std::size_t idx, std::size_t chunk) const {
+  const detail::trace_index_entry_t &entry = chunks_[idx][chunk];
+  std::uint64_t data_offset = entry.offset + sizeof(entry.chunk);
+  if (encoding_ == trace_encoding_t::raw) {
+    return trace_span_t{
+        at<std::int64_t>(mapping_, data_offset),
+        at<std::uint64_t>(mapping_, data_offset + entry.chunk.count *
+                                                      sizeof(std::int64_t)),
+        entry.chunk.count};
+  }
+  std::lock_guard lock{decoded_mtx_};
+  std::unique_ptr<detail::trace_buffer_t> &buffer = decoded_[idx][chunk];
+  if (!buffer) {
+    // the size was validated when the chunk was found
+    const auto *data = at<std::uint8_t>(mapping_, data_offset +
+                                                      sizeof(std::uint64_t));
+    const std::uint8_t *end =
+        data + *at<std::uint64_t>(mapping_, data_offset);
+    auto decoded = std::make_unique<detail::trace_buffer_t>();
+    decoded->time.resize(entry.chunk.count);
+    decoded->energy.resize(entry.chunk.count);
+    std::size_t count;
+    std::error_code ec;
+    if (!codec::block_count(data, static_cast<std::size_t>(end - data), count,
+                            ec) ||
+        count != entry.chunk.count ||
+        !codec::decode(data, end, decoded->time.data(),
+                       decoded->energy.data(), count, ec)) {
+      throw_invalid("Corrupt trace chunk");
+    }
+    buffer = std::move(decoded);
+  }
+  return trace_span_t{buffer->time.data(), buffer->energy.data(),
+                      entry.chunk.count};
+}
+
+trace_recorder_t::trace_recorder_t(const sampler_t &sampler,
+                                   const std::string &path,
+                                   std::size_t chunk_size,
+                                   trace_encoding_t encoding)
+    : sampler_(sampler),
+      writer_(path, series_of(sampler), chunk_size, encoding),
+      cursors_(sampler.size()) {
+  // draining when a quarter of the buffer is filled leaves room for late
+  // wakeups
+  auto quarter = static_cast<clock_t::rep>(sampler.buffer().capacity() / 4);
+  period_ = std::clamp(sampler.period() * quarter, sampler.period(),
+                       MAX_RECORD_PERIOD);
+  thread_ = std::thread{&trace_recorder_t::run, this};
+}
+
+trace_recorder_t::~trace_recorder_t() noexcept { stop(); }
+
+void trace_recorder_t::stop() noexcept {
+  {
+    std::lock_guard lock{mtx_};
+    if (stop_) {
+      return;
+    }
+    stop_ = true;
+  }
+  cv_.notify_all();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+}
+
+std::uint64_t trace_recorder_t::lost() const noexcept {
+  return lost_.load(std::memory_order_relaxed);
+}
+
+bool trace_recorder_t::record(std::vector<readings_t> &scratch,
+                              std::error_code &ec) noexcept {
+  for (std::size_t i = 0; i < cursors_.size(); i++) {
+    std::uint64_t start = cursors_[i];
+    scratch.clear();
+    sampler_.drain(cursors_[i], std::back_inserter(scratch), i);
+    lost_.fetch_add(cursors_[i] - start - scratch.size(),
+                    std::memory_order_relaxed);
+    for (const readings_t &readings : scratch) {
+      if (!writer_.append(i, readings, ec)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+void trace_recorder_t::run() noexcept {
+  bool failing = false;
+  auto record_all = [this, &failing](std::vector<readings_t> &scratch) {
+    if (std::error_code ec; !record(scratch, ec)) {
+      // report only the first of consecutive failures
+      if (!failing) {
+        default_error_handler("Recorder error writing trace", ec);
+      }
+      failing = true;
+    } else {
+      failing = false;
+    }
+  };
+  std::vector<readings_t> scratch;
+  scratch.reserve(sampler_.buffer().capacity());
+  std::unique_lock lock{mtx_};
+  while (!cv_.wait_for(lock, period_, [this] { return stop_; })) {
+    lock.unlock();
+    record_all(scratch);
+    lock.lock();
+  }
+  lock.unlock();
+  record_all(scratch);
+  if (std::error_code ec; !writer_.close(ec)) {
+    default_error_handler("Recorder error closing trace", ec);
+  }
+}
+
+} // namespace erd
@@ -0,0 +1,152 @@
+#include <doctest/doctest.h>
+#include <erd/accumulator.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <thread>
+
+namespace {
+
+using namespace std::chrono_literals;
+
+// what the copies of a manual_reader_t share
+struct manual_state_t {
+  std::atomic<std::uint64_t> counter{0};
+  std::atomic<bool> failing{false};
+};
+
+// a reader whose counter the test sets, wrapping around at max_energy
+class manual_reader_t {
+public:
+  static constexpr const char *backend_name = "manual";
+
+  manual_reader_t(erd::energy_t max_energy,
+                  std::shared_ptr<manual_state_t> state)
+      : max_energy_(max_energy), state_(std::move(state)) {}
+
+  bool obtain_readings(erd::readings_t &into,
+                       std::error_code &ec) const noexcept {
+    if (state_->failing) {
+      ec = std::make_error_code(std::errc::io_error);
+      return false;
+    }
+    into.timestamp = erd::now();
+    into.energy = erd::energy_t{state_->counter};
+    return true;
+  }
+
+  [[nodiscard]] erd::difference_t
+  subtract(const erd::readings_t &lhs,
+           const erd::readings_t &rhs) const noexcept {
+    erd::energy_t energy = lhs.energy - rhs.energy;
+    if (rhs.energy > lhs.energy) {
+      energy += max_energy_;
+    }
+    return erd::difference_t{lhs.timestamp - rhs.timestamp, energy};
+  }
+
+  [[nodiscard]] const erd::attributes_t &attributes() const noexcept {
+    return attr_;
+  }
+
+  [[nodiscard]] erd::energy_t max_energy() const noexcept {
+    return max_energy_;
+  }
+
+private:
+  erd::attributes_t attr_{erd::domain_t::package, 0};
+  erd::energy_t max_energy_;
+  std::shared_ptr<manual_state_t> state_;
+};
+
+erd::reader_t make_reader(erd::energy_t max_energy,
+                          const std::shared_ptr<manual_state_t> &state) {
+  return erd::reader_t{
+      std::in_place,
+      std::make_unique<erd::detail::backend_adapter<manual_reader_t>>(
+          manual_reader_t{max_energy, state})};
+}
+
+uint64_t energy(erd::accumulator_t &accumulator) {
+  erd::readings_t readings;
+  std::error_code ec;
+  REQUIRE(accumulator.obtain_readings(readings, ec));
+  return readings.energy.count();
+}
+
+} // namespace
+
+TEST_CASE("accumulator_t: folds wraparounds into a growing energy") {
+  auto state = std::make_shared<manual_state_t>();
+  state->counter = 900;
+  erd::accumulator_t accumulator{make_reader(erd::energy_t{1000}, state)};
+  CHECK(energy(accumulator) == 0);
+
+  state->counter = 950;
+  CHECK(energy(accumulator) == 50);
+  state->counter = 100;
+  CHECK(energy(accumulator) == 200);
+  state->counter = 50;
+  CHECK(energy(accumulator) == 1150);
+
+  erd::readings_t lhs{erd::time_point_t{2s}, erd::energy_t{1150}};
+  erd::readings_t rhs{erd::time_point_t{1s}, erd::energy_t{200}};
+  erd::difference_t diff = erd::accumulator_t::subtract(lhs, rhs);
+  CHECK(diff.energy_consumed.count() == 950);
+  CHECK(diff.duration == 1s);
+}
+
+TEST_CASE("accumulator_t: saturates at the maximum energy") {
+  constexpr auto max = std::numeric_limits<std::uint64_t>::max();
+  auto state = std::make_shared<manual_state_t>();
+  erd::accumulator_t accumulator{make_reader(erd::energy_t{max}, state)};
+  state->counter = max - 1;
+  CHECK(energy(accumulator) == max - 1);
+  // 11 more, past the maximum
+  state->counter = 10;
+  CHECK(energy(accumulator) == max);
+  state->counter = 20;
+  CHECK(energy(accumulator) == max);
+}
+
+TEST_CASE("accumulator_t: reads more often the faster the counter wraps") {
+  auto state = std::make_shared<manual_state_t>();
+  erd::accumulator_t accumulator{make_reader(erd::energy_t{1000}, state)};
+  // no energy consumed, so there is no wrap to keep up with
+  energy(accumulator);
+  CHECK(accumulator.period() == 1s);
+
+  // half the range in 20 ms or more, a wrap in 40 ms or more
+  std::this_thread::sleep_for(20ms);
+  state->counter = 500;
+  energy(accumulator);
+  CHECK(accumulator.period() >= 10ms);
+  CHECK(accumulator.period() < 100ms);
+
+  // bounded by the minimum period
+  state->counter = 499;
+  energy(accumulator);
+  CHECK(accumulator.period() == 1ms);
+}
+
+TEST_CASE("accumulator_t: counts failed background reads") {
+  auto state = std::make_shared<manual_state_t>();
+  state->failing = true;
+  CHECK_THROWS_AS(
+      erd::accumulator_t{make_reader(erd::energy_t{1000}, state)},
+      std::system_error);
+
+  state->failing = false;
+  erd::accumulator_t accumulator{make_reader(erd::energy_t{1000}, state),
+                                 1ms};
+  state->failing = true;
+  while (accumulator.errors() < 2) {
+    std::this_thread::sleep_for(1ms);
+  }
+  state->failing = false;
+  state->counter = 10;
+  CHECK(energy(accumulator) == 10);
+}
@@ -0,0 +1,155 @@
+#include "temp_dir.hpp"
+
+#include <doctest/doctest.h>
+#include <erd/attribution.hpp>
+
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+// a counter the test sets, in microjoules
+class manual_backend_t final : public erd::backend_t {
+public:
+  manual_backend_t(erd::attributes_t attr, std::shared_ptr<uint64_t> energy)
+      : attr_(attr), energy_(std::move(energy)) {}
+
+  std::unique_ptr<erd::backend_t> clone() const override {
+    return std::make_unique<manual_backend_t>(*this);
+  }
+
+  bool obtain_readings(erd::readings_t &into,
+                       std::error_code &ec) const noexcept override {
+    into.timestamp = erd::now();
+    into.energy = erd::energy_t{*energy_};
+    ec.clear();
+    return true;
+  }
+
+  erd::difference_t
+  subtract(const erd::readings_t &lhs,
+           const erd::readings_t &rhs) const noexcept override {
+    return {lhs.timestamp - rhs.timestamp, lhs.energy - rhs.energy};
+  }
+
+  const erd::attributes_t &attributes() const noexcept override {
+    return attr_;
+  }
+
+  erd::energy_t max_energy() const noexcept override {
+    return erd::energy_t{UINT64_MAX};
+  }
+
+  const char *name() const noexcept override { return "manual"; }
+
+private:
+  erd::attributes_t attr_;
+  std::shared_ptr<uint64_t> energy_;
+};
+
+// the busy ticks of /proc/stat are user + system
+std::string proc_stat(uint64_t user, uint64_t system) {
+  return "cpu  " + std::to_string(user) + " 0 " + std::to_string(system) +
+         " 100000 0 0 0 0 0 0\ncpu0 0 0 0 0 0 0 0 0 0 0\n";
+}
+
+// the fields after the command name start at the state; utime and stime are
+// the 12th and 13th of them and starttime the 20th
+std::string process_stat(int pid, const std::string &comm, uint64_t utime,
+                         uint64_t stime, uint64_t start_time) {
+  return std::to_string(pid) + " (" + comm + ") S 1 1 1 0 -1 4194304 0 0 0 0 " +
+         std::to_string(utime) + " " + std::to_string(stime) +
+         " 0 0 20 0 1 0 " + std::to_string(start_time) +
+         " 1000 100 18446744073709551615 0 0 0 0 0 0 0 0 0 0 0 0 17 3 0 0\n";
+}
+
+// in microjoules
+double process_energy(const erd::attribution_t &attribution, int32_t pid) {
+  erd::joules<double> energy{0};
+  REQUIRE(attribution.process_energy(pid, 0, energy));
+  return erd::microjoules<double>{energy}.count();
+}
+
+double unattributed(const erd::attribution_t &attribution) {
+  erd::joules<double> energy{0};
+  REQUIRE(attribution.unattributed(0, energy));
+  return erd::microjoules<double>{energy}.count();
+}
+
+} // namespace
+
+TEST_CASE("attribution_t: apportions energy by CPU time") {
+  temp_dir_t proc;
+  auto energy = std::make_shared<uint64_t>(0);
+  std::vector<erd::reader_t> readers;
+  readers.emplace_back(std::in_place,
+                       std::make_unique<manual_backend_t>(
+                           erd::attributes_t{erd::domain_t::package, 0},
+                           energy));
+
+  proc.write("stat", proc_stat(1000, 0));
+  proc.write("1/stat", process_stat(1, "init", 10, 0, 1));
+  // the command name holds spaces and parentheses
+  proc.write("4242/stat", process_stat(4242, "a) b (c", 100, 50, 500));
+  proc.write("77/stat", process_stat(77, "idle", 0, 0, 2));
+
+  // the tree is given as it would be to the daemon
+  setenv("ERD_PROC_ROOT", proc.path().c_str(), 1);
+  erd::attribution_t attribution{readers};
+  unsetenv("ERD_PROC_ROOT");
+  std::error_code ec;
+  // the first update only takes a baseline
+  REQUIRE(attribution.update(ec));
+  CHECK(attribution.process_count() == 3);
+  CHECK(process_energy(attribution, 4242) == 0);
+
+  // 60 busy ticks: 40 of 4242, 10 of init and 10 of no process still running
+  *energy = 12000;
+  proc.write("stat", proc_stat(1050, 10));
+  proc.write("1/stat", process_stat(1, "init", 20, 0, 1));
+  proc.write("4242/stat", process_stat(4242, "a) b (c", 130, 60, 500));
+  REQUIRE(attribution.update(ec));
+  CHECK(process_energy(attribution, 4242) == doctest::Approx(8000));
+  CHECK(process_energy(attribution, 1) == doctest::Approx(2000));
+  CHECK(process_energy(attribution, 77) == 0);
+  CHECK(unattributed(attribution) == doctest::Approx(2000));
+
+  // a process started since is given its whole CPU time, and one reusing a
+  // PID starts over
+  *energy = 18000;
+  proc.write("stat", proc_stat(1056, 10));
+  proc.write("5000/stat", process_stat(5000, "new", 4, 0, 900));
+  proc.write("1/stat", process_stat(1, "init", 2, 0, 950));
+  REQUIRE(attribution.update(ec));
+  CHECK(attribution.process_count() == 4);
+  CHECK(process_energy(attribution, 5000) == doctest::Approx(4000));
+  CHECK(process_energy(attribution, 1) == doctest::Approx(2000));
+  CHECK(process_energy(attribution, 4242) == doctest::Approx(8000));
+
+  erd::joules<double> ignored{0};
+  CHECK_FALSE(attribution.process_energy(31337, 0, ignored));
+  CHECK_FALSE(attribution.process_energy(4242, 1, ignored));
+  CHECK_FALSE(attribution.unattributed(1, ignored));
+}
+
+TEST_CASE("attribution_t: fails on a malformed /proc/stat") {
+  temp_dir_t proc;
+  proc.write("stat", "intr 0 0 0\n");
+  std::vector<erd::reader_t> readers;
+  readers.emplace_back(std::in_place,
+                       std::make_unique<manual_backend_t>(
+                           erd::attributes_t{erd::domain_t::package, 0},
+                           std::make_shared<uint64_t>(0)));
+  erd::attribution_t attribution{readers, {}, proc.path()};
+  std::error_code ec;
+  CHECK_FALSE(attribution.update(ec));
+  CHECK(ec == std::errc::bad_message);
+}
+
+TEST_CASE("attribution_t: throws without a proc root") {
+  temp_dir_t proc;
+  CHECK(erd::attribution_t::default_proc_root() == "/proc");
+  CHECK_THROWS(erd::attribution_t{{}, {}, proc.path("missing")});
+}
@@ -0,0 +1,140 @@
+#if defined(ERD_POWERCAP)
+
+#include "fake_powercap.hpp"
+
+#include <doctest/doctest.h>
+#include <erd/erd.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+
+// sets ERD_BACKEND for the lifetime of the object
+class backend_order_t {
+public:
+  explicit backend_order_t(const char *order) {
+    setenv("ERD_BACKEND", order, 1);
+  }
+  ~backend_order_t() { unsetenv("ERD_BACKEND"); }
+
+  backend_order_t(const backend_order_t &) = delete;
+  backend_order_t &operator=(const backend_order_t &) = delete;
+};
+
+// a backend that exists for no domain, registered once for every test
+const bool failing_registered = [] {
+  erd::backend_registry_t::instance().add(
+      "failing",
+      [](const erd::attributes_t &) -> std::unique_ptr<erd::backend_t> {
+        throw std::system_error(std::make_error_code(std::errc::io_error),
+                                "Always fails");
+      },
+      false);
+  return true;
+}();
+
+bool same(const char *lhs, const char *rhs) {
+  return std::strcmp(lhs, rhs) == 0;
+}
+
+} // namespace
+
+TEST_CASE("backend_registry_t: hardware backends are probed first") {
+  std::vector<std::string> names = erd::backend_registry_t::instance().names();
+  REQUIRE(names.size() >= 4);
+  CHECK(names[0] == erd::powercap_reader_t::backend_name);
+#if defined(ERD_MSR)
+  CHECK(names[1] == erd::msr_reader_t::backend_name);
+#endif
+  CHECK(std::count(names.begin(), names.end(), "failing") == 1);
+
+  // powercap has the domain, so nothing else is tried
+  erd::reader_t reader{erd::attributes_t{erd::domain_t::dram, 1}};
+  CHECK(same(reader.backend().name(), erd::powercap_reader_t::backend_name));
+}
+
+TEST_CASE("backend_registry_t: falls through to the next backend") {
+  SUBCASE("in the order ERD_BACKEND lists") {
+    backend_order_t order{"failing,sim,powercap"};
+    erd::reader_t reader{erd::attributes_t{erd::domain_t::package, 0}};
+    CHECK(same(reader.backend().name(), erd::sim_reader_t::backend_name));
+  }
+
+  SUBCASE("past a domain the tree lacks") {
+    backend_order_t order{"powercap,sim"};
+    erd::reader_t reader{erd::attributes_t{erd::domain_t::uncore, 0}};
+    CHECK(same(reader.backend().name(), erd::sim_reader_t::backend_name));
+  }
+
+  SUBCASE("giving every reason when none can read the domain") {
+    backend_order_t order{"failing,powercap,unknown"};
+    try {
+      erd::reader_t reader{erd::attributes_t{erd::domain_t::uncore, 0}};
+      FAIL("no backend should read the domain");
+    } catch (const std::system_error &e) {
+      std::string what = e.what();
+      CHECK(what.find("failing: Always fails") != std::string::npos);
+      CHECK(what.find("powercap: ") != std::string::npos);
+      CHECK(what.find("Unknown backend unknown") != std::string::npos);
+    }
+  }
+}
+
+TEST_CASE("reader_set_t: selects its backend through the registry") {
+  std::vector<erd::attributes_t> attrs{{erd::domain_t::package, 0},
+                                       {erd::domain_t::dram, 1}};
+
+  SUBCASE("batching the reads of powercap") {
+    erd::reader_set_t set{attrs};
+    CHECK(same(set.name(), erd::powercap_reader_t::backend_name));
+    erd::readings_set_t readings;
+    std::error_code ec;
+    REQUIRE(set.obtain_readings(readings, ec));
+    REQUIRE(readings.energy.size() == 2);
+    CHECK(readings.energy[0].count() == 1000);
+    CHECK(readings.energy[1].count() == 1400);
+  }
+
+  SUBCASE("reading a backend without batches one domain at a time") {
+    backend_order_t order{"failing,sim"};
+    erd::reader_set_t set{attrs};
+    CHECK(same(set.name(), erd::sim_reader_t::backend_name));
+    REQUIRE(set.size() == 2);
+    CHECK(set.attributes()[1].domain == erd::domain_t::dram);
+    erd::readings_set_t readings;
+    std::error_code ec;
+    REQUIRE(set.obtain_readings(readings, ec));
+    CHECK(readings.energy.size() == 2);
+    CHECK(readings.begin <= readings.end);
+  }
+
+  SUBCASE("with the backend selected for each domain when they differ") {
+    backend_order_t order{"powercap,sim"};
+    attrs.push_back({erd::domain_t::uncore, 0});
+    erd::reader_set_t set{attrs};
+    CHECK(same(set.name(), erd::any_backend_t::backend_name));
+    erd::readings_set_t readings;
+    std::error_code ec;
+    REQUIRE(set.obtain_readings(readings, ec));
+    REQUIRE(readings.energy.size() == 3);
+    CHECK(readings.energy[0].count() == 1000);
+    CHECK(readings.energy[1].count() == 1400);
+  }
+
+  SUBCASE("throwing when a domain has no backend at all") {
+    attrs.push_back({erd::domain_t::uncore, 0});
+    backend_order_t order{"powercap"};
+    CHECK_THROWS_AS(erd::reader_set_t{attrs}, std::system_error);
+  }
+
+  SUBCASE("of a backend given by name") {
+    erd::reader_set_t set{erd::sim_reader_t::backend_name, attrs};
+    CHECK(same(set.name(), erd::sim_reader_t::backend_name));
+    CHECK_THROWS_AS((erd::reader_set_t{"failing", attrs}), std::system_error);
+  }
+}
+
+#endif // ERD_POWERCAP
@@ -0,0 +1,79 @@
+#include <doctest/doctest.h>
+#include <erd/clock.hpp>
+
+#include <chrono>
+#include <system_error>
+
+namespace {
+
+// timer interrupts and scheduling of a loaded machine, rather than the
+// accuracy of the mapping, bound how closely the clocks can be compared
+constexpr auto tolerance = std::chrono::milliseconds(2);
+
+// whether tsc_clock_t::now() lies between clock_t readings around it
+bool brackets() {
+  erd::time_point_t before = erd::clock_t::now();
+  erd::time_point_t time = erd::tsc_clock_t::now();
+  erd::time_point_t after = erd::clock_t::now();
+  return time >= before - tolerance && time <= after + tolerance;
+}
+
+} // namespace
+
+TEST_CASE("tsc_clock_t: is calibrated on first use") {
+  MESSAGE("tsc: " << erd::tsc_clock_t::available());
+  if (!erd::tsc_clock_t::available()) {
+    CHECK(erd::tsc_clock_t::frequency() == 0);
+    return;
+  }
+  CHECK(erd::tsc_clock_t::frequency() > 1e8);
+  CHECK(erd::tsc_clock_t::frequency() < 1e11);
+  CHECK(brackets());
+}
+
+TEST_CASE("tsc_clock_t: maps the counter onto clock_t across anchors") {
+  if (!erd::tsc_clock_t::available()) {
+    return;
+  }
+  // long enough to re-anchor at least once
+  erd::time_point_t end = erd::clock_t::now() + std::chrono::milliseconds(1200);
+  erd::time_point_t last = erd::tsc_clock_t::now();
+  bool monotonic = true;
+  bool mapped = true;
+  while (erd::clock_t::now() < end) {
+    erd::time_point_t time = erd::tsc_clock_t::now();
+    monotonic = monotonic && time >= last;
+    last = time;
+    mapped = mapped && brackets();
+  }
+  CHECK(monotonic);
+  CHECK(mapped);
+}
+
+TEST_CASE("set_clock_source: selects the clock of now") {
+  std::error_code ec;
+  REQUIRE(erd::set_clock_source(erd::clock_source_t::standard, ec));
+  CHECK(erd::clock_source() == erd::clock_source_t::standard);
+
+  if (!erd::tsc_clock_t::available()) {
+    CHECK_FALSE(erd::set_clock_source(erd::clock_source_t::tsc, ec));
+    CHECK(ec == std::errc::not_supported);
+    CHECK(erd::clock_source() == erd::clock_source_t::standard);
+    return;
+  }
+  REQUIRE(erd::set_clock_source(erd::clock_source_t::tsc, ec));
+  CHECK(erd::clock_source() == erd::clock_source_t::tsc);
+  erd::time_point_t before = erd::clock_t::now();
+  erd::time_point_t time = erd::now();
+  CHECK(time >= before - tolerance);
+  CHECK(time <= erd::clock_t::now() + tolerance);
+  REQUIRE(erd::set_clock_source(erd::clock_source_t::standard, ec));
+}
+
+TEST_CASE("to_realtime: agrees with the system clock") {
+  auto before = std::chrono::system_clock::now();
+  auto time = erd::to_realtime(erd::clock_t::now());
+  auto after = std::chrono::system_clock::now();
+  CHECK(time >= before - tolerance);
+  CHECK(time <= after + tolerance);
+}
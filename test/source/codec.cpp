@@ -0,0 +1,129 @@
+#include <doctest/doctest.h>
+#include <erd/codec.hpp>
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace {
+
+erd::readings_t sample(int64_t ticks, uint64_t energy) {
+  return erd::readings_t{erd::time_point_t{erd::clock_t::duration{ticks}},
+                         erd::energy_t{energy}};
+}
+
+void check_round_trip(const std::vector<erd::readings_t> &samples) {
+  std::vector<uint8_t> block;
+  erd::codec::encode(samples.data(), samples.size(), block);
+  CHECK(block.size() <= erd::codec::max_block_size(samples.size()));
+
+  std::size_t count;
+  std::error_code ec;
+  REQUIRE(erd::codec::block_count(block.data(), block.size(), count, ec));
+  CHECK(count == samples.size());
+
+  std::vector<erd::readings_t> decoded;
+  const uint8_t *data = block.data();
+  REQUIRE(erd::codec::decode(data, block.data() + block.size(), decoded, ec));
+  CHECK(data == block.data() + block.size());
+  REQUIRE(decoded.size() == samples.size());
+  for (std::size_t i = 0; i < samples.size(); i++) {
+    CHECK(decoded[i].timestamp == samples[i].timestamp);
+    CHECK(decoded[i].energy == samples[i].energy);
+  }
+}
+
+} // namespace
+
+TEST_CASE("codec: round trips") {
+  constexpr int64_t min_time = std::numeric_limits<int64_t>::min();
+  constexpr int64_t max_time = std::numeric_limits<int64_t>::max();
+  constexpr uint64_t max_energy = std::numeric_limits<uint64_t>::max();
+
+  SUBCASE("no sample") { check_round_trip({}); }
+
+  SUBCASE("a single sample") { check_round_trip({sample(123456789, 42)}); }
+
+  SUBCASE("a steady period takes about two bytes a sample") {
+    std::vector<erd::readings_t> samples;
+    for (int64_t i = 0; i < 1000; i++) {
+      samples.push_back(sample(1000000 * i, 50 * uint64_t(i)));
+    }
+    check_round_trip(samples);
+    std::vector<uint8_t> block;
+    erd::codec::encode(samples.data(), samples.size(), block);
+    CHECK(block.size() < 3 * samples.size());
+  }
+
+  SUBCASE("extreme values") {
+    check_round_trip({sample(min_time, 0), sample(max_time, max_energy),
+                      sample(0, 0), sample(min_time, max_energy),
+                      sample(-1, 1), sample(max_time, 0)});
+  }
+
+  SUBCASE("a wrap of the counter and irregular steps") {
+    check_round_trip({sample(0, max_energy - 10), sample(7, max_energy),
+                      sample(7, 5), sample(1000, 3), sample(999999999, 3)});
+  }
+}
+
+TEST_CASE("codec: blocks follow each other") {
+  std::vector<uint8_t> blocks;
+  std::vector<erd::readings_t> first{sample(1, 1), sample(2, 2)};
+  std::vector<erd::readings_t> second{sample(10, 10)};
+  erd::codec::encode(first.data(), first.size(), blocks);
+  erd::codec::encode(second.data(), second.size(), blocks);
+
+  const uint8_t *data = blocks.data();
+  const uint8_t *end = blocks.data() + blocks.size();
+  std::vector<erd::readings_t> decoded;
+  std::error_code ec;
+  REQUIRE(erd::codec::decode(data, end, decoded, ec));
+  REQUIRE(erd::codec::decode(data, end, decoded, ec));
+  CHECK(data == end);
+  REQUIRE(decoded.size() == 3);
+  CHECK(decoded[2].energy.count() == 10);
+}
+
+TEST_CASE("codec: rejects malformed blocks") {
+  std::vector<erd::readings_t> samples{sample(1, 100), sample(2, 200),
+                                       sample(3, 300)};
+  std::vector<uint8_t> block;
+  erd::codec::encode(samples.data(), samples.size(), block);
+  erd::readings_t out[3];
+  std::error_code ec;
+
+  SUBCASE("truncated") {
+    for (std::size_t size = 0; size < block.size(); size++) {
+      const uint8_t *data = block.data();
+      CHECK_FALSE(erd::codec::decode(data, block.data() + size, out, 3, ec));
+      CHECK(ec == std::errc::bad_message);
+      CHECK(data == block.data());
+    }
+  }
+
+  SUBCASE("holding more samples than the capacity") {
+    const uint8_t *data = block.data();
+    CHECK_FALSE(
+        erd::codec::decode(data, block.data() + block.size(), out, 2, ec));
+    CHECK(ec == std::errc::no_buffer_space);
+  }
+
+  SUBCASE("counting more samples than the bytes can hold") {
+    std::vector<uint8_t> bogus{0xff, 0xff, 0xff, 0xff, 0x0f, 0, 0};
+    std::vector<erd::readings_t> decoded;
+    const uint8_t *data = bogus.data();
+    CHECK_FALSE(erd::codec::decode(data, bogus.data() + bogus.size(), decoded,
+                                   ec));
+    CHECK(ec == std::errc::bad_message);
+  }
+
+  SUBCASE("with a varint longer than 64 bits") {
+    std::vector<uint8_t> bogus(12, 0xff);
+    bogus.insert(bogus.begin(), 1);
+    const uint8_t *data = bogus.data();
+    CHECK_FALSE(
+        erd::codec::decode(data, bogus.data() + bogus.size(), out, 3, ec));
+    CHECK(ec == std::errc::bad_message);
+  }
+}
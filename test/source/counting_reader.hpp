@@ -0,0 +1,70 @@
+#pragma once
+
+#include <erd/erd.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+// what the copies of a counting_reader_t share; the test changes it between
+// reads
+struct counting_state_t {
+  std::atomic<std::uint64_t> reads{0};
+  std::atomic<bool> failing{false};
+  std::atomic<std::chrono::milliseconds::rep> delay_ms{0};
+};
+
+// a reader whose n-th read gives n mJ, after sleeping for the delay of its
+// state, so that tests know how many reads were made and which one readings
+// come from
+class counting_reader_t {
+public:
+  static constexpr const char *backend_name = "counting";
+
+  counting_reader_t(erd::attributes_t attr,
+                    std::shared_ptr<counting_state_t> state)
+      : attr_(attr), state_(std::move(state)) {}
+
+  bool obtain_readings(erd::readings_t &into,
+                       std::error_code &ec) const noexcept {
+    std::uint64_t reads = ++state_->reads;
+    std::this_thread::sleep_for(std::chrono::milliseconds{state_->delay_ms});
+    if (state_->failing) {
+      ec = std::make_error_code(std::errc::io_error);
+      return false;
+    }
+    into.timestamp = erd::now();
+    into.energy = erd::energy_t{reads * 1000};
+    ec.clear();
+    return true;
+  }
+
+  [[nodiscard]] erd::difference_t
+  subtract(const erd::readings_t &lhs,
+           const erd::readings_t &rhs) const noexcept {
+    return erd::difference_t{lhs.timestamp - rhs.timestamp,
+                             lhs.energy - rhs.energy};
+  }
+
+  [[nodiscard]] const erd::attributes_t &attributes() const noexcept {
+    return attr_;
+  }
+
+  [[nodiscard]] erd::energy_t max_energy() const noexcept {
+    return erd::energy_t{UINT64_MAX};
+  }
+
+private:
+  erd::attributes_t attr_;
+  std::shared_ptr<counting_state_t> state_;
+};
+
+inline erd::reader_t make_counting_reader(
+    erd::attributes_t attr, const std::shared_ptr<counting_state_t> &state) {
+  return erd::reader_t{
+      std::in_place,
+      std::make_unique<erd::detail::backend_adapter<counting_reader_t>>(
+          counting_reader_t{attr, state})};
+}
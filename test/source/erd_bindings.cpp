@@ -0,0 +1,312 @@
+#include "counting_reader.hpp"
+
+#include <doctest/doctest.h>
+#include <erd/erd.h>
+#include <erd/erd.hpp>
+
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr erd::attributes_t package{erd::domain_t::package, 0};
+
+// handles are readers behind the C interface, so tests make them from readers
+// of their own to control what is read
+erd_handle_t make_handle(const std::shared_ptr<counting_state_t> &state) {
+  return reinterpret_cast<erd_handle_t>(
+      new erd::reader_t{make_counting_reader(package, state)});
+}
+
+// a group of one counting reader per state, each added then destroyed
+erd_group_t
+make_group(const std::vector<std::shared_ptr<counting_state_t>> &states) {
+  erd_group_t group;
+  REQUIRE(erd_group_create(&group, nullptr) == ERD_SUCCESS);
+  for (const std::shared_ptr<counting_state_t> &state : states) {
+    erd_handle_t handle = make_handle(state);
+    REQUIRE(erd_group_add(group, handle, nullptr) == ERD_SUCCESS);
+    erd_handle_destroy(handle);
+  }
+  return group;
+}
+
+// polls until the sampler holds at least count samples from cursor 0
+bool wait_available(erd_sampler_t sampler, size_t count) {
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  size_t available = 0;
+  while (erd_sampler_available(sampler, 0, &available) == ERD_SUCCESS &&
+         available < count) {
+    if (std::chrono::steady_clock::now() > deadline) {
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return true;
+}
+
+} // namespace
+
+TEST_CASE("erd_group: reads and subtracts every handle in one call") {
+  std::vector<std::shared_ptr<counting_state_t>> states{
+      std::make_shared<counting_state_t>(),
+      std::make_shared<counting_state_t>(),
+      std::make_shared<counting_state_t>()};
+  // readings from each reader tell them apart
+  states[1]->reads = 10;
+  states[2]->reads = 20;
+  erd_group_t group = make_group(states);
+  size_t size = 0;
+  REQUIRE(erd_group_size(group, &size) == ERD_SUCCESS);
+  REQUIRE(size == 3);
+
+  erd_readings_t before[3];
+  erd_readings_t after[3];
+  REQUIRE(erd_group_obtain_readings(group, before, 3, nullptr) == ERD_SUCCESS);
+  REQUIRE(erd_group_obtain_readings(group, after, 3, nullptr) == ERD_SUCCESS);
+  for (size_t i = 0; i < 3; i++) {
+    CHECK(before[i].energy == (10 * i + 1) * 1000);
+    CHECK(after[i].energy == (10 * i + 2) * 1000);
+    CHECK(before[i].eunit == ERD_MICROJOULE);
+    CHECK(before[i].tunit == ERD_NANOSECOND);
+    CHECK(states[i]->reads == 10 * i + 2);
+  }
+
+  erd_readings_t diff[3];
+  REQUIRE(erd_group_subtract_n(group, after, before, diff, 3) == ERD_SUCCESS);
+  for (size_t i = 0; i < 3; i++) {
+    CHECK(diff[i].energy == 1000);
+    CHECK(diff[i].time == after[i].time - before[i].time);
+    CHECK(diff[i].eunit == ERD_MICROJOULE);
+    CHECK(diff[i].tunit == ERD_NANOSECOND);
+  }
+  erd_group_destroy(group);
+}
+
+TEST_CASE("erd_group: a size other than the group's is rejected") {
+  auto state = std::make_shared<counting_state_t>();
+  erd_group_t group = make_group({state, state});
+  erd_readings_t readings[3];
+  char what[64] = "";
+  erd_error_descriptor_t ed{what, sizeof(what)};
+  CHECK(erd_group_obtain_readings(group, readings, 3, &ed) ==
+        ERD_INVALID_ARGUMENT);
+  CHECK(std::strlen(what) > 0);
+  CHECK(erd_group_obtain_readings(group, readings, 1, nullptr) ==
+        ERD_INVALID_ARGUMENT);
+  CHECK(erd_group_subtract_n(group, readings, readings, readings, 3) ==
+        ERD_INVALID_ARGUMENT);
+  CHECK(state->reads == 0);
+  erd_group_destroy(group);
+}
+
+TEST_CASE("erd_group: a failed read stops at the handle that failed") {
+  auto working = std::make_shared<counting_state_t>();
+  auto failing = std::make_shared<counting_state_t>();
+  failing->failing = true;
+  erd_group_t group = make_group({working, failing, working});
+  erd_readings_t readings[3]{};
+
+  SUBCASE("with the reason in the error descriptor") {
+    char what[128] = "";
+    erd_error_descriptor_t ed{what, sizeof(what)};
+    CHECK(erd_group_obtain_readings(group, readings, 3, &ed) ==
+          ERD_GENERIC_ERROR);
+    CHECK(std::strlen(what) > 0);
+  }
+  SUBCASE("without an error descriptor") {
+    CHECK(erd_group_obtain_readings(group, readings, 3, nullptr) ==
+          ERD_GENERIC_ERROR);
+  }
+  CHECK(readings[0].energy == 1000);
+  CHECK(readings[2].energy == 0);
+  CHECK(working->reads == 1);
+  erd_group_destroy(group);
+}
+
+TEST_CASE("erd_group: an empty group reads nothing") {
+  erd_group_t group = make_group({});
+  size_t size = 1;
+  REQUIRE(erd_group_size(group, &size) == ERD_SUCCESS);
+  CHECK(size == 0);
+  CHECK(erd_group_obtain_readings(group, nullptr, 0, nullptr) == ERD_SUCCESS);
+  CHECK(erd_group_subtract_n(group, nullptr, nullptr, nullptr, 0) ==
+        ERD_SUCCESS);
+  erd_group_destroy(group);
+  CHECK(erd_group_destroy(nullptr) == ERD_SUCCESS);
+}
+
+TEST_CASE("erd_sampler: drains what its thread read, cursor by cursor") {
+  auto state = std::make_shared<counting_state_t>();
+  erd_handle_t handle = make_handle(state);
+  erd_sampler_t sampler;
+  REQUIRE(erd_sampler_create(&sampler, handle, 1000000, 64, nullptr) ==
+          ERD_SUCCESS);
+  // the sampler reads a copy
+  erd_handle_destroy(handle);
+  REQUIRE(wait_available(sampler, 6));
+  REQUIRE(erd_sampler_stop(sampler) == ERD_SUCCESS);
+
+  size_t available = 0;
+  REQUIRE(erd_sampler_available(sampler, 0, &available) == ERD_SUCCESS);
+  uint64_t cursor = 0;
+  int64_t time[64];
+  uint64_t energy[64];
+  size_t count = 0;
+  REQUIRE(erd_sampler_drain(sampler, &cursor, time, energy, 2, &count) ==
+          ERD_SUCCESS);
+  CHECK(count == 2);
+  CHECK(cursor == 2);
+  REQUIRE(erd_sampler_drain(sampler, &cursor, time + 2, energy + 2, 62,
+                            &count) == ERD_SUCCESS);
+  CHECK(count == available - 2);
+  CHECK(cursor == available);
+  for (size_t i = 1; i < available; i++) {
+    CHECK(energy[i] == energy[i - 1] + 1000);
+    CHECK(time[i] >= time[i - 1]);
+  }
+  REQUIRE(erd_sampler_available(sampler, cursor, &available) == ERD_SUCCESS);
+  CHECK(available == 0);
+  uint64_t errors = 1;
+  REQUIRE(erd_sampler_errors(sampler, &errors) == ERD_SUCCESS);
+  CHECK(errors == 0);
+  erd_sampler_destroy(sampler);
+}
+
+TEST_CASE("erd_sampler: skips samples overwritten before being drained") {
+  auto state = std::make_shared<counting_state_t>();
+  erd_handle_t handle = make_handle(state);
+  erd_sampler_t sampler;
+  REQUIRE(erd_sampler_create(&sampler, handle, 1000000, 4, nullptr) ==
+          ERD_SUCCESS);
+  while (state->reads < 12) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  erd_sampler_stop(sampler);
+
+  size_t available = 0;
+  REQUIRE(erd_sampler_available(sampler, 0, &available) == ERD_SUCCESS);
+  CHECK(available == 4);
+  uint64_t cursor = 0;
+  int64_t time[16];
+  uint64_t energy[16];
+  size_t count = 0;
+  REQUIRE(erd_sampler_drain(sampler, &cursor, time, energy, 16, &count) ==
+          ERD_SUCCESS);
+  REQUIRE(count == 4);
+  // the newest ones, and the cursor past them
+  CHECK(energy[3] == cursor * 1000);
+  CHECK(cursor >= 12);
+  erd_sampler_destroy(sampler);
+  erd_handle_destroy(handle);
+}
+
+TEST_CASE("erd_sampler: counts failed reads and rejects bad arguments") {
+  auto state = std::make_shared<counting_state_t>();
+  erd_handle_t handle = make_handle(state);
+  erd_sampler_t sampler;
+  char what[64] = "";
+  erd_error_descriptor_t ed{what, sizeof(what)};
+  CHECK(erd_sampler_create(&sampler, handle, 0, 64, &ed) ==
+        ERD_INVALID_ARGUMENT);
+  CHECK(std::strlen(what) > 0);
+  CHECK(erd_sampler_create(&sampler, handle, 1000000, 0, nullptr) ==
+        ERD_INVALID_ARGUMENT);
+
+  state->failing = true;
+  REQUIRE(erd_sampler_create(&sampler, handle, 1000000, 64, nullptr) ==
+          ERD_SUCCESS);
+  uint64_t errors = 0;
+  while (erd_sampler_errors(sampler, &errors) == ERD_SUCCESS && errors < 3) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  erd_sampler_stop(sampler);
+  size_t available = 1;
+  REQUIRE(erd_sampler_available(sampler, 0, &available) == ERD_SUCCESS);
+  CHECK(available == 0);
+  erd_sampler_destroy(sampler);
+  erd_handle_destroy(handle);
+  CHECK(erd_sampler_destroy(nullptr) == ERD_SUCCESS);
+}
+
+TEST_CASE("erd_stats: reports the reads made through handles") {
+  bool enabled = erd::metrics_t::enabled();
+  auto state = std::make_shared<counting_state_t>();
+  erd_handle_t handle = make_handle(state);
+  erd_readings_t readings;
+  erd_stats_t stats;
+  REQUIRE(erd_stats_enable(1) == ERD_SUCCESS);
+  REQUIRE(erd_stats_reset() == ERD_SUCCESS);
+
+  for (int i = 0; i < 5; i++) {
+    REQUIRE(erd_obtain_readings(handle, &readings, nullptr) == ERD_SUCCESS);
+  }
+  state->failing = true;
+  CHECK(erd_obtain_readings(handle, &readings, nullptr) != ERD_SUCCESS);
+  REQUIRE(erd_stats_get(ERD_METRIC_READ, &stats, nullptr) == ERD_SUCCESS);
+  CHECK(stats.count == 6);
+  CHECK(stats.errors == 1);
+  CHECK(stats.min <= stats.p50);
+  CHECK(stats.p50 <= stats.p99);
+  CHECK(stats.p999 <= stats.max);
+  CHECK(stats.mean > 0);
+
+  SUBCASE("reset discards them") {
+    REQUIRE(erd_stats_reset() == ERD_SUCCESS);
+    REQUIRE(erd_stats_get(ERD_METRIC_READ, &stats, nullptr) == ERD_SUCCESS);
+    CHECK(stats.count == 0);
+    CHECK(stats.errors == 0);
+  }
+  SUBCASE("reads are not recorded while disabled") {
+    REQUIRE(erd_stats_enable(0) == ERD_SUCCESS);
+    state->failing = false;
+    REQUIRE(erd_obtain_readings(handle, &readings, nullptr) == ERD_SUCCESS);
+    REQUIRE(erd_stats_get(ERD_METRIC_READ, &stats, nullptr) == ERD_SUCCESS);
+    CHECK(stats.count == 6);
+  }
+  SUBCASE("an unknown metric is rejected") {
+    char what[64] = "";
+    erd_error_descriptor_t ed{what, sizeof(what)};
+    CHECK(erd_stats_get(static_cast<erd_metric_t>(42), &stats, &ed) ==
+          ERD_INVALID_ARGUMENT);
+    CHECK(std::strlen(what) > 0);
+  }
+  erd_handle_destroy(handle);
+  erd_stats_reset();
+  erd_stats_enable(enabled);
+}
+
+TEST_CASE("erd_set_clock: selects the clock readings are timed with") {
+  REQUIRE(erd_set_clock(ERD_CLOCK_STANDARD, nullptr) == ERD_SUCCESS);
+  CHECK(erd::clock_source() == erd::clock_source_t::standard);
+
+  char what[128] = "";
+  erd_error_descriptor_t ed{what, sizeof(what)};
+  CHECK(erd_set_clock(static_cast<erd_clock_t>(42), &ed) ==
+        ERD_INVALID_ARGUMENT);
+  CHECK(std::strlen(what) > 0);
+  CHECK(erd::clock_source() == erd::clock_source_t::standard);
+
+  if (!erd::tsc_clock_t::available()) {
+    CHECK(erd_set_clock(ERD_CLOCK_TSC, nullptr) == ERD_SYSTEM_ERROR);
+    CHECK(erd::clock_source() == erd::clock_source_t::standard);
+    return;
+  }
+  REQUIRE(erd_set_clock(ERD_CLOCK_TSC, nullptr) == ERD_SUCCESS);
+  CHECK(erd::clock_source() == erd::clock_source_t::tsc);
+  auto state = std::make_shared<counting_state_t>();
+  erd_handle_t handle = make_handle(state);
+  erd_readings_t readings;
+  int64_t before = erd::clock_t::now().time_since_epoch().count();
+  REQUIRE(erd_obtain_readings(handle, &readings, nullptr) == ERD_SUCCESS);
+  int64_t after = erd::clock_t::now().time_since_epoch().count();
+  // tsc timestamps are mapped onto clock_t
+  constexpr int64_t tolerance = 2000000;
+  CHECK(readings.time >= before - tolerance);
+  CHECK(readings.time <= after + tolerance);
+  erd_handle_destroy(handle);
+  REQUIRE(erd_set_clock(ERD_CLOCK_STANDARD, nullptr) == ERD_SUCCESS);
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "temp_dir.hpp"
+
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+
+inline constexpr uint64_t MAX_ENERGY = 262143328850;
+
+// a powercap tree laid out flat like /sys/class/powercap, with two packages,
+// the second made of two dies; set up before main, so that the topology of
+// the process is built from it
+struct fake_powercap_t {
+  temp_dir_t root;
+
+  fake_powercap_t() {
+    zone("intel-rapl:0", "package-0", 1000);
+    zone("intel-rapl:0:0", "core", 200);
+    zone("intel-rapl:0:1", "dram", 300);
+    zone("intel-rapl:1", "package-1-die-0", 5000);
+    zone("intel-rapl:1:0", "dram", 600);
+    zone("intel-rapl:2", "package-1-die-1", 7000);
+    zone("intel-rapl:2:0", "dram", 800);
+    setenv("ERD_POWERCAP_ROOT", root.path().c_str(), 1);
+  }
+
+  void zone(const std::string &dir, const std::string &name,
+            uint64_t energy) const {
+    root.write(dir + "/name", name + "\n");
+    root.write(dir + "/max_energy_range_uj", std::to_string(MAX_ENERGY) + "\n");
+    set_energy(dir, energy);
+  }
+
+  void set_energy(const std::string &dir, uint64_t energy) const {
+    root.write(dir + "/energy_uj", std::to_string(energy) + "\n");
+  }
+};
+
+// one tree for the whole test program
+inline const fake_powercap_t fake_powercap;
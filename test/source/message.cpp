@@ -0,0 +1,254 @@
+#include <doctest/doctest.h>
+#include <erd/ipc/message.hpp>
+
+#include <cstring>
+#include <limits>
+#include <vector>
+
+namespace {
+
+using namespace erd::ipc;
+
+constexpr std::size_t count_offset = 6;
+constexpr std::size_t length_offset = 8;
+
+erd::readings_t sample(int64_t ticks, uint64_t energy) {
+  return erd::readings_t{erd::time_point_t{erd::clock_t::duration{ticks}},
+                         erd::energy_t{energy}};
+}
+
+std::vector<char> bytes_of(const detail::frame_common &frame) {
+  return {frame.data(), frame.data() + frame.size()};
+}
+
+template <typename T>
+void patch(std::vector<char> &bytes, std::size_t offset, T value) {
+  std::memcpy(bytes.data() + offset, &value, sizeof(value));
+}
+
+// receives bytes as a connection would, the header first and then the
+// length it gives
+bool receive(const std::vector<char> &bytes, detail::frame_common &into,
+             std::error_code &ec) {
+  REQUIRE(bytes.size() >= frame_header_t::size);
+  std::memcpy(into.header_buffer(), bytes.data(), frame_header_t::size);
+  if (!into.prepare_payload(ec)) {
+    return false;
+  }
+  REQUIRE(into.payload_size() == bytes.size() - frame_header_t::size);
+  std::memcpy(into.payload_buffer(), bytes.data() + frame_header_t::size,
+              into.payload_size());
+  return true;
+}
+
+} // namespace
+
+TEST_CASE("request_frame: operations are read back") {
+  request_frame sent;
+  sent.begin(7);
+  sent.add_obtain_readings();
+  sent.add_subtract(sample(1, 10), sample(3, 30),
+                    erd::attributes_t{erd::domain_t::dram, 1});
+  sent.add_subscribe(std::chrono::milliseconds(5),
+                     subscription_mode_t::samples, 64);
+  sent.add_attribution("user.slice");
+  sent.finish();
+  CHECK(sent.header().count == 4);
+
+  request_frame received;
+  std::error_code ec;
+  REQUIRE(receive(bytes_of(sent), received, ec));
+  CHECK(received.header().request_id == 7);
+  request_operation_t op;
+  REQUIRE(received.validate(op, ec));
+
+  erd::attributes_t attr{};
+  REQUIRE(received.next(op, ec));
+  CHECK(op.type == operation_type_t::obtain_readings);
+  CHECK_FALSE(op.attributes(attr));
+
+  REQUIRE(received.next(op, ec));
+  erd::readings_t lhs;
+  erd::readings_t rhs;
+  REQUIRE(op.readings(lhs, rhs, ec));
+  CHECK(lhs.energy.count() == 10);
+  CHECK(rhs.timestamp == sample(3, 30).timestamp);
+  REQUIRE(op.attributes(attr));
+  CHECK(attr.domain == erd::domain_t::dram);
+  CHECK(attr.socket == 1);
+
+  REQUIRE(received.next(op, ec));
+  std::chrono::nanoseconds interval;
+  subscription_mode_t mode;
+  uint32_t batch;
+  REQUIRE(op.subscription(interval, mode, batch, ec));
+  CHECK(interval == std::chrono::milliseconds(5));
+  CHECK(mode == subscription_mode_t::samples);
+  CHECK(batch == 64);
+
+  REQUIRE(received.next(op, ec));
+  attribution_target_t target;
+  int32_t pid = 0;
+  std::string_view cgroup;
+  REQUIRE(op.attribution(target, pid, cgroup, ec));
+  CHECK(target == attribution_target_t::cgroup);
+  CHECK(cgroup == "user.slice");
+
+  CHECK_FALSE(received.next(op, ec));
+  CHECK_FALSE(ec);
+}
+
+TEST_CASE("request_frame: malformed frames are rejected") {
+  request_frame sent;
+  sent.begin(1);
+  sent.add_obtain_readings();
+  sent.add_subtract(sample(1, 10), sample(2, 20));
+  sent.finish();
+  std::vector<char> bytes = bytes_of(sent);
+  request_frame received;
+  request_operation_t op;
+  std::error_code ec;
+
+  SUBCASE("a bad magic or version") {
+    std::vector<char> bad = bytes;
+    patch(bad, 0, uint32_t{0});
+    CHECK_FALSE(receive(bad, received, ec));
+    CHECK(ec == std::errc::bad_message);
+    bad = bytes;
+    patch(bad, 4, uint16_t{frame_version + 1});
+    CHECK_FALSE(receive(bad, received, ec));
+    CHECK(ec == std::errc::bad_message);
+  }
+
+  SUBCASE("a length over the maximum") {
+    patch(bytes, length_offset, uint32_t{frame_header_t::max_length + 1});
+    std::memcpy(received.header_buffer(), bytes.data(), frame_header_t::size);
+    CHECK_FALSE(received.prepare_payload(ec));
+    CHECK(ec == std::errc::bad_message);
+  }
+
+  SUBCASE("more operations than the header counts") {
+    patch(bytes, count_offset, uint16_t{1});
+    REQUIRE(receive(bytes, received, ec));
+    CHECK_FALSE(received.validate(op, ec));
+    CHECK(ec == std::errc::bad_message);
+    // validating leaves the iteration where it was
+    REQUIRE(received.next(op, ec));
+    CHECK(op.type == operation_type_t::obtain_readings);
+    CHECK_FALSE(received.next(op, ec));
+    CHECK(ec == std::errc::bad_message);
+  }
+
+  SUBCASE("an operation running past the payload") {
+    // the length of the second operation
+    patch(bytes, frame_header_t::size + 12, uint32_t{1000});
+    REQUIRE(receive(bytes, received, ec));
+    CHECK_FALSE(received.validate(op, ec));
+    CHECK(ec == std::errc::bad_message);
+  }
+
+  SUBCASE("a payload cut within an operation header") {
+    bytes.resize(bytes.size() - 44);
+    patch(bytes, length_offset,
+          uint32_t(bytes.size() - frame_header_t::size));
+    REQUIRE(receive(bytes, received, ec));
+    CHECK_FALSE(received.validate(op, ec));
+    CHECK(ec == std::errc::bad_message);
+  }
+
+  SUBCASE("an operation too short for its type") {
+    // a subtract operation holding a readings and a part of another
+    patch(bytes, frame_header_t::size + 12, uint32_t{24});
+    bytes.resize(bytes.size() - 16);
+    patch(bytes, length_offset,
+          uint32_t(bytes.size() - frame_header_t::size));
+    REQUIRE(receive(bytes, received, ec));
+    REQUIRE(received.validate(op, ec));
+    REQUIRE(received.next(op, ec));
+    REQUIRE(received.next(op, ec));
+    erd::readings_t lhs;
+    erd::readings_t rhs;
+    CHECK_FALSE(op.readings(lhs, rhs, ec));
+    CHECK(ec == std::errc::bad_message);
+  }
+}
+
+TEST_CASE("request_frame: holds at most as many operations as it counts") {
+  request_frame frame;
+  frame.begin(1);
+  for (uint32_t i = 0; i < std::numeric_limits<uint16_t>::max(); i++) {
+    frame.add_unsubscribe();
+  }
+  CHECK_THROWS_AS(frame.add_unsubscribe(), std::length_error);
+  frame.finish();
+  CHECK(frame.header().count == std::numeric_limits<uint16_t>::max());
+}
+
+TEST_CASE("response_frame: operations are read back") {
+  std::vector<erd::readings_t> samples{sample(1, 100), sample(2, 250),
+                                       sample(4, 5)};
+  std::vector<snapshot_entry_t> entries{
+      {{erd::domain_t::package, 0}, status_code_t::success, sample(9, 900)},
+      {{erd::domain_t::dram, 1}, status_code_t::error, sample(0, 0)}};
+
+  response_frame sent;
+  sent.begin(3);
+  sent.add(status_code_t::success, sample(5, 50), std::chrono::seconds(1));
+  sent.add(status_code_t::success, samples.data(), samples.size());
+  sent.add(status_code_t::success, entries);
+  sent.add(operation_type_t::unsubscribe, status_code_t::error);
+  sent.finish();
+
+  response_frame received;
+  std::error_code ec;
+  REQUIRE(receive(bytes_of(sent), received, ec));
+  response_operation_t op;
+
+  REQUIRE(received.next(op, ec));
+  erd::readings_t readings;
+  REQUIRE(op.readings(readings, ec));
+  CHECK(readings.energy.count() == 50);
+  std::chrono::nanoseconds age;
+  REQUIRE(op.age(age));
+  CHECK(age == std::chrono::seconds(1));
+
+  REQUIRE(received.next(op, ec));
+  CHECK(op.type == operation_type_t::samples);
+  std::vector<erd::readings_t> batch;
+  REQUIRE(op.samples(batch, ec));
+  REQUIRE(batch.size() == samples.size());
+  CHECK(batch[2].energy.count() == 5);
+
+  REQUIRE(received.next(op, ec));
+  std::vector<snapshot_entry_t> snapshot;
+  REQUIRE(op.snapshot(snapshot, ec));
+  REQUIRE(snapshot.size() == 2);
+  CHECK(snapshot[0].readings.energy.count() == 900);
+  CHECK(snapshot[1].attributes.domain == erd::domain_t::dram);
+  CHECK(snapshot[1].status == status_code_t::error);
+
+  REQUIRE(received.next(op, ec));
+  CHECK(op.type == operation_type_t::unsubscribe);
+  CHECK(op.status == status_code_t::error);
+  CHECK_FALSE(received.next(op, ec));
+  CHECK_FALSE(ec);
+}
+
+TEST_CASE("response_frame: a snapshot counting more entries than it holds") {
+  response_frame sent;
+  sent.begin(1);
+  sent.add(status_code_t::success, std::vector<snapshot_entry_t>{});
+  sent.finish();
+  std::vector<char> bytes = bytes_of(sent);
+  // the entry count, after the operation header
+  patch(bytes, frame_header_t::size + 12, uint32_t{1000});
+
+  response_frame received;
+  std::error_code ec;
+  REQUIRE(receive(bytes, received, ec));
+  response_operation_t op;
+  REQUIRE(received.next(op, ec));
+  std::vector<snapshot_entry_t> snapshot;
+  CHECK_FALSE(op.snapshot(snapshot, ec));
+  CHECK(ec == std::errc::bad_message);
+}
@@ -0,0 +1,163 @@
+#include <doctest/doctest.h>
+#include <erd/ipc/message.hpp>
+#include <erd/metrics.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using erd::histogram_t;
+
+// every value recorded lies in its bucket, which spans at most 1/16 of it
+bool in_bucket(std::uint64_t value) {
+  std::size_t index = histogram_t::bucket_index(value);
+  std::uint64_t lower = histogram_t::bucket_lower(index);
+  std::uint64_t upper = histogram_t::bucket_upper(index);
+  return index < histogram_t::bucket_count && lower <= value &&
+         value <= upper && upper - lower <= lower / 16;
+}
+
+} // namespace
+
+TEST_CASE("histogram_t: bucket indexing") {
+  // values below 16 have a bucket each
+  for (std::uint64_t value = 0; value < 16; value++) {
+    CHECK(histogram_t::bucket_index(value) == value);
+    CHECK(histogram_t::bucket_upper(value) == value);
+  }
+  CHECK(histogram_t::bucket_index(std::numeric_limits<std::uint64_t>::max()) ==
+        histogram_t::bucket_count - 1);
+
+  // around every power of two, and random values of every magnitude
+  std::vector<std::uint64_t> values;
+  for (unsigned exponent = 2; exponent < 64; exponent++) {
+    std::uint64_t power = std::uint64_t{1} << exponent;
+    values.insert(values.end(), {power - 1, power, power + 1});
+  }
+  std::mt19937_64 random{42};
+  for (int i = 0; i < 10000; i++) {
+    values.push_back(random() >> (random() % 64));
+  }
+  std::sort(values.begin(), values.end());
+  std::size_t previous = 0;
+  bool ordered = true;
+  bool bounded = true;
+  for (std::uint64_t value : values) {
+    std::size_t index = histogram_t::bucket_index(value);
+    ordered = ordered && index >= previous;
+    previous = index;
+    bounded = bounded && in_bucket(value);
+  }
+  CHECK(ordered);
+  CHECK(bounded);
+  // consecutive buckets leave no gap
+  for (std::size_t index = 1; index < histogram_t::bucket_count; index++) {
+    REQUIRE(histogram_t::bucket_lower(index) ==
+            histogram_t::bucket_upper(index - 1) + 1);
+  }
+}
+
+TEST_CASE("histogram_t: summary values") {
+  histogram_t histogram;
+  CHECK(histogram.count() == 0);
+  CHECK(histogram.min() == 0);
+  CHECK(histogram.mean() == 0);
+  CHECK(histogram.percentile(0.5) == 0);
+
+  for (std::uint64_t value = 1; value <= 100; value++) {
+    histogram.record(value);
+  }
+  CHECK(histogram.count() == 100);
+  CHECK(histogram.sum() == 5050);
+  CHECK(histogram.min() == 1);
+  CHECK(histogram.max() == 100);
+  CHECK(histogram.mean() == doctest::Approx(50.5));
+  // within the precision of the buckets
+  CHECK(histogram.percentile(0.5) >= 50);
+  CHECK(histogram.percentile(0.5) <= 53);
+  CHECK(histogram.percentile(0) == 1);
+  CHECK(histogram.percentile(1) == 100);
+
+  histogram_t other;
+  other.record(1000, 3);
+  histogram.merge(other);
+  CHECK(histogram.count() == 103);
+  CHECK(histogram.sum() == 8050);
+  CHECK(histogram.max() == 1000);
+  CHECK(histogram.bucket(histogram_t::bucket_index(1000)) == 3);
+
+  histogram.reset();
+  CHECK(histogram.count() == 0);
+  CHECK(histogram.max() == 0);
+}
+
+TEST_CASE("stats_t: a stats frame is read back") {
+  erd::stats_t sent;
+  sent.histograms[0].record(10);
+  sent.histograms[0].record(123456, 2);
+  sent.histograms[3].record(std::numeric_limits<std::uint64_t>::max());
+  sent.errors[1] = 7;
+
+  erd::ipc::response_frame frame;
+  frame.begin(5);
+  frame.add(erd::ipc::status_code_t::success, sent);
+  frame.finish();
+
+  erd::ipc::response_frame received;
+  std::memcpy(received.header_buffer(), frame.data(),
+              erd::ipc::frame_header_t::size);
+  std::error_code ec;
+  REQUIRE(received.prepare_payload(ec));
+  std::memcpy(received.payload_buffer(),
+              frame.data() + erd::ipc::frame_header_t::size,
+              received.payload_size());
+  erd::ipc::response_operation_t op;
+  REQUIRE(received.next(op, ec));
+  erd::stats_t stats;
+  REQUIRE(op.stats(stats, ec));
+
+  for (std::size_t m = 0; m < erd::metric_count; m++) {
+    CAPTURE(m);
+    const histogram_t &lhs = stats.histograms[m];
+    const histogram_t &rhs = sent.histograms[m];
+    CHECK(lhs.count() == rhs.count());
+    CHECK(lhs.sum() == rhs.sum());
+    CHECK(lhs.min() == rhs.min());
+    CHECK(lhs.max() == rhs.max());
+    CHECK(stats.errors[m] == sent.errors[m]);
+    for (std::size_t i = 0; i < histogram_t::bucket_count; i++) {
+      REQUIRE(lhs.bucket(i) == rhs.bucket(i));
+    }
+  }
+}
+
+TEST_CASE("metrics_t: merges what every thread recorded") {
+  erd::metrics_t &metrics = erd::metrics_t::instance();
+  metrics.reset();
+  metrics.record(erd::metric_t::read, std::chrono::microseconds(5));
+  // a thread that exits before the snapshot
+  std::thread{[&metrics] {
+    metrics.record(erd::metric_t::read, std::chrono::microseconds(7));
+    metrics.record_error(erd::metric_t::ipc);
+  }}.join();
+
+  erd::stats_t stats = metrics.snapshot();
+  const histogram_t &read = stats.histogram(erd::metric_t::read);
+  CHECK(read.count() == 2);
+  CHECK(read.sum() == 12000);
+  CHECK(read.min() == 5000);
+  CHECK(read.max() == 7000);
+  CHECK(stats.error_count(erd::metric_t::ipc) == 1);
+
+  metrics.reset();
+  stats = metrics.snapshot();
+  CHECK(stats.histogram(erd::metric_t::read).count() == 0);
+  CHECK(stats.error_count(erd::metric_t::ipc) == 0);
+}
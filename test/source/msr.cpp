@@ -0,0 +1,129 @@
+#if defined(ERD_MSR)
+
+#include "temp_dir.hpp"
+
+#include <doctest/doctest.h>
+#include <erd/erd_msr.hpp>
+
+#include <cstring>
+#include <string>
+
+namespace {
+
+constexpr uint32_t MSR_RAPL_POWER_UNIT = 0x606;
+constexpr uint32_t MSR_PKG_ENERGY_STATUS = 0x611;
+constexpr uint32_t MSR_DRAM_ENERGY_STATUS = 0x619;
+constexpr uint32_t MSR_PP0_ENERGY_STATUS = 0x639;
+constexpr uint32_t MSR_PP1_ENERGY_STATUS = 0x641;
+
+constexpr uint32_t HASWELL_X = 0x3f;
+constexpr uint32_t SKYLAKE_CLIENT = 0x5e;
+
+// a file laid out like /dev/cpu/N/msr, register R being the 8 bytes at offset
+// R; counts are in 2^-14 J, the usual energy unit
+class fake_msr_t {
+public:
+  // the registers past the end of the file are missing
+  explicit fake_msr_t(std::size_t size = MSR_PP1_ENERGY_STATUS + 8)
+      : registers_(size, '\0') {
+    set(MSR_RAPL_POWER_UNIT, 14 << 8 | 0x3 << 16 | 0x3);
+  }
+
+  void set(uint32_t reg, uint64_t value) {
+    std::memcpy(&registers_[reg], &value, sizeof(value));
+    dir_.write("msr", registers_);
+  }
+
+  [[nodiscard]] std::string path() const { return dir_.path("msr"); }
+
+private:
+  temp_dir_t dir_;
+  std::string registers_;
+};
+
+uint64_t read_energy(const erd::msr_reader_t &reader) {
+  erd::readings_t readings;
+  std::error_code ec;
+  REQUIRE(reader.obtain_readings(readings, ec));
+  return readings.energy.count();
+}
+
+} // namespace
+
+TEST_CASE("msr_reader_t: decodes the energy unit") {
+  fake_msr_t msr;
+  msr.set(MSR_PKG_ENERGY_STATUS, 1 << 14);
+  msr.set(MSR_PP0_ENERGY_STATUS, 1 << 13);
+  erd::msr_reader_t package{{erd::domain_t::package, 0}, msr.path(), 0};
+  erd::msr_reader_t cores{{erd::domain_t::cores, 0}, msr.path(), 0};
+  CHECK(read_energy(package) == 1000000);
+  CHECK(read_energy(cores) == 500000);
+  // 2^32 counts of 2^-14 J
+  CHECK(package.max_energy().count() == 262144000000);
+
+  SUBCASE("the reserved upper half of the register is ignored") {
+    msr.set(MSR_PKG_ENERGY_STATUS, uint64_t(0xdead) << 32 | 1 << 14);
+    CHECK(read_energy(package) == 1000000);
+  }
+
+  SUBCASE("counts are floored to whole microjoules") {
+    // 61.03515625 uJ
+    msr.set(MSR_PKG_ENERGY_STATUS, 1);
+    CHECK(read_energy(package) == 61);
+  }
+}
+
+TEST_CASE("msr_reader_t: DRAM unit of server models") {
+  fake_msr_t msr;
+  msr.set(MSR_DRAM_ENERGY_STATUS, 1 << 16);
+
+  // in the unit of the package on client parts
+  erd::msr_reader_t client{{erd::domain_t::dram, 0}, msr.path(),
+                           SKYLAKE_CLIENT};
+  CHECK(read_energy(client) == 4000000);
+
+  // fixed at 2^-16 J on Haswell-EP and later servers
+  erd::msr_reader_t server{{erd::domain_t::dram, 0}, msr.path(), HASWELL_X};
+  CHECK(read_energy(server) == 1000000);
+  CHECK(server.max_energy().count() == 65536000000);
+
+  // other domains keep the unit of the register
+  msr.set(MSR_PKG_ENERGY_STATUS, 1 << 14);
+  erd::msr_reader_t package{{erd::domain_t::package, 0}, msr.path(),
+                            HASWELL_X};
+  CHECK(read_energy(package) == 1000000);
+}
+
+TEST_CASE("msr_reader_t: subtracts across a wrap of the counter") {
+  fake_msr_t msr;
+  erd::msr_reader_t reader{{erd::domain_t::package, 0}, msr.path(), 0};
+  erd::readings_t before;
+  erd::readings_t after;
+  std::error_code ec;
+  msr.set(MSR_PKG_ENERGY_STATUS, (uint64_t(1) << 32) - (1 << 14));
+  REQUIRE(reader.obtain_readings(before, ec));
+  msr.set(MSR_PKG_ENERGY_STATUS, 1 << 14);
+  REQUIRE(reader.obtain_readings(after, ec));
+  CHECK(reader.subtract(after, before).energy_consumed.count() == 2000000);
+}
+
+TEST_CASE("msr_reader_t: throws without a device") {
+  temp_dir_t dir;
+  CHECK_THROWS(
+      erd::msr_reader_t{{erd::domain_t::package, 0}, dir.path("msr"), 0});
+  // too short to hold MSR_RAPL_POWER_UNIT
+  dir.write("msr", std::string(16, '\0'));
+  CHECK_THROWS(
+      erd::msr_reader_t{{erd::domain_t::package, 0}, dir.path("msr"), 0});
+}
+
+TEST_CASE("msr_reader_t: throws for a domain the part lacks") {
+  // the file ends before the DRAM, PP0 and PP1 status registers
+  fake_msr_t msr{MSR_DRAM_ENERGY_STATUS};
+  CHECK_NOTHROW(erd::msr_reader_t{{erd::domain_t::package, 0}, msr.path(), 0});
+  CHECK_THROWS(erd::msr_reader_t{{erd::domain_t::dram, 0}, msr.path(), 0});
+  CHECK_THROWS(erd::msr_reader_t{{erd::domain_t::cores, 0}, msr.path(), 0});
+  CHECK_THROWS(erd::msr_reader_t{{erd::domain_t::uncore, 0}, msr.path(), 0});
+}
+
+#endif // ERD_MSR
@@ -0,0 +1,176 @@
+#if defined(ERD_POWERCAP)
+
+#include "fake_powercap.hpp"
+
+#include <doctest/doctest.h>
+#include <erd/erd_powercap.hpp>
+#include <erd/topology.hpp>
+
+#include <string>
+#include <vector>
+
+TEST_CASE("topology: zones of a powercap tree") {
+  erd::topology_t topology =
+      erd::topology_t::discover(fake_powercap.root.path());
+  CHECK(topology.sockets() == 2);
+  // the zones of the dies of a package are one
+  REQUIRE(topology.zones().size() == 5);
+
+  const erd::zone_t *dram = topology.find({erd::domain_t::dram, 0});
+  REQUIRE(dram != nullptr);
+  CHECK(dram->name == "dram");
+  CHECK(dram->path == fake_powercap.root.path("intel-rapl:0:1"));
+  CHECK(dram->max_energy.count() == MAX_ENERGY);
+
+  const erd::zone_t *package = topology.find({erd::domain_t::package, 1});
+  REQUIRE(package != nullptr);
+  CHECK(package->name == "package-1-die-0");
+  CHECK(package->dies ==
+        std::vector<std::string>{fake_powercap.root.path("intel-rapl:2")});
+  const erd::zone_t *dram_1 = topology.find({erd::domain_t::dram, 1});
+  REQUIRE(dram_1 != nullptr);
+  CHECK(dram_1->dies ==
+        std::vector<std::string>{fake_powercap.root.path("intel-rapl:2:0")});
+  CHECK(dram->dies.empty());
+  CHECK(topology.find({erd::domain_t::uncore, 0}) == nullptr);
+  CHECK(topology.find({erd::domain_t::package, 2}) == nullptr);
+}
+
+TEST_CASE("powercap_reader_t: reads and subtracts energy_uj") {
+  erd::powercap_reader_t reader{{erd::domain_t::package, 0}};
+  CHECK(reader.max_energy().count() == MAX_ENERGY);
+
+  erd::readings_t before;
+  erd::readings_t after;
+  std::error_code ec;
+  REQUIRE(reader.obtain_readings(before, ec));
+  CHECK(before.energy.count() == 1000);
+
+  SUBCASE("without wrapping") {
+    fake_powercap.set_energy("intel-rapl:0", 1500);
+    REQUIRE(reader.obtain_readings(after, ec));
+    CHECK(after.energy.count() == 1500);
+    CHECK(reader.subtract(after, before).energy_consumed.count() == 500);
+    CHECK(after.timestamp >= before.timestamp);
+  }
+
+  SUBCASE("across a wrap of the counter") {
+    fake_powercap.set_energy("intel-rapl:0", 100);
+    REQUIRE(reader.obtain_readings(after, ec));
+    CHECK(reader.subtract(after, before).energy_consumed.count() ==
+          MAX_ENERGY - 1000 + 100);
+  }
+
+  fake_powercap.set_energy("intel-rapl:0", 1000);
+}
+
+TEST_CASE("powercap_reader_t: adds up the dies of a package") {
+  erd::powercap_reader_t reader{{erd::domain_t::package, 1}};
+  erd::readings_t before;
+  erd::readings_t after;
+  std::error_code ec;
+  REQUIRE(reader.obtain_readings(before, ec));
+  CHECK(before.energy.count() == 12000);
+
+  // the second die wraps around while the first does not
+  fake_powercap.set_energy("intel-rapl:1", 5100);
+  fake_powercap.set_energy("intel-rapl:2", 50);
+  REQUIRE(reader.obtain_readings(after, ec));
+  CHECK(reader.subtract(after, before).energy_consumed.count() ==
+        100 + MAX_ENERGY - 7000 + 50);
+
+  erd::powercap_reader_set_t set{{{erd::domain_t::package, 1}}};
+  erd::readings_set_t readings;
+  REQUIRE(set.obtain_readings(readings, ec));
+  REQUIRE(readings.energy.size() == 1);
+  CHECK(readings.energy[0] == after.energy);
+
+  fake_powercap.set_energy("intel-rapl:1", 5000);
+  fake_powercap.set_energy("intel-rapl:2", 7000);
+}
+
+TEST_CASE("topology: a cache is read back") {
+  temp_dir_t dir;
+  erd::zone_t zone{{erd::domain_t::dram, 1},
+                   "/with space/intel-rapl:1:0",
+                   "dram",
+                   erd::energy_t{MAX_ENERGY},
+                   {"/with \"quotes\"/intel-rapl:2:0"}};
+  erd::topology_t saved{{zone}};
+  std::error_code ec;
+  REQUIRE(saved.save(dir.path("cache"), ec));
+
+  erd::topology_t loaded;
+  REQUIRE(erd::topology_t::load(dir.path("cache"), loaded, ec));
+  REQUIRE(loaded.zones().size() == 1);
+  const erd::zone_t &read = loaded.zones().front();
+  CHECK(read.attr.domain == zone.attr.domain);
+  CHECK(read.attr.socket == zone.attr.socket);
+  CHECK(read.path == zone.path);
+  CHECK(read.name == zone.name);
+  CHECK(read.max_energy == zone.max_energy);
+  CHECK(read.dies == zone.dies);
+}
+
+TEST_CASE("powercap_reader_t: throws for a zone the tree lacks") {
+  CHECK_THROWS(erd::powercap_reader_t{{erd::domain_t::uncore, 0}});
+  CHECK_THROWS(erd::powercap_reader_t{{erd::domain_t::package, 3}});
+}
+
+TEST_CASE("powercap_reader_set_t: reads every zone at once") {
+  erd::powercap_reader_set_t set{{{erd::domain_t::package, 0},
+                                  {erd::domain_t::dram, 0},
+                                  {erd::domain_t::dram, 1}}};
+  REQUIRE(set.size() == 3);
+
+  erd::readings_set_t before;
+  erd::readings_set_t after;
+  std::error_code ec;
+  REQUIRE(set.obtain_readings(before, ec));
+  REQUIRE(before.energy.size() == 3);
+  CHECK(before.energy[0].count() == 1000);
+  CHECK(before.energy[1].count() == 300);
+  CHECK(before.energy[2].count() == 1400);
+  CHECK(before.begin <= before.end);
+
+  fake_powercap.set_energy("intel-rapl:0:1", 350);
+  REQUIRE(set.obtain_readings(after, ec));
+  CHECK(set.subtract(1, after, before).energy_consumed.count() == 50);
+  CHECK(set.subtract(2, after, before).energy_consumed.count() == 0);
+  fake_powercap.set_energy("intel-rapl:0:1", 300);
+}
+
+TEST_CASE("batch_reader: io_uring and pread read alike") {
+  std::vector<std::string> zones{"intel-rapl:0", "intel-rapl:0:0",
+                                 "intel-rapl:0:1", "intel-rapl:1"};
+  auto open_zones = [&] {
+    std::vector<erd::detail::file_descriptor> fds;
+    for (const std::string &zone : zones) {
+      fds.emplace_back(fake_powercap.root.path(zone + "/energy_uj"));
+    }
+    return fds;
+  };
+  erd::detail::batch_reader batched{open_zones()};
+  setenv("ERD_IO_URING", "0", 1);
+  erd::detail::batch_reader sync{open_zones()};
+  unsetenv("ERD_IO_URING");
+  CHECK_FALSE(sync.uses_io_uring());
+  MESSAGE("io_uring: " << batched.uses_io_uring());
+
+  // a batch never takes the completions of another
+  std::error_code ec;
+  for (uint64_t i = 0; i < 100; i++) {
+    fake_powercap.set_energy("intel-rapl:0:0", 200 + i);
+    erd::energy_t lhs[4];
+    erd::energy_t rhs[4];
+    REQUIRE(batched.read(lhs, ec));
+    REQUIRE(sync.read(rhs, ec));
+    for (std::size_t z = 0; z < zones.size(); z++) {
+      CHECK(lhs[z] == rhs[z]);
+    }
+    CHECK(lhs[1].count() == 200 + i);
+  }
+  fake_powercap.set_energy("intel-rapl:0:0", 200);
+}
+
+#endif // ERD_POWERCAP
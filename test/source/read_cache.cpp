@@ -0,0 +1,102 @@
+#include "counting_reader.hpp"
+
+#include <doctest/doctest.h>
+#include <read_cache.hpp>
+
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using namespace std::chrono_literals;
+
+constexpr erd::attributes_t package{erd::domain_t::package, 0};
+
+} // namespace
+
+TEST_CASE("read_cache_t: serves readings younger than max_age") {
+  auto state = std::make_shared<counting_state_t>();
+  erd::reader_t reader = make_counting_reader(package, state);
+  erd::ipc::read_cache_t cache{reader, 1s};
+  CHECK(&cache.reader() == &reader);
+
+  erd::readings_t first;
+  erd::readings_t second;
+  erd::clock_t::duration age;
+  std::error_code ec;
+  REQUIRE(cache.obtain_readings(first, age, ec));
+  CHECK(age >= erd::clock_t::duration::zero());
+  CHECK(age < 1s);
+  std::this_thread::sleep_for(20ms);
+  REQUIRE(cache.obtain_readings(second, age, ec));
+  CHECK(state->reads == 1);
+  CHECK(second.timestamp == first.timestamp);
+  CHECK(second.energy == first.energy);
+  // the age counts from the read, not from the first request served
+  CHECK(age >= 20ms);
+}
+
+TEST_CASE("read_cache_t: reads again once the readings expire") {
+  auto state = std::make_shared<counting_state_t>();
+  erd::reader_t reader = make_counting_reader(package, state);
+  erd::ipc::read_cache_t cache{reader, 10ms};
+
+  erd::readings_t first;
+  erd::readings_t second;
+  erd::clock_t::duration age;
+  std::error_code ec;
+  REQUIRE(cache.obtain_readings(first, age, ec));
+  std::this_thread::sleep_for(20ms);
+  REQUIRE(cache.obtain_readings(second, age, ec));
+  CHECK(state->reads == 2);
+  CHECK(second.timestamp > first.timestamp);
+  CHECK(second.energy.count() == 2000);
+  CHECK(age < 10ms);
+}
+
+TEST_CASE("read_cache_t: coalesces concurrent requests into one read") {
+  auto state = std::make_shared<counting_state_t>();
+  state->delay_ms = 50;
+  erd::reader_t reader = make_counting_reader(package, state);
+  erd::ipc::read_cache_t cache{reader, 1s};
+
+  constexpr std::size_t count = 8;
+  std::vector<erd::readings_t> readings(count);
+  std::vector<int> succeeded(count);
+  std::vector<std::thread> threads;
+  for (std::size_t i = 0; i < count; i++) {
+    threads.emplace_back([&, i] {
+      erd::clock_t::duration age;
+      std::error_code ec;
+      succeeded[i] = cache.obtain_readings(readings[i], age, ec);
+    });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  CHECK(state->reads == 1);
+  for (std::size_t i = 0; i < count; i++) {
+    CHECK(succeeded[i]);
+    CHECK(readings[i].energy.count() == 1000);
+  }
+}
+
+TEST_CASE("read_cache_t: does not cache a failed read") {
+  auto state = std::make_shared<counting_state_t>();
+  state->failing = true;
+  erd::reader_t reader = make_counting_reader(package, state);
+  erd::ipc::read_cache_t cache{reader, 1s};
+
+  erd::readings_t readings;
+  erd::clock_t::duration age;
+  std::error_code ec;
+  CHECK_FALSE(cache.obtain_readings(readings, age, ec));
+  CHECK(ec == std::errc::io_error);
+  state->failing = false;
+  REQUIRE(cache.obtain_readings(readings, age, ec));
+  CHECK_FALSE(ec);
+  CHECK(state->reads == 2);
+  CHECK(readings.energy.count() == 2000);
+}
@@ -0,0 +1,116 @@
+#include "counting_reader.hpp"
+
+#include <doctest/doctest.h>
+#include <erd/region.hpp>
+
+#include <memory>
+#include <optional>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr erd::attributes_t package{erd::domain_t::package, 0};
+
+} // namespace
+
+TEST_CASE("region_t: records the energy and time between its ends") {
+  auto state = std::make_shared<counting_state_t>();
+  erd::profiler_t profiler{make_counting_reader(package, state)};
+  { erd::region_t region{profiler, "whole"}; }
+  {
+    erd::region_t region{profiler, "stopped"};
+    region.stop();
+    // recorded once, not again on destruction
+    region.stop();
+  }
+  { erd::region_t region{profiler, "whole"}; }
+
+  std::vector<erd::region_stats_t> report = profiler.report();
+  REQUIRE(report.size() == 2);
+  CHECK(report[0].label == "stopped");
+  CHECK(report[0].count == 1);
+  CHECK(report[0].energy.count() == 1000);
+  CHECK(report[1].label == "whole");
+  CHECK(report[1].count == 2);
+  CHECK(report[1].errors == 0);
+  CHECK(report[1].energy.count() == 2000);
+  CHECK(report[1].duration > erd::clock_t::duration::zero());
+  CHECK(state->reads == 6);
+}
+
+TEST_CASE("region_t: nested regions each count what they enclose") {
+  auto state = std::make_shared<counting_state_t>();
+  erd::profiler_t profiler{make_counting_reader(package, state)};
+  {
+    erd::region_t outer{profiler, "outer"};
+    erd::region_t inner{profiler, "inner"};
+  }
+  std::vector<erd::region_stats_t> report = profiler.report();
+  REQUIRE(report.size() == 2);
+  CHECK(report[0].label == "inner");
+  CHECK(report[0].energy.count() == 1000);
+  CHECK(report[1].label == "outer");
+  CHECK(report[1].energy.count() == 3000);
+  CHECK(report[1].duration >= report[0].duration);
+}
+
+TEST_CASE("region_t: failed reads and labels beyond the maximum") {
+  auto state = std::make_shared<counting_state_t>();
+  erd::profiler_t profiler{make_counting_reader(package, state), 2};
+
+  SUBCASE("labels beyond the maximum are dropped") {
+    { erd::region_t region{profiler, "a"}; }
+    { erd::region_t region{profiler, "b"}; }
+    { erd::region_t region{profiler, "c"}; }
+    { erd::region_t region{profiler, "a"}; }
+    CHECK(profiler.dropped() == 1);
+    std::vector<erd::region_stats_t> report = profiler.report();
+    REQUIRE(report.size() == 2);
+    CHECK(report[0].label == "a");
+    CHECK(report[0].count == 2);
+    CHECK(report[1].label == "b");
+  }
+
+  SUBCASE("regions that cannot be read count as errors") {
+    state->failing = true;
+    { erd::region_t region{profiler, "a"}; }
+    std::vector<erd::region_stats_t> report = profiler.report();
+    REQUIRE(report.size() == 1);
+    CHECK(report[0].count == 0);
+    CHECK(report[0].errors == 1);
+    CHECK(report[0].energy.count() == 0);
+  }
+}
+
+TEST_CASE("profiler_t: outlives the threads recording into it") {
+  auto state = std::make_shared<counting_state_t>();
+  erd::profiler_t profiler{make_counting_reader(package, state), 1};
+  // one after the other, so each takes over the table of the previous one
+  // and the single label is never exceeded
+  for (int i = 0; i < 4; i++) {
+    std::thread{[&profiler] {
+      erd::region_t region{profiler, "thread"};
+    }}.join();
+  }
+  std::vector<erd::region_stats_t> report = profiler.report();
+  REQUIRE(report.size() == 1);
+  CHECK(report[0].count == 4);
+  CHECK(profiler.dropped() == 0);
+}
+
+TEST_CASE("profiler_t: a thread lets go of the tables of a destroyed one") {
+  auto state = std::make_shared<counting_state_t>();
+  std::optional<erd::profiler_t> first;
+  first.emplace(make_counting_reader(package, state));
+  { erd::region_t region{*first, "first"}; }
+  first.reset();
+
+  // possibly at the same address, but with a table of its own
+  erd::profiler_t second{make_counting_reader(package, state)};
+  { erd::region_t region{second, "second"}; }
+  std::vector<erd::region_stats_t> report = second.report();
+  REQUIRE(report.size() == 1);
+  CHECK(report[0].label == "second");
+  CHECK(report[0].count == 1);
+}
@@ -0,0 +1,105 @@
+#include <doctest/doctest.h>
+#include <erd/ring_buffer.hpp>
+
+#include <cstdint>
+#include <iterator>
+#include <thread>
+#include <vector>
+
+TEST_CASE("ring_buffer_t: rounds its capacity up to a power of two") {
+  CHECK(erd::ring_buffer_t<int>{1}.capacity() == 1);
+  CHECK(erd::ring_buffer_t<int>{5}.capacity() == 8);
+  CHECK(erd::ring_buffer_t<int>{64}.capacity() == 64);
+}
+
+TEST_CASE("ring_buffer_t: latest is the last value pushed") {
+  erd::ring_buffer_t<int> buffer{4};
+  int value = -1;
+  CHECK_FALSE(buffer.latest(value));
+  CHECK(value == -1);
+  for (int i = 0; i < 6; i++) {
+    buffer.push(i);
+    REQUIRE(buffer.latest(value));
+    CHECK(value == i);
+  }
+  CHECK(buffer.head() == 6);
+}
+
+TEST_CASE("ring_buffer_t: drain") {
+  erd::ring_buffer_t<int> buffer{4};
+  std::uint64_t cursor = 0;
+  std::vector<int> values;
+
+  SUBCASE("copies the values pushed since the cursor") {
+    buffer.push(1);
+    buffer.push(2);
+    CHECK(buffer.drain(cursor, std::back_inserter(values)) == 2);
+    CHECK(values == std::vector<int>{1, 2});
+    CHECK(cursor == 2);
+    CHECK(buffer.drain(cursor, std::back_inserter(values)) == 0);
+    buffer.push(3);
+    CHECK(buffer.drain(cursor, std::back_inserter(values)) == 1);
+    CHECK(values == std::vector<int>{1, 2, 3});
+  }
+
+  SUBCASE("skips the values overwritten") {
+    for (int i = 0; i < 10; i++) {
+      buffer.push(i);
+    }
+    CHECK(buffer.drain(cursor, std::back_inserter(values)) == 4);
+    CHECK(values == std::vector<int>{6, 7, 8, 9});
+    CHECK(cursor == 10);
+  }
+
+  SUBCASE("copies at most max_count values, the oldest first") {
+    for (int i = 0; i < 3; i++) {
+      buffer.push(i);
+    }
+    CHECK(buffer.drain(cursor, std::back_inserter(values), 2) == 2);
+    CHECK(values == std::vector<int>{0, 1});
+    CHECK(cursor == 2);
+    CHECK(buffer.drain(cursor, std::back_inserter(values), 2) == 1);
+    CHECK(cursor == 3);
+  }
+
+  SUBCASE("moves a cursor past head back to it") {
+    buffer.push(1);
+    cursor = 100;
+    CHECK(buffer.drain(cursor, std::back_inserter(values)) == 0);
+    CHECK(cursor == 1);
+    buffer.push(2);
+    CHECK(buffer.drain(cursor, std::back_inserter(values)) == 1);
+    CHECK(values == std::vector<int>{2});
+  }
+}
+
+TEST_CASE("ring_buffer_t: a consumer racing the producer reads in order") {
+  constexpr std::uint64_t count = 100000;
+  erd::ring_buffer_t<std::uint64_t> buffer{16};
+  std::thread producer{[&buffer] {
+    for (std::uint64_t i = 0; i < count; i++) {
+      buffer.push(i);
+    }
+  }};
+
+  std::uint64_t cursor = 0;
+  std::uint64_t previous = 0;
+  std::uint64_t received = 0;
+  bool ordered = true;
+  std::vector<std::uint64_t> values;
+  while (cursor < count) {
+    values.clear();
+    buffer.drain(cursor, std::back_inserter(values));
+    for (std::uint64_t value : values) {
+      // each value is its position, so it is below the cursor
+      ordered = ordered && (received == 0 || value > previous) &&
+                value < cursor;
+      previous = value;
+      received++;
+    }
+  }
+  producer.join();
+  CHECK(ordered);
+  CHECK(received > 0);
+  CHECK(previous == count - 1);
+}
@@ -0,0 +1,59 @@
+#include <doctest/doctest.h>
+#include <erd/sampler.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <iterator>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using namespace std::chrono_literals;
+
+erd::reader_t make_reader(erd::domain_t domain) {
+  return erd::reader_t{std::in_place, erd::sim_reader_t::backend_name,
+                       erd::attributes_t{domain, 0}};
+}
+
+} // namespace
+
+TEST_CASE("sampler_t: publishes the readings of each reader") {
+  erd::sampler_t sampler{std::vector<erd::reader_t>{
+                             make_reader(erd::domain_t::package),
+                             make_reader(erd::domain_t::dram)},
+                         1ms};
+  REQUIRE(sampler.size() == 2);
+  CHECK(sampler.reader(1).attributes().domain == erd::domain_t::dram);
+  while (sampler.buffer(0).head() < 3 || sampler.buffer(1).head() < 3) {
+    std::this_thread::sleep_for(1ms);
+  }
+  erd::readings_t readings;
+  CHECK(sampler.latest(readings, 1));
+  CHECK(readings.timestamp <= erd::now());
+  CHECK(sampler.errors() == 0);
+}
+
+TEST_CASE("sampler_t: a slow consumer gets the most recent readings") {
+  erd::sampler_t sampler{make_reader(erd::domain_t::package), 1ms, 8};
+  while (sampler.buffer().head() < 20) {
+    std::this_thread::sleep_for(1ms);
+  }
+  sampler.stop();
+  std::uint64_t head = sampler.buffer().head();
+
+  std::uint64_t cursor = 0;
+  std::vector<erd::readings_t> readings;
+  CHECK(sampler.drain(cursor, std::back_inserter(readings)) == 8);
+  CHECK(cursor == head);
+  for (std::size_t i = 1; i < readings.size(); i++) {
+    CHECK(readings[i - 1].timestamp < readings[i].timestamp);
+  }
+  erd::readings_t latest;
+  REQUIRE(sampler.latest(latest));
+  CHECK(latest.timestamp == readings.back().timestamp);
+
+  // a stopped sampler pushes no more
+  std::this_thread::sleep_for(5ms);
+  CHECK(sampler.buffer().head() == head);
+}
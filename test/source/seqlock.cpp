@@ -0,0 +1,64 @@
+#include <doctest/doctest.h>
+#include <erd/seqlock.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// larger than a word, so that a torn read would mix two stores
+struct triple_t {
+  uint64_t a;
+  uint64_t b;
+  uint64_t c;
+};
+
+} // namespace
+
+TEST_CASE("seqlock_t: loads what was stored") {
+  erd::seqlock_t<triple_t> lock;
+  CHECK(lock.version() == 0);
+  triple_t value = lock.load();
+  CHECK(value.a == 0);
+
+  lock.store({1, 2, 3});
+  lock.store({4, 5, 6});
+  CHECK(lock.version() == 2);
+  REQUIRE(lock.try_load(value));
+  CHECK(value.a == 4);
+  CHECK(value.b == 5);
+  CHECK(value.c == 6);
+}
+
+TEST_CASE("seqlock_t: readers never see a torn value") {
+  erd::seqlock_t<triple_t> lock;
+  constexpr uint64_t stores = 200000;
+  std::atomic<bool> done{false};
+  std::atomic<uint64_t> torn{0};
+
+  std::vector<std::thread> readers;
+  for (int r = 0; r < 3; r++) {
+    readers.emplace_back([&] {
+      uint64_t previous = 0;
+      while (!done.load(std::memory_order_acquire)) {
+        triple_t value = lock.load();
+        if (value.b != value.a * 2 || value.c != value.a * 3 ||
+            value.a < previous) {
+          torn.fetch_add(1, std::memory_order_relaxed);
+        }
+        previous = value.a;
+      }
+    });
+  }
+  for (uint64_t i = 1; i <= stores; i++) {
+    lock.store({i, i * 2, i * 3});
+  }
+  done.store(true, std::memory_order_release);
+  for (std::thread &reader : readers) {
+    reader.join();
+  }
+  CHECK(torn.load() == 0);
+  CHECK(lock.version() == stores);
+}
@@ -0,0 +1,87 @@
+#include <doctest/doctest.h>
+#include <erd/series.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace {
+
+constexpr uint64_t max_energy = 262143328850;
+
+// samples a millisecond or so apart, wrapping around at max_energy now and
+// then, with a few steps the vector kernels leave to the scalar path
+std::vector<erd::readings_t> make_samples(std::size_t count) {
+  std::mt19937_64 random{count};
+  std::vector<erd::readings_t> samples;
+  int64_t time = 1000;
+  uint64_t energy = max_energy - 100000;
+  for (std::size_t i = 0; i < count; i++) {
+    samples.push_back(
+        erd::readings_t{erd::time_point_t{erd::clock_t::duration{time}},
+                        erd::energy_t{energy}});
+    time += 900000 + static_cast<int64_t>(random() % 200000);
+    energy = (energy + random() % 50000) % max_energy;
+    if (i % 13 == 12) {
+      // a step too long for the exponent trick
+      time += int64_t(1) << 53;
+    }
+  }
+  return samples;
+}
+
+double reference_watts(const erd::difference_t &diff) {
+  return static_cast<double>(diff.energy_consumed.count()) * 1e-6 /
+         std::chrono::duration<double>(diff.duration).count();
+}
+
+} // namespace
+
+TEST_CASE("subtract_n: matches subtracting each pair") {
+  // whether or not it is used, the vectorised kernel must agree with subtract
+  MESSAGE("vectorised: " << erd::series_vectorised());
+  for (std::size_t count = 0; count <= 40; count++) {
+    CAPTURE(count);
+    std::vector<erd::readings_t> samples = make_samples(count);
+    std::vector<erd::difference_t> diffs(count, erd::difference_t{});
+    erd::subtract_n(samples.data(), count, erd::energy_t{max_energy},
+                    diffs.data());
+
+    for (std::size_t i = 0; i + 1 < count; i++) {
+      uint64_t lhs = samples[i + 1].energy.count();
+      uint64_t rhs = samples[i].energy.count();
+      uint64_t expected = lhs >= rhs ? lhs - rhs : lhs + max_energy - rhs;
+      CHECK(diffs[i].duration ==
+            samples[i + 1].timestamp - samples[i].timestamp);
+      CHECK(diffs[i].energy_consumed.count() == expected);
+    }
+    // count samples give count - 1 differences and nothing past them
+    if (count > 0) {
+      CHECK(diffs[count - 1].duration.count() == 0);
+      CHECK(diffs[count - 1].energy_consumed.count() == 0);
+    }
+  }
+}
+
+TEST_CASE("power_series: matches dividing each difference") {
+  for (std::size_t count = 0; count <= 40; count++) {
+    CAPTURE(count);
+    std::vector<erd::readings_t> samples = make_samples(count);
+    std::size_t pairs = count > 0 ? count - 1 : 0;
+    std::vector<erd::difference_t> diffs(pairs);
+    erd::subtract_n(samples.data(), count, erd::energy_t{max_energy},
+                    diffs.data());
+
+    std::vector<erd::watts<double>> from_samples(pairs);
+    std::vector<erd::watts<double>> from_diffs(pairs);
+    erd::power_series(samples.data(), count, erd::energy_t{max_energy},
+                      from_samples.data());
+    erd::power_series(diffs.data(), pairs, from_diffs.data());
+    for (std::size_t i = 0; i < pairs; i++) {
+      double expected = reference_watts(diffs[i]);
+      CHECK(from_samples[i].count() == doctest::Approx(expected));
+      CHECK(from_diffs[i].count() == doctest::Approx(expected));
+    }
+  }
+}
@@ -0,0 +1,217 @@
+#include "counting_reader.hpp"
+#include "test_server.hpp"
+#if defined(ERD_POWERCAP)
+#include "fake_powercap.hpp"
+#endif
+
+#include <doctest/doctest.h>
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace {
+
+using namespace erd::ipc;
+
+constexpr erd::attributes_t package{erd::domain_t::package, 0};
+constexpr erd::attributes_t dram{erd::domain_t::dram, 0};
+
+} // namespace
+
+TEST_CASE("server: answers the operations of a frame in order") {
+  auto package_state = std::make_shared<counting_state_t>();
+  auto dram_state = std::make_shared<counting_state_t>();
+  dram_state->reads = 10;
+  std::vector<erd::reader_t> readers{
+      make_counting_reader(package, package_state),
+      make_counting_reader(dram, dram_state)};
+  test_server_t server{readers};
+  auto socket = server.connect();
+
+  erd::readings_t lhs{erd::time_point_t{std::chrono::seconds(2)},
+                      erd::energy_t{5000}};
+  erd::readings_t rhs{erd::time_point_t{std::chrono::seconds(1)},
+                      erd::energy_t{2000}};
+  request_frame request;
+  request.begin(42);
+  request.add_obtain_readings();
+  request.add_obtain_readings(dram);
+  request.add_subtract(lhs, rhs);
+  request.add_obtain_readings({erd::domain_t::uncore, 0});
+  request.finish();
+  send(socket, request);
+
+  response_frame response;
+  receive(socket, response);
+  CHECK(response.header().request_id == 42);
+  CHECK(response.header().count == 4);
+  std::error_code ec;
+  erd::readings_t readings;
+
+  response_operation_t op = next_operation(response);
+  CHECK(op.status == status_code_t::success);
+  REQUIRE(op.readings(readings, ec));
+  CHECK(readings.energy.count() == 1000);
+
+  op = next_operation(response);
+  REQUIRE(op.readings(readings, ec));
+  CHECK(readings.energy.count() == 11000);
+
+  op = next_operation(response);
+  erd::difference_t diff;
+  REQUIRE(op.difference(diff, ec));
+  CHECK(diff.energy_consumed.count() == 3000);
+  CHECK(diff.duration == std::chrono::seconds(1));
+
+  // a domain not served
+  op = next_operation(response);
+  CHECK(op.status == status_code_t::error);
+}
+
+TEST_CASE("server: answers pipelined requests in the order they were sent") {
+  auto state = std::make_shared<counting_state_t>();
+  std::vector<erd::reader_t> readers{make_counting_reader(package, state)};
+  test_server_t server{readers};
+  auto socket = server.connect();
+
+  // frames and a v1 message, all sent before any response is read
+  std::vector<char> bytes;
+  for (uint32_t id = 1; id <= 3; id++) {
+    request_frame request;
+    request.begin(id);
+    request.add_obtain_readings();
+    request.finish();
+    bytes.insert(bytes.end(), request.data(), request.data() + request.size());
+  }
+  message_request message;
+  message.serialize();
+  bytes.insert(bytes.end(), message.buffer(),
+               message.buffer() + message_request::size);
+  asio::write(socket, asio::buffer(bytes));
+
+  std::error_code ec;
+  erd::readings_t readings;
+  for (uint32_t id = 1; id <= 3; id++) {
+    response_frame response;
+    receive(socket, response);
+    CHECK(response.header().request_id == id);
+    REQUIRE(next_operation(response).readings(readings, ec));
+    CHECK(readings.energy.count() == id * 1000);
+  }
+  message_response reply;
+  asio::read(socket, asio::buffer(reply.buffer(), message_response::size));
+  CHECK(reply.status_code() == status_code_t::success);
+  REQUIRE(reply.readings(readings, ec));
+  CHECK(readings.energy.count() == 4000);
+}
+
+TEST_CASE("server: malformed frames") {
+  auto state = std::make_shared<counting_state_t>();
+  std::vector<erd::reader_t> readers{make_counting_reader(package, state)};
+  test_server_t server{readers};
+  auto socket = server.connect();
+
+  request_frame request;
+  request.begin(7);
+  request.add_obtain_readings();
+  request.finish();
+  std::vector<char> bytes{request.data(), request.data() + request.size()};
+
+  SUBCASE("an operation past the payload is answered with an error") {
+    // the length of the operation
+    uint32_t length = 1000;
+    std::memcpy(bytes.data() + frame_header_t::size + 4, &length,
+                sizeof(length));
+    asio::write(socket, asio::buffer(bytes));
+    response_frame response;
+    receive(socket, response);
+    CHECK(response.header().request_id == 7);
+    CHECK(response.header().count == 1);
+    CHECK(next_operation(response).status == status_code_t::error);
+    // without reading
+    CHECK(state->reads == 0);
+
+    // the connection remains usable
+    send(socket, request);
+    receive(socket, response);
+    CHECK(next_operation(response).status == status_code_t::success);
+    CHECK(state->reads == 1);
+  }
+
+  SUBCASE("an invalid header closes the connection") {
+    uint16_t version = frame_version + 1;
+    std::memcpy(bytes.data() + 4, &version, sizeof(version));
+    asio::write(socket, asio::buffer(bytes));
+    char byte;
+    std::error_code ec;
+    CHECK(asio::read(socket, asio::buffer(&byte, 1), ec) == 0);
+    CHECK(ec);
+    CHECK(state->reads == 0);
+  }
+}
+
+namespace {
+
+std::vector<snapshot_entry_t> snapshot(test_server_t::socket_t &socket) {
+  request_frame request;
+  request.begin(3);
+  request.add_snapshot();
+  request.finish();
+  send(socket, request);
+  response_frame response;
+  receive(socket, response);
+  response_operation_t op = next_operation(response);
+  CHECK(op.status == status_code_t::success);
+  std::vector<snapshot_entry_t> entries;
+  std::error_code ec;
+  REQUIRE(op.snapshot(entries, ec));
+  return entries;
+}
+
+} // namespace
+
+TEST_CASE("server: a snapshot without a reader set reads each reader") {
+  auto package_state = std::make_shared<counting_state_t>();
+  auto dram_state = std::make_shared<counting_state_t>();
+  dram_state->reads = 10;
+  std::vector<erd::reader_t> readers{
+      make_counting_reader(package, package_state),
+      make_counting_reader(dram, dram_state)};
+  test_server_t server{readers};
+  auto socket = server.connect();
+
+  std::vector<snapshot_entry_t> entries = snapshot(socket);
+  REQUIRE(entries.size() == 2);
+  CHECK(entries[0].attributes.domain == erd::domain_t::package);
+  CHECK(entries[0].readings.energy.count() == 1000);
+  CHECK(entries[1].attributes.domain == erd::domain_t::dram);
+  CHECK(entries[1].readings.energy.count() == 11000);
+}
+
+#if defined(ERD_POWERCAP)
+
+TEST_CASE("server: a snapshot pairs the readings of a set with its domains") {
+  erd::attributes_t dram_1{erd::domain_t::dram, 1};
+  std::vector<erd::reader_t> readers{
+      erd::reader_t{std::in_place, "powercap", package},
+      erd::reader_t{std::in_place, "powercap", dram_1}};
+  // in the opposite order of the readers
+  erd::reader_set_t set{"powercap", {dram_1, package}};
+  test_server_t server{readers, {}, &set};
+  auto socket = server.connect();
+
+  std::vector<snapshot_entry_t> entries = snapshot(socket);
+  REQUIRE(entries.size() == 2);
+  CHECK(entries[0].attributes.domain == erd::domain_t::dram);
+  CHECK(entries[0].attributes.socket == 1);
+  CHECK(entries[0].readings.energy.count() == 1400);
+  CHECK(entries[1].attributes.domain == erd::domain_t::package);
+  CHECK(entries[1].attributes.socket == 0);
+  CHECK(entries[1].readings.energy.count() == 1000);
+  // read at once
+  CHECK(entries[0].readings.timestamp == entries[1].readings.timestamp);
+}
+
+#endif // ERD_POWERCAP
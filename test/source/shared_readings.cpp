@@ -0,0 +1,99 @@
+#include <doctest/doctest.h>
+#include <erd/ipc/shared_readings.hpp>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace {
+
+std::string segment_name() {
+  return "/erd-test-" + std::to_string(getpid());
+}
+
+erd::readings_t sample(int64_t ns, uint64_t energy) {
+  return erd::readings_t{erd::time_point_t{std::chrono::nanoseconds{ns}},
+                         erd::energy_t{energy}};
+}
+
+} // namespace
+
+TEST_CASE("shared_readings: a reader sees what the writer publishes") {
+  erd::ipc::shared_readings_writer writer{
+      segment_name(),
+      {{erd::domain_t::package, 0}, {erd::domain_t::dram, 1}}};
+  erd::ipc::shared_readings_reader reader{segment_name()};
+  REQUIRE(reader.size() == 2);
+  CHECK(reader.find({erd::domain_t::dram, 1}) == 1);
+  CHECK(reader.find({erd::domain_t::dram, 0}) == reader.size());
+  CHECK(reader.attributes(0).domain == erd::domain_t::package);
+
+  // nothing published yet
+  erd::readings_t readings;
+  std::error_code ec;
+  CHECK_FALSE(reader.obtain_readings(readings, ec, 1));
+  CHECK(ec == std::errc::resource_unavailable_try_again);
+
+  writer.publish(1, sample(1000, 42));
+  writer.publish(1, sample(2000, 43));
+  REQUIRE(reader.obtain_readings(readings, ec, 1));
+  CHECK(readings.timestamp == sample(2000, 43).timestamp);
+  CHECK(readings.energy.count() == 43);
+  CHECK(reader.version(1) == 2);
+  CHECK(reader.version(0) == 0);
+
+  CHECK_FALSE(reader.obtain_readings(readings, ec, 2));
+  CHECK(ec == std::errc::invalid_argument);
+}
+
+TEST_CASE("shared_readings: a new writer replaces the segment") {
+  std::vector<erd::attributes_t> attrs{{erd::domain_t::package, 0}};
+  auto first =
+      std::make_unique<erd::ipc::shared_readings_writer>(segment_name(), attrs);
+  first->publish(0, sample(1, 1));
+  erd::ipc::shared_readings_reader old_reader{segment_name()};
+
+  erd::ipc::shared_readings_writer second{
+      segment_name(),
+      {{erd::domain_t::package, 0}, {erd::domain_t::cores, 0}}};
+  second.publish(0, sample(2, 2));
+
+  // the old mapping stays valid, on the old object
+  erd::readings_t readings;
+  std::error_code ec;
+  REQUIRE(old_reader.obtain_readings(readings, ec));
+  CHECK(readings.energy.count() == 1);
+
+  // destroying the replaced writer leaves the name to the new one
+  first.reset();
+  erd::ipc::shared_readings_reader reader{segment_name()};
+  CHECK(reader.size() == 2);
+  REQUIRE(reader.obtain_readings(readings, ec));
+  CHECK(readings.energy.count() == 2);
+}
+
+TEST_CASE("shared_readings: the writer removes its segment") {
+  {
+    erd::ipc::shared_readings_writer writer{segment_name(),
+                                            {{erd::domain_t::package, 0}}};
+  }
+  CHECK_THROWS(erd::ipc::shared_readings_reader{segment_name()});
+}
+
+TEST_CASE("shared_readings: segments of no writer are rejected") {
+  std::string name = segment_name();
+  int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+  REQUIRE(fd != -1);
+
+  // too small for a header, then a header never initialised
+  CHECK_THROWS(erd::ipc::shared_readings_reader{name});
+  REQUIRE(ftruncate(fd, 4096) == 0);
+  CHECK_THROWS(erd::ipc::shared_readings_reader{name});
+
+  close(fd);
+  shm_unlink(name.c_str());
+}
@@ -0,0 +1,84 @@
+#include <doctest/doctest.h>
+#include <erd/erd.hpp>
+
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+namespace {
+
+using namespace std::chrono_literals;
+
+erd::readings_t read(const erd::sim_reader_t &reader) {
+  erd::readings_t readings;
+  std::error_code ec;
+  REQUIRE(reader.obtain_readings(readings, ec));
+  return readings;
+}
+
+// the energy a constant power draws over a duration, in microjoules
+double energy_of(double watts, erd::clock_t::duration duration) {
+  return watts * std::chrono::duration<double, std::micro>(duration).count();
+}
+
+} // namespace
+
+TEST_CASE("sim_reader_t: draws the power of its model") {
+  erd::sim_model_t model;
+  model.power = 100;
+  model.granularity = 1ms;
+  erd::sim_reader_t reader{{erd::domain_t::package, 0}, model};
+  CHECK(reader.max_energy() == model.max_energy);
+
+  erd::readings_t before = read(reader);
+  std::this_thread::sleep_for(20ms);
+  erd::readings_t after = read(reader);
+  erd::difference_t diff = reader.subtract(after, before);
+  // the counter advances in whole updates, so it lags by up to one of them
+  double expected = energy_of(model.power, diff.duration);
+  CHECK(static_cast<double>(diff.energy_consumed.count()) >
+        expected - energy_of(model.power, model.granularity) - 1);
+  CHECK(static_cast<double>(diff.energy_consumed.count()) <
+        expected + energy_of(model.power, model.granularity) + 1);
+}
+
+TEST_CASE("sim_reader_t: wraps around at the maximum energy") {
+  erd::sim_model_t model;
+  model.power = 1;
+  model.granularity = 1ms;
+  // wraps every 50 ms
+  model.max_energy = erd::energy_t{50000};
+  erd::sim_reader_t reader{{erd::domain_t::dram, 1}, model};
+
+  erd::readings_t previous = read(reader);
+  for (int i = 0; i < 4; i++) {
+    std::this_thread::sleep_for(20ms);
+    erd::readings_t current = read(reader);
+    CHECK(current.energy < model.max_energy);
+    erd::difference_t diff = reader.subtract(current, previous);
+    double expected = energy_of(model.power, diff.duration);
+    CHECK(static_cast<double>(diff.energy_consumed.count()) > expected - 1001);
+    CHECK(static_cast<double>(diff.energy_consumed.count()) < expected + 1001);
+    previous = current;
+  }
+}
+
+TEST_CASE("sim_reader_t: copies share the counter") {
+  erd::sim_reader_t reader{{erd::domain_t::package, 0}, erd::sim_model_t{}};
+  erd::sim_reader_t copy = reader;
+  erd::readings_t first = read(reader);
+  std::this_thread::sleep_for(5ms);
+  erd::readings_t second = read(copy);
+  CHECK(second.energy >= first.energy);
+}
+
+TEST_CASE("sim_reader_t: is chosen by name from the registry") {
+  erd::reader_t reader{std::in_place, "sim",
+                       erd::attributes_t{erd::domain_t::cores, 2}};
+  CHECK(std::strcmp(reader.backend().name(), "sim") == 0);
+  CHECK(reader.attributes().domain == erd::domain_t::cores);
+  CHECK(reader.attributes().socket == 2);
+  erd::readings_t readings;
+  std::error_code ec;
+  CHECK(reader.obtain_readings(readings, ec));
+}
@@ -0,0 +1,140 @@
+#include "counting_reader.hpp"
+#include "test_server.hpp"
+
+#include <doctest/doctest.h>
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using namespace erd::ipc;
+using namespace std::chrono_literals;
+
+constexpr erd::attributes_t package{erd::domain_t::package, 0};
+
+void subscribe(test_server_t::socket_t &socket,
+               std::chrono::nanoseconds interval, subscription_mode_t mode,
+               uint32_t batch = 1) {
+  request_frame request;
+  request.begin(1);
+  request.add_subscribe(interval, mode, batch);
+  request.finish();
+  send(socket, request);
+  response_frame response;
+  receive(socket, response);
+  CHECK(response.header().request_id == 1);
+  response_operation_t op = next_operation(response);
+  CHECK(op.type == operation_type_t::subscribe);
+  CHECK(op.status == status_code_t::success);
+}
+
+// sends an unsubscribe request and receives the pushes written before its
+// response
+std::vector<response_frame> unsubscribe(test_server_t::socket_t &socket) {
+  request_frame request;
+  request.begin(2);
+  request.add_unsubscribe();
+  request.finish();
+  send(socket, request);
+  std::vector<response_frame> pushes;
+  for (;;) {
+    response_frame response;
+    receive(socket, response);
+    if (response.header().request_id == 2) {
+      CHECK(next_operation(response).status == status_code_t::success);
+      return pushes;
+    }
+    pushes.push_back(std::move(response));
+  }
+}
+
+} // namespace
+
+TEST_CASE("subscription: pushes readings until unsubscribed") {
+  auto state = std::make_shared<counting_state_t>();
+  std::vector<erd::reader_t> readers{make_counting_reader(package, state)};
+  test_server_t server{readers};
+  auto socket = server.connect();
+  subscribe(socket, 2ms, subscription_mode_t::readings);
+
+  std::error_code ec;
+  erd::readings_t previous{};
+  for (int i = 0; i < 3; i++) {
+    response_frame push;
+    receive(socket, push);
+    CHECK(push.header().request_id == 1);
+    erd::readings_t readings;
+    REQUIRE(next_operation(push).readings(readings, ec));
+    CHECK(readings.energy > previous.energy);
+    previous = readings;
+  }
+
+  unsubscribe(socket);
+  std::this_thread::sleep_for(20ms);
+  CHECK(socket.available() == 0);
+}
+
+TEST_CASE("subscription: pushes every sample in batches") {
+  auto state = std::make_shared<counting_state_t>();
+  std::vector<erd::reader_t> readers{make_counting_reader(package, state)};
+  test_server_t server{readers};
+  auto socket = server.connect();
+  subscribe(socket, 1ms, subscription_mode_t::samples, 4);
+
+  std::error_code ec;
+  std::vector<erd::readings_t> samples;
+  std::vector<erd::readings_t> batch;
+  while (samples.size() < 12) {
+    response_frame push;
+    receive(socket, push);
+    response_operation_t op = next_operation(push);
+    CHECK(op.type == operation_type_t::samples);
+    REQUIRE(op.samples(batch, ec));
+    CHECK(batch.size() >= 4);
+    samples.insert(samples.end(), batch.begin(), batch.end());
+  }
+  unsubscribe(socket);
+
+  // one sample per read, none lost between batches
+  for (std::size_t i = 0; i < samples.size(); i++) {
+    CHECK(samples[i].energy.count() == (i + 1) * 1000);
+  }
+}
+
+TEST_CASE("subscription: a slow client receives only the latest") {
+  auto state = std::make_shared<counting_state_t>();
+  std::vector<erd::reader_t> readers{make_counting_reader(package, state)};
+  test_server_t server{readers};
+  auto socket = server.connect();
+  subscribe(socket, 1ms, subscription_mode_t::difference);
+
+  // long enough for the pushes to fill the socket buffers, so that the
+  // samples taken while one is written are coalesced into the next
+  std::this_thread::sleep_for(1500ms);
+  std::error_code ec;
+  std::size_t pushes = 0;
+  std::uint64_t total = 0;
+  erd::difference_t diff{};
+  while (diff.energy_consumed.count() <= 1000 && pushes < 10000) {
+    response_frame push;
+    receive(socket, push);
+    REQUIRE(next_operation(push).difference(diff, ec));
+    pushes++;
+    total += diff.energy_consumed.count();
+  }
+  unsubscribe(socket);
+  std::uint64_t reads = state->reads;
+  MESSAGE("reads: " << reads << ", pushes: " << pushes);
+
+  CHECK(diff.energy_consumed.count() > 1000);
+  CHECK(pushes + 1 < reads);
+  // the differences still cover every sample since the one read when
+  // subscribing
+  CHECK(total % 1000 == 0);
+  CHECK(total > pushes * 1000);
+  CHECK(total <= (reads - 1) * 1000);
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cerrno>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <system_error>
+
+// a directory of files for a test, such as a fake sysfs or procfs tree,
+// removed with its contents on destruction
+class temp_dir_t {
+public:
+  temp_dir_t() {
+    std::string pattern =
+        (std::filesystem::temp_directory_path() / "erd-test-XXXXXX").string();
+    if (!mkdtemp(pattern.data())) {
+      throw std::system_error(errno, std::system_category(), pattern);
+    }
+    path_ = pattern;
+  }
+
+  ~temp_dir_t() {
+    std::error_code ec;
+    std::filesystem::remove_all(path_, ec);
+  }
+
+  temp_dir_t(const temp_dir_t &) = delete;
+  temp_dir_t &operator=(const temp_dir_t &) = delete;
+
+  // replaces the contents of a file, creating it and its directories
+  void write(const std::string &relative, const std::string &contents) const {
+    std::filesystem::path file = path_ / relative;
+    std::filesystem::create_directories(file.parent_path());
+    std::ofstream{file, std::ios::binary | std::ios::trunc} << contents;
+  }
+
+  [[nodiscard]] std::string path(const std::string &relative = {}) const {
+    return relative.empty() ? path_.string() : (path_ / relative).string();
+  }
+
+private:
+  std::filesystem::path path_;
+};
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "temp_dir.hpp"
+
+#include <erd/erd.hpp>
+#include <erd/ipc/message.hpp>
+#include <server.hpp>
+
+#include <asio/io_context.hpp>
+#include <asio/local/stream_protocol.hpp>
+#include <asio/read.hpp>
+#include <asio/write.hpp>
+
+#include <doctest/doctest.h>
+
+#include <thread>
+#include <vector>
+
+// a daemon server listening in a temporary directory, run on a thread of its
+// own; the readers must outlive it
+class test_server_t {
+public:
+  using socket_t = asio::local::stream_protocol::socket;
+
+  explicit test_server_t(const std::vector<erd::reader_t> &readers,
+                         erd::clock_t::duration max_age = {},
+                         const erd::reader_set_t *reader_set = nullptr)
+      : server_(context_, dir_.path("erd.sock"), readers, nullptr, max_age,
+                reader_set),
+        thread_([this] { context_.run(); }) {}
+
+  ~test_server_t() {
+    context_.stop();
+    thread_.join();
+  }
+
+  test_server_t(const test_server_t &) = delete;
+  test_server_t &operator=(const test_server_t &) = delete;
+
+  // a client connected to the server, using blocking calls
+  socket_t connect() {
+    socket_t socket{client_context_};
+    socket.connect(
+        asio::local::stream_protocol::endpoint{dir_.path("erd.sock")});
+    return socket;
+  }
+
+private:
+  temp_dir_t dir_;
+  asio::io_context context_;
+  asio::io_context client_context_;
+  erd::ipc::server server_;
+  std::thread thread_;
+};
+
+inline void send(test_server_t::socket_t &socket,
+                 const erd::ipc::detail::frame_common &frame) {
+  asio::write(socket, asio::buffer(frame.data(), frame.size()));
+}
+
+inline void receive(test_server_t::socket_t &socket,
+                    erd::ipc::response_frame &into) {
+  asio::read(socket, asio::buffer(into.header_buffer(),
+                                  erd::ipc::frame_header_t::size));
+  std::error_code ec;
+  REQUIRE(into.prepare_payload(ec));
+  asio::read(socket, asio::buffer(into.payload_buffer(), into.payload_size()));
+}
+
+// the next operation of a received frame, which must have one
+inline erd::ipc::response_operation_t
+next_operation(erd::ipc::response_frame &frame) {
+  erd::ipc::response_operation_t op{};
+  std::error_code ec;
+  REQUIRE(frame.next(op, ec));
+  return op;
+}
@@ -0,0 +1,120 @@
+#include "temp_dir.hpp"
+
+#include <doctest/doctest.h>
+#include <erd/trace.hpp>
+
+#include <filesystem>
+#include <vector>
+
+namespace {
+
+std::vector<erd::trace_series_t> two_series() {
+  return {{{erd::domain_t::package, 0}, erd::energy_t{262143328850}},
+          {{erd::domain_t::dram, 1}, erd::energy_t{65712999613}}};
+}
+
+// a millisecond apart, with a wrap of the counter in the middle
+std::vector<erd::readings_t> samples(std::size_t count, uint64_t first) {
+  std::vector<erd::readings_t> retval;
+  for (std::size_t i = 0; i < count; i++) {
+    uint64_t energy = first + i * 1000;
+    retval.push_back(erd::readings_t{
+        erd::time_point_t{std::chrono::milliseconds(i + 1)},
+        erd::energy_t{i == count / 2 ? energy % 3000 : energy}});
+  }
+  return retval;
+}
+
+void check_equal(const std::vector<erd::readings_t> &actual,
+                 const std::vector<erd::readings_t> &expected) {
+  REQUIRE(actual.size() == expected.size());
+  for (std::size_t i = 0; i < actual.size(); i++) {
+    CHECK(actual[i].timestamp == expected[i].timestamp);
+    CHECK(actual[i].energy == expected[i].energy);
+  }
+}
+
+} // namespace
+
+TEST_CASE("trace: samples written are read back") {
+  temp_dir_t dir;
+  std::string path = dir.path("run.erdt");
+  std::vector<erd::readings_t> first = samples(10, 5000);
+  std::vector<erd::readings_t> second = samples(3, 0);
+
+  for (erd::trace_encoding_t encoding :
+       {erd::trace_encoding_t::raw, erd::trace_encoding_t::compressed}) {
+    {
+      erd::trace_writer_t writer{path, two_series(), 4, encoding};
+      std::error_code ec;
+      for (const erd::readings_t &readings : first) {
+        REQUIRE(writer.append(0, readings, ec));
+      }
+      for (const erd::readings_t &readings : second) {
+        REQUIRE(writer.append(1, readings, ec));
+      }
+      CHECK_FALSE(writer.append(2, first.front(), ec));
+      REQUIRE(writer.close(ec));
+      CHECK_FALSE(writer.append(0, first.front(), ec));
+    }
+
+    erd::trace_reader_t trace{path};
+    CHECK(trace.complete());
+    CHECK(trace.encoding() == encoding);
+    REQUIRE(trace.size() == 2);
+    CHECK(trace.series(1).attributes.domain == erd::domain_t::dram);
+    CHECK(trace.series(1).attributes.socket == 1);
+    CHECK(trace.series(1).max_energy.count() == 65712999613);
+    CHECK(trace.sample_count(0) == first.size());
+    check_equal(trace.readings(0), first);
+    check_equal(trace.readings(1), second);
+
+    // a time range within and across chunks
+    std::vector<erd::readings_t> range =
+        trace.readings(0, first[3].timestamp, first[6].timestamp);
+    check_equal(range, {first.begin() + 3, first.begin() + 7});
+    std::size_t spanned = 0;
+    for (const erd::trace_span_t &span :
+         trace.spans(0, first[3].timestamp, first[6].timestamp)) {
+      spanned += span.count;
+    }
+    CHECK(spanned == 4);
+  }
+}
+
+TEST_CASE("trace: a trace never closed is recovered by scanning") {
+  temp_dir_t dir;
+  std::string path = dir.path("run.erdt");
+  std::string copy = dir.path("crashed.erdt");
+  std::vector<erd::readings_t> first = samples(10, 5000);
+
+  for (erd::trace_encoding_t encoding :
+       {erd::trace_encoding_t::raw, erd::trace_encoding_t::compressed}) {
+    erd::trace_writer_t writer{path, two_series(), 4, encoding};
+    std::error_code ec;
+    for (const erd::readings_t &readings : first) {
+      REQUIRE(writer.append(0, readings, ec));
+    }
+    // three chunks, the last of them partial
+    REQUIRE(writer.flush(ec));
+
+    // what a crash would leave behind, without the index
+    std::filesystem::copy_file(
+        path, copy, std::filesystem::copy_options::overwrite_existing);
+    {
+      erd::trace_reader_t trace{copy};
+      CHECK_FALSE(trace.complete());
+      check_equal(trace.readings(0), first);
+    }
+
+    // and with the last chunk cut short by the crash
+    std::filesystem::resize_file(copy, std::filesystem::file_size(copy) - 8);
+    {
+      erd::trace_reader_t trace{copy};
+      CHECK_FALSE(trace.complete());
+      check_equal(trace.readings(0), {first.begin(), first.begin() + 8});
+      CHECK(trace.readings(1).empty());
+    }
+    REQUIRE(writer.close(ec));
+  }
+}